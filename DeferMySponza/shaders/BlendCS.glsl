@@ -0,0 +1,24 @@
+layout(local_size_x = SMAA_TILE_SIZE, local_size_y = SMAA_TILE_SIZE) in;
+
+uniform sampler2D Input;
+uniform sampler2D Area;
+uniform sampler2D Search;
+
+layout(rgba8) writeonly uniform image2D Output;
+
+void main(void)
+{
+	// Dispatched once per edge tile.
+	ivec2 pixel = unpackTile(Tiles[gl_WorkGroupID.x]) * SMAA_TILE_SIZE + ivec2(gl_LocalInvocationID.xy);
+	if (any(greaterThanEqual(pixel, ivec2(ViewportMetrics.zw))))
+	{
+		return;
+	}
+
+	vec2 texcoord = (vec2(pixel) + 0.5) * SMAA_RT_METRICS.xy;
+	vec2 pixcoord;
+	vec4 offset[3];
+	SMAABlendingWeightCalculationVS(texcoord, pixcoord, offset);
+
+	imageStore(Output, pixel, SMAABlendingWeightCalculationPS(texcoord, pixcoord, offset, Input, Area, Search, vec4(0.0)));
+}
@@ -7,7 +7,7 @@ out vec4 offset[3];
 
 void main(void)
 {
-    texcoord = UV0;
+    texcoord = UV0 * ViewportMetrics.xy;
     SMAABlendingWeightCalculationVS(texcoord, pixcoord, offset);
     gl_Position = vec4(Position, 0.0, 1.0);
 }
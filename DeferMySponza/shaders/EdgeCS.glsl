@@ -0,0 +1,41 @@
+layout(local_size_x = SMAA_TILE_SIZE, local_size_y = SMAA_TILE_SIZE) in;
+
+uniform sampler2D Input;
+
+layout(rgba8) writeonly uniform image2D Output;
+
+shared uint tileHasEdge;
+
+void main(void)
+{
+	if (gl_LocalInvocationIndex == 0u)
+	{
+		tileHasEdge = 0u;
+	}
+	barrier();
+
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	if (all(lessThan(pixel, ivec2(ViewportMetrics.zw))))
+	{
+		vec2 texcoord = (vec2(pixel) + 0.5) * SMAA_RT_METRICS.xy;
+		vec4 offset[3];
+		SMAAEdgeDetectionVS(texcoord, offset);
+
+		vec2 edges = SMAAColorEdgeDetectionPS(texcoord, offset, Input);
+		imageStore(Output, pixel, vec4(edges, 0.0, 0.0));
+
+		if (dot(edges, vec2(1.0, 1.0)) > 0.0)
+		{
+			tileHasEdge = 1u;
+		}
+	}
+	barrier();
+
+	// One invocation appends the tile and grows both indirect commands.
+	if (gl_LocalInvocationIndex == 0u && tileHasEdge != 0u)
+	{
+		uint index = atomicAdd(DispatchGroupsX, 1u);
+		atomicAdd(DrawInstanceCount, 1u);
+		Tiles[index] = gl_WorkGroupID.x | (gl_WorkGroupID.y << 16);
+	}
+}
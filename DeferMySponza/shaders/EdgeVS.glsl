@@ -6,7 +6,7 @@ out vec4 offset[3];
 
 void main(void)
 {
-    texcoord = UV0;
+    texcoord = UV0 * ViewportMetrics.xy;
     SMAAEdgeDetectionVS(texcoord, offset);
     gl_Position = vec4(Position, 0.0, 1.0);
 }
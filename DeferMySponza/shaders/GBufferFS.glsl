@@ -1,11 +1,14 @@
 out vec3 GBufferPosition;
 out vec3 GBufferNormal;
 out uint GBufferMaterial;
+out vec2 GBufferVelocity;
 
 in vec3 P;
 in vec3 N;
 in vec2 UV;
 flat in uint MaterialId;
+in vec4 CurrentClip;
+in vec4 PreviousClip;
 
 void main(void)
 {
@@ -13,4 +16,7 @@ void main(void)
     GBufferPosition = P;
     GBufferNormal = normalize(N);
     GBufferMaterial = uint(MaterialId);
+
+	// Screen UV movement since last frame, TAA subtracts this to find the pixel's history.
+	GBufferVelocity = (CurrentClip.xy / CurrentClip.w - PreviousClip.xy / PreviousClip.w) * 0.5;
 }
\ No newline at end of file
@@ -4,6 +4,8 @@ layout(std140) uniform PerFrameData
     mat4 ViewProjectionMatrix;
     vec3 EyePosition;
     int Padding0;
+    mat4 UnjitteredViewProjectionMatrix;
+    mat4 PreviousViewProjectionMatrix;
 };
 
 in vec3 Position;
@@ -15,6 +17,8 @@ out vec3 P;
 out vec3 N;
 out vec2 UV;
 flat out uint MaterialId;
+out vec4 CurrentClip;
+out vec4 PreviousClip;
 
 void main(void)
 { 
@@ -34,4 +38,8 @@ void main(void)
 
     // World position.
 	gl_Position = ViewProjectionMatrix * instance.ModelTransform * vec4(Position, 1.0);
+
+	// Unjittered clip positions this frame and last, interpolated for per pixel motion vectors.
+	CurrentClip = UnjitteredViewProjectionMatrix * vec4(P, 1.0);
+	PreviousClip = PreviousViewProjectionMatrix * instance.PreviousModelTransform * vec4(Position, 1.0);
 }
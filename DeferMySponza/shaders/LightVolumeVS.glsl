@@ -4,6 +4,7 @@ layout(std140) uniform PerFrameData
     mat4 ViewProjectionMatrix;
     vec3 EyePosition;
     int Padding0;
+    mat4 UnjitteredViewProjectionMatrix;
 };
 
 layout(std140) uniform LightData
@@ -15,6 +16,6 @@ in vec3 Position;
 
 void main(void)
 {
-    // World position.
-	gl_Position = ViewProjectionMatrix * light.ModelTransform * vec4(Position, 1.0);
+    // World position, without TAA's jitter so volumes match the scissors culled against the same view.
+	gl_Position = UnjitteredViewProjectionMatrix * light.ModelTransform * vec4(Position, 1.0);
 }
@@ -24,6 +24,13 @@ uniform sampler2DRect Positions;
 uniform sampler2DRect Normals;
 uniform usampler2DRect MaterialIDs;
 
+#if defined(POINT_SHADOW)
+uniform samplerCubeArrayShadow PointShadowMaps;
+
+// Offset against the stored distance, as a fraction of the light's range.
+const float ShadowBias = 0.005;
+#endif
+
 out vec4 OutColour;
 
 void main(void)
@@ -31,7 +38,15 @@ void main(void)
     vec3 P = texture(Positions, gl_FragCoord.xy).xyz;
     vec3 N = texture(Normals, gl_FragCoord.xy).xyz;
     uint M = texture(MaterialIDs, gl_FragCoord.xy).x;
-	OutColour = vec4(pointLight(light, P, N, M), 1.0);
+	vec3 colour = pointLight(light, P, N, M);
+
+#if defined(POINT_SHADOW)
+    // Cube shadows hold distance to the light over its range, compared with a hardware 2x2 filter.
+    vec3 lightToPixel = P - light.Position;
+    colour *= texture(PointShadowMaps, vec4(lightToPixel, light.ShadowSlot), length(lightToPixel) / light.Range - ShadowBias);
+#endif
+
+	OutColour = vec4(colour, 1.0);
 }
 
 vec3 pointLight(const Light light, vec3 P, vec3 N, uint M)
@@ -0,0 +1,18 @@
+#version 330
+
+layout(std140) uniform PointShadowData
+{
+    mat4 FaceViewProjections[6];
+    vec3 LightPosition;
+    float LightRange;
+    int FirstLayer;
+    uvec4 FaceMasks[25];
+};
+
+in vec3 WorldPosition;
+
+void main(void)
+{
+    // Distance is stored rather than projected depth so lighting can compare without knowing the face.
+    gl_FragDepth = length(WorldPosition - LightPosition) / LightRange;
+}
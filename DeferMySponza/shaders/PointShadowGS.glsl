@@ -0,0 +1,38 @@
+#version 400
+
+// One invocation per cube face.
+layout(triangles, invocations = 6) in;
+layout(triangle_strip, max_vertices = 3) out;
+
+layout(std140) uniform PointShadowData
+{
+    mat4 FaceViewProjections[6];
+    vec3 LightPosition;
+    float LightRange;
+    int FirstLayer;
+    uvec4 FaceMasks[25];
+};
+
+in vec3 VertexWorldPosition[];
+flat in uint VertexInstance[];
+
+out vec3 WorldPosition;
+
+void main(void)
+{
+    // Faces the instance was culled from on the CPU emit nothing.
+    uint mask = FaceMasks[VertexInstance[0] / 4u][VertexInstance[0] % 4u];
+    if ((mask & (1u << uint(gl_InvocationID))) == 0u)
+    {
+        return;
+    }
+
+    for (int i = 0; i < 3; ++i)
+    {
+        gl_Layer = FirstLayer + gl_InvocationID;
+        WorldPosition = VertexWorldPosition[i];
+        gl_Position = FaceViewProjections[gl_InvocationID] * vec4(VertexWorldPosition[i], 1.0);
+        EmitVertex();
+    }
+    EndPrimitive();
+}
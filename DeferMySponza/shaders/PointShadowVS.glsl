@@ -0,0 +1,49 @@
+layout(std140) uniform PerFrameData
+{
+	MeshInstanceData Instances[100];
+	mat4 ViewProjectionMatrix;
+	vec3 EyePosition;
+	int Padding0;
+};
+
+layout(std140) uniform PointShadowData
+{
+    mat4 FaceViewProjections[6];
+    vec3 LightPosition;
+    float LightRange;
+    int FirstLayer;
+    uvec4 FaceMasks[25];
+};
+
+in vec3 Position;
+in vec3 Normal;
+in vec2 UV0;
+in uint InstanceID;
+
+#if defined(SINGLE_FACE)
+
+// Face being rendered when the cube is drawn one face at a time.
+uniform int Face;
+
+out vec3 WorldPosition;
+
+void main(void)
+{
+    vec4 world = Instances[InstanceID].ModelTransform * vec4(Position, 1.0);
+    WorldPosition = world.xyz;
+    gl_Position = FaceViewProjections[Face] * world;
+}
+
+#else
+
+// Projection is left to the geometry shader, which emits each triangle once per face it's needed on.
+out vec3 VertexWorldPosition;
+flat out uint VertexInstance;
+
+void main(void)
+{
+    VertexWorldPosition = (Instances[InstanceID].ModelTransform * vec4(Position, 1.0)).xyz;
+    VertexInstance = InstanceID;
+}
+
+#endif
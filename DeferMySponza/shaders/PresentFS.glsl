@@ -0,0 +1,16 @@
+uniform sampler2D Input;
+
+// Part of the input that's presented, which can be allocated larger than what was rendered into it.
+uniform vec2 InputScale;
+
+in vec2 texcoord;
+
+out vec4 OutColour;
+
+void main(void)
+{
+	// Sampled by UV so the input can be upscaled on the way to the screen, kept half a texel inside the rendered
+	// part so filtering never reaches past it.
+	vec2 uv = min(texcoord * InputScale, InputScale - 0.5 / vec2(textureSize(Input, 0)));
+	OutColour = tonemap(texture(Input, uv));
+}
@@ -0,0 +1,12 @@
+#version 330
+
+in vec2 Position;
+in vec2 UV0;
+
+out vec2 texcoord;
+
+void main(void)
+{
+	texcoord = UV0;
+	gl_Position = vec4(Position, 0.0, 1.0);
+}
@@ -8,5 +8,5 @@ out vec4 OutColour;
 
 void main()
 {
-    OutColour = SMAANeighborhoodBlendingPS(texcoord, offset, Input, Search);
+    OutColour = tonemap(SMAANeighborhoodBlendingPS(texcoord, offset, Input, Search));
 }
\ No newline at end of file
@@ -0,0 +1,13 @@
+out vec2 texcoord;
+out vec4 offset;
+
+void main(void)
+{
+	// One instance per edge tile. Pixels left of and below a tile read its blend weights so the quad grows by one pixel there.
+	vec2 corner = vec2(gl_VertexID == 1 || gl_VertexID == 2, gl_VertexID >= 2);
+	vec2 pixel = vec2(unpackTile(Tiles[gl_InstanceID]) * SMAA_TILE_SIZE) - 1.0 + corner * (SMAA_TILE_SIZE + 1.0);
+
+	texcoord = pixel * SMAA_RT_METRICS.xy;
+	SMAANeighborhoodBlendingVS(texcoord, offset);
+	gl_Position = vec4(pixel / ViewportMetrics.zw * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -6,7 +6,7 @@ out vec4 offset;
 
 void main(void)
 {
-    texcoord = UV0;
+    texcoord = UV0 * ViewportMetrics.xy;
     SMAANeighborhoodBlendingVS(texcoord, offset);
     gl_Position = vec4(Position, 0.0, 1.0);
 }
\ No newline at end of file
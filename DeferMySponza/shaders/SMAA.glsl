@@ -595,9 +595,13 @@ SamplerState PointSampler { Filter = MIN_MAG_MIP_POINT; AddressU = Clamp; Addres
 #error you must define the shading language: SMAA_HLSL_*, SMAA_GLSL_* or SMAA_CUSTOM_SL
 #endif
 
+// Targets are allocated at a capacity that can be larger than the viewport. The metrics describe the targets, so
+// every offset is a texel, and the viewport metrics hold the part of them the viewport covers as a UV scale in xy
+// and a size in pixels in zw.
 layout(std140) uniform ViewportData
 {
     vec4 SMAA_RT_METRICS;
+    vec4 ViewportMetrics;
 };
 
 //-----------------------------------------------------------------------------
@@ -0,0 +1,22 @@
+#version 430
+
+// Edge tiles are SMAA_TILE_SIZE pixels square, this must match g_smaaTileSize.
+#define SMAA_TILE_SIZE 8
+
+// Indirect commands followed by the list of tiles containing edges. Tiles are packed as x | (y << 16).
+layout(std430) buffer SMAATileData
+{
+	uint DispatchGroupsX;
+	uint DispatchGroupsY;
+	uint DispatchGroupsZ;
+	uint DrawVertexCount;
+	uint DrawInstanceCount;
+	uint DrawFirstVertex;
+	uint DrawBaseInstance;
+	uint Tiles[];
+};
+
+ivec2 unpackTile(uint tile)
+{
+	return ivec2(tile & 0xffffu, tile >> 16);
+}
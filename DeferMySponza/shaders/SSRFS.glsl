@@ -4,11 +4,14 @@ layout(std140) uniform PerFrameData
     mat4 ViewProjectionMatrix;
     vec3 EyePosition;
     int Padding0;
+    mat4 UnjitteredViewProjectionMatrix;
 };
 
+// Texel size and size of the targets, then the UV scale and size in pixels of the part the viewport covers.
 layout(std140) uniform ViewportData
 {
     vec4 RTData;
+    vec4 ViewportMetrics;
 };
 
 uniform sampler2DRect Positions;
@@ -18,6 +21,9 @@ uniform usampler2DRect MaterialIDs;
 uniform sampler2D Input;
 uniform sampler2D Search;
 
+// Maximum march and refinement steps, lowered by the quality governor.
+uniform int StepCount;
+
 out vec4 OutColour;
 
 bool outOfView(vec3 pos)
@@ -26,9 +32,10 @@ bool outOfView(vec3 pos)
     return value;
 }
 
+// Reflected rays are reprojected without TAA's jitter, so their hits don't shift from frame to frame.
 vec4 toScreenSpace(vec4 input)
 {
-	vec4 pos = ViewProjectionMatrix * input;
+	vec4 pos = UnjitteredViewProjectionMatrix * input;
 	pos /= pos.w;
 	pos += 1.0;
 	pos /= 2.0;
@@ -36,15 +43,21 @@ vec4 toScreenSpace(vec4 input)
 	return pos;
 }
 
+// Viewport UVs to the colour target's, kept half a texel inside the viewport so filtering never reaches past it.
+vec4 sampleInput(vec2 posUV)
+{
+	return texture(Input, min(posUV * ViewportMetrics.xy, ViewportMetrics.xy - RTData.xy * 0.5));
+}
+
 bool CheckPos(vec3 worldPos, vec2 posUV, out float l1, out float l2)
 {
 	l1 = length(worldPos - EyePosition);
-	vec3 rayFragPos = texture(Positions, posUV * RTData.zw).xyz;
+	vec3 rayFragPos = texture(Positions, posUV * ViewportMetrics.zw).xyz;
 	l2 = length(rayFragPos - EyePosition);
 	return l1 >= l2;
 }
 
-void main(void)
+vec4 addReflection(vec4 colour)
 {
     uint M = texture(MaterialIDs, gl_FragCoord.xy).x;
 	// Special material added for the sake of reflecting only on sponza's floor.
@@ -52,14 +65,13 @@ void main(void)
     {
 		const float Gloss = 0.25f;
 		float stepSize = 1;
-		const int stepCount = 100;
 		vec3 P = texture(Positions, gl_FragCoord.xy).xyz;
 		vec3 N = texture(Normals, gl_FragCoord.xy).xyz;
 
         vec3 R = reflect(P - EyePosition, N);
         vec3 Rdir = normalize(R); 
 		vec3 Pos = P;
-        for (int i = 1; i < stepCount; ++i)
+        for (int i = 1; i < StepCount; ++i)
         {
 			Pos += Rdir * stepSize;
 			
@@ -77,14 +89,13 @@ void main(void)
             {
 				if (abs(l1 - l2) <= 0.5)
 				{
-					OutColour = texture(Input, rasterPos.xy) * Gloss;
-					return;
+					return colour + sampleInput(rasterPos.xy) * Gloss;
 				}
 				else
 				{
 					stepSize *= -1.0f;
 					// We are beyond the position but want to resolve a more accurate result via binary searching.
-					for (int j = 0; j < stepCount; ++j)
+					for (int j = 0; j < StepCount; ++j)
 					{
 						stepSize *= 0.5f;
 						Pos += Rdir * stepSize; 
@@ -101,11 +112,10 @@ void main(void)
 
 						if (abs(l1 - l2) <= 0.5)
 						{
-							OutColour = texture(Input, rasterPos.xy) * Gloss;
-							return;
+							return colour + sampleInput(rasterPos.xy) * Gloss;
 						}
 					}
-					return;
+					return colour;
 				}
             }
 			else
@@ -114,4 +124,12 @@ void main(void)
 			}
         }
     }
+
+    return colour;
+}
+
+void main(void)
+{
+	// Every pixel is written so the pass can target a fresh framebuffer, reflections are added on top.
+	OutColour = tonemap(addReflection(texelFetch(Input, ivec2(gl_FragCoord.xy), 0)));
 }
\ No newline at end of file
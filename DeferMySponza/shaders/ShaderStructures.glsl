@@ -4,6 +4,7 @@
 struct MeshInstanceData
 {
 	mat4 ModelTransform;
+	mat4 PreviousModelTransform;
 	uint MaterialIndex;
 	int Padding1;
 	int Padding2;
@@ -44,4 +45,8 @@ struct Light
     vec3 Direction;
     int CastsShadows;
 	mat4 ModelTransform;
+    int ShadowSlot;
+    int Padding0;
+    int Padding1;
+    int Padding2;
 };
\ No newline at end of file
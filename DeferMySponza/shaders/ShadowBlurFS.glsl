@@ -0,0 +1,21 @@
+#version 330
+
+uniform sampler2D Input;
+
+// One texel along the axis being blurred.
+uniform vec2 Direction;
+
+out vec4 OutColour;
+
+void main(void)
+{
+    vec2 uv = gl_FragCoord.xy / vec2(textureSize(Input, 0));
+    vec2 texel = Direction / vec2(textureSize(Input, 0));
+
+    // 9 tap Gaussian folded into 5 bilinear fetches.
+    OutColour = texture(Input, uv) * 0.2270270270;
+    OutColour += texture(Input, uv + texel * 1.3846153846) * 0.3162162162;
+    OutColour += texture(Input, uv - texel * 1.3846153846) * 0.3162162162;
+    OutColour += texture(Input, uv + texel * 3.2307692308) * 0.0702702703;
+    OutColour += texture(Input, uv - texel * 3.2307692308) * 0.0702702703;
+}
@@ -0,0 +1,27 @@
+#version 330
+
+// Must match SpotShadowFS.glsl.
+const vec2 WarpExponents = vec2(40.0, 5.0);
+
+uniform sampler2D Input;
+
+out vec4 OutColour;
+
+vec4 moments(float depth)
+{
+    depth = depth * 2.0 - 1.0;
+    float positive = exp(WarpExponents.x * depth);
+    float negative = -exp(-WarpExponents.y * depth);
+    return vec4(positive, positive * positive, negative, negative * negative);
+}
+
+void main(void)
+{
+    // The moments map is half the depth map's resolution, each texel averages the moments of the 2x2 depths under it.
+    ivec2 texel = ivec2(gl_FragCoord.xy) * 2;
+
+    OutColour = (moments(texelFetch(Input, texel, 0).r) +
+                 moments(texelFetch(Input, texel + ivec2(1, 0), 0).r) +
+                 moments(texelFetch(Input, texel + ivec2(0, 1), 0).r) +
+                 moments(texelFetch(Input, texel + ivec2(1, 1), 0).r)) * 0.25;
+}
@@ -23,12 +23,18 @@ layout (std140) uniform ShadowData
 };
 
 vec3 spotLight(Light light, vec3 P, vec3 N, uint M);
+float shadowVisibility(vec3 lightSpacePos);
 vec3 specularLight(const vec3 diffuseIntensity, const vec3 lightToPixel, vec3 P, vec3 N, uint M);
 
 uniform sampler2DRect Positions;
 uniform sampler2DRect Normals;
 uniform usampler2DRect MaterialIDs;
+// The filtering tier is picked by the define the shader is compiled with, see ShaderManager.
+#if defined(SHADOW_PCF)
+uniform sampler2DShadow ShadowMap;
+#else
 uniform sampler2D ShadowMap;
+#endif
 
 out vec4 OutColour;
 
@@ -38,22 +44,80 @@ void main(void)
     vec3 N = texture(Normals, gl_FragCoord.xy).xyz;
     uint M = texture(MaterialIDs, gl_FragCoord.xy).x;
 
-	float visibility = 1.0f;
-
 	vec4 lightSpacePos = ShadowVP * vec4(P, 1);
     // Sort bias.
 	lightSpacePos = lightSpacePos / lightSpacePos.w;
 	lightSpacePos = lightSpacePos / 2 + 0.5;
-	if (texture(ShadowMap, lightSpacePos.xy).r < lightSpacePos.z)
-	{
-		visibility = 0.0f;
-	}
+	float visibility = shadowVisibility(lightSpacePos.xyz);
 
 	vec3 color = spotLight(light, P, N, M) * visibility;
 
 	OutColour = vec4(color, 1.0);
 }
 
+#if defined(SHADOW_PCF)
+
+// Poisson disk in texels, each tap is a hardware filtered 2x2 comparison.
+const int PoissonTaps = 16;
+const vec2 PoissonDisk[PoissonTaps] = vec2[](
+    vec2(-0.942, -0.399), vec2(0.946, -0.769), vec2(-0.094, -0.929), vec2(0.345, 0.294),
+    vec2(-0.916, 0.458), vec2(-0.815, -0.879), vec2(-0.383, 0.277), vec2(0.975, 0.756),
+    vec2(0.443, -0.975), vec2(0.537, -0.474), vec2(-0.265, -0.419), vec2(0.792, 0.191),
+    vec2(-0.242, 0.997), vec2(-0.814, 0.914), vec2(0.200, 0.786), vec2(0.144, -0.141));
+const float PoissonRadius = 2.0;
+
+float shadowVisibility(vec3 lightSpacePos)
+{
+    vec2 texel = PoissonRadius / vec2(textureSize(ShadowMap, 0));
+    float visibility = 0.0;
+    for (int i = 0; i < PoissonTaps; ++i)
+    {
+        visibility += texture(ShadowMap, vec3(lightSpacePos.xy + PoissonDisk[i] * texel, lightSpacePos.z));
+    }
+    return visibility / PoissonTaps;
+}
+
+#elif defined(SHADOW_EVSM)
+
+// Must match ShadowMomentsFS.glsl.
+const vec2 WarpExponents = vec2(40.0, 5.0);
+
+// Fraction of the Chebyshev bound cut off to hide light bleeding.
+const float BleedReduction = 0.2;
+
+float chebyshev(vec2 moments, float depth)
+{
+    if (depth <= moments.x)
+    {
+        return 1.0;
+    }
+
+    float variance = max(moments.y - moments.x * moments.x, 0.00001);
+    float d = depth - moments.x;
+    float pMax = variance / (variance + d * d);
+    return clamp((pMax - BleedReduction) / (1.0 - BleedReduction), 0.0, 1.0);
+}
+
+float shadowVisibility(vec3 lightSpacePos)
+{
+    // Prefiltered, so a single trilinear fetch covers the whole filter footprint.
+    vec4 moments = texture(ShadowMap, lightSpacePos.xy);
+
+    float depth = lightSpacePos.z * 2.0 - 1.0;
+    vec2 warped = vec2(exp(WarpExponents.x * depth), -exp(-WarpExponents.y * depth));
+
+    return min(chebyshev(moments.xy, warped.x), chebyshev(moments.zw, warped.y));
+}
+
+#else
+
+float shadowVisibility(vec3 lightSpacePos)
+{
+    return texture(ShadowMap, lightSpacePos.xy).r < lightSpacePos.z ? 0.0 : 1.0;
+}
+
+#endif
+
 vec3 spotLight(Light light, vec3 P, vec3 N, uint M)
 {
 	// Vector from pixel to light.
@@ -0,0 +1,71 @@
+// Texel size and size of the input target, then the UV scale and size in pixels of the part rendered into.
+layout(std140) uniform ViewportData
+{
+    vec4 RTData;
+    vec4 ViewportMetrics;
+};
+
+uniform sampler2D Input;
+uniform sampler2D History;
+uniform sampler2DRect Velocity;
+
+// Part of the history covered by the output, as it's allocated with room to grow too.
+uniform vec2 HistoryScale;
+
+// Next frame's history, stored alongside the output so the resolve doesn't need copying to the screen.
+layout(rgba16f) writeonly uniform image2D Output;
+
+out vec4 OutColour;
+
+// Weight of the current frame in the accumulated history.
+const float FeedbackWeight = 0.1;
+
+// Output UVs to the input target's, kept half a texel inside the rendered part so filtering never reaches past it.
+vec4 sampleInput(vec2 uv)
+{
+	return texture(Input, min(uv * ViewportMetrics.xy, ViewportMetrics.xy - RTData.xy * 0.5));
+}
+
+// The history stays HDR, only the output is tonemapped.
+void writeResolved(vec4 colour)
+{
+	imageStore(Output, ivec2(gl_FragCoord.xy), colour);
+	OutColour = tonemap(colour);
+}
+
+void main(void)
+{
+	// Everything is addressed in output UVs so the input and velocity can be a lower resolution than the output,
+	// and scaled to whatever part of each target is in use.
+	vec2 uv = gl_FragCoord.xy / (vec2(textureSize(History, 0)) * HistoryScale);
+	vec4 current = sampleInput(uv);
+
+	// Neighbourhood of the current frame, history outside of its range is stale and gets clamped.
+	vec2 inputTexel = RTData.xy / ViewportMetrics.xy;
+	vec4 minColour = current;
+	vec4 maxColour = current;
+	for (int y = -1; y <= 1; ++y)
+	{
+		for (int x = -1; x <= 1; ++x)
+		{
+			vec4 neighbour = sampleInput(uv + vec2(x, y) * inputTexel);
+			minColour = min(minColour, neighbour);
+			maxColour = max(maxColour, neighbour);
+		}
+	}
+
+	// Velocity is in the GBuffer, addressed in the pixels the input was rendered alongside.
+	vec2 velocity = texture(Velocity, uv * ViewportMetrics.zw).xy;
+	vec2 historyUV = uv - velocity;
+
+	// Disoccluded from off screen so there is no history to use.
+	if (any(lessThan(historyUV, vec2(0.0))) || any(greaterThan(historyUV, vec2(1.0))))
+	{
+		writeResolved(current);
+		return;
+	}
+
+	vec2 historyLimit = HistoryScale - 0.5 / vec2(textureSize(History, 0));
+	vec4 history = clamp(texture(History, min(historyUV * HistoryScale, historyLimit)), minColour, maxColour);
+	writeResolved(mix(history, current, FeedbackWeight));
+}
@@ -0,0 +1,17 @@
+
+// Set per draw, only the pass presenting to the screen has a non zero exposure.
+uniform float Exposure;
+
+// Exposes and tonemaps HDR light accumulation to display range, or passes colour through when Exposure is 0.
+vec4 tonemap(vec4 colour)
+{
+	if (Exposure <= 0.0)
+	{
+		return colour;
+	}
+
+	// Filmic curve fitted to ACES (Narkowicz 2015).
+	vec3 x = colour.rgb * Exposure;
+	vec3 mapped = clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+	return vec4(mapped, colour.a);
+}
@@ -0,0 +1,91 @@
+#include "DrawSorter.hpp"
+
+#include <sponza/sponza.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace MLK
+{
+    namespace
+    {
+        // Fields of a key from the top: band, material, mesh and instance.
+        const GLuint g_bandBits = 10;
+        const GLuint g_materialBits = 12;
+        const GLuint g_meshBits = 20;
+        const GLuint g_instanceBits = 22;
+
+        // Distances are banded over this many doublings back from the furthest instance, about 4% apart.
+        // Anything nearer shares the first band.
+        const float g_octaves = 16.f;
+        const float g_bandsPerOctave = 16.f;
+
+        GLuint64 field(GLuint value, GLuint bits)
+        {
+            return (GLuint64)(value & ((1u << bits) - 1));
+        }
+    }
+
+    DrawSorter::DrawSorter(const sponza::Context& scene) :
+        m_scene(scene)
+    {
+    }
+
+    void DrawSorter::sortFromPoint(const std::vector<glm::vec4>& bounds, const glm::vec3& eye, std::vector<GLuint>& instances)
+    {
+        const auto materialIds = m_scene.getInstanceMaterialIds();
+        const auto meshIds = m_scene.getInstanceMeshIds();
+
+        // Spheres the eye is inside are at no distance, they're drawn first.
+        m_distances.resize(instances.size());
+        auto furthest = 0.f;
+        for (size_t i = 0; i < instances.size(); ++i)
+        {
+            const auto& sphere = bounds[instances[i]];
+            m_distances[i] = std::max(glm::length(glm::vec3(sphere) - eye) - sphere.w, 0.f);
+            furthest = std::max(furthest, m_distances[i]);
+        }
+
+        const auto nearest = furthest * std::exp2(-g_octaves);
+        m_keys.resize(instances.size());
+        for (size_t i = 0; i < instances.size(); ++i)
+        {
+            const auto instance = instances[i];
+            const auto band = m_distances[i] <= nearest ? 0u :
+                (GLuint)(std::log2(m_distances[i] / nearest) * g_bandsPerOctave) + 1;
+            m_keys[i] = makeKey(std::min(band, (1u << g_bandBits) - 1), materialIds[instance], meshIds[instance], instance);
+        }
+
+        std::sort(m_keys.begin(), m_keys.end());
+
+        ++m_stats.views;
+        m_stats.instances += (GLuint)instances.size();
+        for (size_t i = 0; i < m_keys.size(); ++i)
+        {
+            instances[i] = (GLuint)field((GLuint)m_keys[i], g_instanceBits);
+            if (i == 0 || meshIds[instances[i]] != meshIds[instances[i - 1]])
+            {
+                ++m_stats.meshRuns;
+            }
+            if (i == 0 || materialIds[instances[i]] != materialIds[instances[i - 1]])
+            {
+                ++m_stats.materialRuns;
+            }
+        }
+    }
+
+    GLuint64 DrawSorter::makeKey(GLuint band, GLuint material, GLuint mesh, GLuint instance)
+    {
+        return field(band, g_bandBits) << (g_materialBits + g_meshBits + g_instanceBits) |
+            field(material, g_materialBits) << (g_meshBits + g_instanceBits) |
+            field(mesh, g_meshBits) << g_instanceBits |
+            field(instance, g_instanceBits);
+    }
+
+    void DrawSorter::printStats() const
+    {
+        std::cout << "Draw order: " << m_stats.instances << " instances sorted over " << m_stats.views << " views into "
+            << m_stats.meshRuns << " commands and " << m_stats.materialRuns << " material runs" << std::endl;
+    }
+}
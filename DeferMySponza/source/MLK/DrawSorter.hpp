@@ -0,0 +1,59 @@
+#pragma once
+
+#include <tgl/tgl.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace sponza
+{
+    class Context;
+}
+
+namespace MLK
+{
+    /// <summary>
+    /// How the last sorted list broke down, summed over every view sorted since the counts were reset.
+    /// </summary>
+    struct DrawOrderStats
+    {
+        GLuint views = 0;
+        GLuint instances = 0;
+
+        // Runs of the same mesh, the indirect commands the lists become, and of the same material.
+        GLuint meshRuns = 0;
+        GLuint materialRuns = 0;
+    };
+
+    /// <summary>
+    /// Orders instance lists front to back so early depth testing rejects what the nearer instances hide. Each
+    /// instance gets a 64 bit key: the distance band of the nearest point of its bounding sphere, then its
+    /// material, mesh and id. Bands are spaced logarithmically, as perspective shrinks distant differences, and
+    /// are coarse enough that instances at much the same distance fall into one and stay grouped by material and
+    /// mesh, which keeps the indirect commands few and leaves runs of state to batch by later.
+    /// </summary>
+    class DrawSorter
+    {
+    public:
+        DrawSorter(const sponza::Context& scene);
+
+        // Sorts <instances> by their distance from <eye>, given each instance's bounding sphere in <bounds>.
+        void sortFromPoint(const std::vector<glm::vec4>& bounds, const glm::vec3& eye, std::vector<GLuint>& instances);
+
+        static GLuint64 makeKey(GLuint band, GLuint material, GLuint mesh, GLuint instance);
+
+        void resetStats() { m_stats = DrawOrderStats(); }
+
+        const DrawOrderStats& getStats() const { return m_stats; }
+
+        void printStats() const;
+
+    private:
+        const sponza::Context& m_scene;
+
+        std::vector<float> m_distances;
+        std::vector<GLuint64> m_keys;
+
+        DrawOrderStats m_stats;
+    };
+}
@@ -0,0 +1,226 @@
+#include "FrustumCuller.hpp"
+#include "JobSystem.hpp"
+
+#include <algorithm>
+#include <cfloat>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#else
+#include <xmmintrin.h>
+#endif
+
+namespace MLK
+{
+    namespace
+    {
+        // Chunks of whole batches, large enough that a chunk's compaction is cheap next to its culling.
+        const size_t g_chunkSize = 4096;
+
+#if defined(__AVX2__)
+        // A whole batch of eight fits one register.
+        struct BatchPlanes
+        {
+            __m256 x[6], y[6], z[6], w[6];
+        };
+
+        BatchPlanes broadcastPlanes(const glm::vec4* planes)
+        {
+            BatchPlanes batch;
+            for (int p = 0; p < 6; ++p)
+            {
+                batch.x[p] = _mm256_set1_ps(planes[p].x);
+                batch.y[p] = _mm256_set1_ps(planes[p].y);
+                batch.z[p] = _mm256_set1_ps(planes[p].z);
+                batch.w[p] = _mm256_set1_ps(planes[p].w);
+            }
+            return batch;
+        }
+
+        // Bit per sphere in the batch starting at <i>, set if it touches every plane's inner side.
+        GLuint testBatch(const BatchPlanes& planes, const SphereBoundsSoA& bounds, size_t i)
+        {
+            const auto x = _mm256_loadu_ps(&bounds.x[i]);
+            const auto y = _mm256_loadu_ps(&bounds.y[i]);
+            const auto z = _mm256_loadu_ps(&bounds.z[i]);
+            const auto negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&bounds.radius[i]));
+
+            auto inside = _mm256_cmp_ps(x, x, _CMP_EQ_OQ);
+            for (int p = 0; p < 6; ++p)
+            {
+                const auto distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, planes.x[p]), _mm256_mul_ps(y, planes.y[p])),
+                    _mm256_add_ps(_mm256_mul_ps(z, planes.z[p]), planes.w[p]));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+            }
+            return (GLuint)_mm256_movemask_ps(inside);
+        }
+#else
+        // A batch of eight is tested as two halves of four.
+        struct BatchPlanes
+        {
+            __m128 x[6], y[6], z[6], w[6];
+        };
+
+        BatchPlanes broadcastPlanes(const glm::vec4* planes)
+        {
+            BatchPlanes batch;
+            for (int p = 0; p < 6; ++p)
+            {
+                batch.x[p] = _mm_set1_ps(planes[p].x);
+                batch.y[p] = _mm_set1_ps(planes[p].y);
+                batch.z[p] = _mm_set1_ps(planes[p].z);
+                batch.w[p] = _mm_set1_ps(planes[p].w);
+            }
+            return batch;
+        }
+
+        // Bit per sphere in the batch starting at <i>, set if it touches every plane's inner side.
+        GLuint testBatch(const BatchPlanes& planes, const SphereBoundsSoA& bounds, size_t i)
+        {
+            // The halves are interleaved to keep both chains of multiplies in flight.
+            const auto x0 = _mm_loadu_ps(&bounds.x[i]);
+            const auto x1 = _mm_loadu_ps(&bounds.x[i + 4]);
+            const auto y0 = _mm_loadu_ps(&bounds.y[i]);
+            const auto y1 = _mm_loadu_ps(&bounds.y[i + 4]);
+            const auto z0 = _mm_loadu_ps(&bounds.z[i]);
+            const auto z1 = _mm_loadu_ps(&bounds.z[i + 4]);
+            const auto negativeRadius0 = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&bounds.radius[i]));
+            const auto negativeRadius1 = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&bounds.radius[i + 4]));
+
+            auto inside0 = _mm_cmpeq_ps(x0, x0);
+            auto inside1 = _mm_cmpeq_ps(x1, x1);
+            for (int p = 0; p < 6; ++p)
+            {
+                const auto distance0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x0, planes.x[p]), _mm_mul_ps(y0, planes.y[p])),
+                    _mm_add_ps(_mm_mul_ps(z0, planes.z[p]), planes.w[p]));
+                const auto distance1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x1, planes.x[p]), _mm_mul_ps(y1, planes.y[p])),
+                    _mm_add_ps(_mm_mul_ps(z1, planes.z[p]), planes.w[p]));
+                inside0 = _mm_and_ps(inside0, _mm_cmpge_ps(distance0, negativeRadius0));
+                inside1 = _mm_and_ps(inside1, _mm_cmpge_ps(distance1, negativeRadius1));
+            }
+            return (GLuint)(_mm_movemask_ps(inside0) | (_mm_movemask_ps(inside1) << 4));
+        }
+#endif
+    }
+
+    void SphereBoundsSoA::resize(size_t sphereCount)
+    {
+        count = sphereCount;
+
+        // Padding spheres have the most negative radius there is, so every plane rejects them.
+        const auto padded = (sphereCount + FrustumCuller::BatchSize - 1) / FrustumCuller::BatchSize * FrustumCuller::BatchSize;
+        x.resize(padded, 0.f);
+        y.resize(padded, 0.f);
+        z.resize(padded, 0.f);
+        radius.resize(padded);
+        std::fill(radius.begin() + sphereCount, radius.end(), -FLT_MAX);
+    }
+
+    void SphereBoundsSoA::set(size_t i, const glm::vec4& sphere)
+    {
+        x[i] = sphere.x;
+        y[i] = sphere.y;
+        z[i] = sphere.z;
+        radius[i] = sphere.w;
+    }
+
+    FrustumCuller::FrustumCuller(const glm::mat4& viewProjection)
+    {
+        setViewProjection(viewProjection);
+    }
+
+    void FrustumCuller::setViewProjection(const glm::mat4& viewProjection)
+    {
+        // Planes are extracted from the rows of the view projection matrix, pointing into the frustum.
+        const auto row = [&viewProjection](int i)
+        {
+            return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        };
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            m_planes[axis * 2] = row(3) + row(axis);
+            m_planes[axis * 2 + 1] = row(3) - row(axis);
+        }
+
+        for (auto& plane : m_planes)
+        {
+            plane /= glm::length(glm::vec3(plane));
+        }
+    }
+
+    void FrustumCuller::cull(const SphereBoundsSoA& bounds, std::vector<GLuint>& visible) const
+    {
+        visible.resize(bounds.paddedCount());
+        visible.resize(cullRange(bounds, 0, bounds.paddedCount(), visible.data()));
+    }
+
+    void FrustumCuller::cull(JobSystem& jobs, const SphereBoundsSoA& bounds, std::vector<GLuint>& visible) const
+    {
+        // Each chunk writes its survivors to the start of its own slice, which are then closed up in order.
+        const auto padded = bounds.paddedCount();
+        const auto chunks = (padded + g_chunkSize - 1) / g_chunkSize;
+        std::vector<size_t> counts(chunks);
+
+        visible.resize(padded);
+        jobs.parallelFor("Frustum cull", chunks, 1, [&](size_t first, size_t last)
+        {
+            for (auto chunk = first; chunk < last; ++chunk)
+            {
+                const auto begin = chunk * g_chunkSize;
+                counts[chunk] = cullRange(bounds, begin, std::min(padded, begin + g_chunkSize), visible.data() + begin);
+            }
+        });
+
+        size_t count = 0;
+        for (size_t chunk = 0; chunk < chunks; ++chunk)
+        {
+            const auto begin = visible.begin() + chunk * g_chunkSize;
+            std::copy(begin, begin + counts[chunk], visible.begin() + count);
+            count += counts[chunk];
+        }
+        visible.resize(count);
+    }
+
+    size_t FrustumCuller::cullRange(const SphereBoundsSoA& bounds, size_t begin, size_t end, GLuint* visible) const
+    {
+        const auto planes = broadcastPlanes(m_planes);
+
+        size_t count = 0;
+        for (auto i = begin; i < end; i += BatchSize)
+        {
+            const auto mask = testBatch(planes, bounds, i);
+
+            // Every index is written but only visible ones are kept, so there's no branch to mispredict.
+            for (GLuint lane = 0; lane < BatchSize; ++lane)
+            {
+                visible[count] = (GLuint)(i + lane);
+                count += (mask >> lane) & 1;
+            }
+        }
+
+        return count;
+    }
+
+    size_t FrustumCuller::cullRangeScalar(const SphereBoundsSoA& bounds, size_t begin, size_t end, GLuint* visible) const
+    {
+        size_t count = 0;
+        for (auto i = begin; i < end; ++i)
+        {
+            const glm::vec3 centre(bounds.x[i], bounds.y[i], bounds.z[i]);
+
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; ++p)
+            {
+                inside = glm::dot(glm::vec3(m_planes[p]), centre) + m_planes[p].w >= -bounds.radius[i];
+            }
+
+            if (inside)
+            {
+                visible[count++] = (GLuint)i;
+            }
+        }
+
+        return count;
+    }
+}
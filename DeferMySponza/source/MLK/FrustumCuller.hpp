@@ -0,0 +1,67 @@
+#pragma once
+
+#include <tgl/tgl.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace MLK
+{
+    class JobSystem;
+
+    /// <summary>
+    /// Bounding spheres stored as separate arrays of centre x, y, z and radius, so a batch of spheres loads as one
+    /// register per component. The arrays are padded to a whole number of batches with spheres no frustum can
+    /// contain, so culling loops never need a scalar tail.
+    /// </summary>
+    struct SphereBoundsSoA
+    {
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+        std::vector<float> radius;
+
+        // Spheres in use, not counting the padding.
+        size_t count = 0;
+
+        void resize(size_t sphereCount);
+        void set(size_t i, const glm::vec4& sphere);
+
+        // Count rounded up to the batch size, the length every array is kept at.
+        size_t paddedCount() const { return x.size(); }
+    };
+
+    /// <summary>
+    /// Tests bounding spheres against the six planes of a view frustum. The SIMD path tests eight spheres per
+    /// iteration, as two SSE halves or one AVX2 register when built for it, and writes the indices of the visible
+    /// ones out without branching. A scalar path that stops at the first failing plane is kept as the baseline
+    /// it's measured against.
+    /// </summary>
+    class FrustumCuller
+    {
+    public:
+        static const size_t BatchSize = 8;
+
+        FrustumCuller() {}
+        FrustumCuller(const glm::mat4& viewProjection);
+
+        void setViewProjection(const glm::mat4& viewProjection);
+
+        // Planes point into the frustum and are normalised, so distances are in world units.
+        const glm::vec4* getPlanes() const { return m_planes; }
+
+        // Fills <visible> with the indices of the spheres touching the frustum, in ascending order.
+        void cull(const SphereBoundsSoA& bounds, std::vector<GLuint>& visible) const;
+
+        // As above, split across <jobs> with each chunk's survivors packed together afterwards.
+        void cull(JobSystem& jobs, const SphereBoundsSoA& bounds, std::vector<GLuint>& visible) const;
+
+        // Writes the visible indices in [<begin>, <end>) to <visible>, returning how many. <begin> must be a
+        // multiple of the batch size, and <visible> needs room for every index in the range.
+        size_t cullRange(const SphereBoundsSoA& bounds, size_t begin, size_t end, GLuint* visible) const;
+        size_t cullRangeScalar(const SphereBoundsSoA& bounds, size_t begin, size_t end, GLuint* visible) const;
+
+    private:
+        glm::vec4 m_planes[6];
+    };
+}
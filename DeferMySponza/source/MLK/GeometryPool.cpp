@@ -0,0 +1,188 @@
+#include "GeometryPool.hpp"
+#include "Resources.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+
+namespace MLK
+{
+    namespace
+    {
+        // Buffers are only ever bound to the copy write target here, as the element array buffer is VAO state.
+        void createBuffer(GLuint& id, size_t bytes, bool immutable)
+        {
+            glGenBuffers(1, &id);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+            if (immutable)
+            {
+                // Written only through glBufferSubData as meshes come and go.
+                glBufferStorage(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+            }
+            else
+            {
+                glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_STATIC_DRAW);
+            }
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+
+        void printRanges(const char* name, const RangeAllocator& ranges, size_t unitBytes)
+        {
+            const auto megabytes = 1.f / (1024.f * 1024.f);
+            std::cout << "  " << name << ": " << ranges.getUsed() * unitBytes * megabytes << " of "
+                << ranges.getCapacity() * unitBytes * megabytes << "MB used ("
+                << 100.f * ranges.getUsed() / std::max(1u, ranges.getCapacity()) << "%), " << ranges.getFreeRangeCount()
+                << " free ranges, largest " << ranges.getLargestFreeRange() * unitBytes * megabytes << "MB, "
+                << 100.f * ranges.getFragmentation() << "% fragmented" << std::endl;
+        }
+    }
+
+    RangeAllocator::RangeAllocator(GLuint capacity) :
+        m_capacity(capacity)
+    {
+        if (capacity > 0)
+        {
+            m_freeRanges[0] = capacity;
+        }
+    }
+
+    bool RangeAllocator::allocate(GLuint size, GLuint& offset)
+    {
+        if (size == 0)
+        {
+            offset = 0;
+            return true;
+        }
+
+        // Best fit, the free list being short enough for a linear search.
+        auto best = m_freeRanges.end();
+        for (auto range = m_freeRanges.begin(); range != m_freeRanges.end(); ++range)
+        {
+            if (range->second >= size && (best == m_freeRanges.end() || range->second < best->second))
+            {
+                best = range;
+            }
+        }
+
+        if (best == m_freeRanges.end())
+        {
+            return false;
+        }
+
+        // Taken from the front of the range, the rest stays free.
+        offset = best->first;
+        const auto remaining = best->second - size;
+        m_freeRanges.erase(best);
+        if (remaining > 0)
+        {
+            m_freeRanges[offset + size] = remaining;
+        }
+
+        m_used += size;
+        return true;
+    }
+
+    void RangeAllocator::free(GLuint offset, GLuint size)
+    {
+        if (size == 0)
+        {
+            return;
+        }
+
+        m_used -= size;
+        auto range = m_freeRanges.emplace(offset, size).first;
+
+        // Merge with the free range after, then the one before.
+        const auto next = std::next(range);
+        if (next != m_freeRanges.end() && range->first + range->second == next->first)
+        {
+            range->second += next->second;
+            m_freeRanges.erase(next);
+        }
+
+        if (range != m_freeRanges.begin())
+        {
+            const auto previous = std::prev(range);
+            if (previous->first + previous->second == range->first)
+            {
+                previous->second += range->second;
+                m_freeRanges.erase(range);
+            }
+        }
+    }
+
+    GLuint RangeAllocator::getLargestFreeRange() const
+    {
+        GLuint largest = 0;
+        for (const auto& range : m_freeRanges)
+        {
+            largest = std::max(largest, range.second);
+        }
+        return largest;
+    }
+
+    float RangeAllocator::getFragmentation() const
+    {
+        const auto free = m_capacity - m_used;
+        return free == 0 ? 0.f : 1.f - (float)getLargestFreeRange() / free;
+    }
+
+    GeometryPool::GeometryPool(GLuint vertexCapacity, GLuint elementCapacity) :
+        m_immutable(tglIsAvailable(TGL_EXTENSION_GL_4_4) == GL_TRUE),
+        m_vertices(vertexCapacity),
+        m_elements(elementCapacity)
+    {
+        createBuffer(m_vertexBuffer, vertexCapacity * sizeof(FullVertex), m_immutable);
+        createBuffer(m_elementBuffer, elementCapacity * sizeof(GLuint), m_immutable);
+    }
+
+    GeometryPool::~GeometryPool()
+    {
+        glDeleteBuffers(1, &m_vertexBuffer);
+        glDeleteBuffers(1, &m_elementBuffer);
+    }
+
+    bool GeometryPool::allocate(const std::vector<FullVertex>& vertices, const std::vector<GLuint>& elements, GeometryAllocation& allocation)
+    {
+        GeometryAllocation placed;
+        placed.VertexCount = (GLuint)vertices.size();
+        placed.ElementCount = (GLuint)elements.size();
+        if (!m_vertices.allocate(placed.VertexCount, placed.FirstVertex))
+        {
+            ++m_failedAllocations;
+            return false;
+        }
+        if (!m_elements.allocate(placed.ElementCount, placed.FirstElement))
+        {
+            m_vertices.free(placed.FirstVertex, placed.VertexCount);
+            ++m_failedAllocations;
+            return false;
+        }
+
+        Resources::updateBuffer(m_vertexBuffer, placed.FirstVertex * sizeof(FullVertex), vertices.size() * sizeof(FullVertex), vertices.data());
+        Resources::updateBuffer(m_elementBuffer, placed.FirstElement * sizeof(GLuint), elements.size() * sizeof(GLuint), elements.data());
+
+        ++m_allocations;
+        allocation = placed;
+        return true;
+    }
+
+    void GeometryPool::free(const GeometryAllocation& allocation)
+    {
+        m_vertices.free(allocation.FirstVertex, allocation.VertexCount);
+        m_elements.free(allocation.FirstElement, allocation.ElementCount);
+        --m_allocations;
+    }
+
+    void GeometryPool::printStats() const
+    {
+        std::cout << "Geometry pool: " << m_allocations << " meshes" << (m_immutable ? "" : " (mutable storage)");
+        if (m_failedAllocations > 0)
+        {
+            std::cout << ", " << m_failedAllocations << " failed to fit";
+        }
+        std::cout << std::endl;
+        printRanges("Vertices", m_vertices, sizeof(FullVertex));
+        printRanges("Elements", m_elements, sizeof(GLuint));
+    }
+}
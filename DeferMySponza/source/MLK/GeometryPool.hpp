@@ -0,0 +1,87 @@
+#pragma once
+
+#include "MeshUtils.hpp"
+
+#include <tgl/tgl.h>
+
+#include <map>
+
+namespace MLK
+{
+    /// <summary>
+    /// Sub-allocates ranges of a fixed size space from a free list kept in address order. Allocation takes the
+    /// smallest free range that fits, so large ranges are kept whole for large meshes, and freeing merges a range
+    /// with free neighbours, so the list holds only the gaps between live allocations.
+    /// </summary>
+    class RangeAllocator
+    {
+    public:
+        RangeAllocator(GLuint capacity);
+
+        // Finds room for <size> units, returning false when no free range is large enough.
+        bool allocate(GLuint size, GLuint& offset);
+
+        void free(GLuint offset, GLuint size);
+
+        GLuint getCapacity() const { return m_capacity; }
+        GLuint getUsed() const { return m_used; }
+        GLuint getFreeRangeCount() const { return (GLuint)m_freeRanges.size(); }
+        GLuint getLargestFreeRange() const;
+
+        // How much of the free space is unusable by one allocation, 0 when it's all in one range.
+        float getFragmentation() const;
+
+    private:
+        GLuint m_capacity;
+        GLuint m_used = 0;
+
+        // Free ranges by offset, holding their sizes.
+        std::map<GLuint, GLuint> m_freeRanges;
+    };
+
+    /// <summary>
+    /// Where a mesh's vertices and elements were placed, its elements indexing from its first vertex.
+    /// </summary>
+    struct GeometryAllocation
+    {
+        GLuint FirstVertex = 0;
+        GLuint VertexCount = 0;
+        GLuint FirstElement = 0;
+        GLuint ElementCount = 0;
+    };
+
+    /// <summary>
+    /// One vertex buffer and one element buffer shared by every mesh, so they can all be drawn through a single
+    /// VAO and indirect commands. The buffers are given immutable storage of a fixed size up front, falling back to
+    /// plain buffer data without GL 4.4, and meshes are copied into ranges of them given out by a RangeAllocator,
+    /// so meshes can be streamed in and out later without reallocating anything.
+    /// </summary>
+    class GeometryPool
+    {
+    public:
+        GeometryPool(GLuint vertexCapacity, GLuint elementCapacity);
+        ~GeometryPool();
+
+        // Copies a mesh into the pool, returning false and leaving it untouched when either buffer is too full.
+        bool allocate(const std::vector<FullVertex>& vertices, const std::vector<GLuint>& elements, GeometryAllocation& allocation);
+
+        void free(const GeometryAllocation& allocation);
+
+        GLuint getVertexBuffer() const { return m_vertexBuffer; }
+        GLuint getElementBuffer() const { return m_elementBuffer; }
+
+        // Prints how full each buffer is and how broken up its free space is.
+        void printStats() const;
+
+    private:
+        GLuint m_vertexBuffer = 0;
+        GLuint m_elementBuffer = 0;
+        bool m_immutable = false;
+
+        RangeAllocator m_vertices;
+        RangeAllocator m_elements;
+
+        GLuint m_allocations = 0;
+        GLuint m_failedAllocations = 0;
+    };
+}
@@ -22,13 +22,18 @@ namespace MLK
         m_passFunctions[DrawPass::GBufferPass] = [this]() { setGBufferPass(); };
         m_passFunctions[DrawPass::AmbientPass] = [this]() { setAmbientPass(); };
         m_passFunctions[DrawPass::FullScreenPass] = [this]() { setFullScreenPass(); };
+        m_passFunctions[DrawPass::LightQueryPass] = [this]() { setLightQueryPass(); };
         m_passFunctions[DrawPass::LightStencilPass] = [this]() { setLightStencilPass(); };
         m_passFunctions[DrawPass::LightShadingPass] = [this]() { setLightShadingPass(); };
+        m_passFunctions[DrawPass::LightVolumePass] = [this]() { setLightVolumePass(); };
 		m_passFunctions[DrawPass::ShadowMapPass] = [this]() { setShadowMapPass(); };
+        m_passFunctions[DrawPass::ShadowFilterPass] = [this]() { setShadowFilterPass(); };
         m_passFunctions[DrawPass::SMAAEdge] = [this]() { setSMAAEdge(); };
         m_passFunctions[DrawPass::SMAABlend] = [this]() { setSMAABlend(); };
         m_passFunctions[DrawPass::SMAAResolve] = [this]() { setSMAAResolve(); };
         m_passFunctions[DrawPass::SSRPass] = [this]() { setSSRPass(); };
+        m_passFunctions[DrawPass::TAAResolve] = [this]() { setTAAResolve(); };
+        m_passFunctions[DrawPass::PresentPass] = [this]() { setPresentPass(); };
     }
 
     GlStateManager::~GlStateManager()
@@ -104,6 +109,23 @@ namespace MLK
         glBlendFunc(GL_ONE, GL_ONE);
     }
 
+    void GlStateManager::setLightQueryPass()
+    {
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+        // Only front faces are needed, a closed volume with none in front of the scene lights nothing.
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_BACK);
+
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LEQUAL);
+        glDepthMask(GL_FALSE);
+
+        glDisable(GL_STENCIL_TEST);
+
+        glDisable(GL_BLEND);
+    }
+
     void GlStateManager::setLightStencilPass()
     {
         glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
@@ -143,6 +165,25 @@ namespace MLK
 		glBlendFunc(GL_ONE, GL_ONE);
     }
 
+    void GlStateManager::setLightVolumePass()
+    {
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+        // Single pass for volumes the camera is outside of, front faces behind the scene light nothing.
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_BACK);
+
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LEQUAL);
+        glDepthMask(GL_FALSE);
+
+        glDisable(GL_STENCIL_TEST);
+
+        glEnable(GL_BLEND);
+        glBlendEquation(GL_FUNC_ADD);
+        glBlendFunc(GL_ONE, GL_ONE);
+    }
+
 	void GlStateManager::setShadowMapPass()
 	{
 		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
@@ -159,6 +200,20 @@ namespace MLK
 		glDisable(GL_BLEND);
 	}
 
+    void GlStateManager::setShadowFilterPass()
+    {
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_BACK);
+
+        glDisable(GL_DEPTH_TEST);
+
+        glDisable(GL_STENCIL_TEST);
+
+        glDisable(GL_BLEND);
+    }
+
     void GlStateManager::setSMAAEdge()
     {
         glColorMask(GL_TRUE, GL_TRUE, GL_FALSE, GL_FALSE);
@@ -218,9 +273,36 @@ namespace MLK
 
         glDisable(GL_STENCIL_TEST);
 
-        glEnable(GL_BLEND);
-		glBlendColor(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-		glBlendEquation(GL_FUNC_ADD);
-		glBlendFunc(GL_ONE, GL_ONE);
+        // The SSR shader composites over its input itself.
+        glDisable(GL_BLEND);
+    }
+
+    void GlStateManager::setTAAResolve()
+    {
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_BACK);
+
+        glDisable(GL_DEPTH_TEST);
+
+        glDisable(GL_STENCIL_TEST);
+
+        // History blending is done in the shader.
+        glDisable(GL_BLEND);
+    }
+
+    void GlStateManager::setPresentPass()
+    {
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_BACK);
+
+        glDisable(GL_DEPTH_TEST);
+
+        glDisable(GL_STENCIL_TEST);
+
+        glDisable(GL_BLEND);
     }
 }
\ No newline at end of file
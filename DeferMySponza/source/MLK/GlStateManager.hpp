@@ -14,13 +14,18 @@ namespace MLK
         GBufferPass,
 		AmbientPass,
 		FullScreenPass,
+        LightQueryPass,
         LightStencilPass,
         LightShadingPass,
+        LightVolumePass,
 		ShadowMapPass,
+        ShadowFilterPass,
         SSRPass,
         SMAAEdge,
         SMAABlend,
-        SMAAResolve
+        SMAAResolve,
+        TAAResolve,
+        PresentPass
     };
 
 	/// <summary>
@@ -39,13 +44,18 @@ namespace MLK
         void setGBufferPass();
         void setFullScreenPass();
 		void setAmbientPass();
+        void setLightQueryPass();
         void setLightStencilPass();
         void setLightShadingPass();
+        void setLightVolumePass();
 		void setShadowMapPass();
+        void setShadowFilterPass();
         void setSMAAEdge();
         void setSMAABlend();
         void setSMAAResolve();
         void setSSRPass();
+        void setTAAResolve();
+        void setPresentPass();
 
         DrawPass m_currentPass = DrawPass::NoPass;
         std::unordered_map<DrawPass, std::function<void()>> m_passFunctions;
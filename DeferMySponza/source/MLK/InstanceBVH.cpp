@@ -0,0 +1,629 @@
+#include "InstanceBVH.hpp"
+#include "FrustumCuller.hpp"
+#include "JobSystem.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <numeric>
+
+namespace MLK
+{
+    namespace
+    {
+        using Clock = std::chrono::high_resolution_clock;
+
+        const GLuint g_noParent = ~0u;
+
+        // Leaves are split while they hold more than this, even where the heuristic would keep them.
+        const GLuint g_maxLeafSize = 4;
+
+        // Deeper nodes are left as leaves, which bounds the traversal stack.
+        const GLuint g_maxDepth = 64;
+
+        const GLuint g_binCount = 12;
+
+        // Cost of visiting a node relative to testing one instance.
+        const float g_traversalCost = 1.f;
+
+        // Results of a node test, whether to skip it, look inside or take everything below it.
+        const int g_outside = 0;
+        const int g_partial = 1;
+        const int g_inside = 2;
+
+        float halfArea(const BoundingBox& box)
+        {
+            const auto size = glm::max(box.maximum - box.minimum, glm::vec3(0.f));
+            return size.x * size.y + size.y * size.z + size.z * size.x;
+        }
+
+        void grow(BoundingBox& box, const BoundingBox& other)
+        {
+            box.minimum = glm::min(box.minimum, other.minimum);
+            box.maximum = glm::max(box.maximum, other.maximum);
+        }
+
+        BoundingBox emptyBox()
+        {
+            BoundingBox box;
+            box.minimum = glm::vec3(std::numeric_limits<float>::max());
+            box.maximum = glm::vec3(-std::numeric_limits<float>::max());
+            return box;
+        }
+
+        int testFrustum(const glm::vec4* planes, const glm::vec3& minimum, const glm::vec3& maximum)
+        {
+            auto result = g_inside;
+            for (int p = 0; p < 6; ++p)
+            {
+                const auto normal = glm::vec3(planes[p]);
+
+                // The corners furthest along and against the plane's normal.
+                const auto along = glm::mix(minimum, maximum, glm::vec3(glm::greaterThanEqual(normal, glm::vec3(0.f))));
+                const auto against = minimum + maximum - along;
+
+                if (glm::dot(normal, along) + planes[p].w < 0.f)
+                {
+                    return g_outside;
+                }
+                if (glm::dot(normal, against) + planes[p].w < 0.f)
+                {
+                    result = g_partial;
+                }
+            }
+            return result;
+        }
+
+        int testSphere(const glm::vec4& sphere, const glm::vec3& minimum, const glm::vec3& maximum)
+        {
+            const auto centre = glm::vec3(sphere);
+            const auto closest = glm::clamp(centre, minimum, maximum);
+            const auto radiusSquared = sphere.w * sphere.w;
+            if (glm::dot(closest - centre, closest - centre) > radiusSquared)
+            {
+                return g_outside;
+            }
+
+            const auto furthest = glm::max(glm::abs(minimum - centre), glm::abs(maximum - centre));
+            return glm::dot(furthest, furthest) <= radiusSquared ? g_inside : g_partial;
+        }
+
+        int testCone(const BvhCone& cone, const glm::vec3& minimum, const glm::vec3& maximum)
+        {
+            const auto centre = (minimum + maximum) * 0.5f;
+            const auto radius = glm::length(maximum - minimum) * 0.5f;
+
+            // Distance from the sphere's centre to the cone's side, behind the apex and past the range.
+            const auto offset = centre - cone.apex;
+            const auto along = glm::dot(offset, cone.direction);
+            const auto across = glm::sqrt(std::max(0.f, glm::dot(offset, offset) - along * along));
+            const auto toSide = glm::cos(cone.angle) * across - glm::sin(cone.angle) * along;
+
+            const bool outside = toSide > radius || along > cone.range + radius || along < -radius;
+            return outside ? g_outside : g_partial;
+        }
+
+        // Distance the ray enters and leaves the box, entering after leaving if it misses.
+        glm::vec2 intersectRay(const glm::vec3& origin, const glm::vec3& inverseDirection,
+            const glm::vec3& minimum, const glm::vec3& maximum)
+        {
+            const auto t0 = (minimum - origin) * inverseDirection;
+            const auto t1 = (maximum - origin) * inverseDirection;
+            const auto entry = glm::min(t0, t1);
+            const auto leave = glm::max(t0, t1);
+            return glm::vec2(std::max(entry.x, std::max(entry.y, entry.z)), std::min(leave.x, std::min(leave.y, leave.z)));
+        }
+
+        template<typename Test>
+        void scan(const std::vector<BoundingBox>& boxes, Test test, std::vector<GLuint>& instances)
+        {
+            instances.clear();
+            for (GLuint i = 0; i < (GLuint)boxes.size(); ++i)
+            {
+                if (test(boxes[i].minimum, boxes[i].maximum) != g_outside)
+                {
+                    instances.push_back(i);
+                }
+            }
+        }
+
+        // Returns the instances tested across every query, each query's count kept apart until they're all done.
+        template<typename Query, typename Run>
+        GLuint runBatch(JobSystem& jobs, const char* name, const std::vector<Query>& queries,
+            std::vector<std::vector<GLuint>>& results, Run run)
+        {
+            results.resize(queries.size());
+            std::vector<GLuint> tested(queries.size(), 0);
+            jobs.parallelFor(name, queries.size(), 1, [&](size_t begin, size_t end)
+            {
+                for (auto i = begin; i < end; ++i)
+                {
+                    tested[i] = run(queries[i], results[i]);
+                }
+            });
+            return std::accumulate(tested.begin(), tested.end(), 0u);
+        }
+    }
+
+    void InstanceBVH::build(const std::vector<BoundingBox>& boxes)
+    {
+        const auto start = Clock::now();
+        const auto count = (GLuint)boxes.size();
+
+        m_nodes.clear();
+        m_parents.clear();
+        m_order.resize(count);
+        std::iota(m_order.begin(), m_order.end(), 0);
+        m_leafOf.assign(count, 0);
+        m_stats = BvhStats();
+        m_stats.instances = count;
+
+        if (count == 0)
+        {
+            m_boxes.clear();
+            m_positionOf.clear();
+            return;
+        }
+
+        std::vector<glm::vec3> centres(count);
+        for (GLuint i = 0; i < count; ++i)
+        {
+            centres[i] = (boxes[i].minimum + boxes[i].maximum) * 0.5f;
+        }
+
+        // A binary tree over n leaves of at least one instance has fewer than 2n nodes, so none move while building.
+        m_nodes.reserve(count * 2);
+        m_parents.reserve(count * 2);
+
+        Node root;
+        root.first = 0;
+        root.count = count;
+        fitLeaf(root, boxes);
+        m_nodes.push_back(root);
+        m_parents.push_back(g_noParent);
+
+        std::vector<std::pair<GLuint, GLuint>> stack = { { 0, 1 } };
+        while (!stack.empty())
+        {
+            const auto node = stack.back().first;
+            const auto depth = stack.back().second;
+            stack.pop_back();
+
+            m_stats.depth = std::max(m_stats.depth, depth);
+            if (depth < g_maxDepth && split(node, boxes, centres))
+            {
+                stack.push_back({ m_nodes[node].first, depth + 1 });
+                stack.push_back({ m_nodes[node].first + 1, depth + 1 });
+                continue;
+            }
+
+            for (auto i = m_nodes[node].first; i < m_nodes[node].first + m_nodes[node].count; ++i)
+            {
+                m_leafOf[m_order[i]] = node;
+            }
+        }
+
+        // Instance boxes are kept in leaf order, so a leaf's are next to each other.
+        m_boxes.resize(count);
+        m_positionOf.resize(count);
+        for (GLuint i = 0; i < count; ++i)
+        {
+            m_boxes[i] = boxes[m_order[i]];
+            m_positionOf[m_order[i]] = i;
+        }
+
+        m_isDirty.assign(m_nodes.size(), 0);
+        m_stats.nodes = (GLuint)m_nodes.size();
+        m_stats.buildMs = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    }
+
+    bool InstanceBVH::split(GLuint node, const std::vector<BoundingBox>& boxes, const std::vector<glm::vec3>& centres)
+    {
+        const auto first = m_nodes[node].first;
+        const auto count = m_nodes[node].count;
+        if (count <= 1)
+        {
+            return false;
+        }
+
+        auto centreBounds = emptyBox();
+        for (auto i = first; i < first + count; ++i)
+        {
+            centreBounds.minimum = glm::min(centreBounds.minimum, centres[m_order[i]]);
+            centreBounds.maximum = glm::max(centreBounds.maximum, centres[m_order[i]]);
+        }
+
+        // Cost of the best split on each axis, as if the node's area were one.
+        const auto extent = centreBounds.maximum - centreBounds.minimum;
+        float bestCost = std::numeric_limits<float>::max();
+        int bestAxis = -1;
+        GLuint bestBin = 0;
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (extent[axis] <= 0.f)
+            {
+                continue;
+            }
+
+            BoundingBox binBoxes[g_binCount];
+            GLuint binCounts[g_binCount] = {};
+            for (auto& box : binBoxes)
+            {
+                box = emptyBox();
+            }
+
+            const auto scale = g_binCount / extent[axis];
+            for (auto i = first; i < first + count; ++i)
+            {
+                const auto instance = m_order[i];
+                const auto bin = std::min(g_binCount - 1, (GLuint)((centres[instance][axis] - centreBounds.minimum[axis]) * scale));
+                grow(binBoxes[bin], boxes[instance]);
+                ++binCounts[bin];
+            }
+
+            // Areas and counts to the right of each plane, swept from the right, then the left swept alongside.
+            float rightAreas[g_binCount];
+            GLuint rightCounts[g_binCount];
+            auto right = emptyBox();
+            GLuint rightCount = 0;
+            for (auto bin = g_binCount - 1; bin > 0; --bin)
+            {
+                grow(right, binBoxes[bin]);
+                rightCount += binCounts[bin];
+                rightAreas[bin] = halfArea(right);
+                rightCounts[bin] = rightCount;
+            }
+
+            auto left = emptyBox();
+            GLuint leftCount = 0;
+            for (GLuint plane = 1; plane < g_binCount; ++plane)
+            {
+                grow(left, binBoxes[plane - 1]);
+                leftCount += binCounts[plane - 1];
+                if (leftCount == 0 || rightCounts[plane] == 0)
+                {
+                    continue;
+                }
+
+                const auto cost = halfArea(left) * leftCount + rightAreas[plane] * rightCounts[plane];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = plane;
+                }
+            }
+        }
+
+        const auto area = halfArea(BoundingBox{ m_nodes[node].minimum, m_nodes[node].maximum });
+        const auto splitCost = g_traversalCost + (area > 0.f ? bestCost / area : 0.f);
+        if (count <= g_maxLeafSize && (bestAxis < 0 || splitCost >= count))
+        {
+            return false;
+        }
+
+        auto middle = m_order.begin() + first + count / 2;
+        if (bestAxis >= 0)
+        {
+            const auto scale = g_binCount / extent[bestAxis];
+            middle = std::partition(m_order.begin() + first, m_order.begin() + first + count, [&](GLuint instance)
+            {
+                const auto bin = std::min(g_binCount - 1,
+                    (GLuint)((centres[instance][bestAxis] - centreBounds.minimum[bestAxis]) * scale));
+                return bin < bestBin;
+            });
+        }
+
+        // Instances sharing one centre can't be binned apart, so they're halved by count.
+        const auto leftCount = (GLuint)(middle - (m_order.begin() + first));
+        if (leftCount == 0 || leftCount == count)
+        {
+            middle = m_order.begin() + first + count / 2;
+        }
+
+        const auto children = (GLuint)m_nodes.size();
+        Node left;
+        left.first = first;
+        left.count = (GLuint)(middle - (m_order.begin() + first));
+        fitLeaf(left, boxes);
+
+        Node right;
+        right.first = first + left.count;
+        right.count = count - left.count;
+        fitLeaf(right, boxes);
+
+        m_nodes.push_back(left);
+        m_nodes.push_back(right);
+        m_parents.push_back(node);
+        m_parents.push_back(node);
+
+        m_nodes[node].first = children;
+        m_nodes[node].count = 0;
+        return true;
+    }
+
+    void InstanceBVH::fitLeaf(Node& node, const std::vector<BoundingBox>& boxes) const
+    {
+        auto box = emptyBox();
+        for (auto i = node.first; i < node.first + node.count; ++i)
+        {
+            grow(box, boxes[m_order[i]]);
+        }
+        node.minimum = box.minimum;
+        node.maximum = box.maximum;
+    }
+
+    void InstanceBVH::refit(const std::vector<BoundingBox>& boxes, const std::vector<GLuint>& instances)
+    {
+        const auto start = Clock::now();
+
+        m_stats.refitInstances = (GLuint)instances.size();
+        m_stats.refitNodes = 0;
+        if (m_nodes.empty())
+        {
+            return;
+        }
+
+        // Leaves are refitted straight away, their parents gathered once each.
+        for (const auto instance : instances)
+        {
+            m_boxes[m_positionOf[instance]] = boxes[instance];
+
+            const auto leaf = m_leafOf[instance];
+            fitLeaf(m_nodes[leaf], boxes);
+            ++m_stats.refitNodes;
+
+            for (auto parent = m_parents[leaf]; parent != g_noParent && !m_isDirty[parent]; parent = m_parents[parent])
+            {
+                m_isDirty[parent] = 1;
+                m_dirty.push_back(parent);
+            }
+        }
+
+        // Children always come after their parent, so in descending order every child is done before its parent.
+        std::sort(m_dirty.begin(), m_dirty.end(), std::greater<GLuint>());
+        for (const auto node : m_dirty)
+        {
+            const auto& left = m_nodes[m_nodes[node].first];
+            const auto& right = m_nodes[m_nodes[node].first + 1];
+            m_nodes[node].minimum = glm::min(left.minimum, right.minimum);
+            m_nodes[node].maximum = glm::max(left.maximum, right.maximum);
+            m_isDirty[node] = 0;
+        }
+
+        m_stats.refitNodes += (GLuint)m_dirty.size();
+        m_dirty.clear();
+        m_stats.refitMs = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    }
+
+    template<typename Test>
+    GLuint InstanceBVH::traverse(Test test, std::vector<GLuint>& instances) const
+    {
+        instances.clear();
+        if (m_nodes.empty())
+        {
+            return 0;
+        }
+
+        GLuint tested = 0;
+
+        GLuint stack[g_maxDepth + 1];
+        GLuint size = 0;
+        stack[size++] = 0;
+
+        while (size > 0)
+        {
+            const auto& node = m_nodes[stack[--size]];
+            const auto result = test(node.minimum, node.maximum);
+            if (result == g_outside)
+            {
+                continue;
+            }
+
+            if (result == g_inside)
+            {
+                addSubtree((GLuint)(&node - m_nodes.data()), instances);
+            }
+            else if (node.count == 0)
+            {
+                stack[size++] = node.first;
+                stack[size++] = node.first + 1;
+            }
+            else
+            {
+                tested += node.count;
+                for (auto i = node.first; i < node.first + node.count; ++i)
+                {
+                    if (test(m_boxes[i].minimum, m_boxes[i].maximum) != g_outside)
+                    {
+                        instances.push_back(m_order[i]);
+                    }
+                }
+            }
+        }
+
+        std::sort(instances.begin(), instances.end());
+        return tested;
+    }
+
+    void InstanceBVH::addSubtree(GLuint node, std::vector<GLuint>& instances) const
+    {
+        // A subtree's instances are one run of the instance order, from its leftmost leaf to its rightmost.
+        auto leftmost = node;
+        while (m_nodes[leftmost].count == 0)
+        {
+            leftmost = m_nodes[leftmost].first;
+        }
+
+        auto rightmost = node;
+        while (m_nodes[rightmost].count == 0)
+        {
+            rightmost = m_nodes[rightmost].first + 1;
+        }
+
+        const auto begin = m_order.begin() + m_nodes[leftmost].first;
+        const auto end = m_order.begin() + m_nodes[rightmost].first + m_nodes[rightmost].count;
+        instances.insert(instances.end(), begin, end);
+    }
+
+    GLuint InstanceBVH::queryFrustum(const glm::vec4* planes, std::vector<GLuint>& instances) const
+    {
+        return traverse([planes](const glm::vec3& minimum, const glm::vec3& maximum)
+        {
+            return testFrustum(planes, minimum, maximum);
+        }, instances);
+    }
+
+    GLuint InstanceBVH::querySphere(const glm::vec4& sphere, std::vector<GLuint>& instances) const
+    {
+        return traverse([&sphere](const glm::vec3& minimum, const glm::vec3& maximum)
+        {
+            return testSphere(sphere, minimum, maximum);
+        }, instances);
+    }
+
+    GLuint InstanceBVH::queryCone(const BvhCone& cone, std::vector<GLuint>& instances) const
+    {
+        return traverse([&cone](const glm::vec3& minimum, const glm::vec3& maximum)
+        {
+            return testCone(cone, minimum, maximum);
+        }, instances);
+    }
+
+    BvhHit InstanceBVH::queryRay(const BvhRay& ray) const
+    {
+        BvhHit hit = { NoHit, ray.maxDistance };
+        if (m_nodes.empty())
+        {
+            return hit;
+        }
+
+        const auto inverseDirection = 1.f / ray.direction;
+
+        GLuint stack[g_maxDepth + 1];
+        GLuint size = 0;
+        stack[size++] = 0;
+
+        while (size > 0)
+        {
+            const auto& node = m_nodes[stack[--size]];
+            const auto span = intersectRay(ray.origin, inverseDirection, node.minimum, node.maximum);
+            if (span.x > span.y || span.y < 0.f || span.x > hit.distance)
+            {
+                continue;
+            }
+
+            if (node.count > 0)
+            {
+                for (auto i = node.first; i < node.first + node.count; ++i)
+                {
+                    const auto instanceSpan = intersectRay(ray.origin, inverseDirection, m_boxes[i].minimum, m_boxes[i].maximum);
+                    if (instanceSpan.x > 0.f && instanceSpan.x <= instanceSpan.y && instanceSpan.x < hit.distance)
+                    {
+                        hit = { m_order[i], instanceSpan.x };
+                    }
+                }
+                continue;
+            }
+
+            // The nearer child goes on top so its hits can prune the further one.
+            const auto& left = m_nodes[node.first];
+            const auto& right = m_nodes[node.first + 1];
+            const auto leftEntry = intersectRay(ray.origin, inverseDirection, left.minimum, left.maximum).x;
+            const auto rightEntry = intersectRay(ray.origin, inverseDirection, right.minimum, right.maximum).x;
+            const bool leftNearer = leftEntry <= rightEntry;
+            stack[size++] = leftNearer ? node.first + 1 : node.first;
+            stack[size++] = leftNearer ? node.first : node.first + 1;
+        }
+
+        return hit;
+    }
+
+    GLuint InstanceBVH::queryFrusta(JobSystem& jobs, const std::vector<FrustumCuller>& frusta,
+        std::vector<std::vector<GLuint>>& results) const
+    {
+        return runBatch(jobs, "BVH frusta", frusta, results, [this](const FrustumCuller& frustum, std::vector<GLuint>& instances)
+        {
+            return queryFrustum(frustum.getPlanes(), instances);
+        });
+    }
+
+    GLuint InstanceBVH::querySpheres(JobSystem& jobs, const std::vector<glm::vec4>& spheres,
+        std::vector<std::vector<GLuint>>& results) const
+    {
+        return runBatch(jobs, "BVH spheres", spheres, results, [this](const glm::vec4& sphere, std::vector<GLuint>& instances)
+        {
+            return querySphere(sphere, instances);
+        });
+    }
+
+    GLuint InstanceBVH::queryCones(JobSystem& jobs, const std::vector<BvhCone>& cones,
+        std::vector<std::vector<GLuint>>& results) const
+    {
+        return runBatch(jobs, "BVH cones", cones, results, [this](const BvhCone& cone, std::vector<GLuint>& instances)
+        {
+            return queryCone(cone, instances);
+        });
+    }
+
+    void InstanceBVH::queryRays(JobSystem& jobs, const std::vector<BvhRay>& rays, std::vector<BvhHit>& hits) const
+    {
+        hits.resize(rays.size());
+        jobs.parallelFor("BVH rays", rays.size(), 64, [&](size_t begin, size_t end)
+        {
+            for (auto i = begin; i < end; ++i)
+            {
+                hits[i] = queryRay(rays[i]);
+            }
+        });
+    }
+
+    void InstanceBVH::scanFrustum(const std::vector<BoundingBox>& boxes, const glm::vec4* planes, std::vector<GLuint>& instances)
+    {
+        scan(boxes, [planes](const glm::vec3& minimum, const glm::vec3& maximum)
+        {
+            return testFrustum(planes, minimum, maximum);
+        }, instances);
+    }
+
+    void InstanceBVH::scanSphere(const std::vector<BoundingBox>& boxes, const glm::vec4& sphere, std::vector<GLuint>& instances)
+    {
+        scan(boxes, [&sphere](const glm::vec3& minimum, const glm::vec3& maximum)
+        {
+            return testSphere(sphere, minimum, maximum);
+        }, instances);
+    }
+
+    void InstanceBVH::scanCone(const std::vector<BoundingBox>& boxes, const BvhCone& cone, std::vector<GLuint>& instances)
+    {
+        scan(boxes, [&cone](const glm::vec3& minimum, const glm::vec3& maximum)
+        {
+            return testCone(cone, minimum, maximum);
+        }, instances);
+    }
+
+    BvhHit InstanceBVH::scanRay(const std::vector<BoundingBox>& boxes, const BvhRay& ray)
+    {
+        BvhHit hit = { NoHit, ray.maxDistance };
+        const auto inverseDirection = 1.f / ray.direction;
+        for (GLuint i = 0; i < (GLuint)boxes.size(); ++i)
+        {
+            const auto span = intersectRay(ray.origin, inverseDirection, boxes[i].minimum, boxes[i].maximum);
+            if (span.x > 0.f && span.x <= span.y && span.x < hit.distance)
+            {
+                hit = { i, span.x };
+            }
+        }
+        return hit;
+    }
+
+    void InstanceBVH::printStats() const
+    {
+        std::cout << "Instance BVH: " << m_stats.instances << " instances in " << m_stats.nodes << " nodes, depth "
+            << m_stats.depth << ", built in " << m_stats.buildMs << "ms, last refit " << m_stats.refitInstances
+            << " instances touching " << m_stats.refitNodes << " nodes in " << m_stats.refitMs << "ms" << std::endl;
+    }
+}
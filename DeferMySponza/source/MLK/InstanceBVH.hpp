@@ -0,0 +1,154 @@
+#pragma once
+
+#include <tgl/tgl.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace MLK
+{
+    class JobSystem;
+    class FrustumCuller;
+
+    /// <summary>
+    /// Axis aligned bounds in world space.
+    /// </summary>
+    struct BoundingBox
+    {
+        glm::vec3 minimum = glm::vec3(0.f);
+        glm::vec3 maximum = glm::vec3(0.f);
+    };
+
+    /// <summary>
+    /// A spot light's volume, the apex at the light with <angle> the half angle in radians.
+    /// </summary>
+    struct BvhCone
+    {
+        glm::vec3 apex;
+        float range;
+        glm::vec3 direction;
+        float angle;
+    };
+
+    struct BvhRay
+    {
+        glm::vec3 origin;
+        float maxDistance;
+        glm::vec3 direction;
+    };
+
+    /// <summary>
+    /// Nearest instance a ray enters, <instance> being NoHit if there's none.
+    /// </summary>
+    struct BvhHit
+    {
+        GLuint instance;
+        float distance;
+    };
+
+    /// <summary>
+    /// Counts for the last build and refit.
+    /// </summary>
+    struct BvhStats
+    {
+        GLuint instances = 0;
+        GLuint nodes = 0;
+        GLuint depth = 0;
+        float buildMs = 0.f;
+        GLuint refitInstances = 0;
+        GLuint refitNodes = 0;
+        float refitMs = 0.f;
+    };
+
+    /// <summary>
+    /// Bounding volume hierarchy over the scene's instances, built top down by binning centroids and splitting
+    /// where the surface area heuristic is cheapest. Nodes are stored depth first with a node's children next to
+    /// each other and after it, so a refit only has to walk the moved instances' leaves up to the root, parents
+    /// after children. Each query returns the instance ids it found in ascending order, and the batched forms run
+    /// one query per job. Queries also return how many instances they tested one by one, those in subtrees taken
+    /// whole never being tested.
+    /// </summary>
+    class InstanceBVH
+    {
+    public:
+        static const GLuint NoHit = ~0u;
+
+        // Replaces the hierarchy with one over <boxes>, indexed by instance.
+        void build(const std::vector<BoundingBox>& boxes);
+
+        // Updates the bounds of <instances> from <boxes> and every node above them, leaving the structure alone.
+        // Only instances that moved need passing, static ones never do.
+        void refit(const std::vector<BoundingBox>& boxes, const std::vector<GLuint>& instances);
+
+        bool empty() const { return m_nodes.empty(); }
+
+        // Instances touching the frustum of the six inward facing <planes>.
+        GLuint queryFrustum(const glm::vec4* planes, std::vector<GLuint>& instances) const;
+
+        // Instances touching the sphere, centre in xyz and radius in w.
+        GLuint querySphere(const glm::vec4& sphere, std::vector<GLuint>& instances) const;
+
+        // Instances touching the cone, tested by their bounding spheres so a few near its edge may be included.
+        GLuint queryCone(const BvhCone& cone, std::vector<GLuint>& instances) const;
+
+        // Nearest instance whose bounds the ray enters within its length. Instances the ray starts inside are
+        // skipped, so picking from within the scene's outer shell finds what's in front of the camera.
+        BvhHit queryRay(const BvhRay& ray) const;
+
+        GLuint queryFrusta(JobSystem& jobs, const std::vector<FrustumCuller>& frusta,
+            std::vector<std::vector<GLuint>>& results) const;
+        GLuint querySpheres(JobSystem& jobs, const std::vector<glm::vec4>& spheres,
+            std::vector<std::vector<GLuint>>& results) const;
+        GLuint queryCones(JobSystem& jobs, const std::vector<BvhCone>& cones,
+            std::vector<std::vector<GLuint>>& results) const;
+        void queryRays(JobSystem& jobs, const std::vector<BvhRay>& rays, std::vector<BvhHit>& hits) const;
+
+        // The same queries testing every box in turn, kept as the baseline the hierarchy is measured against.
+        static void scanFrustum(const std::vector<BoundingBox>& boxes, const glm::vec4* planes, std::vector<GLuint>& instances);
+        static void scanSphere(const std::vector<BoundingBox>& boxes, const glm::vec4& sphere, std::vector<GLuint>& instances);
+        static void scanCone(const std::vector<BoundingBox>& boxes, const BvhCone& cone, std::vector<GLuint>& instances);
+        static BvhHit scanRay(const std::vector<BoundingBox>& boxes, const BvhRay& ray);
+
+        const BvhStats& getStats() const { return m_stats; }
+
+        void printStats() const;
+
+    private:
+        // Interior nodes have no count, with their children at <first> and <first> + 1. Leaves hold <count>
+        // instances from <first> in the instance order.
+        struct Node
+        {
+            glm::vec3 minimum;
+            GLuint first;
+            glm::vec3 maximum;
+            GLuint count;
+        };
+
+        // Fills <instances> with those whose bounds <test> accepts. <test> takes a box and returns 0 to skip it, 1 to
+        // look inside it and 2 to take everything below it. Returns how many instances it tested one by one.
+        template<typename Test>
+        GLuint traverse(Test test, std::vector<GLuint>& instances) const;
+
+        void addSubtree(GLuint node, std::vector<GLuint>& instances) const;
+
+        // Splits the node's instances at the cheapest binned plane, or makes it a leaf if no split is cheaper.
+        bool split(GLuint node, const std::vector<BoundingBox>& boxes, const std::vector<glm::vec3>& centres);
+
+        void fitLeaf(Node& node, const std::vector<BoundingBox>& boxes) const;
+
+        std::vector<Node> m_nodes;
+        std::vector<GLuint> m_parents;
+
+        // Instances in leaf order with their boxes, and where each instance is in it and which leaf holds it.
+        std::vector<GLuint> m_order;
+        std::vector<BoundingBox> m_boxes;
+        std::vector<GLuint> m_positionOf;
+        std::vector<GLuint> m_leafOf;
+
+        // Interior nodes above the instances being refitted.
+        std::vector<GLuint> m_dirty;
+        std::vector<GLubyte> m_isDirty;
+
+        BvhStats m_stats;
+    };
+}
@@ -0,0 +1,481 @@
+#include "JobBenchmark.hpp"
+#include "JobSystem.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <random>
+
+namespace MLK
+{
+    namespace
+    {
+        const int g_runs = 5;
+
+        // Roughly Sponza's extents, so lights and instances are spread over a similar space at a higher density.
+        const glm::vec3 g_sceneMin(-1900.f, 0.f, -1100.f);
+        const glm::vec3 g_sceneMax(1800.f, 1400.f, 1100.f);
+
+        // Instances per mesh in the synthetic scene, so 100k instances share 1000 meshes.
+        const GLuint g_instancesPerMesh = 100;
+
+        float millisecondsSince(JobSystem::Clock::time_point start)
+        {
+            return std::chrono::duration<float, std::milli>(JobSystem::Clock::now() - start).count();
+        }
+    }
+
+    JobBenchmark::JobBenchmark(JobSystem& jobs, GLuint instanceCount, GLuint lightCount) :
+        m_jobs(jobs)
+    {
+        // Fixed seed so runs are comparable between builds.
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        const auto randomPosition = [&]()
+        {
+            return glm::mix(g_sceneMin, g_sceneMax, glm::vec3(unit(random), unit(random), unit(random)));
+        };
+
+        m_transforms.reserve(instanceCount);
+        m_materialIds.reserve(instanceCount);
+        for (GLuint i = 0; i < instanceCount; ++i)
+        {
+            const auto rotation = glm::rotate(glm::mat4(1.f), unit(random) * 6.283f, glm::vec3(0.f, 1.f, 0.f));
+            m_transforms.push_back(glm::translate(glm::mat4(1.f), randomPosition()) * rotation *
+                glm::scale(glm::mat4(1.f), glm::vec3(0.5f + unit(random))));
+            m_materialIds.push_back(i % 16);
+        }
+
+        // Half point and half spot lights, the same mix of sizes as the scene's own.
+        for (GLuint i = 0; i < lightCount; ++i)
+        {
+            const auto position = randomPosition();
+            const sponza::Vector3 intensity(unit(random), unit(random), unit(random));
+            const auto range = 50.f + unit(random) * 450.f;
+            if (i % 2 == 0)
+            {
+                sponza::PointLight light(i);
+                light.setPosition(sponza::Vector3(position.x, position.y, position.z));
+                light.setIntensity(intensity);
+                light.setRange(range);
+                m_pointLights.push_back(light);
+            }
+            else
+            {
+                const auto direction = glm::normalize(glm::vec3(unit(random) - 0.5f, -1.f, unit(random) - 0.5f));
+                sponza::SpotLight light(i);
+                light.setPosition(sponza::Vector3(position.x, position.y, position.z));
+                light.setDirection(sponza::Vector3(direction.x, direction.y, direction.z));
+                light.setConeAngleDegrees(20.f + unit(random) * 70.f);
+                light.setIntensity(intensity);
+                light.setRange(range);
+                m_spotLights.push_back(light);
+            }
+        }
+
+        for (GLuint i = 0; i < instanceCount; ++i)
+        {
+            const auto& model = m_transforms[i];
+            const sponza::Matrix4x3 transform(model[0].x, model[0].y, model[0].z, model[1].x, model[1].y, model[1].z,
+                model[2].x, model[2].y, model[2].z, model[3].x, model[3].y, model[3].z);
+
+            sponza::Instance instance(100 + i);
+            instance.setMeshId(300 + i / g_instancesPerMesh);
+            instance.setMaterialId(200 + m_materialIds[i]);
+            instance.setTransformationMatrix(transform);
+            instance.setStatic(i % 10 != 0);
+            m_instanceObjects.push_back(instance);
+
+            m_instanceTransforms.push_back(transform);
+            m_instanceStaticFlags.push_back(instance.isStatic() ? 1 : 0);
+
+            if (i % g_instancesPerMesh == 0)
+            {
+                m_instancesByMesh.emplace_back();
+            }
+            m_instancesByMesh.back().push_back(instance.getId());
+        }
+        m_gathered.resize(instanceCount);
+
+        m_instanceData.resize(instanceCount);
+        m_bounds.resize(instanceCount);
+        m_lights.resize(lightCount);
+        m_rects.resize(lightCount);
+        m_visible.resize(lightCount);
+    }
+
+    void JobBenchmark::run(const glm::mat4& viewProjection, GLint width, GLint height)
+    {
+        m_culler.beginFrame(viewProjection, width, height);
+
+        const auto pointCount = m_pointLights.size();
+        const Stage stages[] =
+        {
+            { "Instance data", m_transforms.size(), 1024, [this](size_t begin, size_t end)
+            {
+                for (auto i = begin; i < end; ++i)
+                {
+                    m_instanceData[i] = MeshInstanceData(m_transforms[i], m_instanceData[i].ModelTransform, m_materialIds[i]);
+                }
+            } },
+            { "Instance bounds", m_transforms.size(), 1024, [this](size_t begin, size_t end)
+            {
+                for (auto i = begin; i < end; ++i)
+                {
+                    const auto& model = m_transforms[i];
+                    const auto scale = std::max(glm::length(glm::vec3(model[0])),
+                        std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+                    m_bounds[i] = glm::vec4(glm::vec3(model[3]), scale);
+                }
+            } },
+            { "Build and cull lights", m_lights.size(), 256, [this, pointCount](size_t begin, size_t end)
+            {
+                for (auto i = begin; i < end; ++i)
+                {
+                    if (i < pointCount)
+                    {
+                        m_lights[i] = ShaderLight(m_pointLights[i]);
+                        m_visible[i] = m_culler.cullPointLight(m_lights[i], m_rects[i]);
+                    }
+                    else
+                    {
+                        m_lights[i] = ShaderLight(m_spotLights[i - pointCount]);
+                        m_visible[i] = m_culler.cullSpotLight(m_lights[i], m_rects[i]);
+                    }
+                }
+            } },
+        };
+
+        std::cout << "Job benchmark: " << m_transforms.size() << " instances, " << m_lights.size() << " lights, "
+            << m_jobs.getThreadCount() << " threads, best of " << g_runs << std::endl;
+        const auto report = [](const char* name, float serialMs, float parallelMs)
+        {
+            std::cout << "  " << name << ": " << serialMs << "ms serial, " << parallelMs << "ms parallel ("
+                << (parallelMs > 0.f ? serialMs / parallelMs : 0.f) << "x)" << std::endl;
+        };
+
+        float serialTotal = 0.f;
+        float parallelTotal = 0.f;
+        for (const auto& stage : stages)
+        {
+            const auto serialMs = time(stage, false);
+            const auto parallelMs = time(stage, true);
+            report(stage.name, serialMs, parallelMs);
+            serialTotal += serialMs;
+            parallelTotal += parallelMs;
+        }
+
+        // Every light is scored as if it survived so the sort is the same size whatever the view.
+        m_scores.clear();
+        for (GLuint i = 0; i < m_lights.size(); ++i)
+        {
+            const auto& intensity = m_lights[i].Intensity;
+            m_scores.push_back({ m_rects[i].width * (float)m_rects[i].height * std::max(intensity.r, std::max(intensity.g, intensity.b)), i });
+        }
+
+        const auto byScore = [](const std::pair<float, GLuint>& a, const std::pair<float, GLuint>& b) { return a.first > b.first; };
+        float sortMs[2] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+        for (int parallel = 0; parallel < 2; ++parallel)
+        {
+            for (int run = 0; run < g_runs; ++run)
+            {
+                auto scores = m_scores;
+                const auto start = JobSystem::Clock::now();
+                if (parallel)
+                {
+                    m_jobs.parallelSort("Sort lights", scores.begin(), scores.end(), byScore, 1024);
+                }
+                else
+                {
+                    std::sort(scores.begin(), scores.end(), byScore);
+                }
+                sortMs[parallel] = std::min(sortMs[parallel], millisecondsSince(start));
+            }
+        }
+        report("Sort lights", sortMs[0], sortMs[1]);
+
+        serialTotal += sortMs[0];
+        parallelTotal += sortMs[1];
+        report("Total", serialTotal, parallelTotal);
+        std::cout << "  " << std::count(m_visible.begin(), m_visible.end(), 1) << " lights visible" << std::endl;
+
+        m_instanceSpheres.resize(m_bounds.size());
+        for (size_t i = 0; i < m_bounds.size(); ++i)
+        {
+            m_instanceSpheres.set(i, m_bounds[i]);
+        }
+
+        m_lightSpheres.resize(m_lights.size());
+        for (size_t i = 0; i < m_lights.size(); ++i)
+        {
+            m_lightSpheres.set(i, i < pointCount ? glm::vec4(m_lights[i].Position, m_lights[i].Range) : LightCuller::getSpotBounds(m_lights[i]));
+        }
+
+        const FrustumCuller culler(viewProjection);
+        benchmarkCulling("Instances", m_instanceSpheres, culler);
+        benchmarkCulling("Lights", m_lightSpheres, culler);
+
+        benchmarkSceneQueries();
+        benchmarkBVH();
+    }
+
+    void JobBenchmark::benchmarkBVH()
+    {
+        // Boxes around the instance spheres, so the hierarchy sees the same scene the culling did.
+        m_instanceBoxes.resize(m_bounds.size());
+        for (size_t i = 0; i < m_bounds.size(); ++i)
+        {
+            m_instanceBoxes[i].minimum = glm::vec3(m_bounds[i]) - m_bounds[i].w;
+            m_instanceBoxes[i].maximum = glm::vec3(m_bounds[i]) + m_bounds[i].w;
+        }
+
+        float buildMs = std::numeric_limits<float>::max();
+        for (int run = 0; run < g_runs; ++run)
+        {
+            const auto start = JobSystem::Clock::now();
+            m_bvh.build(m_instanceBoxes);
+            buildMs = std::min(buildMs, millisecondsSince(start));
+        }
+
+        // One instance in a hundred nudged, as if they were the dynamic ones.
+        std::vector<GLuint> moved;
+        for (GLuint i = 0; i < (GLuint)m_instanceBoxes.size(); i += 100)
+        {
+            m_instanceBoxes[i].minimum.y += 1.f;
+            m_instanceBoxes[i].maximum.y += 1.f;
+            moved.push_back(i);
+        }
+
+        float refitMs = std::numeric_limits<float>::max();
+        for (int run = 0; run < g_runs; ++run)
+        {
+            const auto start = JobSystem::Clock::now();
+            m_bvh.refit(m_instanceBoxes, moved);
+            refitMs = std::min(refitMs, millisecondsSince(start));
+        }
+
+        std::cout << "  Instance BVH over " << m_instanceBoxes.size() << " instances: " << m_bvh.getStats().nodes
+            << " nodes, depth " << m_bvh.getStats().depth << ", built in " << buildMs << "ms, " << moved.size()
+            << " refitted in " << refitMs << "ms (" << m_bvh.getStats().refitNodes << " nodes)" << std::endl;
+
+        // Queries as the renderer makes them: frusta and cones from spot lights, spheres from point lights, and rays
+        // for picking.
+        const GLuint queryCount = 256;
+        std::vector<FrustumCuller> frusta;
+        std::vector<BvhCone> cones;
+        std::vector<glm::vec4> spheres;
+        for (GLuint i = 0; i < queryCount; ++i)
+        {
+            const auto& spot = m_lights[m_pointLights.size() + i % m_spotLights.size()];
+            frusta.push_back(FrustumCuller(glm::perspective(spot.Angle * 2.f, 1.f, 0.1f, spot.Range) *
+                glm::lookAt(spot.Position, spot.Position + spot.Direction, glm::vec3(0.f, 1.f, 0.f))));
+            cones.push_back({ spot.Position, spot.Range, spot.Direction, spot.Angle });
+
+            const auto& point = m_lights[i % m_pointLights.size()];
+            spheres.push_back(glm::vec4(point.Position, point.Range));
+        }
+
+        std::mt19937 random(4321);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        std::vector<BvhRay> rays;
+        for (GLuint i = 0; i < queryCount * 16; ++i)
+        {
+            const auto origin = glm::mix(g_sceneMin, g_sceneMax, glm::vec3(unit(random), unit(random), unit(random)));
+            const auto direction = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) - 0.5f);
+            rays.push_back({ origin, 5000.f, direction });
+        }
+
+        const auto report = [](const char* name, size_t count, float bvhMs, float batchedMs, float scanMs,
+            size_t bvhFound, size_t scanFound)
+        {
+            std::cout << "  " << name << ": " << count / bvhMs << " per ms through the BVH, " << count / batchedMs
+                << " batched, " << count / scanMs << " testing every instance (" << (bvhMs > 0.f ? scanMs / bvhMs : 0.f)
+                << "x), found " << bvhFound << " against " << scanFound << std::endl;
+        };
+
+        // Times <query> over every query serially and batched, and <scan> serially, summing what each finds.
+        std::vector<GLuint> found;
+        std::vector<std::vector<GLuint>> batched;
+        const auto measure = [&](const char* name, size_t count, const std::function<size_t(size_t)>& query,
+            const std::function<void()>& batch, const std::function<size_t(size_t)>& scan)
+        {
+            float best[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+            size_t totals[2] = {};
+            for (int run = 0; run < g_runs; ++run)
+            {
+                totals[0] = totals[1] = 0;
+
+                auto start = JobSystem::Clock::now();
+                for (size_t i = 0; i < count; ++i)
+                {
+                    totals[0] += query(i);
+                }
+                best[0] = std::min(best[0], millisecondsSince(start));
+
+                start = JobSystem::Clock::now();
+                batch();
+                best[1] = std::min(best[1], millisecondsSince(start));
+
+                start = JobSystem::Clock::now();
+                for (size_t i = 0; i < count; ++i)
+                {
+                    totals[1] += scan(i);
+                }
+                best[2] = std::min(best[2], millisecondsSince(start));
+            }
+            report(name, count, best[0], best[1], best[2], totals[0], totals[1]);
+        };
+
+        measure("Frustum queries", frusta.size(),
+            [&](size_t i) { m_bvh.queryFrustum(frusta[i].getPlanes(), found); return found.size(); },
+            [&]() { m_bvh.queryFrusta(m_jobs, frusta, batched); },
+            [&](size_t i) { InstanceBVH::scanFrustum(m_instanceBoxes, frusta[i].getPlanes(), found); return found.size(); });
+
+        measure("Sphere queries", spheres.size(),
+            [&](size_t i) { m_bvh.querySphere(spheres[i], found); return found.size(); },
+            [&]() { m_bvh.querySpheres(m_jobs, spheres, batched); },
+            [&](size_t i) { InstanceBVH::scanSphere(m_instanceBoxes, spheres[i], found); return found.size(); });
+
+        measure("Cone queries", cones.size(),
+            [&](size_t i) { m_bvh.queryCone(cones[i], found); return found.size(); },
+            [&]() { m_bvh.queryCones(m_jobs, cones, batched); },
+            [&](size_t i) { InstanceBVH::scanCone(m_instanceBoxes, cones[i], found); return found.size(); });
+
+        // Rays find at most one instance each, so what they find is their hit count.
+        std::vector<BvhHit> hits;
+        measure("Ray queries", rays.size(),
+            [&](size_t i) { return (size_t)(m_bvh.queryRay(rays[i]).instance != InstanceBVH::NoHit); },
+            [&]() { m_bvh.queryRays(m_jobs, rays, hits); },
+            [&](size_t i) { return (size_t)(InstanceBVH::scanRay(m_instanceBoxes, rays[i]).instance != InstanceBVH::NoHit); });
+    }
+
+    void JobBenchmark::benchmarkSceneQueries()
+    {
+        const auto report = [](const char* name, float objectsMs, float arraysMs)
+        {
+            std::cout << "  " << name << ": " << objectsMs << "ms through objects or copies, " << arraysMs
+                << "ms through arrays or views (" << (arraysMs > 0.f ? objectsMs / arraysMs : 0.f) << "x)" << std::endl;
+        };
+
+        // Each query keeps its best run, with a checksum so the work can't be optimised away.
+        float best[3][2];
+        size_t checksum = 0;
+        for (auto& query : best)
+        {
+            query[0] = query[1] = std::numeric_limits<float>::max();
+        }
+
+        for (int run = 0; run < g_runs; ++run)
+        {
+            // Streaming every transform into an instance buffer.
+            auto start = JobSystem::Clock::now();
+            for (size_t i = 0; i < m_instanceObjects.size(); ++i)
+            {
+                m_gathered[i] = m_instanceObjects[i].getTransformationMatrix();
+            }
+            best[0][0] = std::min(best[0][0], millisecondsSince(start));
+
+            start = JobSystem::Clock::now();
+            const sponza::ArrayView<sponza::Matrix4x3> transforms(m_instanceTransforms.data(), m_instanceTransforms.size());
+            std::copy(transforms.begin(), transforms.end(), m_gathered.begin());
+            best[0][1] = std::min(best[0][1], millisecondsSince(start));
+
+            // Looking up every mesh's instances, once copied out per mesh as getInstancesByMeshId used to.
+            start = JobSystem::Clock::now();
+            for (const auto& ids : m_instancesByMesh)
+            {
+                const std::vector<sponza::InstanceId> copy = ids;
+                checksum += copy.size();
+            }
+            best[1][0] = std::min(best[1][0], millisecondsSince(start));
+
+            start = JobSystem::Clock::now();
+            for (const auto& ids : m_instancesByMesh)
+            {
+                const sponza::ArrayView<sponza::InstanceId> view(ids.data(), ids.size());
+                checksum += view.size();
+            }
+            best[1][1] = std::min(best[1][1], millisecondsSince(start));
+
+            // Counting the static instances.
+            start = JobSystem::Clock::now();
+            for (const auto& instance : m_instanceObjects)
+            {
+                checksum += instance.isStatic() ? 1 : 0;
+            }
+            best[2][0] = std::min(best[2][0], millisecondsSince(start));
+
+            start = JobSystem::Clock::now();
+            for (const auto flag : m_instanceStaticFlags)
+            {
+                checksum += flag;
+            }
+            best[2][1] = std::min(best[2][1], millisecondsSince(start));
+        }
+
+        std::cout << "  Scene queries over " << m_instanceObjects.size() << " instances (checksum " << checksum << ")" << std::endl;
+        report("Gather transforms", best[0][0], best[0][1]);
+        report("Instances by mesh", best[1][0], best[1][1]);
+        report("Count static", best[2][0], best[2][1]);
+    }
+
+    void JobBenchmark::benchmarkCulling(const char* name, const SphereBoundsSoA& bounds, const FrustumCuller& culler)
+    {
+        const auto measure = [&](int path)
+        {
+            auto best = std::numeric_limits<float>::max();
+            size_t visible = 0;
+            for (int run = 0; run < g_runs; ++run)
+            {
+                m_culled.resize(bounds.paddedCount());
+                const auto start = JobSystem::Clock::now();
+                if (path == 0)
+                {
+                    visible = culler.cullRangeScalar(bounds, 0, bounds.count, m_culled.data());
+                }
+                else if (path == 1)
+                {
+                    visible = culler.cullRange(bounds, 0, bounds.paddedCount(), m_culled.data());
+                }
+                else
+                {
+                    culler.cull(m_jobs, bounds, m_culled);
+                    visible = m_culled.size();
+                }
+                best = std::min(best, millisecondsSince(start));
+            }
+
+            // Visible counts are printed alongside so the paths can be checked against each other.
+            std::cout << (path == 0 ? "" : ", ") << bounds.count / std::max(best * 1000.f, 1e-6f)
+                << (path == 0 ? " scalar" : path == 1 ? " SIMD" : " SIMD parallel") << " (" << visible << " visible)";
+        };
+
+        std::cout << "  " << name << " culled per us: ";
+        for (int path = 0; path < 3; ++path)
+        {
+            measure(path);
+        }
+        std::cout << std::endl;
+    }
+
+    float JobBenchmark::time(const Stage& stage, bool parallel)
+    {
+        auto best = std::numeric_limits<float>::max();
+        for (int run = 0; run < g_runs; ++run)
+        {
+            const auto start = JobSystem::Clock::now();
+            if (parallel)
+            {
+                m_jobs.parallelFor(stage.name, stage.count, stage.grain, stage.function);
+            }
+            else
+            {
+                stage.function(0, stage.count);
+            }
+            best = std::min(best, millisecondsSince(start));
+        }
+        return best;
+    }
+}
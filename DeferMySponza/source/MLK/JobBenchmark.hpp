@@ -0,0 +1,87 @@
+#pragma once
+
+#include "ShaderStructs.hpp"
+#include "LightCuller.hpp"
+#include "FrustumCuller.hpp"
+#include "InstanceBVH.hpp"
+
+#include <tgl/tgl.h>
+#include <glm/glm.hpp>
+#include <sponza/sponza.hpp>
+
+#include <functional>
+#include <vector>
+
+namespace MLK
+{
+    class JobSystem;
+
+    /// <summary>
+    /// Times the per frame CPU work over a synthetic scene far larger than Sponza, once on the calling thread and
+    /// once split across the job system, to check the work scales with the number of cores. The stages mirror the
+    /// renderer's: building instance data, bounding the instances, building and culling lights, and sorting the
+    /// survivors by score. Frustum culling throughput is measured separately, scalar against SIMD against SIMD
+    /// across the job threads, as are the scene queries the renderer makes each frame through the instance objects
+    /// against the scene's instance arrays, and the instance BVH's queries against testing every instance.
+    /// </summary>
+    class JobBenchmark
+    {
+    public:
+        JobBenchmark(JobSystem& jobs, GLuint instanceCount = 100000, GLuint lightCount = 10000);
+
+        // Runs each stage serially then in parallel, keeping the best of several runs, and prints the timings.
+        void run(const glm::mat4& viewProjection, GLint width, GLint height);
+
+    private:
+        struct Stage
+        {
+            const char* name;
+            size_t count;
+            size_t grain;
+            std::function<void(size_t, size_t)> function;
+        };
+
+        // Best time in milliseconds of a few runs.
+        float time(const Stage& stage, bool parallel);
+
+        // Times reading instance data from objects, as getAllInstances gives it, against the parallel arrays and
+        // views the scene also keeps.
+        void benchmarkSceneQueries();
+
+        // Times building and refitting a BVH over the instances, then each kind of query through it, serially and
+        // batched, against brute force.
+        void benchmarkBVH();
+
+        // Prints objects culled per microsecond by each frustum culling path.
+        void benchmarkCulling(const char* name, const SphereBoundsSoA& bounds, const FrustumCuller& culler);
+
+        JobSystem& m_jobs;
+
+        std::vector<glm::mat4> m_transforms;
+        std::vector<GLuint> m_materialIds;
+        std::vector<sponza::PointLight> m_pointLights;
+        std::vector<sponza::SpotLight> m_spotLights;
+
+        std::vector<MeshInstanceData> m_instanceData;
+        std::vector<glm::vec4> m_bounds;
+        std::vector<ShaderLight> m_lights;
+        std::vector<ScissorRect> m_rects;
+        std::vector<GLubyte> m_visible;
+        std::vector<std::pair<float, GLuint>> m_scores;
+        SphereBoundsSoA m_instanceSpheres;
+        SphereBoundsSoA m_lightSpheres;
+        std::vector<GLuint> m_culled;
+
+        // The synthetic instances laid out both ways, grouped by mesh as the scene groups them.
+        std::vector<sponza::Instance> m_instanceObjects;
+        std::vector<sponza::Matrix4x3> m_instanceTransforms;
+        std::vector<unsigned char> m_instanceStaticFlags;
+        std::vector<std::vector<sponza::InstanceId>> m_instancesByMesh;
+        std::vector<sponza::Matrix4x3> m_gathered;
+
+        std::vector<BoundingBox> m_instanceBoxes;
+        InstanceBVH m_bvh;
+
+        LightCuller m_culler;
+    };
+}
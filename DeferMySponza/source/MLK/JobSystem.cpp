@@ -0,0 +1,209 @@
+#include "JobSystem.hpp"
+
+#include <fstream>
+#include <iostream>
+
+namespace MLK
+{
+    namespace
+    {
+        // Threads that aren't workers, such as the main thread, share index 0.
+        thread_local GLuint t_threadIndex = 0;
+
+        long long toNanoseconds(JobSystem::Clock::duration duration)
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        }
+    }
+
+    JobSystem::JobSystem(GLuint workerCount)
+    {
+        for (GLuint i = 0; i <= workerCount; ++i)
+        {
+            m_workers.emplace_back(new Worker());
+        }
+
+        for (GLuint i = 1; i <= workerCount; ++i)
+        {
+            m_threads.emplace_back(&JobSystem::workerLoop, this, i);
+        }
+
+        m_frameStart = Clock::now();
+    }
+
+    JobSystem::~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+
+        for (auto& thread : m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    void JobSystem::run(const char* name, const Job& job, std::atomic<GLuint>& counter)
+    {
+        counter.fetch_add(1);
+        push(getThreadIndex(), { name, job, &counter });
+        m_wake.notify_one();
+    }
+
+    void JobSystem::wait(const std::atomic<GLuint>& counter)
+    {
+        const auto thread = getThreadIndex();
+        while (counter.load() > 0)
+        {
+            if (!tryRunJob(thread))
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void JobSystem::beginFrame()
+    {
+        // Every job from the last frame has been waited on, so the workers are no longer writing their traces.
+        const auto now = Clock::now();
+        m_lastFrameLength = toNanoseconds(now - m_frameStart);
+        m_frameStart = now;
+
+        m_lastFrame.clear();
+        for (auto& worker : m_workers)
+        {
+            m_lastFrame.insert(m_lastFrame.end(), worker->trace.begin(), worker->trace.end());
+            worker->trace.clear();
+        }
+    }
+
+    void JobSystem::printTrace() const
+    {
+        std::vector<GLuint> jobs(m_workers.size(), 0);
+        std::vector<long long> busy(m_workers.size(), 0);
+        for (const auto& event : m_lastFrame)
+        {
+            ++jobs[event.thread];
+            busy[event.thread] += event.end - event.start;
+        }
+
+        const auto frameMs = m_lastFrameLength * 1e-6f;
+        std::cout << "Jobs: " << m_lastFrame.size() << " over " << m_workers.size() << " threads in a "
+            << frameMs << "ms frame" << std::endl;
+        for (size_t i = 0; i < m_workers.size(); ++i)
+        {
+            const auto busyMs = busy[i] * 1e-6f;
+            std::cout << "  Thread " << i << (i == 0 ? " (main)" : "") << ": " << jobs[i] << " jobs, " << busyMs
+                << "ms busy (" << (frameMs > 0.f ? 100.f * busyMs / frameMs : 0.f) << "%)" << std::endl;
+        }
+    }
+
+    void JobSystem::writeTrace(const char* path) const
+    {
+        std::ofstream file(path);
+        file << "{\"traceEvents\":[";
+        for (size_t i = 0; i < m_lastFrame.size(); ++i)
+        {
+            const auto& event = m_lastFrame[i];
+            file << (i == 0 ? "" : ",") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+                << event.thread << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":"
+                << (event.end - event.start) / 1000.0 << "}";
+        }
+        file << "]}" << std::endl;
+    }
+
+    void JobSystem::push(GLuint thread, Task&& task)
+    {
+        auto& worker = *m_workers[thread];
+        {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.tasks.push_back(std::move(task));
+        }
+
+        // Taken under the sleep lock so a worker deciding to sleep can't miss it.
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_pending.fetch_add(1);
+    }
+
+    bool JobSystem::tryRunJob(GLuint thread)
+    {
+        Task task;
+        bool found = false;
+
+        // Newest first from our own deque, it's the most likely to still be in cache.
+        {
+            auto& own = *m_workers[thread];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                found = true;
+            }
+        }
+
+        // Oldest first from the others, starting from the next thread along so thieves spread out.
+        for (size_t i = 1; i < m_workers.size() && !found; ++i)
+        {
+            auto& victim = *m_workers[(thread + i) % m_workers.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                found = true;
+            }
+        }
+
+        if (!found)
+        {
+            return false;
+        }
+
+        m_pending.fetch_sub(1);
+        execute(task, thread);
+        return true;
+    }
+
+    void JobSystem::execute(Task& task, GLuint thread)
+    {
+        const auto start = Clock::now();
+        task.job();
+        trace(task.name, thread, start, Clock::now());
+
+        // Released last, once the trace is written, so a finished wait means the job has no more work to do.
+        task.counter->fetch_sub(1);
+    }
+
+    void JobSystem::workerLoop(GLuint thread)
+    {
+        t_threadIndex = thread;
+
+        for (;;)
+        {
+            if (tryRunJob(thread))
+            {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_wake.wait(lock, [this]() { return m_stopping || m_pending.load() > 0; });
+            if (m_stopping)
+            {
+                return;
+            }
+        }
+    }
+
+    void JobSystem::trace(const char* name, GLuint thread, Clock::time_point start, Clock::time_point end)
+    {
+        m_workers[thread]->trace.push_back({ name, thread, toNanoseconds(start - m_frameStart), toNanoseconds(end - m_frameStart) });
+    }
+
+    GLuint JobSystem::getThreadIndex()
+    {
+        return t_threadIndex;
+    }
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <tgl/tgl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace MLK
+{
+    /// <summary>
+    /// A job as it ran, in nanoseconds from the start of the frame it ran in.
+    /// </summary>
+    struct JobTraceEvent
+    {
+        const char* name;
+        GLuint thread;
+        long long start;
+        long long end;
+    };
+
+    /// <summary>
+    /// Work stealing job scheduler for per frame CPU work. Each thread has its own deque, taking its newest job
+    /// from the back while idle threads steal the oldest from the front of the others. The thread waiting on a set
+    /// of jobs runs jobs itself until they're done, so the main thread is never idle while its work is queued.
+    /// Loops are split into chunks of at least a grain of iterations, and no more than a few per thread, so the
+    /// scheduling cost stays flat however large the loop. Every job is traced with its thread and timing for the
+    /// last complete frame.
+    /// </summary>
+    class JobSystem
+    {
+    public:
+        using Job = std::function<void()>;
+        using Clock = std::chrono::high_resolution_clock;
+
+        // The calling thread takes part as thread 0, alongside <workerCount> worker threads.
+        JobSystem(GLuint workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1);
+        ~JobSystem();
+
+        // Queues <job> on the calling thread, counting it on <counter> until it's finished.
+        void run(const char* name, const Job& job, std::atomic<GLuint>& counter);
+
+        // Runs queued jobs until <counter> reaches zero.
+        void wait(const std::atomic<GLuint>& counter);
+
+        // Calls <function>(begin, end) over [0, <count>) in chunks of at least <grain>, returning once all are done.
+        template<typename Function>
+        void parallelFor(const char* name, size_t count, size_t grain, const Function& function);
+
+        // Sorts runs of the range in parallel then merges them in parallel rounds.
+        template<typename Iterator, typename Compare>
+        void parallelSort(const char* name, Iterator begin, Iterator end, Compare compare, size_t grain = 4096);
+
+        GLuint getThreadCount() const { return (GLuint)m_workers.size(); }
+
+        // Keeps the finished frame's trace and starts recording the next.
+        void beginFrame();
+
+        // Prints each thread's job count and busy time over the last frame.
+        void printTrace() const;
+
+        // Writes the last frame's trace in the Chrome trace event format, for chrome://tracing.
+        void writeTrace(const char* path) const;
+
+    private:
+        struct Task
+        {
+            const char* name;
+            Job job;
+            std::atomic<GLuint>* counter;
+        };
+
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+            std::vector<JobTraceEvent> trace;
+        };
+
+        void push(GLuint thread, Task&& task);
+        bool tryRunJob(GLuint thread);
+        void execute(Task& task, GLuint thread);
+        void workerLoop(GLuint thread);
+
+        // Records a job run outside the queues, such as a loop too small to split.
+        void trace(const char* name, GLuint thread, Clock::time_point start, Clock::time_point end);
+
+        static GLuint getThreadIndex();
+
+        std::vector<std::unique_ptr<Worker>> m_workers;
+        std::vector<std::thread> m_threads;
+
+        std::mutex m_sleepMutex;
+        std::condition_variable m_wake;
+        std::atomic<GLuint> m_pending{ 0 };
+        bool m_stopping = false;
+
+        Clock::time_point m_frameStart;
+        long long m_lastFrameLength = 0;
+        std::vector<JobTraceEvent> m_lastFrame;
+    };
+
+    template<typename Function>
+    void JobSystem::parallelFor(const char* name, size_t count, size_t grain, const Function& function)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        // A few chunks per thread lets stealing even out uneven chunks without flooding the deques.
+        const size_t chunksPerThread = 4;
+        grain = std::max(std::max<size_t>(1, grain), count / (getThreadCount() * chunksPerThread));
+
+        if (count <= grain || getThreadCount() == 1)
+        {
+            const auto start = Clock::now();
+            function(size_t(0), count);
+            trace(name, getThreadIndex(), start, Clock::now());
+            return;
+        }
+
+        std::atomic<GLuint> counter{ 0 };
+        const auto thread = getThreadIndex();
+        for (size_t begin = 0; begin < count; begin += grain)
+        {
+            const auto end = std::min(count, begin + grain);
+            counter.fetch_add(1);
+            push(thread, { name, [&function, begin, end]() { function(begin, end); }, &counter });
+        }
+        m_wake.notify_all();
+
+        wait(counter);
+    }
+
+    template<typename Iterator, typename Compare>
+    void JobSystem::parallelSort(const char* name, Iterator begin, Iterator end, Compare compare, size_t grain)
+    {
+        const size_t count = end - begin;
+        if (count <= grain || getThreadCount() == 1)
+        {
+            const auto start = Clock::now();
+            std::sort(begin, end, compare);
+            trace(name, getThreadIndex(), start, Clock::now());
+            return;
+        }
+
+        const size_t runs = std::min<size_t>(getThreadCount() * 2, (count + grain - 1) / grain);
+        const size_t runLength = (count + runs - 1) / runs;
+        parallelFor(name, runs, 1, [&](size_t first, size_t last)
+        {
+            for (auto run = first; run < last; ++run)
+            {
+                std::sort(begin + run * runLength, begin + std::min(count, (run + 1) * runLength), compare);
+            }
+        });
+
+        // Each round merges neighbouring pairs of sorted runs, doubling their length.
+        for (size_t width = runLength; width < count; width *= 2)
+        {
+            const size_t pairs = (count + width * 2 - 1) / (width * 2);
+            parallelFor(name, pairs, 1, [&](size_t first, size_t last)
+            {
+                for (auto pair = first; pair < last; ++pair)
+                {
+                    const auto low = pair * width * 2;
+                    const auto middle = std::min(count, low + width);
+                    const auto high = std::min(count, low + width * 2);
+                    if (middle < high)
+                    {
+                        std::inplace_merge(begin + low, begin + middle, begin + high, compare);
+                    }
+                }
+            });
+        }
+    }
+}
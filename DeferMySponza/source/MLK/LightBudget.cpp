@@ -0,0 +1,125 @@
+#include "LightBudget.hpp"
+#include "JobSystem.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+namespace MLK
+{
+    namespace
+    {
+        // Matches the profiler's smoothing, so the averaged light count lines up with the averaged time.
+        const float g_smoothing = 0.1f;
+
+        // Below this many candidates a partial sort on one thread beats handing out a full sort.
+        const size_t g_parallelSortCount = 2048;
+    }
+
+    LightBudget::LightBudget(JobSystem& jobs, const LightBudgetSettings& settings) :
+        m_jobs(jobs),
+        m_settings(settings)
+    {
+    }
+
+    void LightBudget::beginFrame(const glm::vec3& eyePosition, GLint width, GLint height, float lightGpuMs)
+    {
+        m_eyePosition = eyePosition;
+        m_screenArea = (float)std::max(1, width * height);
+        m_candidates.clear();
+
+        // GPU times arrive several frames late and smoothed, so the shaded count is smoothed the same way before
+        // dividing one by the other.
+        const auto averageShaded = m_averageShaded == 0.f ? (float)m_stats.shaded :
+            m_averageShaded + (m_stats.shaded - m_averageShaded) * g_smoothing;
+        m_averageShaded = averageShaded;
+
+        m_stats.lightMs = lightGpuMs;
+        m_stats.costPerLightMs = averageShaded > 0.f ? lightGpuMs / averageShaded : 0.f;
+
+        // Until a cost has been measured every light is allowed.
+        m_stats.cap = std::numeric_limits<GLuint>::max();
+        if (m_enabled && m_stats.costPerLightMs > 0.f)
+        {
+            m_stats.cap = std::max(m_settings.minLights, (GLuint)(m_settings.budgetMs / m_stats.costPerLightMs));
+        }
+    }
+
+    void LightBudget::addCandidate(const ScheduledLight& light)
+    {
+        m_candidates.push_back({ light.key, score(light) });
+
+        if (m_fades.size() <= light.key)
+        {
+            m_fades.resize(light.key + 1, 1.f);
+        }
+    }
+
+    void LightBudget::schedule()
+    {
+        const auto kept = std::min<size_t>(m_stats.cap, m_candidates.size());
+        const auto byScore = [](const Candidate& a, const Candidate& b) { return a.score > b.score; };
+        if (m_candidates.size() > g_parallelSortCount)
+        {
+            m_jobs.parallelSort("Sort lights", m_candidates.begin(), m_candidates.end(), byScore);
+        }
+        else
+        {
+            std::partial_sort(m_candidates.begin(), m_candidates.begin() + kept, m_candidates.end(), byScore);
+        }
+
+        m_stats.candidates = (GLuint)m_candidates.size();
+        m_stats.shaded = 0;
+        m_stats.fading = 0;
+        m_stats.dropped = 0;
+
+        const auto step = 1.f / std::max(1u, m_settings.fadeFrames);
+        for (size_t i = 0; i < m_candidates.size(); ++i)
+        {
+            auto& fade = m_fades[m_candidates[i].key];
+            fade = i < kept ? std::min(1.f, fade + step) : std::max(0.f, fade - step);
+
+            if (fade > 0.f)
+            {
+                ++m_stats.shaded;
+            }
+            if (fade > 0.f && fade < 1.f)
+            {
+                ++m_stats.fading;
+            }
+            if (i >= kept)
+            {
+                ++m_stats.dropped;
+            }
+        }
+    }
+
+    float LightBudget::getFade(GLuint key) const
+    {
+        return key < m_fades.size() ? m_fades[key] : 1.f;
+    }
+
+    void LightBudget::printStats() const
+    {
+        std::cout << "Light budget: " << m_stats.shaded << " of " << m_stats.candidates << " shaded, "
+            << m_stats.fading << " fading, " << m_stats.dropped << " over cap";
+        if (m_stats.cap != std::numeric_limits<GLuint>::max())
+        {
+            std::cout << " of " << m_stats.cap;
+        }
+        std::cout << ", " << m_stats.lightMs << "ms of " << m_settings.budgetMs << "ms, "
+            << m_stats.costPerLightMs << "ms per light" << std::endl;
+    }
+
+    float LightBudget::score(const ScheduledLight& light) const
+    {
+        const auto coverage = light.rect.width * (float)light.rect.height / m_screenArea;
+        const auto intensity = std::max(light.light.Intensity.r, std::max(light.light.Intensity.g, light.light.Intensity.b));
+
+        // Full weight while the eye is within range, falling off with distance beyond it.
+        const auto distance = glm::length(light.light.Position - m_eyePosition);
+        const auto attenuation = light.light.Range / std::max(light.light.Range, distance);
+
+        return coverage * intensity * attenuation;
+    }
+}
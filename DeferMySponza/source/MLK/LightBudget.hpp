@@ -0,0 +1,110 @@
+#pragma once
+
+#include "ShaderStructs.hpp"
+#include "LightCuller.hpp"
+
+#include <tgl/tgl.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace MLK
+{
+    class JobSystem;
+
+    /// <summary>
+    /// Limits the light budget works within.
+    /// </summary>
+    struct LightBudgetSettings
+    {
+        // GPU time allowed for light shading, including shadow maps.
+        float budgetMs = 4.f;
+
+        // Lights always allowed regardless of cost, so a slow frame can't black out the scene.
+        GLuint minLights = 8;
+
+        // Frames taken for a dropped light to fade out, or a returning one to fade back in.
+        GLuint fadeFrames = 15;
+    };
+
+    /// <summary>
+    /// A light that survived culling, waiting to be scheduled.
+    /// </summary>
+    struct ScheduledLight
+    {
+        // Index of the light within its type, and its key in the budget.
+        GLuint index = 0;
+        GLuint key = 0;
+
+        ShaderLight light;
+        ScissorRect rect;
+    };
+
+    /// <summary>
+    /// Budget counts for the last scheduled frame.
+    /// </summary>
+    struct LightBudgetStats
+    {
+        GLuint candidates = 0;
+        GLuint cap = 0;
+        GLuint shaded = 0;
+        GLuint fading = 0;
+        GLuint dropped = 0;
+        float lightMs = 0.f;
+        float costPerLightMs = 0.f;
+    };
+
+    /// <summary>
+    /// Caps the number of lights shaded each frame. Lights are scored by screen coverage, peak intensity and distance
+    /// from the eye, and the highest scoring ones are kept up to as many as the measured cost per light fits into the
+    /// budget. Lights leaving or entering the selection fade rather than pop.
+    /// </summary>
+    class LightBudget
+    {
+    public:
+        LightBudget(JobSystem& jobs, const LightBudgetSettings& settings = LightBudgetSettings());
+
+        // Starts a new frame, refitting the cap to the last measured light shading time and the lights it covered.
+        void beginFrame(const glm::vec3& eyePosition, GLint width, GLint height, float lightGpuMs);
+
+        void addCandidate(const ScheduledLight& light);
+
+        // Selects the lights to shade and steps their fades.
+        void schedule();
+
+        // Weight to scale light <key>'s intensity by, 0 if it shouldn't be shaded this frame.
+        float getFade(GLuint key) const;
+
+        // Disables the cap, fading every light back in.
+        void setEnabled(bool enabled) { m_enabled = enabled; }
+
+        const LightBudgetStats& getStats() const { return m_stats; }
+
+        void printStats() const;
+
+    private:
+        struct Candidate
+        {
+            GLuint key;
+            float score;
+        };
+
+        float score(const ScheduledLight& light) const;
+
+        JobSystem& m_jobs;
+        LightBudgetSettings m_settings;
+        bool m_enabled = true;
+
+        glm::vec3 m_eyePosition;
+        float m_screenArea = 1.f;
+
+        std::vector<Candidate> m_candidates;
+
+        // Fades are indexed by key, lights start fully faded in.
+        std::vector<float> m_fades;
+
+        float m_averageShaded = 0.f;
+
+        LightBudgetStats m_stats;
+    };
+}
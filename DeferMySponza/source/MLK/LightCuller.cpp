@@ -0,0 +1,155 @@
+#include "LightCuller.hpp"
+
+#include "ShaderStructs.hpp"
+
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <iostream>
+
+namespace MLK
+{
+    LightCuller::LightCuller(float minScreenArea, float minIntensity) :
+        m_minScreenArea(minScreenArea),
+        m_minIntensity(minIntensity)
+    {
+    }
+
+    void LightCuller::beginFrame(const glm::mat4& viewProjection, GLint width, GLint height)
+    {
+        m_viewProjection = viewProjection;
+        m_width = width;
+        m_height = height;
+        m_submitted = 0;
+        m_frustumCulled = 0;
+        m_cutoffCulled = 0;
+        m_scissored = 0;
+        m_cutoffFillSaved = 0;
+
+        m_frustum.setViewProjection(viewProjection);
+    }
+
+    void LightCuller::cullBounds(const SphereBoundsSoA& bounds, std::vector<GLuint>& visible)
+    {
+        m_frustum.cull(bounds, visible);
+        m_frustumCulled += (GLuint)(bounds.count - visible.size());
+    }
+
+    bool LightCuller::cullPointLight(const ShaderLight& light, ScissorRect& rect, bool inFrustum)
+    {
+        return cullSphere(light.Position, light.Range, light.Intensity, rect, inFrustum);
+    }
+
+    bool LightCuller::cullSpotLight(const ShaderLight& light, ScissorRect& rect, bool inFrustum)
+    {
+        const auto bounds = getSpotBounds(light);
+        return cullSphere(glm::vec3(bounds), bounds.w, light.Intensity, rect, inFrustum);
+    }
+
+    glm::vec4 LightCuller::getSpotBounds(const ShaderLight& light)
+    {
+        // Narrow cones are bounded by the circle through the apex and base rim, wide cones by the base circle alone.
+        const auto baseRadius = glm::tan(light.Angle) * light.Range;
+        if (light.Angle > glm::quarter_pi<float>())
+        {
+            return glm::vec4(light.Position + light.Direction * light.Range, baseRadius);
+        }
+
+        const auto radius = light.Range / (2.f * glm::cos(light.Angle) * glm::cos(light.Angle));
+        return glm::vec4(light.Position + light.Direction * radius, radius);
+    }
+
+    bool LightCuller::cullSphere(const glm::vec3& centre, float radius, const glm::vec3& intensity, ScissorRect& rect, bool inFrustum)
+    {
+        const auto planes = m_frustum.getPlanes();
+        for (int i = 0; i < 6 && !inFrustum; ++i)
+        {
+            if (glm::dot(glm::vec3(planes[i]), centre) + planes[i].w < -radius)
+            {
+                ++m_frustumCulled;
+                return false;
+            }
+        }
+
+        // Bounds crossing the near plane can't be projected, so they get the whole viewport.
+        const bool bounded = projectSphere(centre, radius, rect);
+        rect.crossesNearPlane = !bounded;
+        if (!bounded)
+        {
+            rect.x = 0;
+            rect.y = 0;
+            rect.width = m_width;
+            rect.height = m_height;
+        }
+
+        const auto area = (float)rect.width * rect.height;
+        const auto brightest = std::max(intensity.r, std::max(intensity.g, intensity.b));
+        if (area < m_minScreenArea || brightest < m_minIntensity)
+        {
+            ++m_cutoffCulled;
+            m_cutoffFillSaved += (GLuint64)area * 2;
+            return false;
+        }
+
+        ++m_submitted;
+        if (bounded)
+        {
+            ++m_scissored;
+        }
+
+        return true;
+    }
+
+    bool LightCuller::projectSphere(const glm::vec3& centre, float radius, ScissorRect& rect) const
+    {
+        glm::vec2 minimum(1.f);
+        glm::vec2 maximum(-1.f);
+
+        // Corners of the sphere's bounding box in normalised device coordinates.
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            const glm::vec3 offset(corner & 1 ? radius : -radius, corner & 2 ? radius : -radius, corner & 4 ? radius : -radius);
+            const auto clip = m_viewProjection * glm::vec4(centre + offset, 1.f);
+            if (clip.z < -clip.w)
+            {
+                return false;
+            }
+
+            const auto ndc = glm::vec2(clip) / clip.w;
+            minimum = glm::min(minimum, ndc);
+            maximum = glm::max(maximum, ndc);
+        }
+
+        minimum = glm::clamp(minimum, -1.f, 1.f);
+        maximum = glm::clamp(maximum, -1.f, 1.f);
+
+        // Rounded outwards and grown a pixel to cover TAA jitter.
+        const glm::vec2 size(m_width, m_height);
+        const auto low = glm::max(glm::floor((minimum * 0.5f + 0.5f) * size) - 1.f, glm::vec2(0.f));
+        const auto high = glm::min(glm::ceil((maximum * 0.5f + 0.5f) * size) + 1.f, size);
+
+        rect.x = (GLint)low.x;
+        rect.y = (GLint)low.y;
+        rect.width = (GLsizei)std::max(0.f, high.x - low.x);
+        rect.height = (GLsizei)std::max(0.f, high.y - low.y);
+        return true;
+    }
+
+    LightCullStats LightCuller::getStats() const
+    {
+        LightCullStats stats;
+        stats.submitted = m_submitted;
+        stats.frustumCulled = m_frustumCulled;
+        stats.cutoffCulled = m_cutoffCulled;
+        stats.scissored = m_scissored;
+        stats.cutoffFillSaved = m_cutoffFillSaved;
+        return stats;
+    }
+
+    void LightCuller::printStats() const
+    {
+        const auto stats = getStats();
+        std::cout << "Lights: " << stats.submitted << " submitted, " << stats.frustumCulled << " frustum culled, "
+            << stats.cutoffCulled << " below cutoff, " << stats.scissored << " scissored and single pass, ~"
+            << stats.cutoffFillSaved << " pixels of fill saved by the cutoffs" << std::endl;
+    }
+}
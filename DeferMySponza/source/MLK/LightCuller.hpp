@@ -0,0 +1,93 @@
+#pragma once
+
+#include "FrustumCuller.hpp"
+
+#include <tgl/tgl.h>
+#include <glm/glm.hpp>
+
+#include <atomic>
+
+namespace MLK
+{
+    struct ShaderLight;
+
+    /// <summary>
+    /// Pixel rectangle a light is scissored to.
+    /// </summary>
+    struct ScissorRect
+    {
+        GLint x = 0;
+        GLint y = 0;
+        GLsizei width = 0;
+        GLsizei height = 0;
+
+        // The light's bounds reach behind the near plane, so the rectangle covers the whole viewport, the volume's
+        // front faces may be clipped away and the camera may be inside it.
+        bool crossesNearPlane = false;
+    };
+
+    /// <summary>
+    /// Per frame light culling counts. Cutoff fill saved is an estimate from the screen rectangles of lights dropped
+    /// by the cutoffs, which would otherwise have been rasterised by both the stencil and shading passes. Frustum
+    /// culled lights and scissoring aren't included, the GPU would have clipped most of that fill anyway.
+    /// </summary>
+    struct LightCullStats
+    {
+        GLuint submitted = 0;
+        GLuint frustumCulled = 0;
+        GLuint cutoffCulled = 0;
+        GLuint scissored = 0;
+        GLuint64 cutoffFillSaved = 0;
+    };
+
+    /// <summary>
+    /// CPU pre-pass for light volumes. Lights whose bounding sphere is outside the view frustum, or whose screen
+    /// rectangle or intensity is too small to matter, are skipped. The rest get a scissor rectangle around their
+    /// projected bounds unless the bounds cross the near plane, where the whole viewport is used. Lights can be
+    /// culled from several threads at once between calls to beginFrame.
+    /// </summary>
+    class LightCuller
+    {
+    public:
+        LightCuller(float minScreenArea = 16.f, float minIntensity = 0.01f);
+
+        // Sets the view for the frame's lights and resets the counts.
+        void beginFrame(const glm::mat4& viewProjection, GLint width, GLint height);
+
+        // Frustum tests a whole set of light bounds at once, filling <visible> with the indices of those inside.
+        void cullBounds(const SphereBoundsSoA& bounds, std::vector<GLuint>& visible);
+
+        // Returns false if the light should be skipped, otherwise fills <rect> with its scissor. Lights already
+        // found inside the frustum by cullBounds skip that test.
+        bool cullPointLight(const ShaderLight& light, ScissorRect& rect, bool inFrustum = false);
+        bool cullSpotLight(const ShaderLight& light, ScissorRect& rect, bool inFrustum = false);
+
+        // Bounding sphere of a spot light's cone, centre in xyz and radius in w.
+        static glm::vec4 getSpotBounds(const ShaderLight& light);
+
+        LightCullStats getStats() const;
+
+        void printStats() const;
+
+    private:
+        bool cullSphere(const glm::vec3& centre, float radius, const glm::vec3& intensity, ScissorRect& rect, bool inFrustum);
+
+        // Returns false if the sphere can't be bounded on screen as part of it is on the near side of the near plane.
+        bool projectSphere(const glm::vec3& centre, float radius, ScissorRect& rect) const;
+
+        float m_minScreenArea;
+        float m_minIntensity;
+
+        glm::mat4 m_viewProjection;
+        FrustumCuller m_frustum;
+        GLint m_width = 0;
+        GLint m_height = 0;
+
+        // Counted from whichever thread culls the light.
+        std::atomic<GLuint> m_submitted{ 0 };
+        std::atomic<GLuint> m_frustumCulled{ 0 };
+        std::atomic<GLuint> m_cutoffCulled{ 0 };
+        std::atomic<GLuint> m_scissored{ 0 };
+        std::atomic<GLuint64> m_cutoffFillSaved{ 0 };
+    };
+}
@@ -0,0 +1,122 @@
+#include "LightOcclusion.hpp"
+
+#include <iostream>
+
+namespace MLK
+{
+    LightOcclusion::LightOcclusion(const char* name) :
+        m_name(name)
+    {
+    }
+
+    LightOcclusion::~LightOcclusion()
+    {
+        for (auto& query : m_queries)
+        {
+            glDeleteQueries(2, query.queries);
+        }
+    }
+
+    void LightOcclusion::beginFrame()
+    {
+        ++m_frame;
+        m_stats = OcclusionStats();
+
+        // This frame's slot holds the results last frame was conditioned on, they're two frames old by now so are
+        // read back only if they won't stall.
+        const auto slot = m_frame % 2;
+        for (auto& query : m_queries)
+        {
+            const bool conditioned = query.conditioned[slot];
+            query.conditioned[slot] = false;
+            if (query.issuedFrame[slot] != m_frame - 2)
+            {
+                continue;
+            }
+
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(query.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available == GL_FALSE)
+            {
+                continue;
+            }
+
+            GLuint visible = GL_FALSE;
+            glGetQueryObjectuiv(query.queries[slot], GL_QUERY_RESULT, &visible);
+            query.hidden = visible == GL_FALSE;
+            if (query.hidden && conditioned)
+            {
+                ++m_stats.skipped;
+                if (query.castsShadows[slot])
+                {
+                    ++m_stats.shadowedSkipped;
+                }
+            }
+        }
+    }
+
+    void LightOcclusion::beginQuery(GLuint index)
+    {
+        auto& query = getQuery(index);
+        const auto slot = m_frame % 2;
+
+        query.issuedFrame[slot] = m_frame;
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, query.queries[slot]);
+
+        ++m_stats.queried;
+    }
+
+    void LightOcclusion::endQuery()
+    {
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+    }
+
+    bool LightOcclusion::isHidden(GLuint index)
+    {
+        return getQuery(index).hidden;
+    }
+
+    bool LightOcclusion::beginConditionalRender(GLuint index, bool castsShadows)
+    {
+        auto& query = getQuery(index);
+        const auto slot = (m_frame - 1) % 2;
+
+        if (query.issuedFrame[slot] != m_frame - 1)
+        {
+            return false;
+        }
+
+        query.conditioned[slot] = true;
+        query.castsShadows[slot] = castsShadows;
+
+        // Last frame's query is long finished on the GPU by the time this is reached, so waiting for it is free.
+        glBeginConditionalRender(query.queries[slot], GL_QUERY_WAIT);
+
+        ++m_stats.conditional;
+        return true;
+    }
+
+    void LightOcclusion::endConditionalRender()
+    {
+        glEndConditionalRender();
+    }
+
+    void LightOcclusion::printStats() const
+    {
+        std::cout << m_name << " occlusion: " << m_stats.queried << " queried, " << m_stats.conditional
+            << " conditional, " << m_stats.skipped << " skipped, " << m_stats.shadowedSkipped << " shadowed lights skipped"
+            << std::endl;
+    }
+
+    LightQuery& LightOcclusion::getQuery(GLuint index)
+    {
+        // Queries are created the first time a light is seen.
+        while (m_queries.size() <= index)
+        {
+            m_queries.emplace_back();
+            glGenQueries(2, m_queries.back().queries);
+        }
+
+        return m_queries[index];
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <tgl/tgl.h>
+#include <vector>
+
+namespace MLK
+{
+    /// <summary>
+    /// Occlusion counts for a set of lights. As results are only read back once they're two frames old, the skipped
+    /// counts describe the frame before the one the other counts were gathered in. Shadowed lights are counted
+    /// apart as their shading is the more expensive, their shadow maps are rendered beforehand either way.
+    /// </summary>
+    struct OcclusionStats
+    {
+        GLuint queried = 0;
+        GLuint conditional = 0;
+        GLuint skipped = 0;
+        GLuint shadowedSkipped = 0;
+    };
+
+    /// <summary>
+    /// Pair of query objects for a light, alternated each frame so last frame's result can drive this frame's
+    /// conditional rendering while a new one is issued.
+    /// </summary>
+    struct LightQuery
+    {
+        GLuint queries[2] = { 0, 0 };
+        GLuint issuedFrame[2] = { 0, 0 };
+        bool conditioned[2] = { false, false };
+        bool castsShadows[2] = { false, false };
+
+        // Whether the latest result read back found the light hidden.
+        bool hidden = false;
+    };
+
+    /// <summary>
+    /// Occlusion queries for light volumes. Each light's front faces are tested against the scene depth, usually by
+    /// the draw that shades it, and the next frame shades the light conditionally on that result. Shadow maps are rendered before any light is
+    /// shaded, so they aren't covered. Lights without a result from the last frame render unconditionally, so newly
+    /// visible lights are never dropped.
+    /// </summary>
+    class LightOcclusion
+    {
+    public:
+        LightOcclusion(const char* name);
+        ~LightOcclusion();
+
+        // Moves on to the next frame's queries and counts lights skipped by the last frame's conditions.
+        void beginFrame();
+
+        // Wraps the query draw of light <index>.
+        void beginQuery(GLuint index);
+        void endQuery();
+
+        // Whether the latest result read back for light <index> found it hidden. A query wrapped around a draw
+        // that's rendered conditionally counts nothing once that draw is skipped, so these need a draw of their own.
+        bool isHidden(GLuint index);
+
+        // Starts rendering conditionally on the last frame's result for light <index>, returns false with nothing
+        // started if there isn't a usable result. <castsShadows> counts the light as shadowed if it's skipped.
+        bool beginConditionalRender(GLuint index, bool castsShadows);
+        void endConditionalRender();
+
+        const OcclusionStats& getStats() const { return m_stats; }
+
+        void printStats() const;
+
+    private:
+        LightQuery& getQuery(GLuint index);
+
+        const char* m_name;
+        std::vector<LightQuery> m_queries;
+
+        // Starts at 2 so a query slot that has never been issued can't match either of the last two frames.
+        GLuint m_frame = 2;
+
+        OcclusionStats m_stats;
+    };
+}
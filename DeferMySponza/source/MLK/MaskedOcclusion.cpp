@@ -0,0 +1,487 @@
+#include "MaskedOcclusion.hpp"
+#include "JobSystem.hpp"
+
+#include <sponza/sponza.hpp>
+#include <sponza/GeometryBuilder.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+
+namespace MLK
+{
+    namespace
+    {
+        using Clock = std::chrono::high_resolution_clock;
+
+        // Triangles and boxes with a corner this close to the eye, or behind it, aren't projected. Such triangles
+        // are skipped, which only loses occlusion, and such boxes are always visible.
+        const float g_minW = 1e-3f;
+
+        float millisecondsSince(Clock::time_point start)
+        {
+            return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+        }
+
+        glm::vec2 toScreen(const glm::vec4& clip)
+        {
+            return glm::vec2((clip.x / clip.w * 0.5f + 0.5f) * MaskedOcclusion::Width,
+                (clip.y / clip.w * 0.5f + 0.5f) * MaskedOcclusion::Height);
+        }
+
+        // Pixels of a 32 pixel row from <first> on, the leftmost pixel in the top bit.
+        GLuint pixelsFrom(GLint first)
+        {
+            return first >= 32 ? 0u : ~0u >> first;
+        }
+    }
+
+    MaskedOcclusion::MaskedOcclusion(const sponza::Context& scene) :
+        m_scene(scene)
+    {
+        // Padded so testing four tiles from any tile in the last row stays inside the array.
+        m_depths.resize(TileStride * TilesY + 4, 0.f);
+        m_layerDepths.resize(TileStride * TilesY, 0.f);
+        m_masks.resize(TileStride * TilesY * TileHeight, 0);
+    }
+
+    void MaskedOcclusion::buildOccluders(const std::vector<BoundingBox>& instanceBoxes, const OccluderSettings& settings)
+    {
+        const auto transforms = m_scene.getInstanceTransforms();
+        const auto meshIds = m_scene.getInstanceMeshIds();
+        const auto staticFlags = m_scene.getInstanceStaticFlags();
+        const auto instanceCount = std::min(transforms.size(), instanceBoxes.size());
+
+        auto sceneMinimum = glm::vec3(std::numeric_limits<float>::max());
+        auto sceneMaximum = -sceneMinimum;
+        for (size_t i = 0; i < instanceCount; ++i)
+        {
+            if (staticFlags[i])
+            {
+                sceneMinimum = glm::min(sceneMinimum, instanceBoxes[i].minimum);
+                sceneMaximum = glm::max(sceneMaximum, instanceBoxes[i].maximum);
+            }
+        }
+        const auto minSize = glm::length(glm::max(sceneMaximum - sceneMinimum, glm::vec3(0.f))) * settings.minSize;
+
+        struct Candidate
+        {
+            float area;
+            GLuint instance;
+            glm::vec3 corners[3];
+        };
+        std::vector<Candidate> candidates;
+
+        const sponza::GeometryBuilder geometry;
+        std::vector<const sponza::Mesh*> meshes;
+        for (const auto& mesh : geometry.getAllMeshes())
+        {
+            if (meshes.size() <= mesh.getId())
+            {
+                meshes.resize(mesh.getId() + 1, nullptr);
+            }
+            meshes[mesh.getId()] = &mesh;
+        }
+
+        for (GLuint i = 0; i < (GLuint)instanceCount; ++i)
+        {
+            const auto& box = instanceBoxes[i];
+            if (!staticFlags[i] || (i < m_dynamic.size() && m_dynamic[i]) || glm::length(box.maximum - box.minimum) < minSize ||
+                meshIds[i] >= meshes.size() || !meshes[meshIds[i]])
+            {
+                continue;
+            }
+
+            const auto model = glm::mat4((const glm::mat4x3&)transforms[i]);
+            const auto& positions = meshes[meshIds[i]]->getPositionArray();
+            const auto elements = meshes[meshIds[i]]->getElementArray();
+            for (size_t e = 0; e + 2 < elements.size(); e += 3)
+            {
+                Candidate candidate;
+                candidate.instance = i;
+                for (int c = 0; c < 3; ++c)
+                {
+                    candidate.corners[c] = glm::vec3(model * glm::vec4((const glm::vec3&)positions[elements[e + c]], 1.f));
+                }
+                candidate.area = glm::length(glm::cross(candidate.corners[1] - candidate.corners[0],
+                    candidate.corners[2] - candidate.corners[0])) * 0.5f;
+                candidates.push_back(candidate);
+            }
+        }
+
+        // The real surfaces' largest triangles, so an occluder never covers anything the scene doesn't.
+        if (candidates.size() > settings.maxTriangles)
+        {
+            std::nth_element(candidates.begin(), candidates.begin() + settings.maxTriangles, candidates.end(),
+                [](const Candidate& a, const Candidate& b) { return a.area > b.area; });
+            candidates.resize(settings.maxTriangles);
+        }
+
+        m_occluders.clear();
+        m_occluderInstances.clear();
+        for (const auto& candidate : candidates)
+        {
+            m_occluders.insert(m_occluders.end(), candidate.corners, candidate.corners + 3);
+            m_occluderInstances.push_back(candidate.instance);
+        }
+        m_built = true;
+        updateOccluderStats();
+    }
+
+    void MaskedOcclusion::markDynamic(const std::vector<GLuint>& instances)
+    {
+        bool occluderMoved = false;
+        for (const auto instance : instances)
+        {
+            if (instance >= m_dynamic.size())
+            {
+                m_dynamic.resize(instance + 1, 0);
+            }
+            m_dynamic[instance] = 1;
+            occluderMoved |= std::find(m_occluderInstances.begin(), m_occluderInstances.end(), instance) != m_occluderInstances.end();
+        }
+        if (!occluderMoved)
+        {
+            return;
+        }
+
+        // A moved occluder's triangles are where it was, so they're dropped rather than hiding what's there now.
+        GLuint kept = 0;
+        for (GLuint t = 0; t < (GLuint)m_occluderInstances.size(); ++t)
+        {
+            const auto instance = m_occluderInstances[t];
+            if (instance < m_dynamic.size() && m_dynamic[instance])
+            {
+                continue;
+            }
+            std::copy(&m_occluders[t * 3], &m_occluders[t * 3] + 3, &m_occluders[kept * 3]);
+            m_occluderInstances[kept++] = instance;
+        }
+        m_occluders.resize(kept * 3);
+        m_occluderInstances.resize(kept);
+        updateOccluderStats();
+    }
+
+    void MaskedOcclusion::updateOccluderStats()
+    {
+        auto instances = m_occluderInstances;
+        std::sort(instances.begin(), instances.end());
+        m_stats.occluders = (GLuint)(std::unique(instances.begin(), instances.end()) - instances.begin());
+        m_stats.occluderTriangles = (GLuint)m_occluderInstances.size();
+    }
+
+    void MaskedOcclusion::render(JobSystem& jobs, const glm::mat4& viewProjection)
+    {
+        const auto start = Clock::now();
+        m_viewProjection = viewProjection;
+
+        std::fill(m_depths.begin(), m_depths.end(), 0.f);
+        std::fill(m_layerDepths.begin(), m_layerDepths.end(), 0.f);
+        std::fill(m_masks.begin(), m_masks.end(), 0u);
+
+        const auto triangleCount = m_occluders.size() / 3;
+        m_triangles.resize(triangleCount);
+        m_triangleValid.resize(triangleCount);
+        jobs.parallelFor("Occluder setup", triangleCount, 256, [&](size_t begin, size_t end)
+        {
+            for (auto t = begin; t < end; ++t)
+            {
+                glm::vec4 clip[3];
+                for (int c = 0; c < 3; ++c)
+                {
+                    clip[c] = viewProjection * glm::vec4(m_occluders[t * 3 + c], 1.f);
+                }
+
+                m_triangleValid[t] = 0;
+                if (clip[0].w < g_minW || clip[1].w < g_minW || clip[2].w < g_minW)
+                {
+                    continue;
+                }
+
+                glm::vec2 screen[3];
+                float depth[3];
+                for (int c = 0; c < 3; ++c)
+                {
+                    screen[c] = toScreen(clip[c]);
+                    depth[c] = 1.f / clip[c].w;
+                }
+
+                // Drawn from either side, a wall hides as much from behind as in front.
+                auto area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) -
+                    (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+                if (std::abs(area) < 1e-6f)
+                {
+                    continue;
+                }
+                if (area < 0.f)
+                {
+                    std::swap(screen[1], screen[2]);
+                    std::swap(depth[1], depth[2]);
+                    area = -area;
+                }
+
+                auto& triangle = m_triangles[t];
+                const auto minimum = glm::min(screen[0], glm::min(screen[1], screen[2]));
+                const auto maximum = glm::max(screen[0], glm::max(screen[1], screen[2]));
+                triangle.tileMinX = std::max(0, (GLint)std::floor(minimum.x / TileWidth));
+                triangle.tileMinY = std::max(0, (GLint)std::floor(minimum.y / TileHeight));
+                triangle.tileMaxX = std::min((GLint)TilesX - 1, (GLint)std::floor(maximum.x / TileWidth));
+                triangle.tileMaxY = std::min((GLint)TilesY - 1, (GLint)std::floor(maximum.y / TileHeight));
+                if (triangle.tileMinX > triangle.tileMaxX || triangle.tileMinY > triangle.tileMaxY)
+                {
+                    continue;
+                }
+
+                for (int e = 0; e < 3; ++e)
+                {
+                    const auto& from = screen[e];
+                    const auto& to = screen[(e + 1) % 3];
+                    triangle.a[e] = from.y - to.y;
+                    triangle.b[e] = to.x - from.x;
+                    triangle.c[e] = (to.y - from.y) * from.x - (to.x - from.x) * from.y;
+                }
+
+                const auto d1 = depth[1] - depth[0];
+                const auto d2 = depth[2] - depth[0];
+                const auto e1 = screen[1] - screen[0];
+                const auto e2 = screen[2] - screen[0];
+                triangle.depth.x = (d1 * e2.y - d2 * e1.y) / area;
+                triangle.depth.y = (e1.x * d2 - e2.x * d1) / area;
+                triangle.depth.z = depth[0] - triangle.depth.x * screen[0].x - triangle.depth.y * screen[0].y;
+                triangle.minDepth = std::min(depth[0], std::min(depth[1], depth[2]));
+                m_triangleValid[t] = 1;
+            }
+        });
+
+        // Each job owns a band of tile rows, so no two write the same tile.
+        jobs.parallelFor("Occluder raster", TilesY, 4, [&](size_t begin, size_t end)
+        {
+            for (size_t t = 0; t < triangleCount; ++t)
+            {
+                if (m_triangleValid[t])
+                {
+                    drawTriangle(m_triangles[t], (GLint)begin, (GLint)end - 1);
+                }
+            }
+        });
+
+        m_stats.trianglesDrawn = (GLuint)std::count(m_triangleValid.begin(), m_triangleValid.end(), (GLubyte)1);
+        m_stats.rasterMs = millisecondsSince(start);
+    }
+
+    void MaskedOcclusion::cull(JobSystem& jobs, const std::vector<BoundingBox>& instanceBoxes, std::vector<GLuint>& instances)
+    {
+        const auto start = Clock::now();
+
+        m_instanceVisible.resize(instances.size());
+        jobs.parallelFor("Occlusion test", instances.size(), 64, [&](size_t begin, size_t end)
+        {
+            for (auto i = begin; i < end; ++i)
+            {
+                m_instanceVisible[i] = instances[i] >= instanceBoxes.size() || isVisible(instanceBoxes[instances[i]]);
+            }
+        });
+
+        size_t kept = 0;
+        for (size_t i = 0; i < instances.size(); ++i)
+        {
+            if (m_instanceVisible[i])
+            {
+                instances[kept++] = instances[i];
+            }
+        }
+
+        m_stats.tested = (GLuint)instances.size();
+        m_stats.culled = (GLuint)(instances.size() - kept);
+        instances.resize(kept);
+        m_stats.testMs = millisecondsSince(start);
+    }
+
+    bool MaskedOcclusion::isVisible(const BoundingBox& box) const
+    {
+        auto minimum = glm::vec2(std::numeric_limits<float>::max());
+        auto maximum = -minimum;
+        auto nearest = 0.f;
+        for (int c = 0; c < 8; ++c)
+        {
+            const auto corner = glm::vec3(c & 1 ? box.maximum.x : box.minimum.x, c & 2 ? box.maximum.y : box.minimum.y,
+                c & 4 ? box.maximum.z : box.minimum.z);
+            const auto clip = m_viewProjection * glm::vec4(corner, 1.f);
+            if (clip.w < g_minW)
+            {
+                return true;
+            }
+
+            const auto screen = toScreen(clip);
+            minimum = glm::min(minimum, screen);
+            maximum = glm::max(maximum, screen);
+            nearest = std::max(nearest, 1.f / clip.w);
+        }
+
+        // Boxes entirely off screen are left to the frustum culling.
+        const auto tileMinX = std::max(0, (GLint)std::floor(minimum.x / TileWidth));
+        const auto tileMinY = std::max(0, (GLint)std::floor(minimum.y / TileHeight));
+        const auto tileMaxX = std::min((GLint)TilesX - 1, (GLint)std::floor(maximum.x / TileWidth));
+        const auto tileMaxY = std::min((GLint)TilesY - 1, (GLint)std::floor(maximum.y / TileHeight));
+        if (tileMinX > tileMaxX || tileMinY > tileMaxY)
+        {
+            return true;
+        }
+
+        const auto boxDepth = _mm_set1_ps(nearest);
+        for (auto y = tileMinY; y <= tileMaxY; ++y)
+        {
+            for (auto x = tileMinX; x <= tileMaxX; x += 4)
+            {
+                // Lanes past the box's last tile are masked off.
+                const auto lanes = (1 << std::min(4, tileMaxX - x + 1)) - 1;
+                const auto tileDepths = _mm_loadu_ps(&m_depths[y * TileStride + x]);
+                // Hidden only where the tile is strictly nearer, a tie with the box counts as visible.
+                if (_mm_movemask_ps(_mm_cmple_ps(tileDepths, boxDepth)) & lanes)
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void MaskedOcclusion::printStats() const
+    {
+        std::cout << "Masked occlusion: " << m_stats.occluders << " occluders, " << m_stats.trianglesDrawn << " of "
+            << m_stats.occluderTriangles << " triangles drawn in " << m_stats.rasterMs << "ms, " << m_stats.tested
+            << " boxes tested in " << m_stats.testMs << "ms";
+        if (m_stats.testMs > 0.f)
+        {
+            std::cout << " (" << (GLuint)(m_stats.tested / m_stats.testMs) << " per ms)";
+        }
+        std::cout << ", " << m_stats.culled << " culled ("
+            << (m_stats.tested > 0 ? 100.f * m_stats.culled / m_stats.tested : 0.f) << "%)" << std::endl;
+    }
+
+    void MaskedOcclusion::drawTriangle(const ScreenTriangle& triangle, GLint firstRow, GLint lastRow)
+    {
+        const auto zero = _mm_setzero_ps();
+        const auto tileWidth = _mm_set1_ps((float)TileWidth);
+        const auto infinity = _mm_set1_ps(std::numeric_limits<float>::infinity());
+        const auto rowOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+        const auto rowBegin = std::max(firstRow, triangle.tileMinY);
+        const auto rowEnd = std::min(lastRow, triangle.tileMaxY);
+        for (auto tileY = rowBegin; tileY <= rowEnd; ++tileY)
+        {
+            // The span each edge allows along each of the tile's four rows, through the pixel centres.
+            const auto y = _mm_add_ps(_mm_set1_ps((float)(tileY * TileHeight)), rowOffsets);
+            auto left = _mm_sub_ps(zero, infinity);
+            auto right = infinity;
+            for (int e = 0; e < 3; ++e)
+            {
+                const auto value = _mm_add_ps(_mm_mul_ps(y, _mm_set1_ps(triangle.b[e])), _mm_set1_ps(triangle.c[e]));
+                if (triangle.a[e] > 0.f)
+                {
+                    left = _mm_max_ps(left, _mm_div_ps(_mm_sub_ps(zero, value), _mm_set1_ps(triangle.a[e])));
+                }
+                else if (triangle.a[e] < 0.f)
+                {
+                    right = _mm_min_ps(right, _mm_div_ps(_mm_sub_ps(zero, value), _mm_set1_ps(triangle.a[e])));
+                }
+                else
+                {
+                    // A horizontal edge covers whole rows or none.
+                    const auto outside = _mm_cmplt_ps(value, zero);
+                    left = _mm_or_ps(_mm_and_ps(outside, infinity), _mm_andnot_ps(outside, left));
+                }
+            }
+
+            const auto half = _mm_set1_ps(0.5f);
+            for (auto tileX = triangle.tileMinX; tileX <= triangle.tileMaxX; ++tileX)
+            {
+                // First covered pixel is ceil(left - 0.5) and the one past the last floor(right + 0.5), both taken
+                // relative to the tile and clamped to it before converting.
+                const auto origin = _mm_set1_ps((float)(tileX * TileWidth));
+                const auto first = _mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_sub_ps(left, half), origin), zero), tileWidth);
+                const auto last = _mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_add_ps(right, half), origin), zero), tileWidth);
+                const auto firstPixel = _mm_sub_epi32(_mm_set1_epi32(TileWidth), _mm_cvttps_epi32(_mm_sub_ps(tileWidth, first)));
+                const auto endPixel = _mm_cvttps_epi32(last);
+
+                alignas(16) GLuint coverage[4];
+#if defined(__AVX2__)
+                const auto all = _mm_set1_epi32(-1);
+                _mm_store_si128((__m128i*)coverage,
+                    _mm_andnot_si128(_mm_srlv_epi32(all, endPixel), _mm_srlv_epi32(all, firstPixel)));
+#else
+                // SSE2 has no per lane shift, the spans are turned into masks a row at a time.
+                alignas(16) GLint firsts[4];
+                alignas(16) GLint ends[4];
+                _mm_store_si128((__m128i*)firsts, firstPixel);
+                _mm_store_si128((__m128i*)ends, endPixel);
+                for (int row = 0; row < 4; ++row)
+                {
+                    coverage[row] = pixelsFrom(firsts[row]) & ~pixelsFrom(ends[row]);
+                }
+#endif
+                if ((coverage[0] | coverage[1] | coverage[2] | coverage[3]) == 0)
+                {
+                    continue;
+                }
+
+                // The triangle's furthest depth over the tile, from the plane at the tile's corners, but no further
+                // than its furthest vertex.
+                const auto x = (float)(tileX * TileWidth) + (triangle.depth.x < 0.f ? (float)TileWidth : 0.f);
+                const auto yFar = (float)(tileY * TileHeight) + (triangle.depth.y < 0.f ? (float)TileHeight : 0.f);
+                const auto depth = std::max(triangle.depth.x * x + triangle.depth.y * yFar + triangle.depth.z, triangle.minDepth);
+
+                updateTile(tileY * TileStride + tileX, coverage, depth);
+            }
+        }
+    }
+
+    void MaskedOcclusion::updateTile(GLuint tile, const GLuint* coverage, float depth)
+    {
+        auto& tileDepth = m_depths[tile];
+        auto& layerDepth = m_layerDepths[tile];
+        auto* mask = &m_masks[tile * TileHeight];
+
+        // Behind what already covers the whole tile.
+        if (depth <= tileDepth)
+        {
+            return;
+        }
+
+        const auto full = (coverage[0] & coverage[1] & coverage[2] & coverage[3]) == ~0u;
+        if (full)
+        {
+            tileDepth = depth;
+            if (layerDepth <= tileDepth)
+            {
+                layerDepth = 0.f;
+                mask[0] = mask[1] = mask[2] = mask[3] = 0;
+            }
+            return;
+        }
+
+        // The covered pixels are all at least as near as the layer's depth, so once they cover the tile it
+        // becomes the depth the whole tile is in front of.
+        const auto empty = (mask[0] | mask[1] | mask[2] | mask[3]) == 0;
+        layerDepth = empty ? depth : std::min(layerDepth, depth);
+        for (int row = 0; row < 4; ++row)
+        {
+            mask[row] |= coverage[row];
+        }
+
+        if ((mask[0] & mask[1] & mask[2] & mask[3]) == ~0u)
+        {
+            tileDepth = std::max(tileDepth, layerDepth);
+            layerDepth = 0.f;
+            mask[0] = mask[1] = mask[2] = mask[3] = 0;
+        }
+    }
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "InstanceBVH.hpp"
+
+#include <tgl/tgl.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace sponza
+{
+    class Context;
+}
+
+namespace MLK
+{
+    class JobSystem;
+
+    /// <summary>
+    /// Which instances become occluders, and how many of their triangles are kept.
+    /// </summary>
+    struct OccluderSettings
+    {
+        // Static instances whose box diagonal is at least this fraction of the scene's occlude, the walls,
+        // columns and floors, small props don't hide enough to be worth drawing.
+        float minSize = 0.1f;
+
+        // Largest triangles kept across every occluder, enough to cover the big surfaces while staying cheap to draw.
+        GLuint maxTriangles = 4096;
+    };
+
+    /// <summary>
+    /// Counts and timings for the last frame.
+    /// </summary>
+    struct MaskedOcclusionStats
+    {
+        GLuint occluders = 0;
+        GLuint occluderTriangles = 0;
+        GLuint trianglesDrawn = 0;
+        float rasterMs = 0.f;
+        GLuint tested = 0;
+        GLuint culled = 0;
+        float testMs = 0.f;
+    };
+
+    /// <summary>
+    /// CPU occlusion culling against a small masked depth buffer, so nothing waits on the GPU. Occluders are the
+    /// largest triangles of the scene's large static instances, drawn each frame into 32x4 pixel tiles that each
+    /// keep a coverage bit per pixel and two depths: one every pixel of the tile is known to be in front of, and
+    /// one for the pixels covered since, which becomes the first once the whole tile is covered. Depths are 1/w so
+    /// they interpolate linearly across the screen, larger being nearer. A tile's four rows are rasterized
+    /// together, one per SIMD lane, and bands of tile rows are split across jobs. Instance boxes are then tested
+    /// against the tiles they cover, four tiles at a time, and are hidden only if every one is known to be in
+    /// front of the box's nearest corner.
+    /// </summary>
+    class MaskedOcclusion
+    {
+    public:
+        static const GLuint Width = 320;
+        static const GLuint Height = 192;
+        static const GLuint TileWidth = 32;
+        static const GLuint TileHeight = 4;
+
+        MaskedOcclusion(const sponza::Context& scene);
+
+        // Picks the occluders from the static instances' world <instanceBoxes>.
+        void buildOccluders(const std::vector<BoundingBox>& instanceBoxes, const OccluderSettings& settings = OccluderSettings());
+
+        // Whether occluders have been picked, true even once every one of them has moved.
+        bool hasOccluders() const { return m_built; }
+
+        // Treats <instances> as dynamic from now on, such as those the scene has just moved, dropping any occluder
+        // triangles they had and never picking them as occluders again.
+        void markDynamic(const std::vector<GLuint>& instances);
+
+        // Clears the buffer and draws the occluders as seen through <viewProjection>.
+        void render(JobSystem& jobs, const glm::mat4& viewProjection);
+
+        // Removes the instances the occluders hide from the ascending <instances>, keeping the order.
+        void cull(JobSystem& jobs, const std::vector<BoundingBox>& instanceBoxes, std::vector<GLuint>& instances);
+
+        // Whether any part of <box> could be in front of the occluders.
+        bool isVisible(const BoundingBox& box) const;
+
+        const MaskedOcclusionStats& getStats() const { return m_stats; }
+
+        void printStats() const;
+
+    private:
+        static const GLuint TilesX = Width / TileWidth;
+        static const GLuint TilesY = Height / TileHeight;
+
+        // Tiles per row, padded so a row can be tested four tiles at a time.
+        static const GLuint TileStride = (TilesX + 3) / 4 * 4;
+
+        // A screen space triangle ready to rasterize, wound so its inside is where every edge function is positive.
+        struct ScreenTriangle
+        {
+            // Edge i is inside where a[i] * x + b[i] * y + c[i] >= 0.
+            float a[3];
+            float b[3];
+            float c[3];
+
+            // Depth plane, 1/w = depth.x * x + depth.y * y + depth.z, and the nearest and furthest vertex depths.
+            glm::vec3 depth;
+            float minDepth;
+
+            // Tiles the triangle's bounds touch.
+            GLint tileMinX, tileMinY, tileMaxX, tileMaxY;
+        };
+
+        void drawTriangle(const ScreenTriangle& triangle, GLint firstRow, GLint lastRow);
+
+        void updateTile(GLuint tile, const GLuint* coverage, float depth);
+
+        void updateOccluderStats();
+
+        const sponza::Context& m_scene;
+
+        // World space occluder triangles, three corners each, and the instance each came from.
+        std::vector<glm::vec3> m_occluders;
+        std::vector<GLuint> m_occluderInstances;
+
+        // Instances that have moved, whose triangles can't be baked into the occluders.
+        std::vector<GLubyte> m_dynamic;
+        bool m_built = false;
+
+        std::vector<ScreenTriangle> m_triangles;
+        std::vector<GLubyte> m_triangleValid;
+        glm::mat4 m_viewProjection;
+
+        // Per tile, the depth every pixel is in front of, the depth of the pixels covered since and which those
+        // pixels are, a word per row with the leftmost pixel in the top bit.
+        std::vector<float> m_depths;
+        std::vector<float> m_layerDepths;
+        std::vector<GLuint> m_masks;
+
+        std::vector<GLubyte> m_instanceVisible;
+
+        MaskedOcclusionStats m_stats;
+    };
+}
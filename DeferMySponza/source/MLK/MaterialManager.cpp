@@ -18,6 +18,21 @@ namespace MLK
 		generateMaterialData();
 	}
 
+	void MaterialManager::updateMaterials(const std::vector<GLuint>& sponzaMaterialIds)
+	{
+		for (const auto sponzaId : sponzaMaterialIds)
+		{
+			const auto& sponzaMaterial = m_scene.getMaterialById(sponzaId);
+			m_materials[lookupMaterialId(sponzaId)] = ShaderMaterial(sponzaMaterial);
+
+			// The SSR material is a copy of the first, so follows its edits.
+			if (sponzaId == m_scene.getAllMaterials()[0].getId())
+			{
+				m_materials[lookupMaterialId(100)] = ShaderMaterial(sponzaMaterial);
+			}
+		}
+	}
+
 	const std::vector<ShaderMaterial>& MaterialManager::getMaterialData() const
 	{
 		return m_materials;
@@ -27,6 +27,9 @@ namespace MLK
 		// Allows the user to update the materials from the scene in case some material are not static.
 		void updateMaterialDataFromScene();
 
+		// Updates just the given materials, such as those the scene reports edited.
+		void updateMaterials(const std::vector<GLuint>& sponzaMaterialIds);
+
 		// Gets the material data from the scene
 		const std::vector<ShaderMaterial>& getMaterialData() const;
 
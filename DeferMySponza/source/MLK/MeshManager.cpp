@@ -1,4 +1,7 @@
 #include "MeshManager.hpp"
+#include "GeometryPool.hpp"
+#include "RenderQueue.hpp"
+#include "Resources.hpp"
 
 #include <sponza/Mesh.hpp>
 #include <sponza/Camera.hpp>
@@ -6,214 +9,286 @@
 #include <sponza/GeometryBuilder.hpp>
 #include <tsl/tsl.hpp>
 
+#include <algorithm>
+#include <cassert>
 #include <memory>
 
 namespace MLK
 {
     namespace MU = MeshUtils;
 
+    namespace
+    {
+        // Culled draws a frame is sized for up front, the camera and a few shadow casters. Frames with more
+        // orphan the buffers again when they run out.
+        const GLuint g_culledViewsPerFrame = 8;
+
+        // Room the geometry pool leaves for meshes streamed in later, as a fraction of the scene's own geometry.
+        const float g_poolHeadroom = 0.5f;
+
+        // A single draw of a light volume's positions, the rest of each vertex left zeroed.
+        VertexData createVolumeData(const tsl::IndexedMesh& mesh)
+        {
+            VertexData data;
+            const auto positions = (const glm::vec3*)mesh.positionArray();
+            data.VertexArray.resize(mesh.vertexCount());
+            for (size_t i = 0; i < data.VertexArray.size(); ++i)
+            {
+                data.VertexArray[i].Position = positions[i];
+            }
+            data.ElementArray.assign(mesh.indexArray(), mesh.indexArray() + mesh.indexCount());
+
+            Mesh command;
+            command.ElementCount = (GLuint)data.ElementArray.size();
+            command.InstanceCount = 1;
+            data.MeshArray.push_back(command);
+            return data;
+        }
+    }
+
     MeshManager::MeshManager(const sponza::Context& scene) :
 		m_scene(scene)
 	{
-		auto sponzaData = createVaoFromMeshCollection(sponza::GeometryBuilder().getAllMeshes(), MeshGroup::Sponza);
-		sponzaData.drawcall = [sponzaData]()
+		const sponza::GeometryBuilder geometry;
+		const auto sponzaData = MU::generateVertexData(m_scene, geometry.getAllMeshes());
+		const auto quadData = createQuadData();
+		const auto sphereData = createSphereData();
+		const auto coneData = createConeData();
+
+		// The pool is sized for everything at once, with room to spare.
+		GLuint vertexCount = 0;
+		GLuint elementCount = 0;
+		for (const auto data : { sponzaData.get(), &quadData, &sphereData, &coneData })
+		{
+			vertexCount += (GLuint)data->VertexArray.size();
+			elementCount += (GLuint)data->ElementArray.size();
+		}
+		m_geometry.reset(new GeometryPool((GLuint)(vertexCount * (1.f + g_poolHeadroom)), (GLuint)(elementCount * (1.f + g_poolHeadroom))));
+
+		addMeshGroup(MeshGroup::Sponza, *sponzaData);
+		addMeshGroup(MeshGroup::Quad, quadData);
+		addMeshGroup(MeshGroup::Sphere, sphereData);
+		addMeshGroup(MeshGroup::Cone, coneData);
+
+		// Full draws of the scene read the instance ids counting up from zero, the other groups read the first.
+		m_instanceIds = sponzaData->InstanceIdArray;
+		if (m_instanceIds.empty())
 		{
-			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, sponzaData.DrawCommandCount, 0);
-		};
-		m_meshGroups[MeshGroup::Sponza] = sponzaData;
+			m_instanceIds.push_back(0);
+		}
 
-		auto quadData = createQuadVao();
-		quadData.drawcall = []()
+		// Culled draws pick commands from the group's own, moved to where the pool put it.
+		auto& culled = m_culledGroups[MeshGroup::Sponza];
+		const auto& sponzaGroup = m_meshGroups[MeshGroup::Sponza];
+		culled.Meshes.assign(m_commands.begin() + sponzaGroup.FirstCommand,
+			m_commands.begin() + sponzaGroup.FirstCommand + sponzaGroup.DrawCommandCount);
+		culled.MeshOfInstance.resize(sponzaData->InstanceIdArray.size());
+		for (GLuint mesh = 0; mesh < (GLuint)culled.Meshes.size(); ++mesh)
 		{
-			glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
-		};
-		m_meshGroups[MeshGroup::Quad] = quadData;
+			const auto& command = culled.Meshes[mesh];
+			std::fill_n(culled.MeshOfInstance.begin() + command.BaseInstance, command.InstanceCount, mesh);
+		}
 
-        auto sphereData = createSphereVao();
-        sphereData.drawcall = [sphereData]()
-        {
-            glDrawElements(GL_TRIANGLES, sphereData.ElementCount, GL_UNSIGNED_INT, 0);
-        };
-        m_meshGroups[MeshGroup::Sphere] = sphereData;
+		// A sorted draw can need a command per instance.
+		m_streamInstanceCapacity = std::max(1u, (GLuint)sponzaData->InstanceIdArray.size()) * g_culledViewsPerFrame;
+		m_streamCommandCapacity = m_streamInstanceCapacity;
+		m_instanceIdBuffer = Resources::createBuffer(0, nullptr, GL_STREAM_DRAW);
+		m_commandBuffer = Resources::createBuffer(0, nullptr, GL_STREAM_DRAW);
+		orphanStreamingBuffers();
 
-        auto coneData = createConeVao();
-        coneData.drawcall = [coneData]()
-        {
-            glDrawElements(GL_TRIANGLES, coneData.ElementCount, GL_UNSIGNED_INT, 0);
-        };
-        m_meshGroups[MeshGroup::Cone] = coneData;
+		m_vaoId = MU::generateVertexArrayObject(m_geometry->getVertexBuffer(), m_geometry->getElementBuffer(), m_instanceIdBuffer);
+		for (auto& group : m_meshGroups)
+		{
+			group.VaoId = m_vaoId;
+			group.DrawCommandBufferId = m_commandBuffer;
+		}
 	}
 
     MeshManager::~MeshManager()
     {
-        // Ensure all generated vertex buffers are deleted.
-        for (const auto bufferId : m_buffers)
-        {
-            glDeleteBuffers(1, &bufferId);
-        }
-
-        // Ensure all generated VAO and command buffers are deleted.
-        for (const auto drawSet : m_meshGroups)
-        {
-            glDeleteVertexArrays(1, &drawSet.second.VaoId);
-            glDeleteBuffers(1, &drawSet.second.DrawCommandBufferId);
-        }
+        glDeleteVertexArrays(1, &m_vaoId);
+        glDeleteBuffers(1, &m_instanceIdBuffer);
+        glDeleteBuffers(1, &m_commandBuffer);
     }
 
 	void MeshManager::drawMeshGroup(MeshGroup id)
 	{
-		// If the id has changed the data has to be set.
-		if (id != m_currentMeshGroup)
+		bindGeometry();
+
+		DrawPacket packet;
+		fillPacket(id, packet);
+		RenderQueue::issueDraw(packet);
+	}
+
+	void MeshManager::drawMeshGroup(MeshGroup id, const std::vector<GLuint>& visibleInstances)
+	{
+		DrawPacket packet;
+		if (!fillPacket(id, visibleInstances, packet))
 		{
-			updateMeshGroup(id);
+			return;
 		}
 
-		m_meshGroups.at(m_currentMeshGroup).drawcall();
+		bindGeometry();
+		RenderQueue::issueDraw(packet);
 	}
 
-	void MeshManager::updateMeshGroup(MeshGroup id)
+	void MeshManager::fillPacket(MeshGroup id, DrawPacket& packet) const
 	{
-		m_currentMeshGroup = id;
-		auto data = m_meshGroups.at(id);
-		glBindVertexArray(data.VaoId);
-		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, data.DrawCommandBufferId);
+		const auto& data = m_meshGroups[id];
+		packet.Type = data.Type;
+		packet.Mode = data.Mode;
+		packet.VaoId = data.VaoId;
+		packet.IndirectBufferId = data.DrawCommandBufferId;
+		packet.First = data.FirstCommand;
+		packet.Count = data.DrawCommandCount;
+		packet.BaseVertex = 0;
+		packet.InstanceCount = 1;
+		packet.BaseInstance = 0;
 	}
 
-	DrawData MeshManager::createQuadVao()
+	bool MeshManager::fillPacket(MeshGroup id, const std::vector<GLuint>& visibleInstances, DrawPacket& packet)
 	{
-		DrawData data; 
-		
-        std::vector<glm::vec4> posUV(4);
-        posUV[0] = glm::vec4(-1, -1, 0, 0);
-        posUV[1] = glm::vec4(1, -1, 1, 0);
-        posUV[2] = glm::vec4(1, 1, 1, 1);
-        posUV[3] = glm::vec4(-1, 1, 0, 1);
-
-		GLuint vertexBuffer = 0;
-		glGenBuffers(1, &vertexBuffer);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-		glBufferData(GL_ARRAY_BUFFER,
-            posUV.size() * sizeof(glm::vec4),
-            posUV.data(),
-			GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-		glGenVertexArrays(1, &data.VaoId);
-		glBindVertexArray(data.VaoId);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-		glEnableVertexAttribArray(AttribLocation::Position);
-		glVertexAttribPointer(AttribLocation::Position, 2, GL_FLOAT, GL_FALSE,
-			sizeof(glm::vec4), TGL_BUFFER_OFFSET(0));
-        glEnableVertexAttribArray(AttribLocation::UV0);
-        glVertexAttribPointer(AttribLocation::UV0, 2, GL_FLOAT, GL_FALSE,
-            sizeof(glm::vec4), TGL_BUFFER_OFFSET_OF(glm::vec4, z));
-		glBindVertexArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-		m_buffers.push_back(vertexBuffer);
+		const auto& culled = m_culledGroups[id];
+		if (visibleInstances.empty())
+		{
+			return false;
+		}
 
-		return data;
+		// At worst every instance starts a new command, so that's the room checked for.
+		const auto instanceCount = (GLuint)visibleInstances.size();
+		if (m_streamInstanceOffset + instanceCount > m_streamInstanceCapacity ||
+			m_streamCommandOffset + instanceCount > m_streamCommandCapacity)
+		{
+			orphanStreamingBuffers();
+		}
+
+		// Instances are written in the order given, each run of the same mesh extending the last command.
+		const auto firstInstance = (GLuint)m_instanceIds.size() + m_streamInstanceOffset;
+		m_culledCommands.clear();
+		GLuint lastMesh = ~0u;
+		for (GLuint i = 0; i < instanceCount; ++i)
+		{
+			const auto mesh = culled.MeshOfInstance[visibleInstances[i]];
+			if (mesh == lastMesh)
+			{
+				++m_culledCommands.back().InstanceCount;
+				continue;
+			}
+
+			auto command = culled.Meshes[mesh];
+			command.InstanceCount = 1;
+			command.BaseInstance = firstInstance + i;
+			m_culledCommands.push_back(command);
+			lastMesh = mesh;
+		}
+
+		// Written by name so neither the VAO nor the indirect binding changes.
+		const auto firstCommand = (GLuint)m_commands.size() + m_streamCommandOffset;
+		Resources::updateBuffer(m_instanceIdBuffer, firstInstance * sizeof(GLuint), instanceCount * sizeof(GLuint), visibleInstances.data());
+		Resources::updateBuffer(m_commandBuffer, firstCommand * sizeof(Mesh), m_culledCommands.size() * sizeof(Mesh), m_culledCommands.data());
+
+		fillPacket(id, packet);
+		packet.First = firstCommand;
+		packet.Count = (GLuint)m_culledCommands.size();
+
+		m_streamInstanceOffset += instanceCount;
+		m_streamCommandOffset += (GLuint)m_culledCommands.size();
+		return true;
 	}
-    
-    DrawData MeshManager::createVaoFromMeshCollection(const std::vector<sponza::Mesh>& meshCollection, MeshGroup id)
-    {
-        auto vertexData = MU::generateVertexData(m_scene, meshCollection);
-        auto vertexBuffers = MU::generateVertexBuffers(*vertexData);
-		auto drawData = MU::generateDrawData(*vertexBuffers, *vertexData);
 
-        // Store buffer IDs. Not ideal but required in order to delete at the end.
-        m_buffers.push_back(vertexBuffers->ElementVBO);
-        m_buffers.push_back(vertexBuffers->VertexVBO);
-        m_buffers.push_back(vertexBuffers->InstanceIdVBO);
+	void MeshManager::beginFrame()
+	{
+		orphanStreamingBuffers();
+	}
 
-		return drawData;
-    }
+	void MeshManager::orphanStreamingBuffers()
+	{
+		Resources::allocateBuffer(m_instanceIdBuffer, (m_instanceIds.size() + m_streamInstanceCapacity) * sizeof(GLuint), nullptr, GL_STREAM_DRAW);
+		Resources::updateBuffer(m_instanceIdBuffer, 0, m_instanceIds.size() * sizeof(GLuint), m_instanceIds.data());
 
-    DrawData MeshManager::createSphereVao()
-    {
-        DrawData data;
+		Resources::allocateBuffer(m_commandBuffer, (m_commands.size() + m_streamCommandCapacity) * sizeof(Mesh), nullptr, GL_STREAM_DRAW);
+		Resources::updateBuffer(m_commandBuffer, 0, m_commands.size() * sizeof(Mesh), m_commands.data());
+
+		m_streamInstanceOffset = 0;
+		m_streamCommandOffset = 0;
+	}
 
+	void MeshManager::bindMeshGroup(MeshGroup id)
+	{
+		m_geometryBound = false;
+		glBindVertexArray(m_meshGroups[id].VaoId);
+	}
+
+	void MeshManager::bindGeometry()
+	{
+		if (m_geometryBound)
+		{
+			return;
+		}
+
+		m_geometryBound = true;
+		glBindVertexArray(m_vaoId);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	}
+
+	void MeshManager::addMeshGroup(MeshGroup id, const VertexData& data)
+	{
+		GeometryAllocation allocation;
+		const auto placed = m_geometry->allocate(data.VertexArray, data.ElementArray, allocation);
+		assert(placed && "The geometry pool is sized for every group");
+
+		auto& group = m_meshGroups[id];
+		group.Type = DrawType::ElementsIndirect;
+		group.Mode = GL_TRIANGLES;
+		group.FirstCommand = (GLuint)m_commands.size();
+		group.DrawCommandCount = (GLuint)data.MeshArray.size();
+		for (auto command : data.MeshArray)
+		{
+			command.FirstVertex += allocation.FirstVertex;
+			command.FirstElement += allocation.FirstElement;
+			m_commands.push_back(command);
+		}
+	}
+
+	void MeshManager::printStats() const
+	{
+		m_geometry->printStats();
+	}
+
+	VertexData MeshManager::createQuadData() const
+	{
+		VertexData data;
+		data.VertexArray.resize(4);
+		data.VertexArray[0].Position = glm::vec3(-1, -1, 0);
+		data.VertexArray[1].Position = glm::vec3(1, -1, 0);
+		data.VertexArray[2].Position = glm::vec3(1, 1, 0);
+		data.VertexArray[3].Position = glm::vec3(-1, 1, 0);
+		data.VertexArray[0].UV0 = glm::vec2(0, 0);
+		data.VertexArray[1].UV0 = glm::vec2(1, 0);
+		data.VertexArray[2].UV0 = glm::vec2(1, 1);
+		data.VertexArray[3].UV0 = glm::vec2(0, 1);
+
+		// The fan it used to be drawn as, split into the same two triangles.
+		data.ElementArray = { 0, 1, 2, 0, 2, 3 };
+
+		Mesh command;
+		command.ElementCount = (GLuint)data.ElementArray.size();
+		command.InstanceCount = 1;
+		data.MeshArray.push_back(command);
+		return data;
+	}
+
+    VertexData MeshManager::createSphereData() const
+    {
         tsl::IndexedMeshPtr mesh = tsl::createSpherePtr(1.f, 12);
         mesh = tsl::cloneIndexedMeshAsTriangleListPtr(mesh.get());
-
-        data.ElementCount= mesh->indexCount();
-
-        GLuint vbo = 0;
-        glGenBuffers(1, &vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER,
-            mesh->vertexCount() * sizeof(glm::vec3),
-            mesh->positionArray(),
-            GL_STATIC_DRAW);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        GLuint elementBuffer = 0;
-        glGenBuffers(1, &elementBuffer);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-            mesh->indexCount() * sizeof(unsigned int),
-            mesh->indexArray(),
-            GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-        glGenVertexArrays(1, &data.VaoId);
-        glBindVertexArray(data.VaoId);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
-            sizeof(glm::vec3), 0);
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-        m_buffers.push_back(vbo);
-        m_buffers.push_back(elementBuffer);
-
-        return data;
+        return createVolumeData(*mesh);
     }
 
-    DrawData MeshManager::createConeVao()
+    VertexData MeshManager::createConeData() const
     {
-        DrawData data;
-
         tsl::IndexedMeshPtr mesh = tsl::createConePtr(1.f, 1.f, 5);
         mesh = tsl::cloneIndexedMeshAsTriangleListPtr(mesh.get());
-
-        data.ElementCount = mesh->indexCount();
-
-        GLuint vbo = 0;
-        glGenBuffers(1, &vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER,
-            mesh->vertexCount() * sizeof(glm::vec3),
-            mesh->positionArray(),
-            GL_STATIC_DRAW);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        GLuint elementBuffer = 0;
-        glGenBuffers(1, &elementBuffer);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-            mesh->indexCount() * sizeof(unsigned int),
-            mesh->indexArray(),
-            GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-        glGenVertexArrays(1, &data.VaoId);
-        glBindVertexArray(data.VaoId);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
-            sizeof(glm::vec3), 0);
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-        m_buffers.push_back(vbo);
-        m_buffers.push_back(elementBuffer);
-
-        return data;
+        return createVolumeData(*mesh);
     }
-}
\ No newline at end of file
+}
@@ -4,7 +4,7 @@
 
 #include <tgl/tgl.h>
 
-#include <unordered_map>
+#include <memory>
 #include <vector>
 
 namespace sponza
@@ -17,6 +17,8 @@ namespace sponza
 namespace MLK
 {
     struct Mesh;
+    struct DrawPacket;
+    class GeometryPool;
 
     /// <summary>
     /// Enum to specify collections of meshes to be drawn. This could be a string or integer allowing for new
@@ -28,12 +30,14 @@ namespace MLK
         Sponza,
 		Quad,
         Sphere,
-        Cone
+        Cone,
+        MeshGroupCount
     };
 
     /// <summary>
-    /// A class that is responsible for mesh and instance data. This includes vertex buffers, vertex array objects
-    /// and draw command buffers required to draw the given data.
+    /// A class that is responsible for mesh and instance data. Every group's vertices and elements live in one
+    /// geometry pool read through one VAO, and every group's draw is a run of commands in one indirect buffer, so
+    /// any group can be drawn with the same multi-draw call and switching groups binds nothing.
     /// </summary>
 	class MeshManager
 	{
@@ -43,19 +47,81 @@ namespace MLK
 
 		void drawMeshGroup(MeshGroup id);
 
+		// Draws only the listed instances of a group built from the scene, in the order given. Each run of
+		// instances of the same mesh becomes one indirect command, so ascending ids give a command per mesh with
+		// a visible instance, and a sorted order costs only as many commands as it splits the meshes into.
+		void drawMeshGroup(MeshGroup id, const std::vector<GLuint>& visibleInstances);
+
+		// Starts a new frame of culled draws, orphaning the space the last frame's visible lists were written to.
+		void beginFrame();
+
+		// Binds only the VAO the groups share, for passes that supply their own indirect commands. The command
+		// buffer is rebound on the next draw.
+		void bindMeshGroup(MeshGroup id);
+
+		// Fills in the VAO, indirect buffer and draw call of a group's full draw, for recording into a render queue.
+		void fillPacket(MeshGroup id, DrawPacket& packet) const;
+
+		// Writes the listed instances' ids and commands to the streaming buffers as the culled draw does, and fills
+		// in the draw of them. Returns false when there's nothing to draw.
+		bool fillPacket(MeshGroup id, const std::vector<GLuint>& visibleInstances, DrawPacket& packet);
+
+		// Every mesh's full command in a group built from the scene.
+		const std::vector<Mesh>& getMeshes(MeshGroup id) const { return m_culledGroups[id].Meshes; }
+
+		// Forgets the bound geometry after VAOs or the indirect buffer were bound elsewhere, so the next draw rebinds.
+		void invalidateBinding() { m_geometryBound = false; }
+
+		// Prints the geometry pool's occupancy and fragmentation.
+		void printStats() const;
+
 	private:
+		/// <summary>
+		/// The meshes of a group built from the scene, for draws of its visible instances. Each draw appends its
+		/// commands and instance ids to the streamed ends of the command and instance id buffers.
+		/// </summary>
+		struct CulledDrawData
+		{
+			// Every mesh's full command, giving the range of instance ids each one owns, and the mesh each
+			// instance id belongs to.
+			std::vector<Mesh> Meshes;
+			std::vector<GLuint> MeshOfInstance;
+		};
+
+		// Copies a group's geometry into the pool and appends its commands, moved to where it was placed.
+		void addMeshGroup(MeshGroup id, const VertexData& data);
+
+		// Binds the shared VAO and command buffer if something else was bound since.
+		void bindGeometry();
+
+		// Gives the instance id and command buffers fresh storage, rewriting the full draws' part of them, and
+		// starts streaming from just after it.
+		void orphanStreamingBuffers();
+
 		const sponza::Context& m_scene;
-		void updateMeshGroup(MeshGroup id);
 
-		// Creates a VAO from a given sponza mesh collection and stores the resulting VAO under the given id.
-		DrawData createVaoFromMeshCollection(const std::vector<sponza::Mesh>& meshCollection, MeshGroup id);
+		VertexData createQuadData() const;
+		VertexData createSphereData() const;
+		VertexData createConeData() const;
+
+		std::unique_ptr<GeometryPool> m_geometry;
+		GLuint m_vaoId = 0;
+		GLuint m_instanceIdBuffer = 0;
+		GLuint m_commandBuffer = 0;
+		bool m_geometryBound = false;
+
+		// The start of the instance id and command buffers, read by full draws. Instance ids count up from zero.
+		std::vector<GLuint> m_instanceIds;
+		std::vector<Mesh> m_commands;
 
-		DrawData createQuadVao();
-        DrawData createSphereVao();
-        DrawData createConeVao();
+		// Room after them for culled draws, and how much of it this frame's used.
+		GLuint m_streamInstanceCapacity = 0;
+		GLuint m_streamCommandCapacity = 0;
+		GLuint m_streamInstanceOffset = 0;
+		GLuint m_streamCommandOffset = 0;
 
-        MeshGroup m_currentMeshGroup = MeshGroup::None;
-		std::unordered_map<MeshGroup, DrawData> m_meshGroups;
-        std::vector<GLuint> m_buffers;
+		DrawData m_meshGroups[MeshGroupCount];
+		CulledDrawData m_culledGroups[MeshGroupCount];
+		std::vector<Mesh> m_culledCommands;
 	};
 }
\ No newline at end of file
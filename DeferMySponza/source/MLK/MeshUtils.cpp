@@ -4,12 +4,20 @@
 #include <sponza/Context.hpp>
 #include <sponza/Mesh.hpp>
 
+#include <cstddef>
 #include <vector>
 
 namespace MLK
 {
     namespace MeshUtils
     {
+        namespace
+        {
+            // Vertex buffer binding points of the VAO.
+            const GLuint g_vertexBinding = 0;
+            const GLuint g_instanceBinding = 1;
+        }
+
         std::unique_ptr<const VertexData> generateVertexData(const sponza::Context& scene, const std::vector<sponza::Mesh>& meshArray)
         {
             std::unique_ptr<VertexData> vertexData{ new VertexData() };
@@ -85,70 +93,35 @@ namespace MLK
             return std::move(vertexData);
         }
 
-        std::unique_ptr<const VertexBuffers> generateVertexBuffers(const VertexData& vertexData)
-        {
-            std::unique_ptr<VertexBuffers> vertexBuffers{ new VertexBuffers };
-
-            const auto& vertices = vertexData.VertexArray;
-            const auto& elements = vertexData.ElementArray;
-            const auto& instanceIds = vertexData.InstanceIdArray;
-
-            Utils::genBuffer(vertexBuffers->VertexVBO, GL_ARRAY_BUFFER, vertices.size() * sizeof(vertices[0]), (void*)vertices.data());
-            Utils::genBuffer(vertexBuffers->ElementVBO, GL_ELEMENT_ARRAY_BUFFER, elements.size() * sizeof(elements[0]), (void*)elements.data());
-            Utils::genBuffer(vertexBuffers->InstanceIdVBO, GL_ARRAY_BUFFER, instanceIds.size() * sizeof(instanceIds[0]), (void*)instanceIds.data());
-
-            return std::move(vertexBuffers);
-        }
-
-        GLuint generateVertexArrayObject(const VertexBuffers& vertexBuffers)
+        GLuint generateVertexArrayObject(GLuint vertexBuffer, GLuint elementBuffer, GLuint instanceIdBuffer)
         {
             GLuint id = 0;
             glGenVertexArrays(1, &id);
             glBindVertexArray(id);
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vertexBuffers.ElementVBO);
-            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers.VertexVBO);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+
+            // Vertices and instance ids come from separate bindings, so either buffer can be swapped on its own.
+            glBindVertexBuffer(g_vertexBinding, vertexBuffer, 0, sizeof(MLK::FullVertex));
             glEnableVertexAttribArray(AttribLocation::Position);
-            glVertexAttribPointer(AttribLocation::Position, 3, GL_FLOAT, GL_FALSE, sizeof(MLK::FullVertex), TGL_BUFFER_OFFSET_OF(MLK::FullVertex, Position));
+            glVertexAttribFormat(AttribLocation::Position, 3, GL_FLOAT, GL_FALSE, (GLuint)offsetof(MLK::FullVertex, Position));
+            glVertexAttribBinding(AttribLocation::Position, g_vertexBinding);
             glEnableVertexAttribArray(AttribLocation::Normal);
-            glVertexAttribPointer(AttribLocation::Normal, 3, GL_FLOAT, GL_FALSE, sizeof(MLK::FullVertex), TGL_BUFFER_OFFSET_OF(MLK::FullVertex, Normal));
+            glVertexAttribFormat(AttribLocation::Normal, 3, GL_FLOAT, GL_FALSE, (GLuint)offsetof(MLK::FullVertex, Normal));
+            glVertexAttribBinding(AttribLocation::Normal, g_vertexBinding);
             glEnableVertexAttribArray(AttribLocation::UV0);
-            glVertexAttribPointer(AttribLocation::UV0, 2, GL_FLOAT, GL_FALSE, sizeof(MLK::FullVertex), TGL_BUFFER_OFFSET_OF(MLK::FullVertex, UV0));
-            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers.InstanceIdVBO);
+            glVertexAttribFormat(AttribLocation::UV0, 2, GL_FLOAT, GL_FALSE, (GLuint)offsetof(MLK::FullVertex, UV0));
+            glVertexAttribBinding(AttribLocation::UV0, g_vertexBinding);
+
+            glBindVertexBuffer(g_instanceBinding, instanceIdBuffer, 0, sizeof(GLuint));
             glEnableVertexAttribArray(AttribLocation::InstanceID);
-            glVertexAttribIPointer(AttribLocation::InstanceID, 1, GL_UNSIGNED_INT, 0, (GLvoid*)0);
-            glVertexAttribDivisor(AttribLocation::InstanceID, 1);
+            glVertexAttribIFormat(AttribLocation::InstanceID, 1, GL_UNSIGNED_INT, 0);
+            glVertexAttribBinding(AttribLocation::InstanceID, g_instanceBinding);
+            glVertexBindingDivisor(g_instanceBinding, 1);
+
             glBindVertexArray(0);
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
 
             return id;
         }
-
-        GLuint generateDrawCommandBuffer(const VertexData& vertexData)
-        {
-            // Hacked command buffer.
-            const auto& commands = vertexData.MeshArray;
-
-            GLuint id = 0;
-            glGenBuffers(1, &id);
-            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, id);
-            glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(commands[0]), (void*)commands.data(), GL_STATIC_DRAW);
-            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
-
-            return id;
-        }
-        
-        DrawData generateDrawData(const VertexBuffers& vertexBuffers, const VertexData& vertexData)
-        {
-            DrawData drawData;
-
-            drawData.VaoId = generateVertexArrayObject(vertexBuffers);
-
-            drawData.DrawCommandCount = (const GLuint&)vertexData.MeshArray.size();
-            
-            drawData.DrawCommandBufferId = generateDrawCommandBuffer(vertexData);
-
-            return drawData;
-        }
     }
-}
\ No newline at end of file
+}
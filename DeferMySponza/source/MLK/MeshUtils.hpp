@@ -3,7 +3,6 @@
 #include "Utils.hpp"
 
 #include <memory>
-#include <functional>
 #include <tgl/tgl.h>
 
 namespace sponza
@@ -38,15 +37,29 @@ namespace MLK
     };
 
     /// <summary>
-    /// Structure to hold all relevant data to drawing (VAO and DrawCommandBuffer).
+    /// The GL call a draw is issued with.
+    /// </summary>
+    enum class DrawType : GLubyte
+    {
+        Arrays,             // glDrawArrays
+        Elements,           // glDrawElements
+        ElementsInstanced,  // glDrawElementsInstancedBaseVertexBaseInstance
+        ElementsIndirect    // glMultiDrawElementsIndirect
+    };
+
+    /// <summary>
+    /// Structure to hold all relevant data to drawing (VAO and DrawCommandBuffer). Plain data, so the draw can be
+    /// copied into a render queue's packets. Every group shares the VAO and command buffer, owning a run of the
+    /// commands from FirstCommand.
     /// </summary>
     struct DrawData
     {
-		std::function<void()> drawcall;
+        DrawType Type = DrawType::ElementsIndirect;
+        GLenum Mode = GL_TRIANGLES;
+        GLuint FirstCommand = 0;
         GLuint DrawCommandCount = 0;
         GLuint DrawCommandBufferId = 0;
         GLuint VaoId = 0;
-        GLuint ElementCount = 0;
     };
 
     /// <summary>
@@ -60,31 +73,13 @@ namespace MLK
         std::vector<GLuint> InstanceIdArray;
     };
 
-    /// <summary>
-    /// Structure to store buffers IDs for a set of VertexData.
-    /// </summary>
-    struct VertexBuffers
-    {
-        GLuint VertexVBO = 0;
-        GLuint ElementVBO = 0;
-        GLuint InstanceIdVBO = 0;
-    };
-
     namespace MeshUtils
     {
         // Generates a set of vertex data for the given sponza::Context and sponza::Mesh collection.
         std::unique_ptr<const VertexData> generateVertexData(const sponza::Context& scene, const std::vector<sponza::Mesh>& meshArray);
 
-        // Creates and fills buffers for the given VertexData.
-        std::unique_ptr<const VertexBuffers> generateVertexBuffers(const VertexData& vertexData);
-
-        // Creates a draw command buffer for the given VertexData.
-        GLuint generateDrawCommandBuffer(const VertexData& vertexData);
-
-        // Creates a vertex array object from the given VertexBuffers.
-        GLuint generateVertexArrayObject(const VertexBuffers& vertexBuffers);
-
-        // Generates draw commands for the given VertexBuffers and VertexData.
-        DrawData generateDrawData(const VertexBuffers& vertexBuffers, const VertexData& vertexData);
+        // Creates a vertex array object reading FullVertex vertices, their elements and per instance ids from the
+        // given buffers.
+        GLuint generateVertexArrayObject(GLuint vertexBuffer, GLuint elementBuffer, GLuint instanceIdBuffer);
     }
 }
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "PipelineStatistics.hpp"
+
+#include <cstring>
+#include <iostream>
+
+namespace MLK
+{
+    namespace
+    {
+        // Weight given to the newest sample when smoothing, as the profiler does.
+        const double g_smoothing = 0.1;
+    }
+
+    PipelineStatistics::PipelineStatistics(const char* name) :
+        m_name(name)
+    {
+        GLint extensionCount = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        for (GLint i = 0; i < extensionCount && !m_supported; ++i)
+        {
+            const auto extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            m_supported = extension != nullptr && std::strcmp(extension, "GL_ARB_pipeline_statistics_query") == 0;
+        }
+
+        for (GLuint i = 0; i < g_maxQueries; ++i)
+        {
+            m_issued[i] = false;
+        }
+
+        if (m_supported)
+        {
+            glGenQueries(g_maxQueries, m_invocations);
+            glGenQueries(g_maxQueries, m_samples);
+        }
+    }
+
+    PipelineStatistics::~PipelineStatistics()
+    {
+        if (m_supported)
+        {
+            glDeleteQueries(g_maxQueries, m_invocations);
+            glDeleteQueries(g_maxQueries, m_samples);
+        }
+    }
+
+    void PipelineStatistics::begin()
+    {
+        if (m_supported)
+        {
+            glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB, m_invocations[m_frameIndex]);
+            glBeginQuery(GL_SAMPLES_PASSED, m_samples[m_frameIndex]);
+        }
+    }
+
+    void PipelineStatistics::end()
+    {
+        if (m_supported)
+        {
+            glEndQuery(GL_SAMPLES_PASSED);
+            glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB);
+            m_issued[m_frameIndex] = true;
+        }
+    }
+
+    void PipelineStatistics::endFrame()
+    {
+        m_frameIndex = (m_frameIndex + 1) % g_maxQueries;
+        if (!m_issued[m_frameIndex])
+        {
+            return;
+        }
+
+        GLuint64 invocations = 0;
+        GLuint64 samples = 0;
+        glGetQueryObjectui64v(m_invocations[m_frameIndex], GL_QUERY_RESULT, &invocations);
+        glGetQueryObjectui64v(m_samples[m_frameIndex], GL_QUERY_RESULT, &samples);
+        m_issued[m_frameIndex] = false;
+
+        m_averageInvocations = m_averageInvocations == 0.0 ? (double)invocations :
+            m_averageInvocations + ((double)invocations - m_averageInvocations) * g_smoothing;
+        m_averageSamples = m_averageSamples == 0.0 ? (double)samples :
+            m_averageSamples + ((double)samples - m_averageSamples) * g_smoothing;
+    }
+
+    void PipelineStatistics::printStats(GLuint pixels) const
+    {
+        if (!m_supported)
+        {
+            std::cout << m_name << " statistics: ARB_pipeline_statistics_query not supported" << std::endl;
+            return;
+        }
+
+        std::cout << m_name << " statistics: " << (GLuint64)m_averageInvocations << " fragments shaded ("
+            << m_averageInvocations / pixels << " per pixel), " << (GLuint64)m_averageSamples << " passed depth";
+        if (m_averageInvocations > 0.0)
+        {
+            std::cout << ", " << 100.0 * (1.0 - m_averageSamples / m_averageInvocations) << "% rejected after shading";
+        }
+        std::cout << std::endl;
+    }
+}
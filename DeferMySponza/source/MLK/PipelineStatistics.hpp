@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Profiler.hpp"
+
+#include <tgl/tgl.h>
+
+namespace MLK
+{
+    /// <summary>
+    /// Fragment counts of one pass from ARB_pipeline_statistics_query, read back as late as the profiler's timers
+    /// so they never stall. Fragment shader invocations against the pixels drawn show how much overdraw early
+    /// depth testing let through, one per pixel being none, and samples passing the depth test show how much was
+    /// only rejected after shading. Does nothing when the driver lacks the extension.
+    /// </summary>
+    class PipelineStatistics
+    {
+    public:
+        PipelineStatistics(const char* name);
+        ~PipelineStatistics();
+
+        bool isSupported() const { return m_supported; }
+
+        void begin();
+        void end();
+
+        // Reads back any results old enough to be available and moves on to the next queries.
+        void endFrame();
+
+        // Prints the smoothed counts against the <pixels> the pass covers.
+        void printStats(GLuint pixels) const;
+
+    private:
+        const char* m_name;
+        bool m_supported = false;
+
+        GLuint m_invocations[g_maxQueries];
+        GLuint m_samples[g_maxQueries];
+        bool m_issued[g_maxQueries];
+        GLuint m_frameIndex = 0;
+
+        double m_averageInvocations = 0.0;
+        double m_averageSamples = 0.0;
+    };
+}
@@ -0,0 +1,239 @@
+#include "PointShadows.hpp"
+#include "ShaderManager.hpp"
+#include "GlStateManager.hpp"
+#include "MeshManager.hpp"
+#include "UniformManager.hpp"
+#include "SceneBounds.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <type_traits>
+
+namespace MLK
+{
+    namespace
+    {
+        const GLuint g_faceCount = 6;
+        const GLuint g_allFaces = (1u << g_faceCount) - 1;
+
+        // Standard cube map face order and orientation, +X -X +Y -Y +Z -Z.
+        const glm::vec3 g_faceDirections[g_faceCount] =
+        {
+            { 1.f, 0.f, 0.f }, { -1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, { 0.f, -1.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 0.f, -1.f }
+        };
+        const glm::vec3 g_faceUps[g_faceCount] =
+        {
+            { 0.f, -1.f, 0.f }, { 0.f, -1.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 0.f, -1.f }, { 0.f, -1.f, 0.f }, { 0.f, -1.f, 0.f }
+        };
+
+        const float g_nearPlane = 0.1f;
+    }
+
+    PointShadows::PointShadows(ShaderManager* shaderManager, GlStateManager* glStateManager, MeshManager* meshManager,
+        UniformManager* uniformManager, const SceneBounds& sceneBounds, GLuint resolution, GLuint slots) :
+        m_shaderManager(shaderManager),
+        m_glStateManager(glStateManager),
+        m_meshManager(meshManager),
+        m_uniformManager(uniformManager),
+        m_sceneBounds(sceneBounds),
+        m_resolution(resolution),
+        m_slots(slots),
+        m_uniform()
+    {
+        // Distance is stored as depth so lighting can compare in hardware through a cube array shadow sampler.
+        glGenTextures(1, &m_texture);
+        glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, m_texture);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 0, GL_DEPTH_COMPONENT32, m_resolution, m_resolution,
+            m_slots * g_faceCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, 0);
+
+        // The layered framebuffer lets the geometry shader pick the face, the single face one is used for clearing a
+        // slot and for the six pass path.
+        glGenFramebuffers(1, &m_layeredFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_layeredFbo);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_texture, 0);
+        glDrawBuffer(GL_NONE);
+        assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+        glGenFramebuffers(1, &m_faceFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_faceFbo);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_texture, 0, 0);
+        glDrawBuffer(GL_NONE);
+        assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    PointShadows::~PointShadows()
+    {
+        glDeleteFramebuffers(1, &m_layeredFbo);
+        glDeleteFramebuffers(1, &m_faceFbo);
+        glDeleteTextures(1, &m_texture);
+    }
+
+    void PointShadows::beginFrame()
+    {
+        m_stats = PointShadowStats();
+    }
+
+    void PointShadows::render(GLuint slot, const ShaderLight& light, const std::vector<GLuint>* casters)
+    {
+        assert(slot < m_slots);
+
+        ++m_stats.lights;
+
+        m_uniform.LightPosition = light.Position;
+        m_uniform.LightRange = light.Range;
+        m_uniform.FirstLayer = slot * g_faceCount;
+
+        const auto projection = glm::perspective(glm::radians(90.f), 1.f, g_nearPlane, std::max(light.Range, g_nearPlane * 2.f));
+        for (GLuint face = 0; face < g_faceCount; ++face)
+        {
+            m_uniform.FaceViewProjections[face] = projection *
+                glm::lookAt(light.Position, light.Position + g_faceDirections[face], g_faceUps[face]);
+        }
+
+        // Masks are only read by the layered path, the six pass baseline draws everything into every face.
+        const auto maxInstances = std::extent<decltype(PointShadowUniform::FaceMasks)>::value * 4;
+        const auto& instanceBounds = m_sceneBounds.getInstanceBounds();
+        const auto instanceCount = std::min<size_t>(instanceBounds.size(), maxInstances);
+        const auto setMask = [&](size_t i)
+        {
+            const auto& bounds = instanceBounds[i];
+            const auto mask = m_layered ? getFaceMask(glm::vec3(bounds), bounds.w, light.Position, light.Range) : g_allFaces;
+
+            m_uniform.FaceMasks[i / 4][i % 4] = mask;
+
+            for (GLuint face = 0; face < g_faceCount; ++face)
+            {
+                if ((mask & (1u << face)) == 0)
+                {
+                    ++m_stats.instanceFacesCulled;
+                }
+            }
+        };
+
+        m_stats.instanceFaces += (GLuint)instanceCount * g_faceCount;
+        if (casters != nullptr && m_layered)
+        {
+            // Instances out of range are culled from every face without being looked at.
+            for (size_t i = 0; i < instanceCount; ++i)
+            {
+                m_uniform.FaceMasks[i / 4][i % 4] = 0;
+            }
+            size_t inRange = 0;
+            for (const auto i : *casters)
+            {
+                if (i < instanceCount)
+                {
+                    setMask(i);
+                    ++inRange;
+                }
+            }
+            m_stats.instanceFacesCulled += (GLuint)(instanceCount - inRange) * g_faceCount;
+        }
+        else
+        {
+            for (size_t i = 0; i < instanceCount; ++i)
+            {
+                setMask(i);
+            }
+        }
+
+        m_uniformManager->updateBufferData(UniformBufferId::PointShadowCube, &m_uniform, sizeof(m_uniform));
+
+        m_glStateManager->setState(DrawPass::ShadowMapPass);
+        glViewport(0, 0, m_resolution, m_resolution);
+
+        clearSlot(slot);
+
+        if (m_layered)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, m_layeredFbo);
+            m_shaderManager->useProgram(ShaderProgram::PointShadowLayered);
+
+            // Only the casters can have a face to draw into, and they're drawn in the order given.
+            if (casters != nullptr)
+            {
+                m_meshManager->drawMeshGroup(MeshGroup::Sponza, *casters);
+            }
+            else
+            {
+                m_meshManager->drawMeshGroup(MeshGroup::Sponza);
+            }
+        }
+        else
+        {
+            const auto faceLocation = m_shaderManager->getUniformLocation(ShaderProgram::PointShadowFaces, UniformId::UFace);
+            m_shaderManager->useProgram(ShaderProgram::PointShadowFaces);
+
+            for (GLuint face = 0; face < g_faceCount; ++face)
+            {
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_texture, 0, m_uniform.FirstLayer + face);
+                glUniform1i(faceLocation, face);
+                m_meshManager->drawMeshGroup(MeshGroup::Sponza);
+            }
+        }
+    }
+
+    void PointShadows::printStats() const
+    {
+        std::cout << "Point shadows: " << m_stats.lights << " cubes " << (m_layered ? "layered" : "six pass") << ", "
+            << m_stats.instanceFacesCulled << " of " << m_stats.instanceFaces << " instance faces culled" << std::endl;
+    }
+
+    GLuint PointShadows::getFaceMask(const glm::vec3& centre, float radius, const glm::vec3& lightPosition, float range) const
+    {
+        const auto offset = centre - lightPosition;
+        if (glm::length(offset) - radius > range)
+        {
+            return 0;
+        }
+
+        // Each face's frustum is bounded by the four 45 degree planes through the light between its axis and the
+        // neighbouring axes.
+        const auto diagonal = 1.f / glm::sqrt(2.f);
+
+        GLuint mask = 0;
+        for (GLuint face = 0; face < g_faceCount; ++face)
+        {
+            const auto axis = face / 2;
+            const auto sign = face % 2 == 0 ? 1.f : -1.f;
+            const auto along = offset[axis] * sign;
+
+            bool visible = true;
+            for (GLuint other = 1; other < 3 && visible; ++other)
+            {
+                const auto across = offset[(axis + other) % 3];
+                visible = (along - across) * diagonal >= -radius && (along + across) * diagonal >= -radius;
+            }
+
+            if (visible)
+            {
+                mask |= 1u << face;
+            }
+        }
+
+        return mask;
+    }
+
+    void PointShadows::clearSlot(GLuint slot)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_faceFbo);
+        for (GLuint face = 0; face < g_faceCount; ++face)
+        {
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_texture, 0, slot * g_faceCount + face);
+            glClear(GL_DEPTH_BUFFER_BIT);
+        }
+    }
+}
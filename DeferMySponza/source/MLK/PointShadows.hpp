@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Utils.hpp"
+#include "ShaderStructs.hpp"
+
+#include <tgl/tgl.h>
+#include <glm/glm.hpp>
+
+namespace MLK
+{
+    class ShaderManager;
+    class GlStateManager;
+    class MeshManager;
+    class UniformManager;
+    class SceneBounds;
+
+    /// <summary>
+    /// Point shadow counts for the current frame. Instance faces are the cube faces each instance would be drawn
+    /// into without culling.
+    /// </summary>
+    struct PointShadowStats
+    {
+        GLuint lights = 0;
+        GLuint instanceFaces = 0;
+        GLuint instanceFacesCulled = 0;
+    };
+
+    /// <summary>
+    /// Omnidirectional shadows for point lights, stored as distance over range in a cube map array with a cube per
+    /// slot. A light's cube is rendered in one layered pass, with geometry shader instancing emitting each triangle
+    /// to the faces its instance wasn't culled from on the CPU. A six pass path, one draw per face without culling,
+    /// is kept as the baseline to measure against.
+    /// </summary>
+    class PointShadows
+    {
+    public:
+        PointShadows(ShaderManager* shaderManager, GlStateManager* glStateManager, MeshManager* meshManager,
+            UniformManager* uniformManager, const SceneBounds& sceneBounds, GLuint resolution = 512, GLuint slots = 4);
+        ~PointShadows();
+
+        // Resets the counts, instance bounds are expected to be up to date.
+        void beginFrame();
+
+        // Renders <light>'s cube into <slot>. Leaves the shadow framebuffer bound and the viewport at the shadow
+        // resolution. <casters> are the ids of the instances within the light's range if already known, in the
+        // order the layered path draws them, otherwise every instance is tested and drawn.
+        void render(GLuint slot, const ShaderLight& light, const std::vector<GLuint>* casters = nullptr);
+
+        void setLayered(bool layered) { m_layered = layered; }
+        bool isLayered() const { return m_layered; }
+
+        GLuint getTexture() const { return m_texture; }
+        GLuint getSlotCount() const { return m_slots; }
+
+        const PointShadowStats& getStats() const { return m_stats; }
+
+        void printStats() const;
+
+    private:
+        // Bit per face the sphere may be seen from, within the light's range.
+        GLuint getFaceMask(const glm::vec3& centre, float radius, const glm::vec3& lightPosition, float range) const;
+
+        void clearSlot(GLuint slot);
+
+        ShaderManager* m_shaderManager;
+        GlStateManager* m_glStateManager;
+        MeshManager* m_meshManager;
+        UniformManager* m_uniformManager;
+        const SceneBounds& m_sceneBounds;
+
+        GLuint m_resolution;
+        GLuint m_slots;
+        bool m_layered = true;
+
+        GLuint m_texture = 0;
+        GLuint m_layeredFbo = 0;
+        GLuint m_faceFbo = 0;
+
+        PointShadowUniform m_uniform;
+        PointShadowStats m_stats;
+    };
+}
@@ -0,0 +1,175 @@
+#include "PostProcessChain.hpp"
+
+#include "Utils.hpp"
+#include "Resources.hpp"
+#include "GlStateManager.hpp"
+#include "ShaderManager.hpp"
+#include "MeshManager.hpp"
+
+#include <assert.h>
+
+namespace MLK
+{
+    void PostProcessChain::allocateTargets()
+    {
+        // Storage is immutable, so the colour textures are replaced and attached again.
+        for (auto& target : m_targets)
+        {
+            glDeleteTextures(1, &target.colour);
+            target.colour = Resources::createTexture(GL_TEXTURE_2D, m_format, m_capacityWidth, m_capacityHeight);
+            Resources::setSampling(target.colour, GL_TEXTURE_2D, GL_LINEAR, GL_CLAMP_TO_EDGE);
+            Resources::attachTexture(target.fbo, GL_COLOR_ATTACHMENT0, target.colour);
+
+            auto success = Resources::isComplete(target.fbo);
+            assert(success);
+        }
+    }
+
+    PostProcessChain::PostProcessChain(ShaderManager* shaderManager, GlStateManager* stateManager, MeshManager* meshManager,
+        GLuint width, GLuint height) :
+        m_shaderManager(shaderManager),
+        m_stateManager(stateManager),
+        m_meshManager(meshManager),
+        m_width(width),
+        m_height(height),
+        m_capacityWidth(width),
+        m_capacityHeight(height),
+        m_outputWidth(width),
+        m_outputHeight(height)
+    {
+        for (auto& target : m_targets)
+        {
+            target.fbo = Resources::createFramebuffer();
+        }
+        allocateTargets();
+    }
+
+    PostProcessChain::~PostProcessChain()
+    {
+        for (const auto& target : m_targets)
+        {
+            glDeleteFramebuffers(1, &target.fbo);
+            glDeleteTextures(1, &target.colour);
+        }
+    }
+
+    void PostProcessChain::begin(GLuint sourceTex, GLuint sourceFbo, GLuint passCount)
+    {
+        m_currentInput = sourceTex;
+        m_currentInputFbo = sourceFbo;
+        m_remainingPasses = passCount;
+        m_nextTarget = 0;
+        m_presented = false;
+    }
+
+    PostProcessStep PostProcessChain::nextStep(bool generateMips, bool outputResolution)
+    {
+        assert(m_remainingPasses > 0);
+
+        PostProcessStep step;
+        step.input = m_currentInput;
+        step.inputFbo = m_currentInputFbo;
+
+        // Mips are left stale unless a consumer actually samples them.
+        if (generateMips)
+        {
+            Resources::generateMipmap(step.input, GL_TEXTURE_2D);
+        }
+
+        --m_remainingPasses;
+
+        // The last pass composites straight into the default framebuffer, otherwise write to whichever
+        // target isn't being read from.
+        const bool outputMatches = outputResolution || (m_width == m_outputWidth && m_height == m_outputHeight);
+        if (m_remainingPasses == 0 && outputMatches)
+        {
+            step.outputFbo = 0;
+            step.exposure = m_exposure;
+            m_presented = true;
+        }
+        else
+        {
+            const auto& target = m_targets[m_nextTarget];
+            step.outputFbo = target.fbo;
+            m_currentInput = target.colour;
+            m_currentInputFbo = target.fbo;
+            m_nextTarget = 1 - m_nextTarget;
+        }
+
+        return step;
+    }
+
+    void PostProcessChain::end()
+    {
+        assert(m_remainingPasses == 0);
+
+        // Nothing has written to the screen yet so the last result has to be copied, scaling up if necessary.
+        if (m_presented)
+        {
+            return;
+        }
+
+        if (m_exposure <= 0.f)
+        {
+            const auto filter = (m_width == m_outputWidth && m_height == m_outputHeight) ? GL_NEAREST : GL_LINEAR;
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, m_currentInputFbo);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_outputWidth, m_outputHeight, GL_COLOR_BUFFER_BIT, filter);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+            return;
+        }
+
+        // HDR has to be tonemapped on the way, which a blit can't do, so the copy is drawn instead.
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, m_outputWidth, m_outputHeight);
+
+        m_shaderManager->useProgram(ShaderProgram::Present);
+        m_stateManager->setState(DrawPass::PresentPass);
+        Utils::setExposure(m_shaderManager->getUniformLocation(ShaderProgram::Present, UniformId::UExposure), m_exposure);
+
+        // Only the part of the input that was rendered into is presented, which for the source is the LBuffer's
+        // corner of the same capacity.
+        glUniform2f(m_shaderManager->getUniformLocation(ShaderProgram::Present, UniformId::UInputScale),
+            (float)m_width / m_capacityWidth, (float)m_height / m_capacityHeight);
+
+        Resources::bindTexture(TextureSlot::TInput, GL_TEXTURE_2D, m_currentInput);
+
+        m_meshManager->drawMeshGroup(MeshGroup::Quad);
+
+        Resources::bindTexture(TextureSlot::TInput, GL_TEXTURE_2D, 0);
+    }
+
+    void PostProcessChain::resize(GLuint width, GLuint height, GLuint outputWidth, GLuint outputHeight)
+    {
+        assert(width <= m_capacityWidth && height <= m_capacityHeight);
+
+        m_width = width;
+        m_height = height;
+        m_outputWidth = outputWidth;
+        m_outputHeight = outputHeight;
+    }
+
+    void PostProcessChain::setCapacity(GLuint width, GLuint height)
+    {
+        if (width != m_capacityWidth || height != m_capacityHeight)
+        {
+            m_capacityWidth = width;
+            m_capacityHeight = height;
+            allocateTargets();
+        }
+    }
+
+    void PostProcessChain::setFormat(GLenum format)
+    {
+        if (format != m_format)
+        {
+            m_format = format;
+            allocateTargets();
+        }
+    }
+
+    void PostProcessChain::setExposure(float exposure)
+    {
+        m_exposure = exposure;
+    }
+}
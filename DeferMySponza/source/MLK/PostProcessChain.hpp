@@ -0,0 +1,98 @@
+#pragma once
+
+#include <tgl/tgl.h>
+
+namespace MLK
+{
+    class ShaderManager;
+    class GlStateManager;
+    class MeshManager;
+
+    /// <summary>
+    /// Colour target owned by the post process chain.
+    /// </summary>
+    struct PostProcessTarget
+    {
+        GLuint fbo = 0;
+        GLuint colour = 0;
+    };
+
+    /// <summary>
+    /// Input texture and output framebuffer for a single post process pass. An output of 0 is the default framebuffer,
+    /// and only a pass writing there is given an exposure to tonemap with.
+    /// </summary>
+    struct PostProcessStep
+    {
+        GLuint input = 0;
+        GLuint inputFbo = 0;
+        GLuint outputFbo = 0;
+        float exposure = 0.f;
+    };
+
+    /// <summary>
+    /// Ping-pongs full screen passes between two pre-allocated targets so no pass has to copy its input before
+    /// compositing on top of it. The final pass of a frame writes straight into the default framebuffer, and mips
+    /// are only generated for an input when the pass consuming it asks for them. When rendering below output
+    /// resolution the final pass can only write to the screen if it upscales itself, otherwise the chain upscales.
+    /// HDR sources are tonemapped by whichever pass presents, so tonemapping never costs a pass of its own.
+    /// Targets are allocated at a capacity that can be larger than the render size, passes drawing into the corner
+    /// the viewport covers.
+    /// </summary>
+    class PostProcessChain
+    {
+    public:
+        PostProcessChain(ShaderManager* shaderManager,
+            GlStateManager* stateManager,
+            MeshManager* meshManager,
+            GLuint width = 1280,
+            GLuint height = 720);
+        ~PostProcessChain();
+
+        // Starts a frame reading from <sourceTex>, expecting exactly <passCount> calls to nextStep.
+        void begin(GLuint sourceTex, GLuint sourceFbo, GLuint passCount);
+
+        // Returns the input and output for the next pass, generating input mips if <generateMips> is set.
+        // <outputResolution> passes write at output resolution whatever the size of their input.
+        PostProcessStep nextStep(bool generateMips = false, bool outputResolution = false);
+
+        // Presents the source directly if no passes ran this frame, or upscales the last pass if it couldn't.
+        void end();
+
+        // Passes render <width> by <height> into the targets, the default framebuffer is <outputWidth> by <outputHeight>.
+        void resize(GLuint width, GLuint height, GLuint outputWidth, GLuint outputHeight);
+
+        // Replaces the targets with ones <width> by <height>, which must hold the render size.
+        void setCapacity(GLuint width, GLuint height);
+
+        // Targets match the source format so HDR survives until the presenting pass.
+        void setFormat(GLenum format);
+
+        // Exposure for tonemapping on present, 0 for LDR sources which are presented as they are.
+        void setExposure(float exposure);
+
+    private:
+        // Replaces the targets' colour textures with ones of the current capacity and format.
+        void allocateTargets();
+
+        ShaderManager* m_shaderManager;
+        GlStateManager* m_stateManager;
+        MeshManager* m_meshManager;
+
+        PostProcessTarget m_targets[2];
+        GLuint m_nextTarget = 0;
+
+        GLuint m_currentInput = 0;
+        GLuint m_currentInputFbo = 0;
+        GLuint m_remainingPasses = 0;
+        bool m_presented = false;
+
+        GLuint m_width;
+        GLuint m_height;
+        GLuint m_capacityWidth;
+        GLuint m_capacityHeight;
+        GLuint m_outputWidth;
+        GLuint m_outputHeight;
+        GLenum m_format = GL_R11F_G11F_B10F;
+        float m_exposure = 1.f;
+    };
+}
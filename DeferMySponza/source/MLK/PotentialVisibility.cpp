@@ -0,0 +1,786 @@
+#include "PotentialVisibility.hpp"
+#include "JobSystem.hpp"
+
+#include <sponza/sponza.hpp>
+#include <sponza/GeometryBuilder.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+
+namespace MLK
+{
+    namespace
+    {
+        using Clock = std::chrono::high_resolution_clock;
+
+        const char g_magic[4] = { 'P', 'V', 'S', '1' };
+        const GLuint g_fileVersion = 1;
+
+        const GLuint g_noHit = ~0u;
+
+        // Triangles in a leaf of the bake's hierarchy, split at the median so its depth stays well under the
+        // traversal stack.
+        const GLuint g_maxLeafTriangles = 4;
+        const GLuint g_stackSize = 64;
+
+        // Hits closer than this to a ray's origin are ignored, so rays starting on a surface don't hit it.
+        const float g_minDistance = 1e-3f;
+
+        const float g_goldenAngle = 2.39996323f;
+
+        struct FileHeader
+        {
+            char magic[4];
+            GLuint version;
+            GLuint instanceCount;
+            GLuint sceneHash;
+            glm::vec3 origin;
+            float cellSize;
+            glm::uvec3 dimensions;
+            GLuint dataSize;
+        };
+
+        // A world space triangle as a corner and the two edges from it, tagged with the instance it belongs to.
+        struct Triangle
+        {
+            glm::vec3 vertex;
+            GLuint instance;
+            glm::vec3 edge1;
+            glm::vec3 edge2;
+        };
+
+        /// <summary>
+        /// Hierarchy over the static scene's triangles, only needed while baking. Nodes split their triangles at
+        /// the median centroid on the longest axis, and leaves are tested with Moller-Trumbore.
+        /// </summary>
+        class TriangleTree
+        {
+        public:
+            explicit TriangleTree(std::vector<Triangle>&& triangles);
+
+            // Instance owning the nearest triangle along the ray, or g_noHit.
+            GLuint intersect(const glm::vec3& origin, const glm::vec3& direction) const;
+
+        private:
+            // Interior nodes have no count, with their children at <first> and <first> + 1.
+            struct Node
+            {
+                glm::vec3 minimum;
+                GLuint first;
+                glm::vec3 maximum;
+                GLuint count;
+            };
+
+            std::vector<Triangle> m_triangles;
+            std::vector<Node> m_nodes;
+        };
+
+        glm::vec3 centroid(const Triangle& triangle)
+        {
+            return triangle.vertex + (triangle.edge1 + triangle.edge2) * (1.f / 3.f);
+        }
+
+        TriangleTree::TriangleTree(std::vector<Triangle>&& triangles) :
+            m_triangles(std::move(triangles))
+        {
+            struct Pending
+            {
+                GLuint node;
+                GLuint first;
+                GLuint count;
+            };
+
+            m_nodes.reserve(2 * m_triangles.size() / g_maxLeafTriangles + 1);
+            m_nodes.push_back(Node());
+            std::vector<Pending> pending = { { 0, 0, (GLuint)m_triangles.size() } };
+            while (!pending.empty())
+            {
+                const auto range = pending.back();
+                pending.pop_back();
+
+                auto minimum = glm::vec3(std::numeric_limits<float>::max());
+                auto maximum = -minimum;
+                auto centreMinimum = minimum;
+                auto centreMaximum = maximum;
+                for (auto t = range.first; t < range.first + range.count; ++t)
+                {
+                    const auto& triangle = m_triangles[t];
+                    const auto a = triangle.vertex;
+                    const auto b = a + triangle.edge1;
+                    const auto c = a + triangle.edge2;
+                    minimum = glm::min(minimum, glm::min(a, glm::min(b, c)));
+                    maximum = glm::max(maximum, glm::max(a, glm::max(b, c)));
+                    centreMinimum = glm::min(centreMinimum, centroid(triangle));
+                    centreMaximum = glm::max(centreMaximum, centroid(triangle));
+                }
+
+                auto& node = m_nodes[range.node];
+                node.minimum = minimum;
+                node.maximum = maximum;
+                node.first = range.first;
+                node.count = range.count;
+
+                const auto size = centreMaximum - centreMinimum;
+                if (range.count <= g_maxLeafTriangles || std::max(size.x, std::max(size.y, size.z)) <= 0.f)
+                {
+                    continue;
+                }
+
+                const int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+                const auto half = range.count / 2;
+                std::nth_element(m_triangles.begin() + range.first, m_triangles.begin() + range.first + half,
+                    m_triangles.begin() + range.first + range.count,
+                    [axis](const Triangle& a, const Triangle& b) { return centroid(a)[axis] < centroid(b)[axis]; });
+
+                const auto children = (GLuint)m_nodes.size();
+                node.first = children;
+                node.count = 0;
+                m_nodes.push_back(Node());
+                m_nodes.push_back(Node());
+                pending.push_back({ children, range.first, half });
+                pending.push_back({ children + 1, range.first + half, range.count - half });
+            }
+        }
+
+        GLuint TriangleTree::intersect(const glm::vec3& origin, const glm::vec3& direction) const
+        {
+            const auto inverse = 1.f / direction;
+            auto closest = std::numeric_limits<float>::max();
+            auto hit = g_noHit;
+
+            // Distance the ray enters the node, or infinity if it misses or the node is beyond the closest hit.
+            const auto entry = [&](const Node& node)
+            {
+                const auto t0 = (node.minimum - origin) * inverse;
+                const auto t1 = (node.maximum - origin) * inverse;
+                const auto tMin = glm::min(t0, t1);
+                const auto tMax = glm::max(t0, t1);
+                const auto enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.f));
+                const auto leave = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, closest));
+                return enter <= leave ? enter : std::numeric_limits<float>::max();
+            };
+
+            if (m_nodes.empty() || entry(m_nodes[0]) == std::numeric_limits<float>::max())
+            {
+                return g_noHit;
+            }
+
+            GLuint stack[g_stackSize];
+            GLuint depth = 0;
+            stack[depth++] = 0;
+            while (depth > 0)
+            {
+                const auto& node = m_nodes[stack[--depth]];
+                if (node.count == 0)
+                {
+                    // The nearer child is pushed last so it's visited first and shortens the ray for the other.
+                    auto nearer = node.first;
+                    auto further = node.first + 1;
+                    auto nearDistance = entry(m_nodes[nearer]);
+                    auto farDistance = entry(m_nodes[further]);
+                    if (farDistance < nearDistance)
+                    {
+                        std::swap(nearer, further);
+                        std::swap(nearDistance, farDistance);
+                    }
+                    if (farDistance != std::numeric_limits<float>::max())
+                    {
+                        stack[depth++] = further;
+                    }
+                    if (nearDistance != std::numeric_limits<float>::max())
+                    {
+                        stack[depth++] = nearer;
+                    }
+                    continue;
+                }
+
+                for (auto t = node.first; t < node.first + node.count; ++t)
+                {
+                    const auto& triangle = m_triangles[t];
+                    const auto p = glm::cross(direction, triangle.edge2);
+                    const auto determinant = glm::dot(triangle.edge1, p);
+                    if (std::abs(determinant) < 1e-12f)
+                    {
+                        continue;
+                    }
+
+                    const auto inverseDeterminant = 1.f / determinant;
+                    const auto s = origin - triangle.vertex;
+                    const auto u = glm::dot(s, p) * inverseDeterminant;
+                    if (u < 0.f || u > 1.f)
+                    {
+                        continue;
+                    }
+
+                    const auto q = glm::cross(s, triangle.edge1);
+                    const auto v = glm::dot(direction, q) * inverseDeterminant;
+                    if (v < 0.f || u + v > 1.f)
+                    {
+                        continue;
+                    }
+
+                    const auto distance = glm::dot(triangle.edge2, q) * inverseDeterminant;
+                    if (distance > g_minDistance && distance < closest)
+                    {
+                        closest = distance;
+                        hit = triangle.instance;
+                    }
+                }
+            }
+
+            return hit;
+        }
+
+        void setBit(std::vector<GLubyte>& set, GLuint bit)
+        {
+            set[bit >> 3] |= (GLubyte)(1u << (bit & 7));
+        }
+
+        bool getBit(const std::vector<GLubyte>& set, GLuint bit)
+        {
+            return ((set[bit >> 3] >> (bit & 7)) & 1u) != 0;
+        }
+
+        // Runs of zero bytes then literal bytes, each run's length a byte: [zeros][literals][literal bytes...], until
+        // the whole set is covered. Sets XORed against their neighbour are mostly zero, and sparse where they aren't.
+        void encode(const std::vector<GLubyte>& delta, std::vector<GLubyte>& data)
+        {
+            size_t i = 0;
+            while (i < delta.size())
+            {
+                GLubyte zeros = 0;
+                while (i < delta.size() && delta[i] == 0 && zeros < 255)
+                {
+                    ++zeros;
+                    ++i;
+                }
+
+                const auto literalStart = i;
+                GLubyte literals = 0;
+                while (i < delta.size() && delta[i] != 0 && literals < 255)
+                {
+                    ++literals;
+                    ++i;
+                }
+
+                data.push_back(zeros);
+                data.push_back(literals);
+                data.insert(data.end(), delta.begin() + literalStart, delta.begin() + literalStart + literals);
+            }
+        }
+
+        // XORs the set encoded at <data> into <set>, returning where the next set starts.
+        const GLubyte* decodeInto(const GLubyte* data, std::vector<GLubyte>& set)
+        {
+            size_t i = 0;
+            while (i < set.size())
+            {
+                i += data[0];
+                const auto literals = data[1];
+                data += 2;
+                for (GLuint l = 0; l < literals; ++l)
+                {
+                    set[i++] ^= *data++;
+                }
+            }
+            return data;
+        }
+    }
+
+    PotentialVisibility::PotentialVisibility(const sponza::Context& scene) :
+        m_scene(scene)
+    {
+        // Named, the temporary's meshes wouldn't outlive the loop's first statement.
+        const sponza::GeometryBuilder geometry;
+        for (const auto& mesh : geometry.getAllMeshes())
+        {
+            if (m_meshTriangles.size() <= mesh.getId())
+            {
+                m_meshTriangles.resize(mesh.getId() + 1, 0);
+            }
+            m_meshTriangles[mesh.getId()] = (GLuint)mesh.getElementArray().size() / 3;
+        }
+    }
+
+    void PotentialVisibility::bake(JobSystem& jobs, const std::vector<BoundingBox>& instanceBoxes,
+        const PVSBakeSettings& settings)
+    {
+        const auto start = Clock::now();
+        const auto transforms = m_scene.getInstanceTransforms();
+        const auto meshIds = m_scene.getInstanceMeshIds();
+        const auto staticFlags = m_scene.getInstanceStaticFlags();
+        m_instanceCount = (GLuint)std::min(transforms.size(), instanceBoxes.size());
+
+        // The grid covers the static instances, dynamic ones can be anywhere and are always drawn.
+        auto minimum = glm::vec3(std::numeric_limits<float>::max());
+        auto maximum = -minimum;
+        for (GLuint i = 0; i < m_instanceCount; ++i)
+        {
+            if (staticFlags[i])
+            {
+                minimum = glm::min(minimum, instanceBoxes[i].minimum);
+                maximum = glm::max(maximum, instanceBoxes[i].maximum);
+            }
+        }
+        if (glm::any(glm::greaterThan(minimum, maximum)))
+        {
+            minimum = maximum = glm::vec3(0.f);
+        }
+
+        const auto extent = glm::max(maximum - minimum, glm::vec3(1e-3f));
+        m_origin = minimum;
+        m_cellSize = std::cbrt(extent.x * extent.y * extent.z / (float)std::max(settings.maxCells, 1u));
+        for (;;)
+        {
+            m_dimensions = glm::max(glm::uvec3(glm::ceil(extent / m_cellSize)), glm::uvec3(1));
+            if (m_dimensions.x * m_dimensions.y * m_dimensions.z <= std::max(settings.maxCells, 1u))
+            {
+                break;
+            }
+            m_cellSize *= 1.05f;
+        }
+        const auto cellCount = m_dimensions.x * m_dimensions.y * m_dimensions.z;
+
+        // World space triangles of the static instances, the only ones that can hide anything for good.
+        std::vector<Triangle> triangles;
+        {
+            const sponza::GeometryBuilder geometry;
+            std::vector<const sponza::Mesh*> meshes;
+            for (const auto& mesh : geometry.getAllMeshes())
+            {
+                if (meshes.size() <= mesh.getId())
+                {
+                    meshes.resize(mesh.getId() + 1, nullptr);
+                }
+                meshes[mesh.getId()] = &mesh;
+            }
+
+            for (GLuint i = 0; i < m_instanceCount; ++i)
+            {
+                if (!staticFlags[i] || meshIds[i] >= meshes.size() || !meshes[meshIds[i]])
+                {
+                    continue;
+                }
+
+                const auto model = glm::mat4((const glm::mat4x3&)transforms[i]);
+                const auto& positions = meshes[meshIds[i]]->getPositionArray();
+                const auto elements = meshes[meshIds[i]]->getElementArray();
+                for (size_t e = 0; e + 2 < elements.size(); e += 3)
+                {
+                    const auto a = glm::vec3(model * glm::vec4((const glm::vec3&)positions[elements[e]], 1.f));
+                    const auto b = glm::vec3(model * glm::vec4((const glm::vec3&)positions[elements[e + 1]], 1.f));
+                    const auto c = glm::vec3(model * glm::vec4((const glm::vec3&)positions[elements[e + 2]], 1.f));
+                    triangles.push_back({ a, i, b - a, c - a });
+                }
+            }
+        }
+        const TriangleTree tree(std::move(triangles));
+
+        // Each cell's set is found from its own seed, so a bake gives the same sets however it's split.
+        const auto setBytes = (m_instanceCount + 7) / 8;
+        std::vector<std::vector<GLubyte>> sets(cellCount, std::vector<GLubyte>(setBytes, 0));
+        jobs.parallelFor("PVS bake", cellCount, 1, [&](size_t begin, size_t end)
+        {
+            for (auto cell = begin; cell < end; ++cell)
+            {
+                auto& set = sets[cell];
+                const auto cellMinimum = getCellMinimum((GLuint)cell);
+                const auto cellMaximum = cellMinimum + glm::vec3(m_cellSize);
+
+                // The camera can be inside anything overlapping the cell, whatever the rays find.
+                for (GLuint i = 0; i < m_instanceCount; ++i)
+                {
+                    const auto& box = instanceBoxes[i];
+                    if (staticFlags[i] && glm::all(glm::lessThanEqual(box.minimum, cellMaximum)) &&
+                        glm::all(glm::lessThanEqual(cellMinimum, box.maximum)))
+                    {
+                        setBit(set, i);
+                    }
+                }
+
+                std::mt19937 random((unsigned int)cell + 1);
+                std::uniform_real_distribution<float> unit(0.f, 1.f);
+                for (GLuint s = 0; s < settings.samplesPerCell; ++s)
+                {
+                    const auto origin = cellMinimum + glm::vec3(unit(random), unit(random), unit(random)) * m_cellSize;
+
+                    // A Fibonacci sphere spins by a random angle per sample, so the samples don't share directions.
+                    const auto spin = unit(random) * 6.28318531f;
+                    for (GLuint r = 0; r < settings.raysPerSample; ++r)
+                    {
+                        const auto z = 1.f - 2.f * ((float)r + 0.5f) / (float)settings.raysPerSample;
+                        const auto radius = std::sqrt(std::max(0.f, 1.f - z * z));
+                        const auto angle = (float)r * g_goldenAngle + spin;
+                        const auto direction = glm::vec3(std::cos(angle) * radius, std::sin(angle) * radius, z);
+
+                        const auto hit = tree.intersect(origin, direction);
+                        if (hit != g_noHit)
+                        {
+                            setBit(set, hit);
+                        }
+                    }
+                }
+            }
+        });
+
+        if (settings.dilate)
+        {
+            const auto sampled = sets;
+            const glm::ivec3 dimensions = glm::ivec3(m_dimensions);
+            jobs.parallelFor("PVS dilate", cellCount, 64, [&](size_t begin, size_t end)
+            {
+                for (auto cell = begin; cell < end; ++cell)
+                {
+                    const auto position = glm::ivec3((int)cell % dimensions.x, ((int)cell / dimensions.x) % dimensions.y,
+                        (int)cell / (dimensions.x * dimensions.y));
+                    const glm::ivec3 offsets[] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+                    for (const auto& offset : offsets)
+                    {
+                        const auto neighbour = position + offset;
+                        if (glm::any(glm::lessThan(neighbour, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(neighbour, dimensions)))
+                        {
+                            continue;
+                        }
+
+                        const auto& other = sampled[neighbour.x + dimensions.x * (neighbour.y + dimensions.y * neighbour.z)];
+                        for (GLuint b = 0; b < setBytes; ++b)
+                        {
+                            sets[cell][b] |= other[b];
+                        }
+                    }
+                }
+            });
+        }
+
+        compress(sets);
+        resetDynamic();
+
+        m_stats = PVSStats();
+        m_stats.bakeMs = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+        m_stats.rays = cellCount * settings.samplesPerCell * settings.raysPerSample;
+        measure();
+    }
+
+    bool PotentialVisibility::save(const char* path) const
+    {
+        if (!isReady())
+        {
+            return false;
+        }
+
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+        {
+            return false;
+        }
+
+        FileHeader header;
+        std::memcpy(header.magic, g_magic, sizeof(g_magic));
+        header.version = g_fileVersion;
+        header.instanceCount = m_instanceCount;
+        header.sceneHash = getSceneHash();
+        header.origin = m_origin;
+        header.cellSize = m_cellSize;
+        header.dimensions = m_dimensions;
+        header.dataSize = (GLuint)m_data.size();
+
+        file.write((const char*)&header, sizeof(header));
+        file.write((const char*)m_rowOffsets.data(), m_rowOffsets.size() * sizeof(GLuint));
+        file.write((const char*)m_data.data(), m_data.size());
+        return (bool)file;
+    }
+
+    bool PotentialVisibility::load(const char* path)
+    {
+        m_rowOffsets.clear();
+        m_data.clear();
+        m_decodedCell = -1;
+
+        std::ifstream file(path, std::ios::binary);
+        FileHeader header;
+        if (!file || !file.read((char*)&header, sizeof(header)))
+        {
+            return false;
+        }
+
+        // Sets baked for other instances or transforms would hide the wrong things.
+        m_instanceCount = (GLuint)m_scene.getInstanceTransforms().size();
+        if (std::memcmp(header.magic, g_magic, sizeof(g_magic)) != 0 || header.version != g_fileVersion ||
+            header.instanceCount != m_instanceCount || header.sceneHash != getSceneHash())
+        {
+            std::cout << "PVS: " << path << " was baked for a different scene, press V to bake again" << std::endl;
+            return false;
+        }
+
+        std::vector<GLuint> offsets(header.dimensions.y * header.dimensions.z + 1);
+        std::vector<GLubyte> data(header.dataSize);
+        file.read((char*)offsets.data(), offsets.size() * sizeof(GLuint));
+        file.read((char*)data.data(), data.size());
+        if (!file || offsets.back() != data.size())
+        {
+            return false;
+        }
+
+        m_origin = header.origin;
+        m_cellSize = header.cellSize;
+        m_dimensions = header.dimensions;
+        m_rowOffsets.swap(offsets);
+        m_data.swap(data);
+        resetDynamic();
+
+        m_stats = PVSStats();
+        measure();
+        return true;
+    }
+
+    void PotentialVisibility::markDynamic(const std::vector<GLuint>& instances)
+    {
+        for (const auto instance : instances)
+        {
+            if (instance >= m_dynamic.size())
+            {
+                m_dynamic.resize(instance + 1, 0);
+            }
+            m_dynamic[instance] = 1;
+        }
+    }
+
+    void PotentialVisibility::filter(const glm::vec3& eye, std::vector<GLuint>& instances)
+    {
+        const auto meshIds = m_scene.getInstanceMeshIds();
+        const auto triangles = [&](GLuint instance)
+        {
+            return instance < meshIds.size() && meshIds[instance] < m_meshTriangles.size() ? m_meshTriangles[meshIds[instance]] : 0u;
+        };
+
+        m_stats.cell = isReady() ? getCell(eye) : -1;
+        m_stats.instancesIn = (GLuint)instances.size();
+        m_stats.trianglesIn = 0;
+        for (const auto instance : instances)
+        {
+            m_stats.trianglesIn += triangles(instance);
+        }
+
+        if (m_stats.cell < 0)
+        {
+            m_stats.instancesOut = m_stats.instancesIn;
+            m_stats.trianglesOut = m_stats.trianglesIn;
+            m_stats.dynamicInstances = 0;
+            return;
+        }
+
+        if (m_stats.cell != m_decodedCell)
+        {
+            decompress((GLuint)m_stats.cell, m_decoded);
+            m_decodedCell = m_stats.cell;
+        }
+
+        // Instances added since the bake aren't in the sets, so they're kept like dynamic ones.
+        m_stats.dynamicInstances = 0;
+        m_stats.trianglesOut = 0;
+        const auto last = std::remove_if(instances.begin(), instances.end(), [&](GLuint instance)
+        {
+            if (instance >= m_instanceCount || (instance < m_dynamic.size() && m_dynamic[instance]))
+            {
+                ++m_stats.dynamicInstances;
+            }
+            else if (!getBit(m_decoded, instance))
+            {
+                return true;
+            }
+
+            m_stats.trianglesOut += triangles(instance);
+            return false;
+        });
+        instances.erase(last, instances.end());
+        m_stats.instancesOut = (GLuint)instances.size();
+    }
+
+    void PotentialVisibility::printStats() const
+    {
+        if (!isReady())
+        {
+            std::cout << "PVS: not baked" << std::endl;
+            return;
+        }
+
+        std::cout << "PVS: " << m_stats.cells << " cells of " << m_cellSize << " (" << m_dimensions.x << "x" << m_dimensions.y
+            << "x" << m_dimensions.z << "), " << m_stats.compressedBytes << " bytes compressed from "
+            << m_stats.uncompressedBytes;
+        if (m_stats.rays > 0)
+        {
+            std::cout << ", baked " << m_stats.rays << " rays in " << m_stats.bakeMs << "ms";
+        }
+        std::cout << std::endl;
+
+        std::cout << "  per cell " << m_stats.averageInstances << " of " << m_stats.staticInstances << " static instances (min "
+            << m_stats.minInstances << ", max " << m_stats.maxInstances << "), " << m_stats.averageTriangles << " of "
+            << m_stats.staticTriangles << " triangles" << std::endl;
+
+        if (m_stats.cell < 0)
+        {
+            std::cout << "  camera outside the grid, nothing filtered" << std::endl;
+        }
+        else
+        {
+            std::cout << "  cell " << m_stats.cell << " drew " << m_stats.instancesOut << " of " << m_stats.instancesIn
+                << " frustum visible instances (" << m_stats.dynamicInstances << " dynamic), " << m_stats.trianglesOut << " of "
+                << m_stats.trianglesIn << " triangles" << std::endl;
+        }
+    }
+
+    GLint PotentialVisibility::getCell(const glm::vec3& position) const
+    {
+        const auto local = (position - m_origin) / m_cellSize;
+        if (glm::any(glm::lessThan(local, glm::vec3(0.f))) || glm::any(glm::greaterThanEqual(local, glm::vec3(m_dimensions))))
+        {
+            return -1;
+        }
+
+        const auto cell = glm::uvec3(local);
+        return (GLint)(cell.x + m_dimensions.x * (cell.y + m_dimensions.y * cell.z));
+    }
+
+    glm::vec3 PotentialVisibility::getCellMinimum(GLuint cell) const
+    {
+        const auto position = glm::uvec3(cell % m_dimensions.x, (cell / m_dimensions.x) % m_dimensions.y,
+            cell / (m_dimensions.x * m_dimensions.y));
+        return m_origin + glm::vec3(position) * m_cellSize;
+    }
+
+    GLuint PotentialVisibility::getSceneHash() const
+    {
+        const auto transforms = m_scene.getInstanceTransforms();
+        const auto meshIds = m_scene.getInstanceMeshIds();
+        const auto staticFlags = m_scene.getInstanceStaticFlags();
+
+        // FNV-1a over each instance's mesh and whether it's static, and the static ones' transforms.
+        GLuint hash = 2166136261u;
+        const auto add = [&hash](const void* data, size_t size)
+        {
+            for (size_t b = 0; b < size; ++b)
+            {
+                hash = (hash ^ ((const GLubyte*)data)[b]) * 16777619u;
+            }
+        };
+
+        for (size_t i = 0; i < transforms.size(); ++i)
+        {
+            add(&meshIds[i], sizeof(meshIds[i]));
+            add(&staticFlags[i], sizeof(staticFlags[i]));
+            if (staticFlags[i])
+            {
+                add(&transforms[i], sizeof(transforms[i]));
+            }
+        }
+        return hash;
+    }
+
+    void PotentialVisibility::compress(const std::vector<std::vector<GLubyte>>& sets)
+    {
+        m_rowOffsets.clear();
+        m_data.clear();
+        m_decodedCell = -1;
+
+        // Neighbouring cells see much the same, so each is stored as its difference from the one before it in its
+        // row. Rows start from nothing, so decoding a cell never has to go further back than its row.
+        std::vector<GLubyte> delta;
+        for (GLuint cell = 0; cell < (GLuint)sets.size(); ++cell)
+        {
+            delta = sets[cell];
+            if (cell % m_dimensions.x != 0)
+            {
+                for (size_t b = 0; b < delta.size(); ++b)
+                {
+                    delta[b] ^= sets[cell - 1][b];
+                }
+            }
+
+            if (cell % m_dimensions.x == 0)
+            {
+                m_rowOffsets.push_back((GLuint)m_data.size());
+            }
+            encode(delta, m_data);
+        }
+        m_rowOffsets.push_back((GLuint)m_data.size());
+    }
+
+    void PotentialVisibility::decompress(GLuint cell, std::vector<GLubyte>& set) const
+    {
+        set.assign((m_instanceCount + 7) / 8, 0);
+        auto data = m_data.data() + m_rowOffsets[cell / m_dimensions.x];
+        for (GLuint c = 0; c <= cell % m_dimensions.x; ++c)
+        {
+            data = decodeInto(data, set);
+        }
+    }
+
+    void PotentialVisibility::resetDynamic()
+    {
+        const auto staticFlags = m_scene.getInstanceStaticFlags();
+        m_dynamic.resize(std::max(m_dynamic.size(), staticFlags.size()), 0);
+        for (size_t i = 0; i < staticFlags.size(); ++i)
+        {
+            m_dynamic[i] |= staticFlags[i] ? 0 : 1;
+        }
+    }
+
+    void PotentialVisibility::measure()
+    {
+        const auto meshIds = m_scene.getInstanceMeshIds();
+        const auto staticFlags = m_scene.getInstanceStaticFlags();
+        const auto cellCount = m_dimensions.x * m_dimensions.y * m_dimensions.z;
+
+        m_stats.cells = cellCount;
+        m_stats.compressedBytes = (GLuint)(m_data.size() + m_rowOffsets.size() * sizeof(GLuint));
+        m_stats.uncompressedBytes = cellCount * ((m_instanceCount + 7) / 8);
+        m_stats.staticInstances = 0;
+        m_stats.staticTriangles = 0;
+        for (GLuint i = 0; i < m_instanceCount; ++i)
+        {
+            if (staticFlags[i])
+            {
+                ++m_stats.staticInstances;
+                m_stats.staticTriangles += meshIds[i] < m_meshTriangles.size() ? m_meshTriangles[meshIds[i]] : 0;
+            }
+        }
+
+        // Rows are stored one after another, so every cell can be decoded in a single pass.
+        double instances = 0.0;
+        double triangles = 0.0;
+        m_stats.minInstances = m_instanceCount;
+        m_stats.maxInstances = 0;
+        std::vector<GLubyte> set;
+        const GLubyte* data = m_data.data();
+        for (GLuint cell = 0; cell < cellCount; ++cell)
+        {
+            if (cell % m_dimensions.x == 0)
+            {
+                set.assign((m_instanceCount + 7) / 8, 0);
+            }
+            data = decodeInto(data, set);
+
+            GLuint visible = 0;
+            for (GLuint i = 0; i < m_instanceCount; ++i)
+            {
+                if (getBit(set, i))
+                {
+                    ++visible;
+                    triangles += meshIds[i] < m_meshTriangles.size() ? m_meshTriangles[meshIds[i]] : 0;
+                }
+            }
+            instances += visible;
+            m_stats.minInstances = std::min(m_stats.minInstances, visible);
+            m_stats.maxInstances = std::max(m_stats.maxInstances, visible);
+        }
+
+        m_stats.averageInstances = cellCount > 0 ? (float)(instances / cellCount) : 0.f;
+        m_stats.averageTriangles = cellCount > 0 ? (float)(triangles / cellCount) : 0.f;
+    }
+}
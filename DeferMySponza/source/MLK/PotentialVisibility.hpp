@@ -0,0 +1,134 @@
+#pragma once
+
+#include "InstanceBVH.hpp"
+
+#include <tgl/tgl.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace sponza
+{
+    class Context;
+}
+
+namespace MLK
+{
+    class JobSystem;
+
+    /// <summary>
+    /// How finely the scene is divided and how thoroughly each cell is sampled when baking.
+    /// </summary>
+    struct PVSBakeSettings
+    {
+        // Most cells the scene's bounds are divided into, the cells being cubes.
+        GLuint maxCells = 4096;
+
+        // Points rays are cast from in each cell, and the rays cast from each over the sphere of directions.
+        GLuint samplesPerCell = 8;
+        GLuint raysPerSample = 128;
+
+        // Adds each cell's neighbours' sets to its own, covering gaps between the sampled rays.
+        bool dilate = true;
+    };
+
+    /// <summary>
+    /// Counts for the bake, and for the last frame's filtering.
+    /// </summary>
+    struct PVSStats
+    {
+        GLuint cells = 0;
+        GLuint staticInstances = 0;
+        GLuint staticTriangles = 0;
+        GLuint compressedBytes = 0;
+        GLuint uncompressedBytes = 0;
+        float bakeMs = 0.f;
+        GLuint rays = 0;
+        GLuint minInstances = 0;
+        GLuint maxInstances = 0;
+        float averageInstances = 0.f;
+        float averageTriangles = 0.f;
+
+        GLint cell = -1;
+        GLuint instancesIn = 0;
+        GLuint instancesOut = 0;
+        GLuint dynamicInstances = 0;
+        GLuint trianglesIn = 0;
+        GLuint trianglesOut = 0;
+    };
+
+    /// <summary>
+    /// Precomputed visibility for the scene's static instances. An offline bake divides the scene's bounds into
+    /// cube cells and casts rays against the static triangles from points in every cell, across every core, to
+    /// find which instances can be seen from somewhere inside it. Each cell's set is stored as a bitset, XORed with
+    /// the previous cell's in its row and run length encoded, in a side file that's loaded on later runs. At
+    /// runtime the camera's cell removes what it can't see from the instance list the indirect draws are built
+    /// from. Dynamic instances, and any static ones seen moving, are never removed.
+    /// </summary>
+    class PotentialVisibility
+    {
+    public:
+        PotentialVisibility(const sponza::Context& scene);
+
+        // Bakes the sets over the static instances' <instanceBoxes>, splitting the cells across <jobs>.
+        void bake(JobSystem& jobs, const std::vector<BoundingBox>& instanceBoxes,
+            const PVSBakeSettings& settings = PVSBakeSettings());
+
+        bool save(const char* path) const;
+
+        // Returns false, leaving the sets empty, if the file is missing or was baked for a different scene.
+        bool load(const char* path);
+
+        bool isReady() const { return !m_rowOffsets.empty(); }
+
+        // Treats <instances> as dynamic from now on, such as those the scene has just moved.
+        void markDynamic(const std::vector<GLuint>& instances);
+
+        // Removes the instances that can't be seen from <eye>'s cell from the ascending <instances>. Nothing is
+        // removed when the eye is outside every cell.
+        void filter(const glm::vec3& eye, std::vector<GLuint>& instances);
+
+        const PVSStats& getStats() const { return m_stats; }
+
+        void printStats() const;
+
+    private:
+        // Index of the cell holding <position>, or -1 outside the grid.
+        GLint getCell(const glm::vec3& position) const;
+
+        glm::vec3 getCellMinimum(GLuint cell) const;
+
+        // Hash of what the bake depends on, the static instances' meshes and transforms.
+        GLuint getSceneHash() const;
+
+        void compress(const std::vector<std::vector<GLubyte>>& sets);
+        void decompress(GLuint cell, std::vector<GLubyte>& set) const;
+
+        // Marks the static instances' flags alongside any already marked dynamic, sized to the scene.
+        void resetDynamic();
+
+        // Fills the bake's counts by decoding every cell.
+        void measure();
+
+        const sponza::Context& m_scene;
+
+        // Triangles in each mesh, indexed by mesh id, and whether each instance is dynamic.
+        std::vector<GLuint> m_meshTriangles;
+        std::vector<GLubyte> m_dynamic;
+        GLuint m_instanceCount = 0;
+
+        glm::vec3 m_origin = glm::vec3(0.f);
+        float m_cellSize = 0.f;
+        glm::uvec3 m_dimensions = glm::uvec3(0);
+
+        // Where each row of cells starts in the encoded sets, the cells of a row following one another.
+        std::vector<GLuint> m_rowOffsets;
+        std::vector<GLubyte> m_data;
+
+        // The last cell decoded, as one byte per eight instances.
+        GLint m_decodedCell = -1;
+        std::vector<GLubyte> m_decoded;
+
+        PVSStats m_stats;
+    };
+}
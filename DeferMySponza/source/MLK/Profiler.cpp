@@ -1,38 +1,126 @@
 #include "Profiler.hpp"
 
 #include <iostream>
+#include <string>
 
 namespace MLK
 {
-	Profiler::Profiler()
-    {
-    }
+	namespace
+	{
+		// Print order and names of profile keys.
+		const std::vector<std::pair<ProfileKey, std::string>> g_profileNames =
+		{
+			{ ProfileKey::FrameTime, "Frame" },
+			{ ProfileKey::GBufferTime, "GBuffer" },
+			{ ProfileKey::AmbientTime, "Ambient" },
+			{ ProfileKey::PointLightTime, "Point lights" },
+			{ ProfileKey::PointShadowTime, "Point shadow maps (within point lights)" },
+			{ ProfileKey::SpotLightTime, "Spot lights" },
+			{ ProfileKey::ShadowMapTime, "Spot shadow maps (within spot lights)" },
+			{ ProfileKey::SSRTime, "SSR" },
+			{ ProfileKey::SMAATime, "SMAA" },
+			{ ProfileKey::TAATime, "TAA" }
+		};
 
-	Profiler::~Profiler()
-    {
+		// Weight given to the newest sample when smoothing.
+		const float g_smoothing = 0.1f;
+	}
 
-    }
+	Profiler::Profiler()
+	{
+	}
 
-	void Profiler::beginQuery(ProfileKey key)
+	Profiler::~Profiler()
 	{
-		if (m_queries.find(key) == m_queries.end())
+		for (const auto& queries : m_queries)
 		{
-			m_queries[key].resize(g_maxQueries);
 			for (GLuint i = 0; i < g_maxQueries; ++i)
 			{
-				glGenQueries(1, &m_queries.at(key)[i]);
+				glDeleteQueries((GLsizei)queries.second.begin[i].size(), queries.second.begin[i].data());
+				glDeleteQueries((GLsizei)queries.second.end[i].size(), queries.second.end[i].data());
 			}
 		}
 	}
 
+	void Profiler::beginQuery(ProfileKey key)
+	{
+		auto& queries = m_queries[key];
+		if (queries.issued.empty())
+		{
+			queries.begin.resize(g_maxQueries);
+			queries.end.resize(g_maxQueries);
+			queries.issued.resize(g_maxQueries, 0);
+		}
+
+		// Query pairs are created the first time a slot needs them.
+		auto& begin = queries.begin[m_frameIndex];
+		auto& end = queries.end[m_frameIndex];
+		const auto index = queries.issued[m_frameIndex];
+		if (index == begin.size())
+		{
+			begin.push_back(0);
+			end.push_back(0);
+			glGenQueries(1, &begin.back());
+			glGenQueries(1, &end.back());
+		}
+
+		glQueryCounter(begin[index], GL_TIMESTAMP);
+	}
+
 	void Profiler::endQuery(ProfileKey key)
 	{
-		GLuint result;
-		glGetQueryObjectuiv(m_queries.at(key)[0], GL_QUERY_RESULT_AVAILABLE, &result);
-		if (result == GL_TRUE)
+		auto& queries = m_queries.at(key);
+		auto& index = queries.issued[m_frameIndex];
+		glQueryCounter(queries.end[m_frameIndex][index], GL_TIMESTAMP);
+		++index;
+	}
+
+	void Profiler::endFrame()
+	{
+		m_frameIndex = (m_frameIndex + 1) % g_maxQueries;
+
+		// The slot about to be reused was issued g_maxQueries frames ago, so reading it shouldn't wait on the GPU.
+		for (auto& queries : m_queries)
+		{
+			auto& profile = queries.second;
+			const auto issued = profile.issued[m_frameIndex];
+			if (issued == 0)
+			{
+				continue;
+			}
+
+			GLuint64 total = 0;
+			for (GLuint i = 0; i < issued; ++i)
+			{
+				GLuint64 begin = 0;
+				GLuint64 end = 0;
+				glGetQueryObjectui64v(profile.begin[m_frameIndex][i], GL_QUERY_RESULT, &begin);
+				glGetQueryObjectui64v(profile.end[m_frameIndex][i], GL_QUERY_RESULT, &end);
+				total += end - begin;
+			}
+			profile.issued[m_frameIndex] = 0;
+
+			profile.lastMs = total / 1000000.f;
+			profile.averageMs = profile.averageMs == 0.f ? profile.lastMs :
+				profile.averageMs + (profile.lastMs - profile.averageMs) * g_smoothing;
+		}
+	}
+
+	float Profiler::getAverageTime(ProfileKey key) const
+	{
+		const auto queries = m_queries.find(key);
+		return queries == m_queries.end() ? 0.f : queries->second.averageMs;
+	}
+
+	void Profiler::printTimings() const
+	{
+		std::cout << "GPU pass timings (ms):" << std::endl;
+		for (const auto& name : g_profileNames)
 		{
-			glGetQueryObjectuiv(m_queries.at(key)[0], GL_QUERY_RESULT, &result);
-			std::cout << result << std::endl;
+			if (m_queries.find(name.first) != m_queries.end())
+			{
+				std::cout << "  " << name.second << ": " << getAverageTime(name.first) << std::endl;
+			}
 		}
 	}
-}
\ No newline at end of file
+}
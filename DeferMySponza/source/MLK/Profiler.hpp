@@ -1,22 +1,45 @@
 #pragma once
 
 #include <unordered_map>
+#include <vector>
 #include <tgl/tgl.h>
 
 namespace MLK
 {
+	// Number of frames of queries kept in flight per key, results are read back once a slot comes round again.
 	const GLuint g_maxQueries = 10;
 
 	enum ProfileKey
 	{
+		FrameTime,
 		GBufferTime,
-		AmbientTime
+		AmbientTime,
+		PointLightTime,
+		PointShadowTime,
+		SpotLightTime,
+		ShadowMapTime,
+		SSRTime,
+		SMAATime,
+		TAATime
 	};
 
 	/// <summary>
-    /// Implementation to help manage witching of OpenGl variables. The different passes require multiple
-    /// GL variables to be set, this groups them and ensures they aren't switched unnecessarily.
-    /// </summary>
+	/// Ring of timestamp query pairs for a single profile key. A key may be timed several times in a frame, such as
+	/// once per shadow map, so each frame's slot holds as many pairs as it needed and their times are summed.
+	/// </summary>
+	struct ProfileQueries
+	{
+		std::vector<std::vector<GLuint>> begin;
+		std::vector<std::vector<GLuint>> end;
+		std::vector<GLuint> issued;
+		float averageMs = 0.f;
+		float lastMs = 0.f;
+	};
+
+	/// <summary>
+	/// GPU pass timer using timestamp queries. Results are read back several frames late so querying them never
+	/// stalls the pipeline, and are smoothed to give a stable per pass cost.
+	/// </summary>
 	class Profiler
 	{
 	public:
@@ -26,7 +49,16 @@ namespace MLK
 		void beginQuery(ProfileKey key);
 		void endQuery(ProfileKey key);
 
+		// Reads back any results old enough to be available and moves on to the next set of queries.
+		void endFrame();
+
+		// Smoothed GPU time of <key> in milliseconds, 0 if it has never run.
+		float getAverageTime(ProfileKey key) const;
+
+		void printTimings() const;
+
 	private:
-		std::unordered_map<ProfileKey, std::vector<GLuint>> m_queries;
+		std::unordered_map<ProfileKey, ProfileQueries> m_queries;
+		GLuint m_frameIndex = 0;
 	};
-}
\ No newline at end of file
+}
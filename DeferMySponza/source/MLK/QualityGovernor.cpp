@@ -0,0 +1,93 @@
+#include "QualityGovernor.hpp"
+
+#include <algorithm>
+
+namespace MLK
+{
+    QualityGovernor::QualityGovernor(const QualityBounds& bounds) :
+        m_bounds(bounds)
+    {
+        m_settings.resolutionScale = m_bounds.maxScale;
+        m_framesSinceChange = m_bounds.settleFrames;
+        applyTiers();
+    }
+
+    bool QualityGovernor::update(float gpuFrameMs)
+    {
+        // Timings lag behind changes, so wait for them to settle rather than overshooting.
+        if (m_framesSinceChange < m_bounds.settleFrames)
+        {
+            ++m_framesSinceChange;
+            return false;
+        }
+
+        bool changed = false;
+        if (gpuFrameMs > m_bounds.targetFrameMs)
+        {
+            changed = lowerQuality();
+        }
+        else if (gpuFrameMs < m_bounds.targetFrameMs * m_bounds.headroom)
+        {
+            changed = raiseQuality();
+        }
+
+        if (changed)
+        {
+            m_framesSinceChange = 0;
+        }
+
+        return changed;
+    }
+
+    bool QualityGovernor::lowerQuality()
+    {
+        // Resolution first, then the cheapest feature to lose.
+        if (m_settings.resolutionScale > m_bounds.minScale)
+        {
+            m_settings.resolutionScale = std::max(m_bounds.minScale, m_settings.resolutionScale - m_bounds.scaleStep);
+            return true;
+        }
+        if (m_ssrTier + 1 < m_bounds.ssrStepCounts.size())
+        {
+            ++m_ssrTier;
+            applyTiers();
+            return true;
+        }
+        if (m_shadowTier + 1 < m_bounds.shadowResolutions.size())
+        {
+            ++m_shadowTier;
+            applyTiers();
+            return true;
+        }
+        return false;
+    }
+
+    bool QualityGovernor::raiseQuality()
+    {
+        // The reverse of lowering, features come back before resolution.
+        if (m_shadowTier > 0)
+        {
+            --m_shadowTier;
+            applyTiers();
+            return true;
+        }
+        if (m_ssrTier > 0)
+        {
+            --m_ssrTier;
+            applyTiers();
+            return true;
+        }
+        if (m_settings.resolutionScale < m_bounds.maxScale)
+        {
+            m_settings.resolutionScale = std::min(m_bounds.maxScale, m_settings.resolutionScale + m_bounds.scaleStep);
+            return true;
+        }
+        return false;
+    }
+
+    void QualityGovernor::applyTiers()
+    {
+        m_settings.shadowResolution = m_bounds.shadowResolutions[m_shadowTier];
+        m_settings.ssrStepCount = m_bounds.ssrStepCounts[m_ssrTier];
+    }
+}
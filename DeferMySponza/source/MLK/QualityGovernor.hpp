@@ -0,0 +1,66 @@
+#pragma once
+
+#include <tgl/tgl.h>
+
+#include <vector>
+
+namespace MLK
+{
+    /// <summary>
+    /// Bounds the governor works within. Tiers are ordered from highest to lowest quality.
+    /// </summary>
+    struct QualityBounds
+    {
+        float targetFrameMs = 16.6f;
+
+        // Frame time below this fraction of the target is considered headroom to raise quality.
+        float headroom = 0.8f;
+
+        float minScale = 0.5f;
+        float maxScale = 1.f;
+        float scaleStep = 0.1f;
+
+        std::vector<GLuint> shadowResolutions = { 2048, 1024, 512 };
+        std::vector<GLuint> ssrStepCounts = { 100, 50, 25 };
+
+        // Frames to wait after a change, long enough for its effect to reach the GPU timings.
+        GLuint settleFrames = 30;
+    };
+
+    /// <summary>
+    /// Settings chosen by the governor for the next frame.
+    /// </summary>
+    struct QualitySettings
+    {
+        float resolutionScale = 1.f;
+        GLuint shadowResolution = 2048;
+        GLuint ssrStepCount = 100;
+    };
+
+    /// <summary>
+    /// Holds GPU frame time at a target by adjusting internal resolution. Once resolution is at its floor the
+    /// feature tiers are stepped down, and on the way back up tiers are restored before resolution.
+    /// </summary>
+    class QualityGovernor
+    {
+    public:
+        QualityGovernor(const QualityBounds& bounds = QualityBounds());
+
+        // Feeds in the latest GPU frame time, returning true if the settings changed.
+        bool update(float gpuFrameMs);
+
+        const QualitySettings& getSettings() const { return m_settings; }
+
+    private:
+        bool lowerQuality();
+        bool raiseQuality();
+        void applyTiers();
+
+        QualityBounds m_bounds;
+        QualitySettings m_settings;
+
+        GLuint m_shadowTier = 0;
+        GLuint m_ssrTier = 0;
+        GLuint m_framesSinceChange = 0;
+    };
+}
@@ -0,0 +1,329 @@
+#include "RenderQueue.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <type_traits>
+
+namespace MLK
+{
+    namespace
+    {
+        typedef std::chrono::high_resolution_clock Clock;
+
+        // Packets are copied about and dropped wholesale with the arena, so they mustn't own anything.
+        static_assert(std::is_trivially_copyable<DrawPacket>::value && std::is_trivially_destructible<DrawPacket>::value,
+            "Draw packets must be plain data");
+
+        // Room for a few thousand packets before a second block is needed.
+        const size_t g_arenaBlockSize = 256 * 1024;
+
+        // Fields of a key from the top: layer, state, program, VAO and the order within them.
+        const GLuint g_layerBits = 8;
+        const GLuint g_stateBits = 8;
+        const GLuint g_programBits = 8;
+        const GLuint g_vaoBits = 8;
+        const GLuint g_orderBits = 32;
+
+        // Best of this many runs of each path, as the first pays for the driver warming up.
+        const GLuint g_benchmarkRuns = 3;
+
+        GLuint64 field(GLuint value, GLuint bits)
+        {
+            return bits >= 32 ? (GLuint64)value : (GLuint64)(value & ((1u << bits) - 1));
+        }
+
+        float millisecondsSince(Clock::time_point start)
+        {
+            return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+        }
+    }
+
+    FrameArena::FrameArena(size_t blockSize) :
+        m_blockSize(blockSize)
+    {
+    }
+
+    void* FrameArena::allocate(size_t size, size_t alignment)
+    {
+        const auto aligned = (m_blockOffset + alignment - 1) & ~(alignment - 1);
+        if (m_currentBlock < m_blocks.size() && aligned + size <= m_blocks[m_currentBlock].size())
+        {
+            m_blockOffset = aligned + size;
+            m_usedBytes += size;
+            return m_blocks[m_currentBlock].data() + aligned;
+        }
+
+        // Moves on to the next block, making one if this frame's the busiest yet. Blocks start suitably aligned
+        // for anything, and oversized requests get a block of their own.
+        if (m_currentBlock < m_blocks.size())
+        {
+            ++m_currentBlock;
+        }
+        if (m_currentBlock == m_blocks.size() || m_blocks[m_currentBlock].size() < size)
+        {
+            m_blocks.insert(m_blocks.begin() + m_currentBlock, std::vector<unsigned char>(std::max(size, m_blockSize)));
+        }
+
+        m_blockOffset = size;
+        m_usedBytes += size;
+        return m_blocks[m_currentBlock].data();
+    }
+
+    void FrameArena::reset()
+    {
+        m_currentBlock = 0;
+        m_blockOffset = 0;
+        m_usedBytes = 0;
+    }
+
+    RenderQueue::RenderQueue(ShaderManager& shaders, GlStateManager& states, MeshManager& meshes) :
+        m_shaders(shaders),
+        m_states(states),
+        m_meshes(meshes),
+        m_arena(g_arenaBlockSize)
+    {
+    }
+
+    void RenderQueue::beginFrame()
+    {
+        m_lastFrameStats = m_stats;
+        m_stats = RenderQueueStats();
+        m_entries.clear();
+        m_arena.reset();
+    }
+
+    DrawPacket& RenderQueue::record(GLuint64 key)
+    {
+        const auto packet = new (m_arena.allocate<DrawPacket>()) DrawPacket();
+        m_entries.push_back({ key, packet });
+        return *packet;
+    }
+
+    void RenderQueue::execute()
+    {
+        if (m_entries.empty())
+        {
+            return;
+        }
+
+        auto start = Clock::now();
+        radixSort();
+        m_stats.sortMs += millisecondsSince(start);
+
+        start = Clock::now();
+        const DrawPacket* last = nullptr;
+        GLuint indirectBuffer = 0;
+        for (const auto& entry : m_entries)
+        {
+            const auto& packet = *entry.packet;
+            if (packet.State != DrawPass::NoPass && (last == nullptr || packet.State != last->State))
+            {
+                m_states.setState(packet.State);
+                ++m_stats.stateChanges;
+            }
+            if (packet.Program != ShaderProgram::NoProgram && (last == nullptr || packet.Program != last->Program))
+            {
+                m_shaders.useProgram(packet.Program);
+                ++m_stats.programBinds;
+            }
+            if (last == nullptr || packet.VaoId != last->VaoId)
+            {
+                glBindVertexArray(packet.VaoId);
+                ++m_stats.vaoBinds;
+            }
+            if (packet.Type == DrawType::ElementsIndirect && packet.IndirectBufferId != indirectBuffer)
+            {
+                indirectBuffer = packet.IndirectBufferId;
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+                ++m_stats.bufferBinds;
+            }
+
+            issueDraw(packet);
+            last = &packet;
+        }
+        m_stats.submitMs += millisecondsSince(start);
+        m_stats.packets += (GLuint)m_entries.size();
+
+        // The mesh manager's idea of what's bound is out of date now.
+        m_meshes.invalidateBinding();
+        m_entries.clear();
+    }
+
+    void RenderQueue::issueDraw(const DrawPacket& packet)
+    {
+        switch (packet.Type)
+        {
+            case DrawType::Arrays:
+                glDrawArrays(packet.Mode, packet.First, packet.Count);
+                break;
+
+            case DrawType::Elements:
+                glDrawElements(packet.Mode, packet.Count, GL_UNSIGNED_INT, TGL_BUFFER_OFFSET(packet.First * sizeof(GLuint)));
+                break;
+
+            case DrawType::ElementsInstanced:
+                glDrawElementsInstancedBaseVertexBaseInstance(packet.Mode, packet.Count, GL_UNSIGNED_INT,
+                    TGL_BUFFER_OFFSET(packet.First * sizeof(GLuint)), packet.InstanceCount, packet.BaseVertex, packet.BaseInstance);
+                break;
+
+            case DrawType::ElementsIndirect:
+                glMultiDrawElementsIndirect(packet.Mode, GL_UNSIGNED_INT, TGL_BUFFER_OFFSET(packet.First * sizeof(Mesh)),
+                    packet.Count, 0);
+                break;
+        }
+    }
+
+    GLuint64 RenderQueue::makeKey(GLuint layer, DrawPass state, ShaderProgram program, GLuint vao, GLuint order)
+    {
+        return field(layer, g_layerBits) << (g_stateBits + g_programBits + g_vaoBits + g_orderBits) |
+            field(state, g_stateBits) << (g_programBits + g_vaoBits + g_orderBits) |
+            field(program, g_programBits) << (g_vaoBits + g_orderBits) |
+            field(vao, g_vaoBits) << g_orderBits |
+            field(order, g_orderBits);
+    }
+
+    void RenderQueue::radixSort()
+    {
+        // Least significant byte first, each pass a stable counting sort, so ties keep the order they were
+        // recorded in. A byte every key shares would leave the order as it is, so its pass is skipped.
+        m_scratch.resize(m_entries.size());
+        const auto count = m_entries.size();
+        for (GLuint shift = 0; shift < 64; shift += 8)
+        {
+            size_t offsets[256] = {};
+            for (const auto& entry : m_entries)
+            {
+                ++offsets[(entry.key >> shift) & 0xff];
+            }
+
+            if (offsets[(m_entries[0].key >> shift) & 0xff] == count)
+            {
+                continue;
+            }
+
+            size_t total = 0;
+            for (auto& offset : offsets)
+            {
+                const auto bucket = offset;
+                offset = total;
+                total += bucket;
+            }
+
+            for (const auto& entry : m_entries)
+            {
+                m_scratch[offsets[(entry.key >> shift) & 0xff]++] = entry;
+            }
+            m_entries.swap(m_scratch);
+        }
+    }
+
+    void RenderQueue::printStats() const
+    {
+        const auto& stats = m_lastFrameStats;
+        std::cout << "Render queue: " << stats.packets << " packets, " << stats.programBinds << " program, "
+            << stats.stateChanges << " state, " << stats.vaoBinds << " VAO and " << stats.bufferBinds << " buffer binds, "
+            << stats.sortMs << "ms sorting, " << stats.submitMs << "ms submitting, " << m_arena.getReservedBytes() / 1024
+            << "KB arena" << std::endl;
+    }
+
+    void RenderQueue::runBenchmark(MeshGroup group, GLuint drawCount)
+    {
+        // Every instance of the group drawn alone, cycled through until there are enough draws. A third go through
+        // the shadow program and state, mixed in as an unsorted list of passes' draws would be.
+        DrawPacket full;
+        m_meshes.fillPacket(group, full);
+
+        std::vector<DrawPacket> draws;
+        for (const auto& mesh : m_meshes.getMeshes(group))
+        {
+            for (GLuint instance = 0; instance < mesh.InstanceCount; ++instance)
+            {
+                DrawPacket packet;
+                packet.Type = DrawType::ElementsInstanced;
+                packet.VaoId = full.VaoId;
+                packet.Count = mesh.ElementCount;
+                packet.First = mesh.FirstElement;
+                packet.BaseVertex = (GLint)mesh.FirstVertex;
+                packet.BaseInstance = mesh.BaseInstance + instance;
+                draws.push_back(packet);
+            }
+        }
+        if (draws.empty())
+        {
+            return;
+        }
+
+        const auto instanceCount = draws.size();
+        draws.resize(drawCount);
+        for (GLuint i = 0; i < drawCount; ++i)
+        {
+            draws[i] = draws[i % instanceCount];
+            const auto shadow = i % 3 == 0;
+            draws[i].Program = shadow ? ShaderProgram::Shadows : ShaderProgram::GBufferProgram;
+            draws[i].State = shadow ? DrawPass::ShadowMapPass : DrawPass::GBufferPass;
+        }
+
+        // Each draw binding what it needs as it's made, the managers skipping what's already set.
+        auto immediateMs = std::numeric_limits<float>::max();
+        RenderQueueStats immediate;
+        for (GLuint run = 0; run < g_benchmarkRuns; ++run)
+        {
+            glFinish();
+            immediate = RenderQueueStats();
+            const auto start = Clock::now();
+            const DrawPacket* last = nullptr;
+            for (const auto& packet : draws)
+            {
+                m_states.setState(packet.State);
+                m_shaders.useProgram(packet.Program);
+                glBindVertexArray(packet.VaoId);
+                issueDraw(packet);
+
+                immediate.stateChanges += last == nullptr || packet.State != last->State ? 1 : 0;
+                immediate.programBinds += last == nullptr || packet.Program != last->Program ? 1 : 0;
+                ++immediate.vaoBinds;
+                last = &packet;
+            }
+            immediateMs = std::min(immediateMs, millisecondsSince(start));
+        }
+
+        // The same draws recorded, sorted and submitted, the frame's own counts put aside meanwhile.
+        const auto frameStats = m_stats;
+        auto recordMs = std::numeric_limits<float>::max();
+        RenderQueueStats queued;
+        for (GLuint run = 0; run < g_benchmarkRuns; ++run)
+        {
+            glFinish();
+            m_stats = RenderQueueStats();
+            const auto start = Clock::now();
+            for (GLuint i = 0; i < drawCount; ++i)
+            {
+                const auto& draw = draws[i];
+                record(makeKey(0, draw.State, draw.Program, draw.VaoId, i)) = draw;
+            }
+            const auto runRecordMs = millisecondsSince(start);
+            execute();
+
+            if (run == 0 || runRecordMs + m_stats.sortMs + m_stats.submitMs < recordMs + queued.sortMs + queued.submitMs)
+            {
+                recordMs = runRecordMs;
+                queued = m_stats;
+            }
+        }
+        m_stats = frameStats;
+        m_meshes.invalidateBinding();
+
+        const auto queuedMs = recordMs + queued.sortMs + queued.submitMs;
+        std::cout << "Render queue benchmark, " << drawCount << " draws:" << std::endl;
+        std::cout << "  immediate: " << immediateMs << "ms (" << immediate.programBinds << " program, "
+            << immediate.stateChanges << " state and " << immediate.vaoBinds << " VAO binds)" << std::endl;
+        std::cout << "  queued: " << queuedMs << "ms, " << recordMs << "ms recording, " << queued.sortMs << "ms sorting, "
+            << queued.submitMs << "ms submitting (" << queued.programBinds << " program, " << queued.stateChanges
+            << " state and " << queued.vaoBinds << " VAO binds)" << std::endl;
+        std::cout << "  " << 1000.f * immediateMs / drawCount << "us against " << 1000.f * queuedMs / drawCount
+            << "us per draw" << std::endl;
+    }
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "GlStateManager.hpp"
+#include "MeshManager.hpp"
+#include "ShaderManager.hpp"
+
+#include <tgl/tgl.h>
+
+#include <vector>
+
+namespace MLK
+{
+    /// <summary>
+    /// Everything one draw needs, as plain data so packets can be written to an arena, sorted and replayed
+    /// without touching the objects that recorded them. Counts and offsets are read as the draw type needs:
+    /// vertices or elements from First for direct draws, or Count commands from First in the indirect buffer.
+    /// </summary>
+    struct DrawPacket
+    {
+        ShaderProgram Program = ShaderProgram::NoProgram;
+        DrawPass State = DrawPass::NoPass;
+        DrawType Type = DrawType::Elements;
+        GLenum Mode = GL_TRIANGLES;
+        GLuint VaoId = 0;
+        GLuint IndirectBufferId = 0;
+        GLuint Count = 0;
+        GLuint First = 0;
+        GLint BaseVertex = 0;
+        GLuint InstanceCount = 1;
+        GLuint BaseInstance = 0;
+    };
+
+    /// <summary>
+    /// Bump allocator for a frame's packets. Blocks are kept from frame to frame, so once the busiest frame has
+    /// been seen recording allocates nothing, and everything is released at once when the next frame begins.
+    /// </summary>
+    class FrameArena
+    {
+    public:
+        FrameArena(size_t blockSize);
+
+        // Room for <count> objects of type T, left uninitialised. Only for types needing no destructor.
+        template<typename T>
+        T* allocate(size_t count = 1)
+        {
+            return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+        }
+
+        void* allocate(size_t size, size_t alignment);
+
+        // Makes every block free again, invalidating whatever was allocated from them.
+        void reset();
+
+        size_t getUsedBytes() const { return m_usedBytes; }
+        size_t getReservedBytes() const { return m_blocks.size() * m_blockSize; }
+
+    private:
+        size_t m_blockSize;
+        std::vector<std::vector<unsigned char>> m_blocks;
+        size_t m_currentBlock = 0;
+        size_t m_blockOffset = 0;
+        size_t m_usedBytes = 0;
+    };
+
+    /// <summary>
+    /// Binds and draws counted over a frame's queued packets, with the time spent sorting and submitting them.
+    /// </summary>
+    struct RenderQueueStats
+    {
+        GLuint packets = 0;
+        GLuint programBinds = 0;
+        GLuint stateChanges = 0;
+        GLuint vaoBinds = 0;
+        GLuint bufferBinds = 0;
+        float sortMs = 0.f;
+        float submitMs = 0.f;
+    };
+
+    /// <summary>
+    /// Passes record draw packets rather than drawing, each under a 64 bit key. Executing sorts the keys with a
+    /// radix sort and replays the packets in that order, binding only what differs from the packet before, so
+    /// packets that share a program, state and VAO run back to back without rebinding anything. Keys from makeKey
+    /// sort by layer, then state, program and VAO, leaving the low bits for the order a pass wants within those.
+    /// Program and state changes go through their managers so their caches stay right for immediate draws.
+    /// </summary>
+    class RenderQueue
+    {
+    public:
+        RenderQueue(ShaderManager& shaders, GlStateManager& states, MeshManager& meshes);
+
+        // Releases the last frame's packets and starts counting afresh.
+        void beginFrame();
+
+        // A packet to fill in, executed in the order of <key> against the others recorded since the last execute.
+        DrawPacket& record(GLuint64 key);
+
+        // Sorts and draws everything recorded since the last execute.
+        void execute();
+
+        // Issues the packet's draw call alone, with its VAO and indirect buffer already bound.
+        static void issueDraw(const DrawPacket& packet);
+
+        static GLuint64 makeKey(GLuint layer, DrawPass state, ShaderProgram program, GLuint vao, GLuint order);
+
+        const RenderQueueStats& getStats() const { return m_lastFrameStats; }
+
+        void printStats() const;
+
+        // Times recording, sorting and submitting <drawCount> single instance draws of <group> against binding and
+        // drawing each in the order made, and prints the comparison. Draws into whatever framebuffer is bound.
+        void runBenchmark(MeshGroup group, GLuint drawCount);
+
+    private:
+        struct SortEntry
+        {
+            GLuint64 key;
+            DrawPacket* packet;
+        };
+
+        void radixSort();
+
+        ShaderManager& m_shaders;
+        GlStateManager& m_states;
+        MeshManager& m_meshes;
+
+        FrameArena m_arena;
+        std::vector<SortEntry> m_entries;
+        std::vector<SortEntry> m_scratch;
+
+        RenderQueueStats m_stats;
+        RenderQueueStats m_lastFrameStats;
+    };
+}
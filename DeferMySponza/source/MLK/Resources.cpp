@@ -0,0 +1,355 @@
+#include "Resources.hpp"
+
+#include <iostream>
+
+namespace MLK
+{
+    namespace Resources
+    {
+        namespace
+        {
+            bool g_dsaAvailable = false;
+            bool g_useDSA = false;
+
+            ResourceBindStats g_stats;
+            ResourceBindStats g_lastFrameStats;
+
+            // Fallback edits go through TEmpty so no slot a pass samples from is disturbed.
+            void bindTextureForEdit(GLenum target, GLuint texture)
+            {
+                glActiveTexture(TextureSlot::TEmpty);
+                glBindTexture(target, texture);
+                ++g_stats.activeTextureChanges;
+                ++g_stats.textureBinds;
+            }
+
+            void unbindTextureAfterEdit(GLenum target)
+            {
+                glBindTexture(target, 0);
+                ++g_stats.textureBinds;
+            }
+
+            // The copy write target is neither VAO state nor read by any draw.
+            void bindBufferForEdit(GLuint buffer)
+            {
+                glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+                ++g_stats.bufferBinds;
+            }
+
+            void unbindBufferAfterEdit()
+            {
+                glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+                ++g_stats.bufferBinds;
+            }
+
+            void bindFramebufferForEdit(GLuint framebuffer)
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+                ++g_stats.framebufferBinds;
+            }
+
+            void unbindFramebufferAfterEdit()
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                ++g_stats.framebufferBinds;
+            }
+        }
+
+        void init()
+        {
+            g_dsaAvailable = tglIsAvailable(TGL_EXTENSION_GL_4_5) == GL_TRUE;
+            g_useDSA = g_dsaAvailable;
+        }
+
+        bool isDSAAvailable()
+        {
+            return g_dsaAvailable;
+        }
+
+        bool usesDSA()
+        {
+            return g_useDSA;
+        }
+
+        void setUseDSA(bool useDSA)
+        {
+            g_useDSA = useDSA && g_dsaAvailable;
+        }
+
+        void beginFrame()
+        {
+            g_lastFrameStats = g_stats;
+            g_stats = ResourceBindStats();
+        }
+
+        const ResourceBindStats& getStats()
+        {
+            return g_lastFrameStats;
+        }
+
+        void printStats()
+        {
+            const auto& stats = g_lastFrameStats;
+            std::cout << "Resource binds (" << (g_useDSA ? "direct state access" : "bind to edit")
+                << (g_dsaAvailable ? "" : ", GL 4.5 unavailable") << "): " << stats.textureBinds << " texture ("
+                << stats.activeTextureChanges << " active unit changes), " << stats.bufferBinds << " buffer, "
+                << stats.framebufferBinds << " framebuffer and " << stats.renderbufferBinds << " renderbuffer over "
+                << stats.edits << " edits, counting only what goes through the layer, not the passes' own framebuffer and buffer binds"
+                << std::endl;
+        }
+
+        GLuint createTexture(GLenum target, GLenum format, GLuint width, GLuint height, GLuint levels)
+        {
+            GLuint texture = 0;
+            ++g_stats.edits;
+            if (g_useDSA)
+            {
+                glCreateTextures(target, 1, &texture);
+                glTextureStorage2D(texture, levels, format, width, height);
+            }
+            else
+            {
+                glGenTextures(1, &texture);
+                bindTextureForEdit(target, texture);
+                glTexStorage2D(target, levels, format, width, height);
+                unbindTextureAfterEdit(target);
+            }
+            return texture;
+        }
+
+        void setSampling(GLuint texture, GLenum target, GLint filter, GLint wrap)
+        {
+            ++g_stats.edits;
+            if (g_useDSA)
+            {
+                glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, filter);
+                glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, filter);
+                glTextureParameteri(texture, GL_TEXTURE_WRAP_S, wrap);
+                glTextureParameteri(texture, GL_TEXTURE_WRAP_T, wrap);
+            }
+            else
+            {
+                bindTextureForEdit(target, texture);
+                glTexParameteri(target, GL_TEXTURE_MIN_FILTER, filter);
+                glTexParameteri(target, GL_TEXTURE_MAG_FILTER, filter);
+                glTexParameteri(target, GL_TEXTURE_WRAP_S, wrap);
+                glTexParameteri(target, GL_TEXTURE_WRAP_T, wrap);
+                unbindTextureAfterEdit(target);
+            }
+        }
+
+        void setParameter(GLuint texture, GLenum target, GLenum name, GLint value)
+        {
+            ++g_stats.edits;
+            if (g_useDSA)
+            {
+                glTextureParameteri(texture, name, value);
+            }
+            else
+            {
+                bindTextureForEdit(target, texture);
+                glTexParameteri(target, name, value);
+                unbindTextureAfterEdit(target);
+            }
+        }
+
+        void uploadTexture(GLuint texture, GLenum target, GLuint width, GLuint height, GLenum format, GLenum type, const void* data)
+        {
+            ++g_stats.edits;
+            if (g_useDSA)
+            {
+                glTextureSubImage2D(texture, 0, 0, 0, width, height, format, type, data);
+            }
+            else
+            {
+                bindTextureForEdit(target, texture);
+                glTexSubImage2D(target, 0, 0, 0, width, height, format, type, data);
+                unbindTextureAfterEdit(target);
+            }
+        }
+
+        void generateMipmap(GLuint texture, GLenum target)
+        {
+            ++g_stats.edits;
+            if (g_useDSA)
+            {
+                glGenerateTextureMipmap(texture);
+            }
+            else
+            {
+                bindTextureForEdit(target, texture);
+                glGenerateMipmap(target);
+                unbindTextureAfterEdit(target);
+            }
+        }
+
+        void bindTexture(TextureSlot slot, GLenum target, GLuint texture)
+        {
+            ++g_stats.textureBinds;
+            if (g_useDSA)
+            {
+                glBindTextureUnit(Utils::getTextureID(slot), texture);
+            }
+            else
+            {
+                // The active unit goes back to TEmpty afterwards, which the raw binds elsewhere still rely on.
+                glActiveTexture(slot);
+                glBindTexture(target, texture);
+                ++g_stats.activeTextureChanges;
+                if (slot != TextureSlot::TEmpty)
+                {
+                    glActiveTexture(TextureSlot::TEmpty);
+                    ++g_stats.activeTextureChanges;
+                }
+            }
+        }
+
+        GLuint createRenderbuffer(GLenum format, GLuint width, GLuint height)
+        {
+            GLuint renderbuffer = 0;
+            if (g_useDSA)
+            {
+                glCreateRenderbuffers(1, &renderbuffer);
+            }
+            else
+            {
+                glGenRenderbuffers(1, &renderbuffer);
+            }
+            allocateRenderbuffer(renderbuffer, format, width, height);
+            return renderbuffer;
+        }
+
+        void allocateRenderbuffer(GLuint renderbuffer, GLenum format, GLuint width, GLuint height)
+        {
+            ++g_stats.edits;
+            if (g_useDSA)
+            {
+                glNamedRenderbufferStorage(renderbuffer, format, width, height);
+            }
+            else
+            {
+                glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+                glRenderbufferStorage(GL_RENDERBUFFER, format, width, height);
+                glBindRenderbuffer(GL_RENDERBUFFER, 0);
+                g_stats.renderbufferBinds += 2;
+            }
+        }
+
+        GLuint createFramebuffer()
+        {
+            GLuint framebuffer = 0;
+            if (g_useDSA)
+            {
+                glCreateFramebuffers(1, &framebuffer);
+            }
+            else
+            {
+                glGenFramebuffers(1, &framebuffer);
+            }
+            return framebuffer;
+        }
+
+        void attachTexture(GLuint framebuffer, GLenum attachment, GLuint texture)
+        {
+            ++g_stats.edits;
+            if (g_useDSA)
+            {
+                glNamedFramebufferTexture(framebuffer, attachment, texture, 0);
+            }
+            else
+            {
+                bindFramebufferForEdit(framebuffer);
+                glFramebufferTexture(GL_FRAMEBUFFER, attachment, texture, 0);
+                unbindFramebufferAfterEdit();
+            }
+        }
+
+        void attachRenderbuffer(GLuint framebuffer, GLenum attachment, GLuint renderbuffer)
+        {
+            ++g_stats.edits;
+            if (g_useDSA)
+            {
+                glNamedFramebufferRenderbuffer(framebuffer, attachment, GL_RENDERBUFFER, renderbuffer);
+            }
+            else
+            {
+                bindFramebufferForEdit(framebuffer);
+                glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, renderbuffer);
+                unbindFramebufferAfterEdit();
+            }
+        }
+
+        void setDrawBuffers(GLuint framebuffer, GLsizei count, const GLenum* buffers)
+        {
+            ++g_stats.edits;
+            if (g_useDSA)
+            {
+                glNamedFramebufferDrawBuffers(framebuffer, count, buffers);
+            }
+            else
+            {
+                bindFramebufferForEdit(framebuffer);
+                glDrawBuffers(count, buffers);
+                unbindFramebufferAfterEdit();
+            }
+        }
+
+        bool isComplete(GLuint framebuffer)
+        {
+            if (g_useDSA)
+            {
+                return glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+            }
+
+            bindFramebufferForEdit(framebuffer);
+            const auto status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            unbindFramebufferAfterEdit();
+            return status == GL_FRAMEBUFFER_COMPLETE;
+        }
+
+        GLuint createBuffer(size_t bytes, const void* data, GLenum usage)
+        {
+            GLuint buffer = 0;
+            if (g_useDSA)
+            {
+                glCreateBuffers(1, &buffer);
+            }
+            else
+            {
+                glGenBuffers(1, &buffer);
+            }
+            allocateBuffer(buffer, bytes, data, usage);
+            return buffer;
+        }
+
+        void allocateBuffer(GLuint buffer, size_t bytes, const void* data, GLenum usage)
+        {
+            ++g_stats.edits;
+            if (g_useDSA)
+            {
+                glNamedBufferData(buffer, bytes, data, usage);
+            }
+            else
+            {
+                bindBufferForEdit(buffer);
+                glBufferData(GL_COPY_WRITE_BUFFER, bytes, data, usage);
+                unbindBufferAfterEdit();
+            }
+        }
+
+        void updateBuffer(GLuint buffer, size_t offset, size_t bytes, const void* data)
+        {
+            ++g_stats.edits;
+            if (g_useDSA)
+            {
+                glNamedBufferSubData(buffer, offset, bytes, data);
+            }
+            else
+            {
+                bindBufferForEdit(buffer);
+                glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+                unbindBufferAfterEdit();
+            }
+        }
+    }
+}
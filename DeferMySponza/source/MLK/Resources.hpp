@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Utils.hpp"
+
+#include <tgl/tgl.h>
+
+namespace MLK
+{
+    /// <summary>
+    /// Binds made by the resource layer over a frame, both to use objects and to edit them. Edits are counted
+    /// apart so the two paths can be compared on the same work. Binds the passes make with GL directly, such as
+    /// their render target framebuffers, aren't included.
+    /// </summary>
+    struct ResourceBindStats
+    {
+        GLuint edits = 0;
+        GLuint textureBinds = 0;
+        GLuint activeTextureChanges = 0;
+        GLuint bufferBinds = 0;
+        GLuint framebufferBinds = 0;
+        GLuint renderbufferBinds = 0;
+    };
+
+    /// <summary>
+    /// Creates, edits and binds textures, buffers and framebuffers by name with GL 4.5 direct state access, so
+    /// editing an object never disturbs what's bound for drawing. Without 4.5 each edit falls back to binding the
+    /// object to a target nothing draws from, editing it and unbinding it again: textures on TEmpty, buffers on
+    /// the copy write target and framebuffers on the framebuffer target. Textures are given immutable storage on
+    /// both paths, so they're recreated rather than respecified to change size.
+    /// </summary>
+    namespace Resources
+    {
+        /// <summary>
+        /// Picks direct state access when the context has GL 4.5. Must be called before anything is created.
+        /// </summary>
+        void init();
+
+        bool isDSAAvailable();
+        bool usesDSA();
+
+        /// <summary>
+        /// Switches between direct state access and the bind to edit fallback, ignored without GL 4.5.
+        /// </summary>
+        void setUseDSA(bool useDSA);
+
+        /// <summary>
+        /// Rolls the bind counts over to the last frame's and starts counting afresh.
+        /// </summary>
+        void beginFrame();
+
+        const ResourceBindStats& getStats();
+
+        void printStats();
+
+        /// <summary>
+        /// Create a texture with immutable storage for <levels> mip levels of <format>.
+        /// </summary>
+        GLuint createTexture(GLenum target, GLenum format, GLuint width, GLuint height, GLuint levels = 1);
+
+        /// <summary>
+        /// Set the min and mag <filter> and S and T <wrap> of a texture together.
+        /// </summary>
+        void setSampling(GLuint texture, GLenum target, GLint filter, GLint wrap);
+
+        void setParameter(GLuint texture, GLenum target, GLenum name, GLint value);
+
+        /// <summary>
+        /// Copy <data> over the whole of a texture's first level.
+        /// </summary>
+        void uploadTexture(GLuint texture, GLenum target, GLuint width, GLuint height, GLenum format, GLenum type, const void* data);
+
+        void generateMipmap(GLuint texture, GLenum target);
+
+        /// <summary>
+        /// Bind a texture for sampling in <slot>, 0 unbinding the slot. The active unit is left on TEmpty.
+        /// </summary>
+        void bindTexture(TextureSlot slot, GLenum target, GLuint texture);
+
+        GLuint createRenderbuffer(GLenum format, GLuint width, GLuint height);
+
+        /// <summary>
+        /// Respecify a renderbuffer's storage, which unlike a texture's stays mutable.
+        /// </summary>
+        void allocateRenderbuffer(GLuint renderbuffer, GLenum format, GLuint width, GLuint height);
+
+        GLuint createFramebuffer();
+
+        void attachTexture(GLuint framebuffer, GLenum attachment, GLuint texture);
+
+        void attachRenderbuffer(GLuint framebuffer, GLenum attachment, GLuint renderbuffer);
+
+        void setDrawBuffers(GLuint framebuffer, GLsizei count, const GLenum* buffers);
+
+        bool isComplete(GLuint framebuffer);
+
+        /// <summary>
+        /// Create a buffer of <bytes> with mutable storage, so it can be orphaned with allocateBuffer.
+        /// </summary>
+        GLuint createBuffer(size_t bytes, const void* data, GLenum usage);
+
+        void allocateBuffer(GLuint buffer, size_t bytes, const void* data, GLenum usage);
+
+        void updateBuffer(GLuint buffer, size_t offset, size_t bytes, const void* data);
+    }
+}
@@ -5,71 +5,48 @@
 #include "../ShaderManager.hpp"
 #include "../MeshManager.hpp"
 #include "../Utils.hpp"
+#include "../Resources.hpp"
 #include "AreaTex.h"
 #include "SearchTex.h"
 
 namespace MLK
 {
+	namespace
+	{
+		// A clamped, linearly filtered texture, as every SMAA texture is sampled.
+		GLuint createTexture(GLenum format, GLuint width, GLuint height)
+		{
+			const auto texture = Resources::createTexture(GL_TEXTURE_2D, format, width, height);
+			Resources::setSampling(texture, GL_TEXTURE_2D, GL_LINEAR, GL_CLAMP_TO_EDGE);
+			return texture;
+		}
+	}
+
 	SMAA::SMAA(ShaderManager* shaderManager, GlStateManager* stateManager, MeshManager* meshManager,
 		GLuint width, GLuint height) :
 		m_shaderManager(shaderManager), m_stateManager(stateManager), m_meshManager(meshManager),
-		m_width(width), m_height(height)
+		m_width(width), m_height(height), m_capacityWidth(width), m_capacityHeight(height)
 	{
-		// Prepare edge texture.
-		glGenTextures(1, &m_edgeTex);
-		glBindTexture(GL_TEXTURE_2D, m_edgeTex);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_width, m_height, 0, GL_RGBA, GL_BYTE, 0);
-
-		// Prepare blend texture.
-		glGenTextures(1, &m_blendTex);
-		glBindTexture(GL_TEXTURE_2D, m_blendTex);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_width, m_height, 0, GL_RGBA, GL_BYTE, 0);
-
-		// Shared stencil for optimisation.
-		glGenRenderbuffers(1, &m_stencil);
-		glBindRenderbuffer(GL_RENDERBUFFER, m_stencil);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_STENCIL_INDEX8, m_width, m_height);
+		// Edge and blend targets share a stencil for optimisation.
+		m_edgeFbo = Resources::createFramebuffer();
+		m_blendFbo = Resources::createFramebuffer();
+		m_stencil = Resources::createRenderbuffer(GL_STENCIL_INDEX8, m_capacityWidth, m_capacityHeight);
+		Resources::attachRenderbuffer(m_edgeFbo, GL_STENCIL_ATTACHMENT, m_stencil);
+		Resources::attachRenderbuffer(m_blendFbo, GL_STENCIL_ATTACHMENT, m_stencil);
 
 		// Load in area texture.
-		glGenTextures(1, &m_areaTex);
-		glBindTexture(GL_TEXTURE_2D, m_areaTex);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, (GLsizei)AREATEX_WIDTH, (GLsizei)AREATEX_HEIGHT, 0, GL_RG, GL_UNSIGNED_BYTE, areaTexBytes);
-		
-		// Load in search texture.
-		glGenTextures(1, &m_searchTex);
-		glBindTexture(GL_TEXTURE_2D, m_searchTex);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, (GLsizei)SEARCHTEX_WIDTH, (GLsizei)SEARCHTEX_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, searchTexBytes); 
-
-		// Draw buffers.
-		glGenFramebuffers(1, &m_edgeFbo);
-		glBindFramebuffer(GL_FRAMEBUFFER, m_edgeFbo);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_edgeTex, 0);
-		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_stencil);
+		m_areaTex = createTexture(GL_RG8, (GLuint)AREATEX_WIDTH, (GLuint)AREATEX_HEIGHT);
+		Resources::uploadTexture(m_areaTex, GL_TEXTURE_2D, (GLuint)AREATEX_WIDTH, (GLuint)AREATEX_HEIGHT, GL_RG, GL_UNSIGNED_BYTE, areaTexBytes);
 
-		glGenFramebuffers(1, &m_blendFbo);
-		glBindFramebuffer(GL_FRAMEBUFFER, m_blendFbo);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_blendTex, 0);
-		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_stencil);
-
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glBindRenderbuffer(GL_RENDERBUFFER, 0);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		// Load in search texture.
+		m_searchTex = createTexture(GL_R8, (GLuint)SEARCHTEX_WIDTH, (GLuint)SEARCHTEX_HEIGHT);
+		Resources::uploadTexture(m_searchTex, GL_TEXTURE_2D, (GLuint)SEARCHTEX_WIDTH, (GLuint)SEARCHTEX_HEIGHT, GL_RED, GL_UNSIGNED_BYTE, searchTexBytes);
+
+		// Tile list for the compute path.
+		m_tileBuffer = Resources::createBuffer(0, nullptr, GL_DYNAMIC_DRAW);
+		allocateTargets();
+		updateTileCounts();
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, StorageBufferId::SMAATiles, m_tileBuffer);
 	}
 
 	SMAA::~SMAA()
@@ -83,37 +60,70 @@ namespace MLK
         
         glDeleteFramebuffers(1, &m_edgeFbo);
         glDeleteFramebuffers(1, &m_blendFbo);
+
+        glDeleteBuffers(1, &m_tileBuffer);
 	}
 
-	void SMAA::runSMAA(GLuint input)
+	void SMAA::runSMAA(GLuint input, GLuint outputFbo, float exposure)
 	{
 		edgePass(input);
         weightPass();
-        neighbourhoodPass(input);
+        neighbourhoodPass(input, outputFbo, exposure);
+	}
+
+	void SMAA::runComputeSMAA(GLuint input, GLuint inputFbo, GLuint outputFbo, float exposure)
+	{
+		// Dispatch X and draw instance count start at zero and are grown by the edge pass as it appends tiles.
+		const GLuint resetArgs[] = { 0, 1, 1, 4, 0, 0, 0 };
+		Resources::updateBuffer(m_tileBuffer, 0, sizeof(resetArgs), resetArgs);
+
+		edgeComputePass(input);
+		weightComputePass();
+		tileResolvePass(input, inputFbo, outputFbo, exposure);
 	}
 
     void SMAA::resizeBuffers(GLuint width, GLuint height)
     {
-		if (width != m_width || height != m_height)
-		{
-			m_width = width;
-			m_height = height;
+		assert(width <= m_capacityWidth && height <= m_capacityHeight);
 
-			glActiveTexture(TextureSlot::TEmpty);
-
-			glBindTexture(GL_TEXTURE_2D, m_edgeTex);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_BYTE, 0);
+		m_width = width;
+		m_height = height;
+		updateTileCounts();
+    }
 
-			glBindTexture(GL_TEXTURE_2D, m_blendTex);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_BYTE, 0);
+	void SMAA::setCapacity(GLuint width, GLuint height)
+	{
+		if (width != m_capacityWidth || height != m_capacityHeight)
+		{
+			m_capacityWidth = width;
+			m_capacityHeight = height;
+			allocateTargets();
+		}
+	}
 
-			glBindRenderbuffer(GL_RENDERBUFFER, m_stencil);
-			glRenderbufferStorage(GL_RENDERBUFFER, GL_STENCIL_INDEX8, width, height);
+	void SMAA::updateTileCounts()
+	{
+		m_tileCountX = (m_width + g_smaaTileSize - 1) / g_smaaTileSize;
+		m_tileCountY = (m_height + g_smaaTileSize - 1) / g_smaaTileSize;
+	}
 
-			glBindTexture(GL_TEXTURE_2D, 0);
-			glBindRenderbuffer(GL_RENDERBUFFER, 0);
-		}
-    }
+	void SMAA::allocateTargets()
+	{
+		// Storage is immutable, so the targets are replaced to resize and attached again.
+		glDeleteTextures(1, &m_edgeTex);
+		glDeleteTextures(1, &m_blendTex);
+		m_edgeTex = createTexture(GL_RGBA8, m_capacityWidth, m_capacityHeight);
+		m_blendTex = createTexture(GL_RGBA8, m_capacityWidth, m_capacityHeight);
+		Resources::attachTexture(m_edgeFbo, GL_COLOR_ATTACHMENT0, m_edgeTex);
+		Resources::attachTexture(m_blendFbo, GL_COLOR_ATTACHMENT0, m_blendTex);
+		Resources::allocateRenderbuffer(m_stencil, GL_STENCIL_INDEX8, m_capacityWidth, m_capacityHeight);
+
+		// 3 dispatch arguments and 4 draw arguments precede the tiles, room is left for every tile of the capacity.
+		const auto tilesX = (m_capacityWidth + g_smaaTileSize - 1) / g_smaaTileSize;
+		const auto tilesY = (m_capacityHeight + g_smaaTileSize - 1) / g_smaaTileSize;
+		const auto size = (7 + tilesX * tilesY) * sizeof(GLuint);
+		Resources::allocateBuffer(m_tileBuffer, size, nullptr, GL_DYNAMIC_DRAW);
+	}
 
 	void SMAA::edgePass(GLuint input)
 	{
@@ -124,9 +134,7 @@ namespace MLK
 
         glClear(GL_COLOR_BUFFER_BIT);
 
-		glActiveTexture(TextureSlot::TInput);
-		glBindTexture(GL_TEXTURE_2D, input);
-        glGenerateMipmap(GL_TEXTURE_2D);
+		Resources::bindTexture(TextureSlot::TInput, GL_TEXTURE_2D, input);
 
 		m_meshManager->drawMeshGroup(MeshGroup::Quad);
 	}
@@ -140,33 +148,100 @@ namespace MLK
 
 		glClear(GL_COLOR_BUFFER_BIT);
         
-		glActiveTexture(TextureSlot::TInput);
-		glBindTexture(GL_TEXTURE_2D, m_edgeTex);
-		glActiveTexture(TextureSlot::TArea);
-		glBindTexture(GL_TEXTURE_2D, m_areaTex);
-		glActiveTexture(TextureSlot::TSearch);
-		glBindTexture(GL_TEXTURE_2D, m_searchTex);
+		Resources::bindTexture(TextureSlot::TInput, GL_TEXTURE_2D, m_edgeTex);
+		Resources::bindTexture(TextureSlot::TArea, GL_TEXTURE_2D, m_areaTex);
+		Resources::bindTexture(TextureSlot::TSearch, GL_TEXTURE_2D, m_searchTex);
 
 		m_meshManager->drawMeshGroup(MeshGroup::Quad);
 	}
 
-	void SMAA::neighbourhoodPass(GLuint input)
+	void SMAA::neighbourhoodPass(GLuint input, GLuint outputFbo, float exposure)
 	{
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFbo);
 
 		m_shaderManager->useProgram(ShaderProgram::Resolve);
         m_stateManager->setState(DrawPass::SMAAResolve);
+        Utils::setExposure(m_shaderManager->getUniformLocation(ShaderProgram::Resolve, UniformId::UExposure), exposure);
 
-		glActiveTexture(TextureSlot::TInput);
-		glBindTexture(GL_TEXTURE_2D, input);
-		glActiveTexture(TextureSlot::TSearch);
-		glBindTexture(GL_TEXTURE_2D, m_blendTex);
+		Resources::bindTexture(TextureSlot::TInput, GL_TEXTURE_2D, input);
+		Resources::bindTexture(TextureSlot::TSearch, GL_TEXTURE_2D, m_blendTex);
 
 		m_meshManager->drawMeshGroup(MeshGroup::Quad);
 
-        glActiveTexture(TextureSlot::TInput);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glActiveTexture(TextureSlot::TSearch);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        Resources::bindTexture(TextureSlot::TInput, GL_TEXTURE_2D, 0);
+        Resources::bindTexture(TextureSlot::TSearch, GL_TEXTURE_2D, 0);
+	}
+
+	void SMAA::edgeComputePass(GLuint input)
+	{
+		m_shaderManager->useProgram(ShaderProgram::EdgeCompute);
+
+		Resources::bindTexture(TextureSlot::TInput, GL_TEXTURE_2D, input);
+		glBindImageTexture(ImageUnit::IOutput, m_edgeTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+		// Every tile is visited so edges outside the compacted tiles are still cleared for the weight searches.
+		glDispatchCompute(m_tileCountX, m_tileCountY, 1);
+
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+	}
+
+	void SMAA::weightComputePass()
+	{
+		// Tiles without edges are never written so the weights have to be cleared.
+		glBindFramebuffer(GL_FRAMEBUFFER, m_blendFbo);
+		m_stateManager->setState(DrawPass::SMAAResolve);
+		glClear(GL_COLOR_BUFFER_BIT);
+
+		m_shaderManager->useProgram(ShaderProgram::BlendCompute);
+
+		Resources::bindTexture(TextureSlot::TInput, GL_TEXTURE_2D, m_edgeTex);
+		Resources::bindTexture(TextureSlot::TArea, GL_TEXTURE_2D, m_areaTex);
+		Resources::bindTexture(TextureSlot::TSearch, GL_TEXTURE_2D, m_searchTex);
+		glBindImageTexture(ImageUnit::IOutput, m_blendTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+		glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, m_tileBuffer);
+		glDispatchComputeIndirect(0);
+		glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+
+	void SMAA::tileResolvePass(GLuint input, GLuint inputFbo, GLuint outputFbo, float exposure)
+	{
+		// Anything outside the edge tiles resolves to the input, so copy it and only shade the edge tiles on top.
+		// A tonemapped copy has to be drawn as a blit can't tonemap.
+		Resources::bindTexture(TextureSlot::TInput, GL_TEXTURE_2D, input);
+
+		if (exposure > 0.f)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, outputFbo);
+			m_shaderManager->useProgram(ShaderProgram::Present);
+			m_stateManager->setState(DrawPass::PresentPass);
+			Utils::setExposure(m_shaderManager->getUniformLocation(ShaderProgram::Present, UniformId::UExposure), exposure);
+			glUniform2f(m_shaderManager->getUniformLocation(ShaderProgram::Present, UniformId::UInputScale),
+				(float)m_width / m_capacityWidth, (float)m_height / m_capacityHeight);
+			m_meshManager->drawMeshGroup(MeshGroup::Quad);
+		}
+		else
+		{
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, inputFbo);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, outputFbo);
+			glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			glBindFramebuffer(GL_FRAMEBUFFER, outputFbo);
+		}
+
+		m_shaderManager->useProgram(ShaderProgram::ResolveTiles);
+		m_stateManager->setState(DrawPass::SMAAResolve);
+		Utils::setExposure(m_shaderManager->getUniformLocation(ShaderProgram::ResolveTiles, UniformId::UExposure), exposure);
+		Resources::bindTexture(TextureSlot::TSearch, GL_TEXTURE_2D, m_blendTex);
+
+		// One instanced quad per edge tile, the instance count having been written by the edge pass.
+		m_meshManager->bindMeshGroup(MeshGroup::Quad);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_tileBuffer);
+		glDrawArraysIndirect(GL_TRIANGLE_FAN, TGL_BUFFER_OFFSET(3 * sizeof(GLuint)));
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+		Resources::bindTexture(TextureSlot::TInput, GL_TEXTURE_2D, 0);
+		Resources::bindTexture(TextureSlot::TSearch, GL_TEXTURE_2D, 0);
 	}
-}
\ No newline at end of file
+}
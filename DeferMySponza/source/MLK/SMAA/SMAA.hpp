@@ -1,9 +1,12 @@
 #pragma once
 
-#include <tgl/tgl.h>
+#include "../Utils.hpp"
 
 namespace MLK
 {
+	// Width and height in pixels of a compute SMAA tile, must match SMAA_TILE_SIZE in SMAACompute.glsl.
+	const GLuint g_smaaTileSize = 8;
+
 	class ShaderManager;
 	class GlStateManager;
 	class MeshManager;
@@ -23,14 +26,34 @@ namespace MLK
 			GLuint height = 720);
 		~SMAA();
 
-        // SMAA should be the final step so output to screen by default.
-		void runSMAA(GLuint input);
+        // SMAA should be the final step so output to screen by default. A non zero <exposure> tonemaps the
+        // neighbourhood resolve.
+		void runSMAA(GLuint input, GLuint outputFbo = 0, float exposure = 0.f);
+
+        // Compute path that only runs blending weights and the resolve on tiles containing edges. Tiles without
+        // edges are copied from <inputFbo> unchanged.
+        void runComputeSMAA(GLuint input, GLuint inputFbo, GLuint outputFbo = 0, float exposure = 0.f);
+
+        // Sets the size rendered at, which must fit the capacity. Nothing is reallocated.
         void resizeBuffers(GLuint width, GLuint height);
 
+        // Replaces the targets and tile list with ones holding <width> by <height>.
+        void setCapacity(GLuint width, GLuint height);
+
 	private:
 		void edgePass(GLuint input);
 		void weightPass();
-		void neighbourhoodPass(GLuint input);
+		void neighbourhoodPass(GLuint input, GLuint outputFbo, float exposure);
+
+		void edgeComputePass(GLuint input);
+		void weightComputePass();
+		void tileResolvePass(GLuint input, GLuint inputFbo, GLuint outputFbo, float exposure);
+
+		// Tiles covering the render size, dispatched and drawn each frame.
+		void updateTileCounts();
+
+		// Replaces the edge and blend textures, stencil and tile list with ones of the current capacity.
+		void allocateTargets();
 
 	private:
 		ShaderManager* m_shaderManager;
@@ -38,13 +61,20 @@ namespace MLK
 		MeshManager* m_meshManager;
 		GLuint m_width = 1280;
 		GLuint m_height = 720;
+		GLuint m_capacityWidth = 1280;
+		GLuint m_capacityHeight = 720;
+
+		GLuint m_edgeFbo = 0;
+		GLuint m_blendFbo = 0;
+		GLuint m_stencil = 0;
+		GLuint m_edgeTex = 0;
+		GLuint m_blendTex = 0;
+		GLuint m_areaTex = 0;
+		GLuint m_searchTex = 0;
 
-		GLuint m_edgeFbo;
-		GLuint m_blendFbo;
-		GLuint m_stencil;
-		GLuint m_edgeTex;
-		GLuint m_blendTex;
-		GLuint m_areaTex;
-		GLuint m_searchTex;
+		// Indirect dispatch/draw arguments followed by the list of tiles with edges.
+		GLuint m_tileBuffer = 0;
+		GLuint m_tileCountX = 0;
+		GLuint m_tileCountY = 0;
 	};
 }
\ No newline at end of file
@@ -15,30 +15,28 @@ namespace MLK
     };
 
 	/// <summary>
+    /// Screen space reflections. The pass composites reflections over its input itself, so it can write to any
+    /// target without the input first being copied there.
     /// </summary>
 	class SSR
 	{
 	public:
         SSR(ShaderManager* shaderManager, 
             GlStateManager* stateManager, 
-            MeshManager* meshManager,
-			GLuint width = 1280,
-			GLuint height = 720);
+            MeshManager* meshManager);
 		~SSR();
 
-        void run(GLuint& inputTex, GLuint inputDepth, GLuint inputFBO);
-        void resize(GLuint width, GLuint height);
+        // A non zero <exposure> tonemaps the output, for when SSR is the pass presenting to the screen.
+        void run(GLuint inputTex, GLuint inputDepth, GLuint outputFbo, float exposure = 0.f);
+
+        // Number of ray march steps, fewer steps shorten reflections but cost less.
+        void setStepCount(GLuint stepCount);
 
     private:
         ShaderManager* m_shaderManager;
         GlStateManager* m_stateManager;
         MeshManager* m_meshManager;
 
-        GLuint m_outputFbo;
-        GLuint m_outputTex;
-		GLuint m_outputStencil;
-
-		GLuint m_width;
-		GLuint m_height;
+        GLuint m_stepCount = 100;
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,134 @@
+#include "SceneBounds.hpp"
+#include "JobSystem.hpp"
+
+#include <sponza/sponza.hpp>
+#include <sponza/GeometryBuilder.hpp>
+
+#include <algorithm>
+
+namespace MLK
+{
+    SceneBounds::SceneBounds(const sponza::Context& scene) :
+        m_scene(scene)
+    {
+        // Spheres around each mesh's bounding box, loose but cheap to transform. The builder's named, a temporary's
+        // meshes wouldn't outlive the start of the loop.
+        const sponza::GeometryBuilder geometry;
+        for (const auto& mesh : geometry.getAllMeshes())
+        {
+            const auto& positions = mesh.getPositionArray();
+            if (positions.empty())
+            {
+                continue;
+            }
+
+            glm::vec3 minimum = (const glm::vec3&)positions[0];
+            glm::vec3 maximum = minimum;
+            for (const auto& position : positions)
+            {
+                minimum = glm::min(minimum, (const glm::vec3&)position);
+                maximum = glm::max(maximum, (const glm::vec3&)position);
+            }
+
+            if (m_meshBounds.size() <= mesh.getId())
+            {
+                m_meshBounds.resize(mesh.getId() + 1, glm::vec4(0.f));
+                m_meshBoxes.resize(mesh.getId() + 1);
+            }
+            m_meshBounds[mesh.getId()] = glm::vec4((minimum + maximum) * 0.5f, glm::length(maximum - minimum) * 0.5f);
+            m_meshBoxes[mesh.getId()].minimum = minimum;
+            m_meshBoxes[mesh.getId()].maximum = maximum;
+        }
+    }
+
+    void SceneBounds::update(JobSystem& jobs, const sponza::SceneChanges& changes)
+    {
+        const auto transforms = m_scene.getInstanceTransforms();
+        const auto meshIds = m_scene.getInstanceMeshIds();
+
+        // Nothing has moved on the first update, there's no earlier state for it to have moved from.
+        const bool hasPrevious = m_transforms.size() == transforms.size();
+        if (!hasPrevious)
+        {
+            m_instanceBounds.assign(transforms.size(), glm::vec4(0.f));
+            m_instanceBoxes.assign(transforms.size(), BoundingBox());
+            m_transforms.assign(transforms.size(), glm::mat4(0.f));
+            m_instanceSpheres.resize(transforms.size());
+        }
+
+        m_updated.clear();
+        const bool rebuild = changes.everything || !hasPrevious;
+        if (rebuild)
+        {
+            for (GLuint i = 0; i < (GLuint)transforms.size(); ++i)
+            {
+                m_updated.push_back(i);
+            }
+        }
+        else
+        {
+            for (const auto& range : changes.instances)
+            {
+                const auto end = std::min(range.first + range.count, transforms.size());
+                for (auto i = range.first; i < end; ++i)
+                {
+                    m_updated.push_back((GLuint)i);
+                }
+            }
+        }
+
+        m_previousBounds.resize(m_updated.size());
+        m_moved.resize(m_updated.size());
+
+        jobs.parallelFor("Scene bounds", m_updated.size(), 1024, [&](size_t begin, size_t end)
+        {
+            for (auto u = begin; u < end; ++u)
+            {
+                const auto i = m_updated[u];
+                const auto& model = glm::mat4((const glm::mat4x3&)transforms[i]);
+                const auto meshId = meshIds[i];
+                const auto local = meshId < m_meshBounds.size() ? m_meshBounds[meshId] : glm::vec4(0.f);
+
+                const auto scale = std::max(glm::length(glm::vec3(model[0])),
+                    std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+                m_moved[u] = hasPrevious && model != m_transforms[i];
+                m_previousBounds[u] = m_instanceBounds[i];
+                m_instanceBounds[i] = glm::vec4(glm::vec3(model * glm::vec4(glm::vec3(local), 1.f)), local.w * scale);
+                m_instanceSpheres.set(i, m_instanceBounds[i]);
+                m_transforms[i] = model;
+
+                // The box around the transformed mesh box, its half extents projected onto each world axis.
+                const auto& box = meshId < m_meshBoxes.size() ? m_meshBoxes[meshId] : BoundingBox();
+                const auto centre = glm::vec3(model * glm::vec4((box.minimum + box.maximum) * 0.5f, 1.f));
+                const auto halfSize = (box.maximum - box.minimum) * 0.5f;
+                const auto extent = glm::abs(glm::vec3(model[0])) * halfSize.x + glm::abs(glm::vec3(model[1])) * halfSize.y +
+                    glm::abs(glm::vec3(model[2])) * halfSize.z;
+                m_instanceBoxes[i].minimum = centre - extent;
+                m_instanceBoxes[i].maximum = centre + extent;
+            }
+        });
+
+        // Gathered in instance order once every chunk is done, so the list is the same however it was split.
+        m_movedBounds.clear();
+        m_movedInstances.clear();
+        for (size_t u = 0; u < m_updated.size(); ++u)
+        {
+            if (m_moved[u])
+            {
+                m_movedBounds.push_back(m_previousBounds[u]);
+                m_movedBounds.push_back(m_instanceBounds[m_updated[u]]);
+                m_movedInstances.push_back(m_updated[u]);
+            }
+        }
+
+        if (rebuild)
+        {
+            m_bvh.build(m_instanceBoxes);
+        }
+        else if (!m_movedInstances.empty())
+        {
+            m_bvh.refit(m_instanceBoxes, m_movedInstances);
+        }
+    }
+}
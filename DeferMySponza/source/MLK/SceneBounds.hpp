@@ -0,0 +1,76 @@
+#pragma once
+
+#include "FrustumCuller.hpp"
+#include "InstanceBVH.hpp"
+
+#include <tgl/tgl.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace sponza
+{
+    class Context;
+    struct SceneChanges;
+}
+
+namespace MLK
+{
+    class JobSystem;
+
+    /// <summary>
+    /// World bounding spheres of the scene's instances, centre in xyz and radius in w, kept in the same order as
+    /// the per frame instance data. Only instances the scene's change journal reports changed are recomputed, and
+    /// those whose transform changed since the last update are reported so cached views of the scene, such as
+    /// shadow maps, know what to refresh. World boxes of the instances are kept in a hierarchy for spatial
+    /// queries, rebuilt when every instance is recomputed and otherwise refitted over just the ones that moved.
+    /// </summary>
+    class SceneBounds
+    {
+    public:
+        SceneBounds(const sponza::Context& scene);
+
+        // Recomputes the world bounds of the instances in <changes> from their current transforms, split across
+        // <jobs>. Every instance is recomputed when the changes aren't known.
+        void update(JobSystem& jobs, const sponza::SceneChanges& changes);
+
+        const std::vector<glm::vec4>& getInstanceBounds() const { return m_instanceBounds; }
+
+        // The same spheres split into component arrays for batched culling.
+        const SphereBoundsSoA& getInstanceSpheres() const { return m_instanceSpheres; }
+
+        // Instances that moved in the last update, both where they were and where they are now.
+        const std::vector<glm::vec4>& getMovedBounds() const { return m_movedBounds; }
+
+        // Ascending ids of the instances that moved in the last update.
+        const std::vector<GLuint>& getMovedInstances() const { return m_movedInstances; }
+
+        const std::vector<BoundingBox>& getInstanceBoxes() const { return m_instanceBoxes; }
+
+        const InstanceBVH& getBVH() const { return m_bvh; }
+
+        // Instances recomputed in the last update.
+        size_t getUpdatedCount() const { return m_updated.size(); }
+
+    private:
+        const sponza::Context& m_scene;
+
+        // Bounding spheres and boxes of each mesh in model space, indexed by mesh id.
+        std::vector<glm::vec4> m_meshBounds;
+        std::vector<BoundingBox> m_meshBoxes;
+
+        std::vector<glm::vec4> m_instanceBounds;
+        std::vector<BoundingBox> m_instanceBoxes;
+        SphereBoundsSoA m_instanceSpheres;
+        std::vector<glm::mat4> m_transforms;
+
+        // Instances recomputed in the last update, with their bounds beforehand and whether they moved.
+        std::vector<GLuint> m_updated;
+        std::vector<glm::vec4> m_previousBounds;
+        std::vector<GLubyte> m_moved;
+        std::vector<glm::vec4> m_movedBounds;
+        std::vector<GLuint> m_movedInstances;
+
+        InstanceBVH m_bvh;
+    };
+}
@@ -10,6 +10,10 @@ namespace MLK
 
     std::string ShaderManager::s_shaderStructures = "";
     std::string ShaderManager::s_smaaFunctions = "";
+    std::string ShaderManager::s_smaaComputeFunctions = "";
+    std::string ShaderManager::s_tonemapFunctions = "";
+    std::string ShaderManager::s_shaderStructures400 = "";
+    std::string ShaderManager::s_shaderStructures420 = "";
 
     ShaderManager::ShaderManager()
     {
@@ -21,6 +25,29 @@ namespace MLK
         {
             s_smaaFunctions = tygra::createStringFromFile("resource:///SMAA.glsl");
         }
+        if (s_smaaComputeFunctions.empty())
+        {
+            // Compute SMAA needs GLSL 4.3, so the SMAA functions follow the compute header in place of their own #version.
+            const auto versionEnd = s_smaaFunctions.find('\n');
+            s_smaaComputeFunctions = tygra::createStringFromFile("resource:///SMAACompute.glsl") + "\n" + s_smaaFunctions.substr(versionEnd + 1);
+        }
+
+        if (s_tonemapFunctions.empty())
+        {
+            s_tonemapFunctions = tygra::createStringFromFile("resource:///Tonemap.glsl");
+        }
+        if (s_shaderStructures400.empty())
+        {
+            // Cube map array shadow samplers need GLSL 4.0.
+            const auto versionEnd = s_shaderStructures.find('\n');
+            s_shaderStructures400 = "#version 400\n" + s_shaderStructures.substr(versionEnd + 1);
+        }
+        if (s_shaderStructures420.empty())
+        {
+            // Image stores from a fragment shader need GLSL 4.2.
+            const auto versionEnd = s_shaderStructures.find('\n');
+            s_shaderStructures420 = "#version 420\n" + s_shaderStructures.substr(versionEnd + 1);
+        }
 
         m_currentProgram = ShaderProgram::NoProgram;
 
@@ -48,27 +75,49 @@ namespace MLK
         m_shaders[ShaderId::QuadVS] = SU::createShader(GL_VERTEX_SHADER, tygra::createStringFromFile("resource:///QuadVS.glsl"));
         m_shaders[ShaderId::LightVolumeVS] = SU::createShader(GL_VERTEX_SHADER, tygra::createStringFromFile("resource:///LightVolumeVS.glsl"), s_shaderStructures);
         m_shaders[ShaderId::ShadowsVS] = SU::createShader(GL_VERTEX_SHADER, tygra::createStringFromFile("resource:///ShadowVS.glsl"), s_shaderStructures);
+        m_shaders[ShaderId::PresentVS] = SU::createShader(GL_VERTEX_SHADER, tygra::createStringFromFile("resource:///PresentVS.glsl"));
 
         // SMAA
         m_shaders[ShaderId::EdgeVS] = SU::createShader(GL_VERTEX_SHADER, tygra::createStringFromFile("resource:///EdgeVS.glsl"), s_smaaFunctions);
         m_shaders[ShaderId::BlendVS] = SU::createShader(GL_VERTEX_SHADER, tygra::createStringFromFile("resource:///BlendVS.glsl"), s_smaaFunctions);
         m_shaders[ShaderId::ResolveVS] = SU::createShader(GL_VERTEX_SHADER, tygra::createStringFromFile("resource:///ResolveVS.glsl"), s_smaaFunctions);
+        m_shaders[ShaderId::ResolveTilesVS] = SU::createShader(GL_VERTEX_SHADER, tygra::createStringFromFile("resource:///ResolveTilesVS.glsl"), s_smaaComputeFunctions);
 
         // Fragment Shaders.
         m_shaders[ShaderId::AmbientFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///AmbientFS.glsl"), s_shaderStructures);
         m_shaders[ShaderId::PointFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///PointLightFS.glsl"), s_shaderStructures);
+        m_shaders[ShaderId::PointShadowLightFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///PointLightFS.glsl"), s_shaderStructures400 + "#define POINT_SHADOW\n");
         m_shaders[ShaderId::SpotFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///SpotLightFS.glsl"), s_shaderStructures);
         m_shaders[ShaderId::SpotShadowFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///SpotShadowFS.glsl"), s_shaderStructures);
+        m_shaders[ShaderId::SpotShadowPCFFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///SpotShadowFS.glsl"), s_shaderStructures + "#define SHADOW_PCF\n");
+        m_shaders[ShaderId::SpotShadowEVSMFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///SpotShadowFS.glsl"), s_shaderStructures + "#define SHADOW_EVSM\n");
         m_shaders[ShaderId::GBufferFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///GBufferFS.glsl"), s_shaderStructures);
         m_shaders[ShaderId::ShadowsFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///ShadowFS.glsl"));
+        m_shaders[ShaderId::ShadowMomentsFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///ShadowMomentsFS.glsl"));
+        m_shaders[ShaderId::ShadowBlurFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///ShadowBlurFS.glsl"));
+
+        // Point shadows, layered through geometry shader instancing or one face at a time.
+        m_shaders[ShaderId::PointShadowVS] = SU::createShader(GL_VERTEX_SHADER, tygra::createStringFromFile("resource:///PointShadowVS.glsl"), s_shaderStructures);
+        m_shaders[ShaderId::PointShadowFaceVS] = SU::createShader(GL_VERTEX_SHADER, tygra::createStringFromFile("resource:///PointShadowVS.glsl"), s_shaderStructures + "#define SINGLE_FACE\n");
+        m_shaders[ShaderId::PointShadowGS] = SU::createShader(GL_GEOMETRY_SHADER, tygra::createStringFromFile("resource:///PointShadowGS.glsl"));
+        m_shaders[ShaderId::PointShadowFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///PointShadowFS.glsl"));
+        m_shaders[ShaderId::PresentFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///PresentFS.glsl"), s_shaderStructures + s_tonemapFunctions);
+
+        // TAA
+        m_shaders[ShaderId::TAAFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///TAAFS.glsl"), s_shaderStructures420 + s_tonemapFunctions);
 
         // SSR
-        m_shaders[ShaderId::SSRFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///SSRFS.glsl"), s_shaderStructures);
+        m_shaders[ShaderId::SSRFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///SSRFS.glsl"), s_shaderStructures + s_tonemapFunctions);
         
         // SMAA
         m_shaders[ShaderId::EdgeFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///EdgeFS.glsl"), s_smaaFunctions);
         m_shaders[ShaderId::BlendFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///BlendFS.glsl"), s_smaaFunctions);
-        m_shaders[ShaderId::ResolveFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///ResolveFS.glsl"), s_smaaFunctions);
+        m_shaders[ShaderId::ResolveFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///ResolveFS.glsl"), s_smaaFunctions + s_tonemapFunctions);
+        m_shaders[ShaderId::ResolveTilesFS] = SU::createShader(GL_FRAGMENT_SHADER, tygra::createStringFromFile("resource:///ResolveFS.glsl"), s_smaaComputeFunctions + s_tonemapFunctions);
+
+        // Compute SMAA
+        m_shaders[ShaderId::EdgeCS] = SU::createShader(GL_COMPUTE_SHADER, tygra::createStringFromFile("resource:///EdgeCS.glsl"), s_smaaComputeFunctions);
+        m_shaders[ShaderId::BlendCS] = SU::createShader(GL_COMPUTE_SHADER, tygra::createStringFromFile("resource:///BlendCS.glsl"), s_smaaComputeFunctions);
     }
 
     void ShaderManager::deleteShaders()
@@ -87,7 +136,7 @@ namespace MLK
         m_programs[ShaderProgram::GBufferProgram] = SU::createProgram(
         { m_shaders.at(ShaderId::GBufferVS), m_shaders.at(ShaderId::GBufferFS) },
         { AttribLocation::Position, AttribLocation::Normal, AttribLocation::UV0, AttribLocation::InstanceID },
-        { FragDataLocation::GBufferPosition, FragDataLocation::GBufferNormal, FragDataLocation::GBufferMaterial },
+        { FragDataLocation::GBufferPosition, FragDataLocation::GBufferNormal, FragDataLocation::GBufferMaterial, FragDataLocation::GBufferVelocity },
         { UniformBufferId::Frame },
         { }
         );
@@ -116,6 +165,22 @@ namespace MLK
         { TextureSlot::TPosition, TextureSlot::TNormal, TextureSlot::TMaterial, TextureSlot::TShadow }
         );
 
+        m_programs[ShaderProgram::SpotShadowPCF] = SU::createProgram(
+        { m_shaders.at(ShaderId::LightVolumeVS), m_shaders.at(ShaderId::SpotShadowPCFFS) },
+        { AttribLocation::Position },
+        { FragDataLocation::OutColour },
+        { UniformBufferId::Frame, UniformBufferId::Static, UniformBufferId::Light, UniformBufferId::Shadow },
+        { TextureSlot::TPosition, TextureSlot::TNormal, TextureSlot::TMaterial, TextureSlot::TShadow }
+        );
+
+        m_programs[ShaderProgram::SpotShadowEVSM] = SU::createProgram(
+        { m_shaders.at(ShaderId::LightVolumeVS), m_shaders.at(ShaderId::SpotShadowEVSMFS) },
+        { AttribLocation::Position },
+        { FragDataLocation::OutColour },
+        { UniformBufferId::Frame, UniformBufferId::Static, UniformBufferId::Light, UniformBufferId::Shadow },
+        { TextureSlot::TPosition, TextureSlot::TNormal, TextureSlot::TMaterial, TextureSlot::TShadow }
+        );
+
         m_programs[ShaderProgram::PointLight] = SU::createProgram(
         { m_shaders.at(ShaderId::LightVolumeVS), m_shaders.at(ShaderId::PointFS) },
         { AttribLocation::Position },
@@ -124,6 +189,30 @@ namespace MLK
         { TextureSlot::TPosition, TextureSlot::TNormal, TextureSlot::TMaterial }
         );
 
+        m_programs[ShaderProgram::PointShadow] = SU::createProgram(
+        { m_shaders.at(ShaderId::LightVolumeVS), m_shaders.at(ShaderId::PointShadowLightFS) },
+        { AttribLocation::Position },
+        { FragDataLocation::OutColour },
+        { UniformBufferId::Frame, UniformBufferId::Static, UniformBufferId::Light },
+        { TextureSlot::TPosition, TextureSlot::TNormal, TextureSlot::TMaterial, TextureSlot::TPointShadow }
+        );
+
+        m_programs[ShaderProgram::PointShadowLayered] = SU::createProgram(
+        { m_shaders.at(ShaderId::PointShadowVS), m_shaders.at(ShaderId::PointShadowGS), m_shaders.at(ShaderId::PointShadowFS) },
+        { AttribLocation::Position, AttribLocation::Normal, AttribLocation::UV0, AttribLocation::InstanceID },
+        { },
+        { UniformBufferId::Frame, UniformBufferId::PointShadowCube },
+        { }
+        );
+
+        m_programs[ShaderProgram::PointShadowFaces] = SU::createProgram(
+        { m_shaders.at(ShaderId::PointShadowFaceVS), m_shaders.at(ShaderId::PointShadowFS) },
+        { AttribLocation::Position, AttribLocation::Normal, AttribLocation::UV0, AttribLocation::InstanceID },
+        { },
+        { UniformBufferId::Frame, UniformBufferId::PointShadowCube },
+        { }
+        );
+
         m_programs[ShaderProgram::Shadows] = SU::createProgram(
         { m_shaders.at(ShaderId::ShadowsVS), m_shaders.at(ShaderId::ShadowsFS) },
         { AttribLocation::Position, AttribLocation::Normal, AttribLocation::UV0, AttribLocation::InstanceID },
@@ -132,6 +221,22 @@ namespace MLK
         { }
         );
 
+        m_programs[ShaderProgram::ShadowMoments] = SU::createProgram(
+        { m_shaders.at(ShaderId::QuadVS), m_shaders.at(ShaderId::ShadowMomentsFS) },
+        { AttribLocation::Position, AttribLocation::UV0 },
+        { FragDataLocation::OutColour },
+        { },
+        { TextureSlot::TInput }
+        );
+
+        m_programs[ShaderProgram::ShadowBlur] = SU::createProgram(
+        { m_shaders.at(ShaderId::QuadVS), m_shaders.at(ShaderId::ShadowBlurFS) },
+        { AttribLocation::Position, AttribLocation::UV0 },
+        { FragDataLocation::OutColour },
+        { },
+        { TextureSlot::TInput }
+        );
+
         m_programs[ShaderProgram::SSRProgram] = SU::createProgram(
         { m_shaders.at(ShaderId::QuadVS), m_shaders.at(ShaderId::SSRFS) },
         { AttribLocation::Position, AttribLocation::UV0 },
@@ -140,6 +245,24 @@ namespace MLK
         { TextureSlot::TPosition, TextureSlot::TNormal, TextureSlot::TMaterial, TextureSlot::TInput, TextureSlot::TSearch}
         );
 
+        m_programs[ShaderProgram::TAAProgram] = SU::createProgram(
+        { m_shaders.at(ShaderId::QuadVS), m_shaders.at(ShaderId::TAAFS) },
+        { AttribLocation::Position, AttribLocation::UV0 },
+        { FragDataLocation::OutColour },
+        { UniformBufferId::Viewport },
+        { TextureSlot::TInput, TextureSlot::THistory, TextureSlot::TVelocity },
+        { },
+        { ImageUnit::IOutput }
+        );
+
+        m_programs[ShaderProgram::Present] = SU::createProgram(
+        { m_shaders.at(ShaderId::PresentVS), m_shaders.at(ShaderId::PresentFS) },
+        { AttribLocation::Position, AttribLocation::UV0 },
+        { FragDataLocation::OutColour },
+        { },
+        { TextureSlot::TInput }
+        );
+
         m_programs[ShaderProgram::Edge] = SU::createProgram(
         { m_shaders.at(ShaderId::EdgeVS), m_shaders.at(ShaderId::EdgeFS) },
         { AttribLocation::Position, AttribLocation::UV0 },
@@ -164,7 +287,42 @@ namespace MLK
         { TextureSlot::TInput, TextureSlot::TSearch }
         );
 
+        m_programs[ShaderProgram::EdgeCompute] = SU::createProgram(
+        { m_shaders.at(ShaderId::EdgeCS) },
+        { },
+        { },
+        { UniformBufferId::Viewport },
+        { TextureSlot::TInput },
+        { StorageBufferId::SMAATiles },
+        { ImageUnit::IOutput }
+        );
+
+        m_programs[ShaderProgram::BlendCompute] = SU::createProgram(
+        { m_shaders.at(ShaderId::BlendCS) },
+        { },
+        { },
+        { UniformBufferId::Viewport },
+        { TextureSlot::TInput, TextureSlot::TArea, TextureSlot::TSearch },
+        { StorageBufferId::SMAATiles },
+        { ImageUnit::IOutput }
+        );
+
+        m_programs[ShaderProgram::ResolveTiles] = SU::createProgram(
+        { m_shaders.at(ShaderId::ResolveTilesVS), m_shaders.at(ShaderId::ResolveTilesFS) },
+        { },
+        { FragDataLocation::OutColour },
+        { UniformBufferId::Viewport },
+        { TextureSlot::TInput, TextureSlot::TSearch },
+        { StorageBufferId::SMAATiles }
+        );
+
         deleteShaders();
+
+        // Uniforms set every frame are found once here rather than by name on each use.
+        for (const auto& program : m_programs)
+        {
+            m_uniformLocations[program.first] = SU::getUniformLocations(program.second);
+        }
     }
 
     void ShaderManager::deletePrograms()
@@ -174,6 +332,7 @@ namespace MLK
             glDeleteProgram(program.second);
         }
         m_programs.clear();
+        m_uniformLocations.clear();
     }
 
     GLuint ShaderManager::getProgramId(ShaderProgram program) const
@@ -181,6 +340,13 @@ namespace MLK
         return m_programs.at(program);
     }
 
+    GLint ShaderManager::getUniformLocation(ShaderProgram program, UniformId uniform) const
+    {
+        const auto& locations = m_uniformLocations.at(program);
+        const auto location = locations.find(uniform);
+        return location != locations.end() ? location->second : -1;
+    }
+
     void ShaderManager::useProgram(ShaderProgram program)
     {
         if (m_currentProgram == program || program == ShaderProgram::NoProgram)
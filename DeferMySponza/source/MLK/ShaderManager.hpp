@@ -1,7 +1,7 @@
 #pragma once
 
 #include <glm/glm.hpp>
-#include <tgl/tgl.h>
+#include "Utils.hpp"
 #include <unordered_map>
 
 namespace MLK
@@ -16,12 +16,24 @@ namespace MLK
         Ambient,
         SpotLight,
         SpotShadow,
+        SpotShadowPCF,
+        SpotShadowEVSM,
         PointLight,
+        PointShadow,
 		Shadows,
+        ShadowMoments,
+        ShadowBlur,
+        PointShadowLayered,
+        PointShadowFaces,
         SSRProgram,
         Edge,
         Blend,
-        Resolve
+        Resolve,
+        EdgeCompute,
+        BlendCompute,
+        ResolveTiles,
+        TAAProgram,
+        Present
     };
 
     /// <summary>
@@ -36,6 +48,9 @@ namespace MLK
         void useProgram(ShaderProgram program);
         GLuint getProgramId(ShaderProgram program) const;
 
+        // Location of <uniform> in <program> found at link time, -1 when the program doesn't use it.
+        GLint getUniformLocation(ShaderProgram program, UniformId uniform) const;
+
         void recompileShaders();
 
     private:
@@ -44,20 +59,36 @@ namespace MLK
 			AmbientFS,
             SpotFS,
             SpotShadowFS,
+            SpotShadowPCFFS,
+            SpotShadowEVSMFS,
             PointFS,
+            PointShadowLightFS,
             GBufferVS,
             GBufferFS,
 			QuadVS,
             LightVolumeVS,
 			ShadowsVS,
 			ShadowsFS,
+            ShadowMomentsFS,
+            ShadowBlurFS,
+            PointShadowVS,
+            PointShadowFaceVS,
+            PointShadowGS,
+            PointShadowFS,
             SSRFS,
             EdgeVS,
             EdgeFS,
             BlendVS,
             BlendFS,
             ResolveVS,
-            ResolveFS
+            ResolveFS,
+            EdgeCS,
+            BlendCS,
+            ResolveTilesVS,
+            ResolveTilesFS,
+            TAAFS,
+            PresentVS,
+            PresentFS
         };
 
         void createShaders();
@@ -68,10 +99,15 @@ namespace MLK
 
         std::unordered_map<ShaderId, GLuint> m_shaders;
         std::unordered_map<ShaderProgram, GLuint> m_programs;
+        std::unordered_map<ShaderProgram, std::unordered_map<UniformId, GLint>> m_uniformLocations;
 
         ShaderProgram m_currentProgram;
         
         static std::string s_shaderStructures;
         static std::string s_smaaFunctions;
+        static std::string s_smaaComputeFunctions;
+        static std::string s_tonemapFunctions;
+        static std::string s_shaderStructures400;
+        static std::string s_shaderStructures420;
 	};
 }
\ No newline at end of file
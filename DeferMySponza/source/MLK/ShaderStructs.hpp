@@ -44,6 +44,10 @@ namespace MLK
 		glm::vec3 Direction;
 		GLint CastsShadows;
 		glm::mat4 ModelTransform;
+		GLint ShadowSlot = -1; // Point lights only, the light's cube in the point shadow map array.
+		GLint Padding0;
+		GLint Padding1;
+		GLint Padding2;
 	};
 
 	struct DirectionalLight
@@ -73,16 +77,19 @@ namespace MLK
 	{
         MeshInstanceData() {}
 
-		MeshInstanceData(const glm::mat4& modelTransform, GLuint materialId) :
-			ModelTransform(modelTransform), MaterialIndex(materialId) {}
+		MeshInstanceData(const glm::mat4& modelTransform, const glm::mat4& previousModelTransform, GLuint materialId) :
+			ModelTransform(modelTransform), PreviousModelTransform(previousModelTransform), MaterialIndex(materialId) {}
 
 		glm::mat4 ModelTransform;
+		glm::mat4 PreviousModelTransform;
 		GLuint MaterialIndex;
 		GLuint Padding[3];
 	};
 
     /// <summary>
     /// Structure for per frame data. Instance data, view projection matrix and eye position are expected to change once per frame (for now).
+    /// The view projection matrix includes any TAA jitter and is only used to rasterize the scene, motion vectors, SSR and
+    /// lighting use the unjittered current and previous matrices.
     /// </summary>
     struct PerFrameUniformData
     {
@@ -90,6 +97,8 @@ namespace MLK
         glm::mat4 ViewProjectionMatrix;
         glm::vec3 EyePosition;
         GLuint Padding;
+        glm::mat4 UnjitteredViewProjectionMatrix;
+        glm::mat4 PreviousViewProjectionMatrix;
     };
 
     /// <summary>
@@ -106,11 +115,34 @@ namespace MLK
         glm::mat4 VP;
     };
 
+    /// <summary>
+    /// Structure for rendering a point light's cube shadow. Face masks hold a bit per cube face for each instance,
+    /// four instances to a uvec4 to keep std140 from padding every element.
+    /// </summary>
+    struct PointShadowUniform
+    {
+        glm::mat4 FaceViewProjections[6];
+        glm::vec3 LightPosition;
+        float LightRange;
+        GLint FirstLayer;
+        GLint Padding[3];
+        glm::uvec4 FaceMasks[25];
+    };
+
+    /// <summary>
+    /// Sizes for passes sampling targets at render resolution. Targets are allocated at a capacity that can be
+    /// larger than what's rendered, so the texel size describes the targets and the viewport is the corner of them
+    /// in use, as a UV scale and in pixels.
+    /// </summary>
     struct ViewportData
     {
         float PixelWidth;
         float PixelHeight;
-        float ScreenWidth;
-        float ScreenHeight;
+        float TargetWidth;
+        float TargetHeight;
+        float ViewportScaleX;
+        float ViewportScaleY;
+        float ViewportWidth;
+        float ViewportHeight;
     };
 }
\ No newline at end of file
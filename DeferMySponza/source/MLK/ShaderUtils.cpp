@@ -20,7 +20,8 @@ namespace MLK
             { FragDataLocation::GBufferPosition, "GBufferPosition"},
             { FragDataLocation::GBufferNormal, "GBufferNormal" },
             { FragDataLocation::GBufferColour, "GBufferColour" },
-            { FragDataLocation::GBufferMaterial, "GBufferMaterial" }
+            { FragDataLocation::GBufferMaterial, "GBufferMaterial" },
+            { FragDataLocation::GBufferVelocity, "GBufferVelocity" }
         };
 
         std::unordered_map<UniformBufferId, std::string> g_uniformToName = 
@@ -29,7 +30,8 @@ namespace MLK
             { UniformBufferId::Light, "LightData" },
             { UniformBufferId::Static, "StaticData"},
             { UniformBufferId::Shadow, "ShadowData"},
-            { UniformBufferId::Viewport, "ViewportData" }
+            { UniformBufferId::Viewport, "ViewportData" },
+            { UniformBufferId::PointShadowCube, "PointShadowData" }
         };
 
         std::unordered_map<TextureSlot, std::string> g_textureToName =
@@ -40,14 +42,39 @@ namespace MLK
             { TextureSlot::TShadow, "ShadowMap" },
             { TextureSlot::TInput, "Input" },
             { TextureSlot::TArea, "Area" },
-            { TextureSlot::TSearch, "Search" }
+            { TextureSlot::TSearch, "Search" },
+            { TextureSlot::TVelocity, "Velocity" },
+            { TextureSlot::THistory, "History" },
+            { TextureSlot::TPointShadow, "PointShadowMaps" }
+        };
+
+        std::unordered_map<StorageBufferId, std::string> g_storageToName =
+        {
+            { StorageBufferId::SMAATiles, "SMAATileData" }
+        };
+
+        std::unordered_map<ImageUnit, std::string> g_imageToName =
+        {
+            { ImageUnit::IOutput, "Output" }
+        };
+
+        std::unordered_map<UniformId, std::string> g_plainUniformToName =
+        {
+            { UniformId::UExposure, "Exposure" },
+            { UniformId::UStepCount, "StepCount" },
+            { UniformId::UDirection, "Direction" },
+            { UniformId::UFace, "Face" },
+            { UniformId::UInputScale, "InputScale" },
+            { UniformId::UHistoryScale, "HistoryScale" }
         };
 
         GLuint createProgram(const std::vector<GLuint>& shaderIds,
             const std::vector<AttribLocation>& attribLocations,
             const std::vector<FragDataLocation>& fragLocations,
             const std::vector<UniformBufferId>& uboIds, 
-            const std::vector<TextureSlot>& textureIds)
+            const std::vector<TextureSlot>& textureIds,
+            const std::vector<StorageBufferId>& ssboIds,
+            const std::vector<ImageUnit>& imageIds)
         {
             GLuint programId = glCreateProgram();
 
@@ -74,6 +101,12 @@ namespace MLK
                 glUniformBlockBinding(programId, uniformLocation, ubo);
             }
 
+            for (const auto ssbo : ssboIds)
+            {
+                auto blockIndex = glGetProgramResourceIndex(programId, GL_SHADER_STORAGE_BLOCK, g_storageToName.at(ssbo).c_str());
+                glShaderStorageBlockBinding(programId, blockIndex, ssbo);
+            }
+
             // Program must be in use to bind textures.
             glUseProgram(programId);
             for (const auto texture : textureIds)
@@ -81,6 +114,11 @@ namespace MLK
                 auto location = glGetUniformLocation(programId, g_textureToName.at(texture).c_str());
                 glUniform1i(location, Utils::getTextureID(texture));
             }
+            for (const auto image : imageIds)
+            {
+                auto location = glGetUniformLocation(programId, g_imageToName.at(image).c_str());
+                glUniform1i(location, image);
+            }
             glUseProgram(0);
 
             return programId;
@@ -148,6 +186,20 @@ namespace MLK
             }
         }
 
+        std::unordered_map<UniformId, GLint> getUniformLocations(GLuint programId)
+        {
+            std::unordered_map<UniformId, GLint> locations;
+            for (const auto& uniform : g_plainUniformToName)
+            {
+                const auto location = glGetUniformLocation(programId, uniform.second.c_str());
+                if (location != -1)
+                {
+                    locations[uniform.first] = location;
+                }
+            }
+            return locations;
+        }
+
         void bindAttributes(GLuint programId, const std::vector<AttribLocation>& attributes)
         {
             for (auto attribute : attributes)
@@ -10,16 +10,22 @@ namespace MLK
         GLuint createShader(GLuint shaderType, const std::string& source, const std::string& shaderPrefix = "");
 
         // Creates a new program given all required parameters. Should potentially be split into multiple functions
-        // however this ensures nothing is missed when adding programs.
+        // however this ensures nothing is missed when adding programs. Storage blocks and images are only used by
+        // compute programs so default to empty.
         GLuint createProgram(const std::vector<GLuint>& shaderIds,
             const std::vector<AttribLocation>& attribLocations,
             const std::vector<FragDataLocation>& fragLocations,
             const std::vector<UniformBufferId>& uboIds,
-            const std::vector<TextureSlot>& textureIds);
+            const std::vector<TextureSlot>& textureIds,
+            const std::vector<StorageBufferId>& ssboIds = {},
+            const std::vector<ImageUnit>& imageIds = {});
 
         // Links a given program asserting if failure.
         void linkProgram(GLuint programId);
 
+        // Looks up the location of every plain uniform a linked program uses. See g_plainUniformToName map for names.
+        std::unordered_map<UniformId, GLint> getUniformLocations(GLuint programId);
+
         // Binds the given attributes to the given program. See g_vertexLocationToName map for variable names.
         void bindAttributes(GLuint programId, const std::vector<AttribLocation>& attributes);
 
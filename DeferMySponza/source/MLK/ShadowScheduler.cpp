@@ -0,0 +1,242 @@
+#include "ShadowScheduler.hpp"
+#include "LightCuller.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+namespace MLK
+{
+    namespace
+    {
+        // Matches the profiler's smoothing, so the averaged update count lines up with the averaged time.
+        const float g_smoothing = 0.1f;
+
+        // Movement is held at its peak and decays, so a light that starts moving is picked up straight away but
+        // one that stops isn't dropped to the slowest rate on its first still frame.
+        const float g_motionDecay = 0.9f;
+    }
+
+    ShadowScheduler::ShadowScheduler(GLuint resolution, const ShadowSchedulerSettings& settings) :
+        m_settings(settings),
+        m_resolution(resolution)
+    {
+    }
+
+    ShadowScheduler::~ShadowScheduler()
+    {
+        for (const auto& caster : m_casters)
+        {
+            if (caster.allocated)
+            {
+                Utils::deleteShadowMap(caster.map);
+            }
+        }
+    }
+
+    void ShadowScheduler::beginFrame(float shadowGpuMs, const std::vector<glm::vec4>& movedBounds)
+    {
+        ++m_frame;
+        m_movedBounds = &movedBounds;
+
+        const auto averageUpdated = m_averageUpdated == 0.f ? (float)m_stats.updated :
+            m_averageUpdated + (m_stats.updated - m_averageUpdated) * g_smoothing;
+        m_averageUpdated = averageUpdated;
+
+        m_stats = ShadowSchedulerStats();
+        m_stats.shadowMs = shadowGpuMs;
+        m_stats.costPerMapMs = averageUpdated > 0.f ? shadowGpuMs / averageUpdated : 0.f;
+
+        // Until a cost has been measured every due map is allowed.
+        m_stats.cap = std::numeric_limits<GLuint>::max();
+        if (m_enabled && m_stats.costPerMapMs > 0.f)
+        {
+            m_stats.cap = std::max(1u, (GLuint)(m_settings.budgetMs / m_stats.costPerMapMs));
+        }
+
+        for (auto& caster : m_casters)
+        {
+            caster.coverage = -1.f;
+            caster.scheduled = false;
+        }
+    }
+
+    void ShadowScheduler::addCaster(GLuint key, const ShaderLight& light, float coverage)
+    {
+        if (m_casters.size() <= key)
+        {
+            m_casters.resize(key + 1);
+        }
+
+        auto& caster = m_casters[key];
+        caster.coverage = coverage;
+
+        ++m_stats.casters;
+        if (coverage >= 0.f)
+        {
+            ++m_stats.visible;
+        }
+
+        if (caster.hasPrevious)
+        {
+            caster.motion = std::max(getMotion(caster.previous, light), caster.motion * g_motionDecay);
+        }
+        caster.previous = light;
+        caster.hasPrevious = true;
+
+        // Staleness sticks until the map is rendered, so lights that change while off screen are caught up when
+        // they come back.
+        if (!caster.valid || caster.stale)
+        {
+            caster.stale = true;
+            return;
+        }
+
+        caster.stale = getMotion(caster.rendered, light) > m_settings.stillThreshold;
+
+        const auto bounds = LightCuller::getSpotBounds(light);
+        for (size_t i = 0; i < m_movedBounds->size() && !caster.stale; ++i)
+        {
+            const auto& moved = (*m_movedBounds)[i];
+            caster.stale = glm::length(glm::vec3(moved) - glm::vec3(bounds)) < moved.w + bounds.w;
+        }
+    }
+
+    void ShadowScheduler::schedule()
+    {
+        m_candidates.clear();
+
+        const auto cap = m_stats.cap;
+        GLuint scheduled = 0;
+        for (GLuint key = 0; key < m_casters.size(); ++key)
+        {
+            auto& caster = m_casters[key];
+            if (caster.coverage < 0.f)
+            {
+                continue;
+            }
+
+            if (caster.stale)
+            {
+                ++m_stats.stale;
+            }
+
+            // Lights without a map can't be shaded at all, and with scheduling off every map is redrawn, so
+            // neither waits its turn.
+            if (!caster.valid || !m_enabled)
+            {
+                caster.scheduled = true;
+                ++scheduled;
+                if (!caster.valid)
+                {
+                    ++m_stats.forced;
+                }
+                continue;
+            }
+
+            if (!caster.stale)
+            {
+                continue;
+            }
+
+            // Large or fast lights are due every frame, small and slow ones stretch towards the longest interval.
+            const auto importance = glm::clamp(std::max(caster.coverage / m_settings.fullRateCoverage,
+                caster.motion / m_settings.fullRateMotion), 0.f, 1.f);
+            const auto interval = 1.f + (m_settings.maxInterval - 1) * (1.f - importance);
+            const auto priority = (m_frame - caster.updatedFrame) / interval;
+
+            if (priority >= 1.f)
+            {
+                m_candidates.push_back({ key, priority });
+            }
+        }
+
+        // The most overdue go first, and as rendering resets a map's wait the rest come round in later frames.
+        m_stats.due = (GLuint)m_candidates.size();
+        const auto kept = std::min<size_t>(cap > scheduled ? cap - scheduled : 0, m_candidates.size());
+        std::partial_sort(m_candidates.begin(), m_candidates.begin() + kept, m_candidates.end(),
+            [](const Candidate& a, const Candidate& b) { return a.priority > b.priority; });
+
+        for (size_t i = 0; i < kept; ++i)
+        {
+            m_casters[m_candidates[i].key].scheduled = true;
+        }
+        m_stats.deferred = (GLuint)(m_candidates.size() - kept);
+
+        for (auto& caster : m_casters)
+        {
+            if (caster.scheduled && !caster.allocated)
+            {
+                caster.map = Utils::createShadowMap(m_resolution);
+                caster.allocated = true;
+            }
+        }
+    }
+
+    bool ShadowScheduler::needsUpdate(GLuint key) const
+    {
+        return key < m_casters.size() && m_casters[key].scheduled;
+    }
+
+    void ShadowScheduler::markUpdated(GLuint key, const glm::mat4& viewProjection)
+    {
+        auto& caster = m_casters[key];
+        caster.valid = true;
+        caster.stale = false;
+        caster.rendered = caster.previous;
+        caster.viewProjection = viewProjection;
+        caster.updatedFrame = m_frame;
+
+        ++m_stats.updated;
+    }
+
+    bool ShadowScheduler::hasShadowMap(GLuint key) const
+    {
+        return key < m_casters.size() && m_casters[key].valid;
+    }
+
+    void ShadowScheduler::invalidate()
+    {
+        for (auto& caster : m_casters)
+        {
+            caster.valid = false;
+            caster.stale = true;
+        }
+    }
+
+    void ShadowScheduler::setResolution(GLuint resolution)
+    {
+        m_resolution = resolution;
+        for (const auto& caster : m_casters)
+        {
+            if (caster.allocated)
+            {
+                Utils::resizeShadowMap(caster.map, resolution);
+            }
+        }
+
+        invalidate();
+    }
+
+    void ShadowScheduler::printStats() const
+    {
+        std::cout << "Shadow scheduler" << (m_enabled ? "" : " (off)") << ": " << m_stats.updated << " maps updated ("
+            << m_stats.forced << " new), " << m_stats.stale << " stale of " << m_stats.visible << " visible and "
+            << m_stats.casters << " casters, " << m_stats.deferred << " of " << m_stats.due << " due deferred";
+        if (m_stats.cap != std::numeric_limits<GLuint>::max())
+        {
+            std::cout << ", cap " << m_stats.cap;
+        }
+        std::cout << ", " << m_stats.shadowMs << "ms of " << m_settings.budgetMs << "ms, "
+            << m_stats.costPerMapMs << "ms per map" << std::endl;
+    }
+
+    float ShadowScheduler::getMotion(const ShaderLight& from, const ShaderLight& to)
+    {
+        const auto moved = glm::length(to.Position - from.Position) / std::max(to.Range, 0.001f);
+        const auto turned = glm::acos(glm::clamp(glm::dot(from.Direction, to.Direction), -1.f, 1.f));
+        const auto reshaped = std::abs(to.Angle - from.Angle) + std::abs(to.Range - from.Range) / std::max(to.Range, 0.001f);
+
+        return moved + turned + reshaped;
+    }
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "Utils.hpp"
+#include "ShaderStructs.hpp"
+
+#include <tgl/tgl.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace MLK
+{
+    /// <summary>
+    /// Limits the shadow scheduler works within.
+    /// </summary>
+    struct ShadowSchedulerSettings
+    {
+        // GPU time allowed for shadow map updates each frame, maps without any contents yet are rendered regardless.
+        float budgetMs = 2.f;
+
+        // Most frames a moving light's map may go between updates, small and slow lights drift towards this.
+        GLuint maxInterval = 8;
+
+        // Light movement since its map was rendered, as a fraction of its range or radians of turn, that's treated
+        // as still.
+        float stillThreshold = 0.001f;
+
+        // Screen coverage and movement per frame, again as a fraction of range or radians, that earn a light an
+        // update every frame.
+        float fullRateCoverage = 0.25f;
+        float fullRateMotion = 0.05f;
+    };
+
+    /// <summary>
+    /// Scheduler counts for the last scheduled frame.
+    /// </summary>
+    struct ShadowSchedulerStats
+    {
+        GLuint casters = 0;
+        GLuint visible = 0;
+        GLuint stale = 0;
+        GLuint due = 0;
+        GLuint updated = 0;
+        GLuint forced = 0;
+        GLuint deferred = 0;
+        GLuint cap = 0;
+        float shadowMs = 0.f;
+        float costPerMapMs = 0.f;
+    };
+
+    /// <summary>
+    /// Keeps a persistent shadow map per shadow casting light and decides which are refreshed each frame. Maps go
+    /// stale when their light moves or an instance moves within the light's bounds, and stationary lights in an
+    /// unchanged scene are never re-rendered. Stale maps of visible lights are given an update interval from how
+    /// fast the light moves and how much of the screen it covers, and the most overdue are rendered round-robin up
+    /// to as many as the measured cost per map fits into the budget. Until a light's map is refreshed it's shaded
+    /// with the view projection the map was rendered with, so shadows lag rather than detach.
+    /// </summary>
+    class ShadowScheduler
+    {
+    public:
+        ShadowScheduler(GLuint resolution, const ShadowSchedulerSettings& settings = ShadowSchedulerSettings());
+        ~ShadowScheduler();
+
+        // Starts a new frame, refitting the cap to the last measured shadow time and the maps it covered.
+        // <movedBounds> are the bounding spheres of anything that moved since the last frame.
+        void beginFrame(float shadowGpuMs, const std::vector<glm::vec4>& movedBounds);
+
+        // Tracks caster <key> for this frame. Coverage is the fraction of the screen the light is shaded over, or
+        // negative if it isn't shaded this frame.
+        void addCaster(GLuint key, const ShaderLight& light, float coverage);
+
+        // Selects the maps to render this frame.
+        void schedule();
+
+        bool needsUpdate(GLuint key) const;
+
+        // Records that <key>'s map was rendered with <viewProjection> from its light this frame.
+        void markUpdated(GLuint key, const glm::mat4& viewProjection);
+
+        // Returns false if <key> has no rendered map to shade with.
+        bool hasShadowMap(GLuint key) const;
+
+        const ShadowMap& getShadowMap(GLuint key) const { return m_casters[key].map; }
+        const glm::mat4& getViewProjection(GLuint key) const { return m_casters[key].viewProjection; }
+
+        // Drops the contents of every map, such as when what they store changes.
+        void invalidate();
+
+        void setResolution(GLuint resolution);
+        GLuint getResolution() const { return m_resolution; }
+
+        // Disables scheduling, rendering every visible caster's map every frame.
+        void setEnabled(bool enabled) { m_enabled = enabled; }
+        bool isEnabled() const { return m_enabled; }
+
+        const ShadowSchedulerStats& getStats() const { return m_stats; }
+
+        void printStats() const;
+
+    private:
+        struct Caster
+        {
+            ShadowMap map;
+            bool allocated = false;
+            bool valid = false;
+            bool stale = true;
+            bool scheduled = false;
+
+            // Light as its map was last rendered, and as it was last frame.
+            ShaderLight rendered;
+            ShaderLight previous;
+            bool hasPrevious = false;
+            glm::mat4 viewProjection;
+
+            // Smoothed movement per frame and the frame the map was last rendered.
+            float motion = 0.f;
+            GLuint updatedFrame = 0;
+
+            float coverage = -1.f;
+        };
+
+        struct Candidate
+        {
+            GLuint key;
+            float priority;
+        };
+
+        // Movement between two states of a light, relative to its range for position.
+        static float getMotion(const ShaderLight& from, const ShaderLight& to);
+
+        ShadowSchedulerSettings m_settings;
+        GLuint m_resolution;
+        bool m_enabled = true;
+
+        GLuint m_frame = 0;
+        const std::vector<glm::vec4>* m_movedBounds = nullptr;
+
+        std::vector<Caster> m_casters;
+        std::vector<Candidate> m_candidates;
+
+        float m_averageUpdated = 0.f;
+
+        ShadowSchedulerStats m_stats;
+    };
+}
@@ -0,0 +1,215 @@
+#include "Simulation.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace MLK
+{
+    namespace
+    {
+        // Matches the profiler's smoothing so CPU and GPU timings are comparable.
+        const float g_smoothing = 0.1f;
+
+        float smooth(float average, float sample)
+        {
+            return average == 0.f ? sample : average + (sample - average) * g_smoothing;
+        }
+
+        long long toNanoseconds(Simulation::Clock::time_point time)
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+        }
+
+        float toMilliseconds(Simulation::Clock::duration duration)
+        {
+            return std::chrono::duration<float, std::milli>(duration).count();
+        }
+    }
+
+    Simulation::Simulation(sponza::Context& scene) :
+        m_scene(scene),
+        m_snapshot(scene)
+    {
+        start();
+    }
+
+    Simulation::~Simulation()
+    {
+        stop();
+    }
+
+    void Simulation::setThreaded(bool threaded)
+    {
+        if (threaded)
+        {
+            start();
+        }
+        else
+        {
+            stop();
+        }
+    }
+
+    void Simulation::post(const Command& command, bool isInput)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_commands.push_back({ command, isInput ? Clock::now() : Clock::time_point() });
+    }
+
+    void Simulation::acquire(sponza::Context& scene)
+    {
+        m_frameStart = Clock::now();
+
+        if (!m_threaded)
+        {
+            publish(step());
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        const auto waitStart = Clock::now();
+        m_published.wait(lock, [this]() { return m_fresh; });
+
+        // Time spent waiting on the simulation isn't render thread work, so the frame is timed from here.
+        m_frameStart += Clock::now() - waitStart;
+
+        scene = m_snapshot;
+        m_frameInput = m_snapshotInput;
+        m_snapshotInput = Clock::time_point();
+        m_fresh = false;
+
+        lock.unlock();
+        m_consumed.notify_one();
+    }
+
+    void Simulation::frameSubmitted()
+    {
+        const auto now = Clock::now();
+
+        m_stats.renderMs = smooth(m_stats.renderMs, toMilliseconds(now - m_frameStart));
+        m_stats.updateMs = m_updateMs.load();
+
+        if (m_frameInput != Clock::time_point())
+        {
+            m_stats.inputLatencyMs = smooth(m_stats.inputLatencyMs, toMilliseconds(now - m_frameInput));
+        }
+
+        // The update overlapping this frame is either still running or finished during it. Inline updates run
+        // before the frame they're for, so never overlap.
+        float overlapMs = 0.f;
+        if (m_threaded)
+        {
+            const auto updateStart = m_updateStart.load();
+            const auto updateEnd = m_updateEnd.load();
+            const auto frameStart = toNanoseconds(m_frameStart);
+            const auto frameEnd = toNanoseconds(now);
+
+            const auto overlapStart = std::max(updateStart, frameStart);
+            const auto overlapEnd = std::min(updateEnd == 0 ? frameEnd : updateEnd, frameEnd);
+            overlapMs = std::max(0.f, (overlapEnd - overlapStart) * 1e-6f);
+        }
+        m_stats.overlapMs = smooth(m_stats.overlapMs, overlapMs);
+    }
+
+    void Simulation::printStats() const
+    {
+        const auto overlapPercent = m_stats.renderMs > 0.f ? 100.f * m_stats.overlapMs / m_stats.renderMs : 0.f;
+        std::cout << "Simulation (" << (m_threaded ? "threaded" : "serial") << "): update " << m_stats.updateMs
+            << "ms, render thread " << m_stats.renderMs << "ms, input to submit " << m_stats.inputLatencyMs
+            << "ms, overlap " << m_stats.overlapMs << "ms (" << overlapPercent << "% of render)" << std::endl;
+    }
+
+    void Simulation::start()
+    {
+        if (m_threaded)
+        {
+            return;
+        }
+
+        m_stopping = false;
+        m_threaded = true;
+        m_thread = std::thread(&Simulation::run, this);
+    }
+
+    void Simulation::stop()
+    {
+        if (!m_threaded)
+        {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_consumed.notify_one();
+
+        m_thread.join();
+        m_threaded = false;
+    }
+
+    void Simulation::run()
+    {
+        for (;;)
+        {
+            publish(step());
+
+            // The next update starts as soon as the renderer takes this one, so it runs alongside that frame.
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_consumed.wait(lock, [this]() { return !m_fresh || m_stopping; });
+            if (m_stopping)
+            {
+                return;
+            }
+        }
+    }
+
+    Simulation::Clock::time_point Simulation::step()
+    {
+        std::vector<std::pair<Command, Clock::time_point>> commands;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            commands.swap(m_commands);
+        }
+
+        Clock::time_point input;
+        for (const auto& command : commands)
+        {
+            command.first(m_scene);
+
+            const auto posted = command.second;
+            if (posted != Clock::time_point() && (input == Clock::time_point() || posted < input))
+            {
+                input = posted;
+            }
+        }
+
+        const auto start = Clock::now();
+        m_updateEnd = 0;
+        m_updateStart = toNanoseconds(start);
+
+        m_scene.update();
+
+        const auto end = Clock::now();
+        m_updateEnd = toNanoseconds(end);
+        m_updateMs = smooth(m_updateMs.load(), toMilliseconds(end - start));
+
+        return input;
+    }
+
+    void Simulation::publish(Clock::time_point inputTime)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_snapshot = m_scene;
+
+            // An unconsumed snapshot is replaced, but the input it carried still counts from when it was posted.
+            if (inputTime != Clock::time_point() &&
+                (m_snapshotInput == Clock::time_point() || inputTime < m_snapshotInput))
+            {
+                m_snapshotInput = inputTime;
+            }
+            m_fresh = true;
+        }
+        m_published.notify_one();
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <sponza/sponza.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace MLK
+{
+    /// <summary>
+    /// Smoothed timings of the simulation and render threads. Overlap is how much of each render frame the
+    /// simulation spent updating alongside it.
+    /// </summary>
+    struct SimulationStats
+    {
+        float updateMs = 0.f;
+        float renderMs = 0.f;
+        float inputLatencyMs = 0.f;
+        float overlapMs = 0.f;
+    };
+
+    /// <summary>
+    /// Runs the scene's update on its own thread, publishing a copy of the scene after each update for the render
+    /// thread to pick up. The simulation works on its scene while the last snapshot waits in a second copy, and the
+    /// render thread copies that into its own scene, so neither thread sees the other's scene mid change. Each
+    /// snapshot the renderer takes lets the simulation start the next, so frame N is built and submitted while
+    /// frame N+1 is simulated. Changes to the scene from input are posted as commands and run on the simulation
+    /// thread before its next update. With threading off the update runs inline when a snapshot is taken, as it
+    /// did before, for comparison.
+    /// </summary>
+    class Simulation
+    {
+    public:
+        using Clock = std::chrono::high_resolution_clock;
+        using Command = std::function<void(sponza::Context&)>;
+
+        // <scene> is updated by the simulation thread from here on and must only be changed through commands.
+        Simulation(sponza::Context& scene);
+        ~Simulation();
+
+        void setThreaded(bool threaded);
+        bool isThreaded() const { return m_threaded; }
+
+        // Queues <command> to run before the next update. Input is timed from here to the submission of the first
+        // frame built from a snapshot it's in.
+        void post(const Command& command, bool isInput = true);
+
+        // Copies the latest snapshot into <scene>, waiting for one if the simulation hasn't published since the
+        // last, and starts timing the render frame.
+        void acquire(sponza::Context& scene);
+
+        // Ends the render frame started by the last acquire, once its commands have been submitted.
+        void frameSubmitted();
+
+        const SimulationStats& getStats() const { return m_stats; }
+
+        void printStats() const;
+
+    private:
+        void start();
+        void stop();
+
+        void run();
+
+        // Applies queued commands and updates the scene, returning when the earliest input it applied was posted.
+        Clock::time_point step();
+
+        // Copies the simulation's scene into the snapshot.
+        void publish(Clock::time_point inputTime);
+
+        sponza::Context& m_scene;
+        sponza::Context m_snapshot;
+
+        bool m_threaded = false;
+        std::thread m_thread;
+
+        // Guards the snapshot, the commands and the flags below.
+        std::mutex m_mutex;
+        std::condition_variable m_published;
+        std::condition_variable m_consumed;
+        bool m_fresh = false;
+        bool m_stopping = false;
+
+        std::vector<std::pair<Command, Clock::time_point>> m_commands;
+
+        // Time the earliest input in the snapshot was posted, or zero if it holds none.
+        Clock::time_point m_snapshotInput;
+        Clock::time_point m_frameInput;
+        Clock::time_point m_frameStart;
+
+        // Latest update, in nanoseconds since the clock's epoch. The end is zero while it's running.
+        std::atomic<long long> m_updateStart{ 0 };
+        std::atomic<long long> m_updateEnd{ 0 };
+        std::atomic<float> m_updateMs{ 0.f };
+
+        SimulationStats m_stats;
+    };
+}
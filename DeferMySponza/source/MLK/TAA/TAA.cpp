@@ -0,0 +1,146 @@
+#include "TAA.hpp"
+
+#include <assert.h>
+#include "../GlStateManager.hpp"
+#include "../ShaderManager.hpp"
+#include "../MeshManager.hpp"
+#include "../Utils.hpp"
+#include "../Resources.hpp"
+
+namespace MLK
+{
+	namespace
+	{
+		// Length of the jitter sequence before it repeats.
+		const GLuint g_jitterSamples = 8;
+
+		float halton(GLuint index, GLuint base)
+		{
+			float result = 0.f;
+			float fraction = 1.f / base;
+			while (index > 0)
+			{
+				result += (index % base) * fraction;
+				index /= base;
+				fraction /= base;
+			}
+			return result;
+		}
+	}
+
+	TAA::TAA(ShaderManager* shaderManager, GlStateManager* stateManager, MeshManager* meshManager,
+		GLuint width, GLuint height) :
+		m_shaderManager(shaderManager), m_stateManager(stateManager), m_meshManager(meshManager),
+		m_width(width), m_height(height), m_inputWidth(width), m_inputHeight(height),
+		m_capacityWidth(width), m_capacityHeight(height)
+	{
+		for (auto& fbo : m_historyFbo)
+		{
+			fbo = Resources::createFramebuffer();
+		}
+		allocateHistory();
+	}
+
+	TAA::~TAA()
+	{
+		glDeleteTextures(2, m_historyTex);
+		glDeleteFramebuffers(2, m_historyFbo);
+	}
+
+	glm::vec2 TAA::getJitter(GLuint frameIndex)
+	{
+		// Halton(2, 3) covers the pixel evenly, index 0 is skipped as it sits on the corner.
+		const auto index = (frameIndex % g_jitterSamples) + 1;
+		return glm::vec2(halton(index, 2), halton(index, 3)) - 0.5f;
+	}
+
+	void TAA::run(GLuint input, GLuint inputFbo, GLuint velocity, GLuint outputFbo, float exposure)
+	{
+		// Without a history the first frame is simply the input.
+		if (!m_historyValid)
+		{
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, inputFbo);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_historyFbo[m_currentHistory]);
+			glBlitFramebuffer(0, 0, m_inputWidth, m_inputHeight, 0, 0, m_width, m_height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+			m_historyValid = true;
+		}
+
+		// The resolve draws the output and stores the next history in the same pass, as the output is usually the
+		// default framebuffer, which can't share a framebuffer with the history.
+		const auto nextHistory = 1 - m_currentHistory;
+		glBindFramebuffer(GL_FRAMEBUFFER, outputFbo);
+
+		// The input may be rendered smaller, the resolve is always at output resolution.
+		glViewport(0, 0, m_width, m_height);
+
+		m_shaderManager->useProgram(ShaderProgram::TAAProgram);
+		m_stateManager->setState(DrawPass::TAAResolve);
+		Utils::setExposure(m_shaderManager->getUniformLocation(ShaderProgram::TAAProgram, UniformId::UExposure), exposure);
+		glUniform2f(m_shaderManager->getUniformLocation(ShaderProgram::TAAProgram, UniformId::UHistoryScale),
+			(float)m_width / m_capacityWidth, (float)m_height / m_capacityHeight);
+
+		Resources::bindTexture(TextureSlot::TInput, GL_TEXTURE_2D, input);
+		Resources::bindTexture(TextureSlot::THistory, GL_TEXTURE_2D, m_historyTex[m_currentHistory]);
+		Resources::bindTexture(TextureSlot::TVelocity, GL_TEXTURE_RECTANGLE, velocity);
+		glBindImageTexture(ImageUnit::IOutput, m_historyTex[nextHistory], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+		m_meshManager->drawMeshGroup(MeshGroup::Quad);
+
+		// Next frame samples the stored history, or blits over it if it's been reset.
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+
+		Resources::bindTexture(TextureSlot::TInput, GL_TEXTURE_2D, 0);
+		Resources::bindTexture(TextureSlot::THistory, GL_TEXTURE_2D, 0);
+		Resources::bindTexture(TextureSlot::TVelocity, GL_TEXTURE_RECTANGLE, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		m_currentHistory = nextHistory;
+	}
+
+	void TAA::resizeBuffers(GLuint inputWidth, GLuint inputHeight, GLuint width, GLuint height)
+	{
+		assert(width <= m_capacityWidth && height <= m_capacityHeight);
+
+		m_inputWidth = inputWidth;
+		m_inputHeight = inputHeight;
+
+		// History pixels no longer line up with the output, so it's reprojected from nothing.
+		if (width != m_width || height != m_height)
+		{
+			m_width = width;
+			m_height = height;
+			reset();
+		}
+	}
+
+	void TAA::setCapacity(GLuint width, GLuint height)
+	{
+		if (width != m_capacityWidth || height != m_capacityHeight)
+		{
+			m_capacityWidth = width;
+			m_capacityHeight = height;
+			allocateHistory();
+			reset();
+		}
+	}
+
+	void TAA::allocateHistory()
+	{
+		// Half float history so accumulation doesn't band. Storage is immutable, so it's replaced to resize.
+		glDeleteTextures(2, m_historyTex);
+		for (int i = 0; i < 2; ++i)
+		{
+			m_historyTex[i] = Resources::createTexture(GL_TEXTURE_2D, GL_RGBA16F, m_capacityWidth, m_capacityHeight);
+			Resources::setSampling(m_historyTex[i], GL_TEXTURE_2D, GL_LINEAR, GL_CLAMP_TO_EDGE);
+			Resources::attachTexture(m_historyFbo[i], GL_COLOR_ATTACHMENT0, m_historyTex[i]);
+
+			auto success = Resources::isComplete(m_historyFbo[i]);
+			assert(success);
+		}
+	}
+
+	void TAA::reset()
+	{
+		m_historyValid = false;
+	}
+}
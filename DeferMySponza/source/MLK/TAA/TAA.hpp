@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../Utils.hpp"
+#include <glm/glm.hpp>
+
+namespace MLK
+{
+	class ShaderManager;
+	class GlStateManager;
+	class MeshManager;
+
+	/// <summary>
+	/// Temporal anti-aliasing. Each frame is rendered with a sub-pixel jitter and blended into a history that is
+	/// reprojected with the GBuffer motion vectors and clamped to the current neighbourhood. The history is kept at
+	/// output resolution, so the input may be rendered smaller and still resolve to a full size image. It's
+	/// allocated at a capacity that can be larger than the output, resolving into the corner the output covers.
+	/// </summary>
+	class TAA
+	{
+	public:
+		TAA(ShaderManager* shaderManager,
+			GlStateManager* stateManager,
+			MeshManager* meshManager,
+			GLuint width = 1280,
+			GLuint height = 720);
+		~TAA();
+
+		// Sub-pixel offset in pixels, between -0.5 and 0.5, to render <frameIndex> with.
+		static glm::vec2 getJitter(GLuint frameIndex);
+
+		// Resolves <input> against the history into <outputFbo>, the history is seeded from <inputFbo> when empty.
+		// Leaves the viewport at output resolution. The history stays HDR, a non zero <exposure> only tonemaps what's
+		// written to <outputFbo>.
+		void run(GLuint input, GLuint inputFbo, GLuint velocity, GLuint outputFbo = 0, float exposure = 0.f);
+
+		// Input is rendered <inputWidth> by <inputHeight> and resolved at <width> by <height>, which must fit the
+		// capacity. The history is discarded when the output size changes.
+		void resizeBuffers(GLuint inputWidth, GLuint inputHeight, GLuint width, GLuint height);
+
+		// Replaces the history with one <width> by <height>, discarding it.
+		void setCapacity(GLuint width, GLuint height);
+
+		// Discards the history, for when it no longer matches what is being rendered.
+		void reset();
+
+	private:
+		// Replaces the history textures with ones of the current capacity.
+		void allocateHistory();
+
+	private:
+		ShaderManager* m_shaderManager;
+		GlStateManager* m_stateManager;
+		MeshManager* m_meshManager;
+		GLuint m_width = 1280;
+		GLuint m_height = 720;
+		GLuint m_inputWidth = 1280;
+		GLuint m_inputHeight = 720;
+		GLuint m_capacityWidth = 1280;
+		GLuint m_capacityHeight = 720;
+
+		// Ping-pong history, one is read while the other is stored to. The framebuffers are only for seeding it.
+		GLuint m_historyFbo[2] = {};
+		GLuint m_historyTex[2] = {};
+		GLuint m_currentHistory = 0;
+		bool m_historyValid = false;
+	};
+}
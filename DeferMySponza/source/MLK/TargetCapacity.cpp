@@ -0,0 +1,137 @@
+#include "TargetCapacity.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace MLK
+{
+    namespace
+    {
+        // Pixels per bucket, a drag has to cross one of these edges before anything is reallocated.
+        const GLuint g_bucketSize = 256;
+
+        // Frames the targets must have been a bucket too large before they shrink, a couple of seconds.
+        const GLuint g_shrinkDelayFrames = 120;
+
+        // Weight given to the newest frame when smoothing, as the profiler does.
+        const float g_smoothing = 0.1f;
+
+        float millisecondsBetween(std::chrono::high_resolution_clock::time_point start, std::chrono::high_resolution_clock::time_point end)
+        {
+            return std::chrono::duration<float, std::milli>(end - start).count();
+        }
+    }
+
+    TargetCapacity::TargetCapacity(const char* name) :
+        m_name(name)
+    {
+    }
+
+    GLuint TargetCapacity::bucket(GLuint size)
+    {
+        return std::max(1u, (size + g_bucketSize - 1) / g_bucketSize) * g_bucketSize;
+    }
+
+    bool TargetCapacity::fit(GLuint width, GLuint height)
+    {
+        m_usedWidth = width;
+        m_usedHeight = height;
+
+        // Any resize restarts the wait to shrink, so it never happens partway through a drag.
+        m_oversizedFrames = 0;
+
+        if (width <= m_width && height <= m_height)
+        {
+            return false;
+        }
+
+        m_width = std::max(m_width, bucket(width));
+        m_height = std::max(m_height, bucket(height));
+        return true;
+    }
+
+    bool TargetCapacity::endFrame()
+    {
+        const auto neededWidth = bucket(m_usedWidth);
+        const auto neededHeight = bucket(m_usedHeight);
+        if (neededWidth >= m_width && neededHeight >= m_height)
+        {
+            m_oversizedFrames = 0;
+            return false;
+        }
+
+        if (++m_oversizedFrames < g_shrinkDelayFrames)
+        {
+            return false;
+        }
+
+        m_width = neededWidth;
+        m_height = neededHeight;
+        m_oversizedFrames = 0;
+        ++m_shrinks;
+        return true;
+    }
+
+    void TargetCapacity::beginResize()
+    {
+        m_resizeStart = Clock::now();
+    }
+
+    void TargetCapacity::endResize(bool reallocated)
+    {
+        const auto ms = millisecondsBetween(m_resizeStart, Clock::now());
+        ++m_resizes;
+        m_totalResizeMs += ms;
+        m_maxResizeMs = std::max(m_maxResizeMs, ms);
+        if (reallocated)
+        {
+            ++m_reallocations;
+            m_totalReallocationMs += ms;
+        }
+        m_resizedThisFrame = true;
+    }
+
+    void TargetCapacity::frameStarted()
+    {
+        const auto now = Clock::now();
+        if (m_frameStarted)
+        {
+            const auto frameMs = millisecondsBetween(m_frameStart, now);
+            if (m_resizedThisFrame)
+            {
+                ++m_hitchFrames;
+                m_totalHitchMs += frameMs;
+                m_maxHitchMs = std::max(m_maxHitchMs, frameMs);
+            }
+            else
+            {
+                m_typicalFrameMs = m_typicalFrameMs == 0.f ? frameMs : m_typicalFrameMs + (frameMs - m_typicalFrameMs) * g_smoothing;
+            }
+        }
+
+        m_frameStart = now;
+        m_frameStarted = true;
+        m_resizedThisFrame = false;
+    }
+
+    void TargetCapacity::printStats() const
+    {
+        std::cout << m_name << " capacity: " << m_width << "x" << m_height << " for " << m_usedWidth << "x" << m_usedHeight
+            << ", " << m_resizes << " resizes, " << m_reallocations << " reallocating (" << m_shrinks << " deferred shrinks)";
+        if (m_resizes > 0)
+        {
+            std::cout << ", " << m_totalResizeMs / m_resizes << "ms average, " << m_maxResizeMs << "ms worst";
+        }
+        if (m_reallocations > 0)
+        {
+            std::cout << ", " << m_totalReallocationMs / m_reallocations << "ms average reallocating";
+        }
+        std::cout << std::endl;
+
+        if (m_hitchFrames > 0)
+        {
+            std::cout << "  Frames with a resize: " << m_totalHitchMs / m_hitchFrames << "ms average, " << m_maxHitchMs
+                << "ms worst, against " << m_typicalFrameMs << "ms without" << std::endl;
+        }
+    }
+}
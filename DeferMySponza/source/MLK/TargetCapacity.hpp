@@ -0,0 +1,71 @@
+#pragma once
+
+#include <tgl/tgl.h>
+
+#include <chrono>
+
+namespace MLK
+{
+    /// <summary>
+    /// Decides how large render targets are allocated, so a resize doesn't have to replace them. Capacity is
+    /// rounded up to whole buckets and only grows when the size outgrows it, rendering otherwise using the corner
+    /// the viewport covers. Targets sampled by UV scale their UVs down to that corner. Shrinking waits until the
+    /// size has fit a smaller bucket for a while, so dragging a window back and forth doesn't reallocate on every
+    /// step. Resizes are timed, along with the frame each one lands in, to show the hitch a resize causes.
+    /// </summary>
+    class TargetCapacity
+    {
+    public:
+        TargetCapacity(const char* name);
+
+        // Records the size now rendered at, returning true when the targets must grow to hold it.
+        bool fit(GLuint width, GLuint height);
+
+        // Counts frames the targets have been larger than needed, returning true once they should shrink.
+        bool endFrame();
+
+        GLuint getWidth() const { return m_width; }
+        GLuint getHeight() const { return m_height; }
+
+        // Times the work of a resize between the two calls, <reallocated> saying whether targets were replaced.
+        void beginResize();
+        void endResize(bool reallocated);
+
+        // Measures the time since the last frame started, put down to a resize if one happened in between.
+        void frameStarted();
+
+        void printStats() const;
+
+        // Smallest whole number of buckets holding <size> pixels.
+        static GLuint bucket(GLuint size);
+
+    private:
+        typedef std::chrono::high_resolution_clock Clock;
+
+        const char* m_name;
+
+        GLuint m_width = 0;
+        GLuint m_height = 0;
+        GLuint m_usedWidth = 0;
+        GLuint m_usedHeight = 0;
+        GLuint m_oversizedFrames = 0;
+
+        Clock::time_point m_resizeStart;
+        Clock::time_point m_frameStart;
+        bool m_frameStarted = false;
+        bool m_resizedThisFrame = false;
+
+        GLuint m_resizes = 0;
+        GLuint m_reallocations = 0;
+        GLuint m_shrinks = 0;
+        float m_totalResizeMs = 0.f;
+        float m_maxResizeMs = 0.f;
+        float m_totalReallocationMs = 0.f;
+
+        // Frames a resize landed in, against a smoothed frame time of the frames without one.
+        GLuint m_hitchFrames = 0;
+        float m_totalHitchMs = 0.f;
+        float m_maxHitchMs = 0.f;
+        float m_typicalFrameMs = 0.f;
+    };
+}
@@ -1,4 +1,5 @@
 #include "UniformManager.hpp"
+#include "Resources.hpp"
 
 // Camera not used but required for Context.hpp to compile.
 #include <sponza/Camera.hpp>
@@ -14,20 +15,16 @@ namespace MLK
         buffer.base = base;
         buffer.usage = usage;
 
-        glGenBuffers(1, &buffer.id);
-        glBindBuffer(GL_UNIFORM_BUFFER, buffer.id);
-        glBufferData(GL_UNIFORM_BUFFER, size, data, buffer.usage);
+        buffer.id = Resources::createBuffer(size, data, buffer.usage);
         glBindBufferBase(GL_UNIFORM_BUFFER, buffer.base, buffer.id);
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
         return buffer;
     }
 
-    void UniformManager::updateUniformBuffer(UniformBuffer buffer, size_t size, void* data)
+    void UniformManager::updateUniformBuffer(UniformBuffer buffer, size_t size, const void* data, size_t offset)
     {
-        glBindBuffer(GL_UNIFORM_BUFFER, buffer.id);
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        // Written by name, so the generic uniform buffer binding is never touched.
+        Resources::updateBuffer(buffer.id, offset, size, data);
     }
 
 	UniformManager::UniformManager(const sponza::Context& scene) :
@@ -45,6 +42,11 @@ namespace MLK
         updateUniformBuffer(m_uniformBuffers.at(id), size, data);
     }
 
+    void UniformManager::updateBufferData(UniformBufferId id, size_t offset, const void* data, size_t size)
+    {
+        updateUniformBuffer(m_uniformBuffers.at(id), size, data, offset);
+    }
+
 	void UniformManager::createUniformBuffers()
 	{
         m_uniformBuffers[UniformBufferId::Frame] =
@@ -61,5 +63,8 @@ namespace MLK
 
         m_uniformBuffers[UniformBufferId::Viewport] =
             createUniformBuffer(UniformBufferId::Viewport, sizeof(ViewportData), GL_DYNAMIC_READ);
+
+        m_uniformBuffers[UniformBufferId::PointShadowCube] =
+            createUniformBuffer(UniformBufferId::PointShadowCube, sizeof(PointShadowUniform), GL_STREAM_READ);
 	}
 }
\ No newline at end of file
@@ -32,6 +32,9 @@ namespace MLK
 
         void updateBufferData(UniformBufferId id, void* data, size_t size);
 
+        // Updates <size> bytes from <offset> into the buffer, <data> pointing at the first of them.
+        void updateBufferData(UniformBufferId id, size_t offset, const void* data, size_t size);
+
 	private:
 		const sponza::Context& m_scene;
 
@@ -41,6 +44,6 @@ namespace MLK
 
         // Static helper functions.
         static UniformBuffer createUniformBuffer(GLuint base, size_t size, GLuint usage, void* data = nullptr);
-        static void updateUniformBuffer(UniformBuffer buffer, size_t size, void* data = nullptr);
+        static void updateUniformBuffer(UniformBuffer buffer, size_t size, const void* data = nullptr, size_t offset = 0);
 	};
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "Utils.hpp"
+#include "Resources.hpp"
 
 #include <iostream>
+#include <algorithm>
 #include <tygra/FileHelper.hpp>
 #include <sponza/Camera.hpp>
 #include <sponza/Context.hpp>
@@ -12,6 +14,58 @@ namespace MLK
 {
     namespace Utils
     {
+        namespace
+        {
+            // Specifies every mip level of the moments texture bound to GL_TEXTURE_2D, so it's complete for its
+            // trilinear filter before the first filter pass has generated the mips and again after a resize.
+            void allocateMomentsLevels(GLuint resolution)
+            {
+                GLint level = 0;
+                for (GLuint size = resolution; ; size /= 2, ++level)
+                {
+                    glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA32F, size, size, 0, GL_RGBA, GL_FLOAT, 0);
+                    if (size == 1)
+                    {
+                        break;
+                    }
+                }
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level);
+            }
+
+            // Replaces the G-buffer's textures with new ones of the given size and attaches them, velocity being
+            // sampled with filtering when the TAA output is a different resolution.
+            void allocateGBufferTextures(GBuffer& buffer, GLuint width, GLuint height)
+            {
+                const GLuint textures[] = { buffer.posTex, buffer.normTex, buffer.matTex, buffer.velocityTex, buffer.depth };
+                glDeleteTextures(5, textures);
+
+                buffer.posTex = Resources::createTexture(GL_TEXTURE_RECTANGLE, GL_RGB32F, width, height);
+                buffer.normTex = Resources::createTexture(GL_TEXTURE_RECTANGLE, GL_RGB32F, width, height);
+                buffer.matTex = Resources::createTexture(GL_TEXTURE_RECTANGLE, GL_R8UI, width, height);
+                buffer.velocityTex = Resources::createTexture(GL_TEXTURE_RECTANGLE, GL_RG16F, width, height);
+                Resources::setParameter(buffer.velocityTex, GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                Resources::setParameter(buffer.velocityTex, GL_TEXTURE_RECTANGLE, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                buffer.depth = Resources::createTexture(GL_TEXTURE_2D, GL_DEPTH24_STENCIL8, width, height);
+
+                Resources::attachTexture(buffer.fbo, GL_COLOR_ATTACHMENT0, buffer.posTex);
+                Resources::attachTexture(buffer.fbo, GL_COLOR_ATTACHMENT1, buffer.normTex);
+                Resources::attachTexture(buffer.fbo, GL_COLOR_ATTACHMENT2, buffer.matTex);
+                Resources::attachTexture(buffer.fbo, GL_COLOR_ATTACHMENT3, buffer.velocityTex);
+                Resources::attachTexture(buffer.fbo, GL_DEPTH_STENCIL_ATTACHMENT, buffer.depth);
+            }
+
+            // Replaces the L-buffer's colour texture with a new one in its current format.
+            void allocateLBufferColour(LBuffer& buffer, GLuint width, GLuint height)
+            {
+                buffer.width = width;
+                buffer.height = height;
+                glDeleteTextures(1, &buffer.color);
+                buffer.color = Resources::createTexture(GL_TEXTURE_2D, buffer.format, width, height);
+                Resources::setSampling(buffer.color, GL_TEXTURE_2D, GL_LINEAR, GL_CLAMP_TO_EDGE);
+                Resources::attachTexture(buffer.fbo, GL_COLOR_ATTACHMENT0, buffer.color);
+            }
+        }
+
         glm::mat4 getViewProjectionMatrix(const sponza::Context& scene, float aspectRatio)
         {
             const auto& camera = scene.getCamera();
@@ -70,8 +124,8 @@ namespace MLK
 
         ShadowMap createShadowMap(GLuint resolution)
         {
-			// Understanding this should be a shadowSample and have the texture comparison parameters set,
-			// I found that a normal texture actually looks nicer than the shadow sampler.
+			// The depth texture stays unfiltered for the point sampled tier, PCF reads it through the comparison
+			// sampler instead.
             ShadowMap shadowMap;
 
             glGenTextures(1, &shadowMap.depthTex);
@@ -93,6 +147,45 @@ namespace MLK
 
             glDrawBuffer(GL_NONE);
 
+            // Moments for EVSM are kept at half resolution, the blur and mips make up for it. Exponential warping
+            // needs full floats.
+            const auto momentsRes = std::max(1u, resolution / 2);
+
+            glGenTextures(1, &shadowMap.momentsTex);
+            glBindTexture(GL_TEXTURE_2D, shadowMap.momentsTex);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            allocateMomentsLevels(momentsRes);
+
+            glGenFramebuffers(1, &shadowMap.momentsFbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, shadowMap.momentsFbo);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, shadowMap.momentsTex, 0);
+            assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+            glGenTextures(1, &shadowMap.blurTex);
+            glBindTexture(GL_TEXTURE_2D, shadowMap.blurTex);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, momentsRes, momentsRes, 0, GL_RGBA, GL_FLOAT, 0);
+
+            glGenFramebuffers(1, &shadowMap.blurFbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, shadowMap.blurFbo);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, shadowMap.blurTex, 0);
+            assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+            // PCF compares through a sampler object, so the depth texture itself stays a plain texture.
+            glGenSamplers(1, &shadowMap.compareSampler);
+            glSamplerParameteri(shadowMap.compareSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glSamplerParameteri(shadowMap.compareSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glSamplerParameteri(shadowMap.compareSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glSamplerParameteri(shadowMap.compareSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glSamplerParameteri(shadowMap.compareSampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glSamplerParameteri(shadowMap.compareSampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
             glBindFramebuffer(GL_FRAMEBUFFER, 0);
             glBindTexture(GL_TEXTURE_2D, 0);
 
@@ -103,34 +196,43 @@ namespace MLK
         {
             glBindTexture(GL_TEXTURE_2D, shadowMap.depthTex);
             glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, resolution, resolution, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, 0);
+
+            const auto momentsRes = std::max(1u, resolution / 2);
+            glBindTexture(GL_TEXTURE_2D, shadowMap.momentsTex);
+            allocateMomentsLevels(momentsRes);
+            glBindTexture(GL_TEXTURE_2D, shadowMap.blurTex);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, momentsRes, momentsRes, 0, GL_RGBA, GL_FLOAT, 0);
+
             glBindTexture(GL_TEXTURE_2D, 0);
         }
 
-		LBuffer createLBuffer(GLuint width, GLuint height, GLuint depth)
+        void deleteShadowMap(const ShadowMap& shadowMap)
+        {
+            const GLuint framebuffers[] = { shadowMap.fbo, shadowMap.momentsFbo, shadowMap.blurFbo };
+            const GLuint textures[] = { shadowMap.depthTex, shadowMap.momentsTex, shadowMap.blurTex };
+            glDeleteFramebuffers(3, framebuffers);
+            glDeleteTextures(3, textures);
+            glDeleteSamplers(1, &shadowMap.compareSampler);
+        }
+
+        void setExposure(GLint location, float exposure)
+        {
+            glUniform1f(location, exposure);
+        }
+
+		LBuffer createLBuffer(GLuint width, GLuint height, GLuint depth, GLenum format)
 		{
 			LBuffer buffer;
 			buffer.depth = depth;
-			glGenFramebuffers(1, &buffer.fbo);
-			glBindFramebuffer(GL_FRAMEBUFFER, buffer.fbo);
-
-			glGenTextures(1, &buffer.color);
-			glBindTexture(GL_TEXTURE_2D, buffer.color);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_BYTE, 0);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, buffer.color, 0);
+			buffer.format = format;
+			buffer.fbo = Resources::createFramebuffer();
 
-            glBindTexture(GL_TEXTURE_2D, depth);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+			allocateLBufferColour(buffer, width, height);
+            Resources::attachTexture(buffer.fbo, GL_DEPTH_STENCIL_ATTACHMENT, depth);
 
-			auto success = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+			auto success = Resources::isComplete(buffer.fbo);
 
-			assert(success == GL_FRAMEBUFFER_COMPLETE);
-            
-            glBindTexture(GL_TEXTURE_2D, 0);
-			glBindRenderbuffer(GL_RENDERBUFFER, 0);
+			assert(success);
 
 			return buffer;
 		}
@@ -138,71 +240,49 @@ namespace MLK
         GBuffer createGBuffer(GLuint width, GLuint height)
         {
             GBuffer buffer;
-            glGenFramebuffers(1, &buffer.fbo);
-            glBindFramebuffer(GL_FRAMEBUFFER, buffer.fbo);
+            buffer.fbo = Resources::createFramebuffer();
+
+			allocateGBufferTextures(buffer, width, height);
 
-			GLuint attachments[3] =
+			const GLenum attachments[4] =
 			{
 				GL_COLOR_ATTACHMENT0,
 				GL_COLOR_ATTACHMENT1,
-				GL_COLOR_ATTACHMENT2
+				GL_COLOR_ATTACHMENT2,
+				GL_COLOR_ATTACHMENT3
 			};
+			Resources::setDrawBuffers(buffer.fbo, 4, attachments);
 
-            glGenTextures(1, &buffer.posTex);
-            glBindTexture(GL_TEXTURE_RECTANGLE, buffer.posTex);
-            glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGB32F, width, height, 0, GL_RGB, GL_FLOAT, 0);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, attachments[0], GL_TEXTURE_RECTANGLE, buffer.posTex, 0);
-
-            glGenTextures(1, &buffer.normTex);
-            glBindTexture(GL_TEXTURE_RECTANGLE, buffer.normTex);
-
-            glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGB32F, width, height, 0, GL_RGB, GL_FLOAT, 0);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, attachments[1], GL_TEXTURE_RECTANGLE, buffer.normTex, 0);
-
-            glGenTextures(1, &buffer.matTex);
-            glBindTexture(GL_TEXTURE_RECTANGLE, buffer.matTex);
-            glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_R8UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, attachments[2], GL_TEXTURE_RECTANGLE, buffer.matTex, 0);
-			
-            glGenTextures(1, &buffer.depth);
-            glBindTexture(GL_TEXTURE_2D, buffer.depth);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, 0);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, buffer.depth, 0);
-
-			glDrawBuffers(3, attachments);
-
-            auto success = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            auto success = Resources::isComplete(buffer.fbo);
 
-			assert(success == GL_FRAMEBUFFER_COMPLETE);
-
-			glBindTexture(GL_TEXTURE_2D, 0);
-			glBindTexture(GL_TEXTURE_RECTANGLE, 0);
+			assert(success);
 
             return buffer;
         }
 
-		void resizeFramebuffers(GLuint width, GLuint height, GBuffer gbuffer, LBuffer lbuffer)
+		void resizeGBuffer(GLuint width, GLuint height, GBuffer& gbuffer, LBuffer& lbuffer)
 		{
-            glActiveTexture(TextureSlot::TEmpty);
-
-			glBindTexture(GL_TEXTURE_RECTANGLE, gbuffer.posTex);
-			glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGB32F, width, height, 0, GL_RGB, GL_FLOAT, 0);
-			glBindTexture(GL_TEXTURE_RECTANGLE, gbuffer.normTex);
-			glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGB32F, width, height, 0, GL_RGB, GL_FLOAT, 0);
-			glBindTexture(GL_TEXTURE_RECTANGLE, gbuffer.matTex);
-			glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_R8UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+			assert(gbuffer.depth == lbuffer.depth);
 
-			glBindTexture(GL_TEXTURE_2D, lbuffer.color);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_BYTE, 0);
+			// Storage is immutable, so every attachment is replaced and the framebuffer keeps its draw buffers.
+			allocateGBufferTextures(gbuffer, width, height);
 
-            glBindTexture(GL_TEXTURE_2D, gbuffer.depth);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, 0);
+			lbuffer.depth = gbuffer.depth;
+			Resources::attachTexture(lbuffer.fbo, GL_DEPTH_STENCIL_ATTACHMENT, lbuffer.depth);
+		}
 
-			assert(gbuffer.depth == lbuffer.depth);
+		void resizeLBuffer(GLuint width, GLuint height, LBuffer& lbuffer)
+		{
+			if (width != lbuffer.width || height != lbuffer.height)
+			{
+				allocateLBufferColour(lbuffer, width, height);
+			}
+		}
 
-			glBindRenderbuffer(GL_RENDERBUFFER, 0);
-			glBindTexture(GL_TEXTURE_RECTANGLE, 0);
-            glBindTexture(GL_TEXTURE_2D, 0);
+		void setLBufferFormat(GLenum format, LBuffer& lbuffer)
+		{
+			lbuffer.format = format;
+			allocateLBufferColour(lbuffer, lbuffer.width, lbuffer.height);
 		}
 
 		GLuint getTextureID(TextureSlot texLocation)
@@ -210,26 +290,18 @@ namespace MLK
 			return texLocation - GL_TEXTURE0;
 		}
 
-		void bindGBufferTextures(GBuffer gbuffer)
+		void bindGBufferTextures(const GBuffer& gbuffer)
 		{
-			glActiveTexture(TextureSlot::TPosition);
-			glBindTexture(GL_TEXTURE_RECTANGLE, gbuffer.posTex);
-			glActiveTexture(TextureSlot::TNormal);
-			glBindTexture(GL_TEXTURE_RECTANGLE, gbuffer.normTex);
-			glActiveTexture(TextureSlot::TMaterial);
-			glBindTexture(GL_TEXTURE_RECTANGLE, gbuffer.matTex);
-			glActiveTexture(TextureSlot::TEmpty);
+			Resources::bindTexture(TextureSlot::TPosition, GL_TEXTURE_RECTANGLE, gbuffer.posTex);
+			Resources::bindTexture(TextureSlot::TNormal, GL_TEXTURE_RECTANGLE, gbuffer.normTex);
+			Resources::bindTexture(TextureSlot::TMaterial, GL_TEXTURE_RECTANGLE, gbuffer.matTex);
 		}
 
 		void unbindGBufferTextures()
 		{
-			glActiveTexture(TextureSlot::TPosition);
-			glBindTexture(GL_TEXTURE_RECTANGLE, 0);
-			glActiveTexture(TextureSlot::TNormal);
-			glBindTexture(GL_TEXTURE_RECTANGLE, 0);
-			glActiveTexture(TextureSlot::TMaterial);
-			glBindTexture(GL_TEXTURE_RECTANGLE, 0);
-			glActiveTexture(TextureSlot::TEmpty);
+			Resources::bindTexture(TextureSlot::TPosition, GL_TEXTURE_RECTANGLE, 0);
+			Resources::bindTexture(TextureSlot::TNormal, GL_TEXTURE_RECTANGLE, 0);
+			Resources::bindTexture(TextureSlot::TMaterial, GL_TEXTURE_RECTANGLE, 0);
 		}
 
 		void setTextureUniform(GLuint program, const std::string& id, GLuint value)
@@ -1,7 +1,8 @@
 #pragma once
 
 #include <sponza/sponza_fwd.hpp>
-#define TGL_TARGET_GL_4_3
+// GL 4.3 is required. Later entry points are declared too, but only called once tglIsAvailable has found them.
+#define TGL_TARGET_GL_4_5
 #include <tgl/tgl.h>
 #include <glm/glm.hpp>
 
@@ -12,12 +13,29 @@
 namespace MLK
 {
     /// <summary>
-    /// Stores shadow map FBO and texture.
+    /// Shadow filtering tiers, from a single unfiltered tap up to prefiltered exponential variance maps.
+    /// </summary>
+    enum ShadowFilter
+    {
+        ShadowsOff,
+        PointFilter,
+        PCFFilter,
+        EVSMFilter
+    };
+
+    /// <summary>
+    /// Stores shadow map FBO and texture, along with the half resolution moments map and its blur target used by
+    /// EVSM filtering and the comparison sampler used by PCF.
     /// </summary>
     struct ShadowMap
     {
         GLuint fbo = 0;
         GLuint depthTex = 0;
+        GLuint momentsFbo = 0;
+        GLuint momentsTex = 0;
+        GLuint blurFbo = 0;
+        GLuint blurTex = 0;
+        GLuint compareSampler = 0;
     };
 
     /// <summary>
@@ -29,6 +47,9 @@ namespace MLK
 		GLuint color = 0;
 		GLuint depth = 0;
         GLuint stencil = 0;
+        GLenum format = GL_R11F_G11F_B10F;
+        GLuint width = 0;
+        GLuint height = 0;
 	};
 
     /// <summary>
@@ -42,6 +63,7 @@ namespace MLK
         GLuint posTex = 0;
         GLuint normTex = 0;
         GLuint matTex = 0;
+        GLuint velocityTex = 0;
     };
 
     /// <summary>
@@ -64,7 +86,8 @@ namespace MLK
         GBufferPosition,
         GBufferNormal,
         GBufferColour,
-        GBufferMaterial
+        GBufferMaterial,
+        GBufferVelocity
     };
 
 	/// <summary>
@@ -79,7 +102,10 @@ namespace MLK
 		TShadow,
 		TInput,
 		TArea,
-		TSearch
+		TSearch,
+		TVelocity,
+		THistory,
+		TPointShadow
 	};
 
     /// <summary>
@@ -91,7 +117,37 @@ namespace MLK
         Frame,
         Light,
         Shadow,
-        Viewport
+        Viewport,
+        PointShadowCube
+    };
+
+    /// <summary>
+    /// Enum used for shader storage block bindings to ensure they are consistent.
+    /// </summary>
+    enum StorageBufferId
+    {
+        SMAATiles = 0
+    };
+
+    /// <summary>
+    /// Enum to name image units used by compute shaders.
+    /// </summary>
+    enum ImageUnit
+    {
+        IOutput = 0
+    };
+
+    /// <summary>
+    /// Enum to name plain uniforms set per draw, whose locations are looked up once when programs are linked.
+    /// </summary>
+    enum UniformId
+    {
+        UExposure = 0,
+        UStepCount,
+        UDirection,
+        UFace,
+        UInputScale,
+        UHistoryScale
     };
 
     namespace Utils
@@ -104,7 +160,7 @@ namespace MLK
 		/// <summary>
 		/// Bind the GBuffer textures for use.
 		/// </summary>
-		void bindGBufferTextures(GBuffer gbuffer);
+		void bindGBufferTextures(const GBuffer& gbuffer);
 
 		/// <summary>
 		/// Unbind the GBuffer textures for drawing to.
@@ -128,24 +184,45 @@ namespace MLK
         ShadowMap createShadowMap(GLuint resolution);
 
         /// <summary>
-        /// Resize the depthTex attachment of a givne shadow map.
+        /// Resize the depthTex attachment of a givne shadow map, and its moments textures to match.
         /// </summary>
         void resizeShadowMap(ShadowMap shadowMap, GLuint resolution);
 
+        /// <summary>
+        /// Delete every GL object owned by a shadow map.
+        /// </summary>
+        void deleteShadowMap(const ShadowMap& shadowMap);
+
 		/// <summary>
-		/// Create a framebuffer with <depth> depth attachment and RGBA8 colours.
+		/// Create a framebuffer with <depth> depth attachment and <format> colours, HDR packed float by default.
 		/// </summary>
-		LBuffer createLBuffer(GLuint width, GLuint height, GLuint depth);
+		LBuffer createLBuffer(GLuint width, GLuint height, GLuint depth, GLenum format = GL_R11F_G11F_B10F);
+
+        /// <summary>
+        /// Set the exposure used to tonemap at <location> in the program in use, 0 leaves colours untouched.
+        /// </summary>
+        void setExposure(GLint location, float exposure);
 
 		/// <summary>
-		/// Create a framebuffer with <depth> depth, RGB32F position, RGB32F normal and R8UI material attachments.
+		/// Create a framebuffer with <depth> depth, RGB32F position, RGB32F normal, R8UI material and RG16F velocity attachments.
 		/// </summary>
         GBuffer createGBuffer(GLuint width, GLuint height);
 
         /// <summary>
-        /// Set height and width of GBuffer and LBuffer attachments, assuming a shared depth buffer.
+        /// Set height and width of the GBuffer attachments and the depth buffer it shares with the LBuffer. The
+        /// attachments are replaced, so their ids change.
+        /// </summary>
+        void resizeGBuffer(GLuint width, GLuint height, GBuffer& gbuffer, LBuffer& lbuffer);
+
+        /// <summary>
+        /// Set height and width of the LBuffer colour, only reallocated when the size changes.
+        /// </summary>
+        void resizeLBuffer(GLuint width, GLuint height, LBuffer& lbuffer);
+
+        /// <summary>
+        /// Reallocate the LBuffer colour in <format> at its current size.
         /// </summary>
-        void resizeFramebuffers(GLuint width, GLuint height, GBuffer gbuffer, LBuffer lbuffer);
+        void setLBufferFormat(GLenum format, LBuffer& lbuffer);
 
         /// <summary>
         /// Given a scene and aspect ratio outputs the ViewProjection matrix.
@@ -1,5 +1,6 @@
 #include "MyController.hpp"
 #include "MyView.hpp"
+#include "MLK/Simulation.hpp"
 
 #include <sponza/sponza.hpp>
 #include <tygra/Window.hpp>
@@ -14,14 +15,22 @@ MyController::MyController() : camera_turn_mode_(false)
     camera_move_speed_[3] = 0;
     camera_rotate_speed_[0] = 0;
     camera_rotate_speed_[1] = 0;
+    mouse_rotation_[0] = 0;
+    mouse_rotation_[1] = 0;
     scene_ = new sponza::Context();
+    // The view renders from its own copy of the scene, refreshed from the simulation's snapshots each frame.
+    render_scene_ = new sponza::Context(*scene_);
+    simulation_ = new MLK::Simulation(*scene_);
     view_ = new MyView();
-    view_->setScene(scene_);
+    view_->setScene(render_scene_);
+    view_->setSimulation(simulation_);
 }
 
 MyController::~MyController()
 {
+    delete simulation_;
     delete view_;
+    delete render_scene_;
     delete scene_;
 }
 
@@ -30,24 +39,53 @@ void MyController::windowControlWillStart(tygra::Window * window)
     window->setView(view_);
     window->setTitle("Real-Time Graphics :: DeferMySponza");
     std::cout << "Real-Time Graphics :: DeferMySponza" << std::endl;
+    std::cout << "  Press F1 to toggle the light budget" << std::endl;
     std::cout << "  Press F2 to toggle an animated camera" << std::endl;
+    std::cout << "  Press F3 to toggle the quality governor" << std::endl;
+    std::cout << "  Press F4 to toggle light occlusion queries" << std::endl;
     std::cout << "  Press F5 to recompile shaders (RELEASE ONLY)" << std::endl;
-    std::cout << "  Press F7 to toggle shadows" << std::endl;
+    std::cout << "  Press F7 to cycle shadow filtering (off, point, PCF, EVSM)" << std::endl;
     std::cout << "  Press F8 to toggle SSR" << std::endl;
     std::cout << "  Press F9 to toggle SMAA 1x" << std::endl;
+    std::cout << "  Press F10 to toggle compute SMAA" << std::endl;
+    std::cout << "  Press F11 to toggle TAA (replaces SMAA)" << std::endl;
+    std::cout << "  Press F6 to print GPU pass timings and the job trace" << std::endl;
+    std::cout << "  Press F12 to cycle the light accumulation format" << std::endl;
+    std::cout << "  Press L to toggle layered point shadows against six passes" << std::endl;
+    std::cout << "  Press U to toggle time-sliced spot shadow updates" << std::endl;
+    std::cout << "  Press T to toggle the threaded simulation" << std::endl;
+    std::cout << "  Press C to toggle CPU frustum culling of instances" << std::endl;
+    std::cout << "  Press B to toggle shadow caster queries through the instance BVH" << std::endl;
+    std::cout << "  Press V to toggle PVS filtering, baking sponza.pvs first if there isn't one" << std::endl;
+    std::cout << "  Press O to toggle masked software occlusion culling of instances" << std::endl;
+    std::cout << "  Press K to toggle front to back draw order for the G-buffer and shadow maps" << std::endl;
+    std::cout << "  Press Q to benchmark CPU draw submission through the render queue against immediate draws" << std::endl;
+    std::cout << "  Press G to toggle direct state access for resource edits and texture binds" << std::endl;
+    std::cout << "  Press H to write the last frame's job trace to job_trace.json" << std::endl;
+    std::cout << "  Press P to pick the instance at the centre of the screen" << std::endl;
+    std::cout << "  Press J to benchmark the job system, culling and BVH queries on a 100k instance, 10k light scene" << std::endl;
 }
 
 void MyController::windowControlDidStop(tygra::Window * window)
 {
+    simulation_->setThreaded(false);
     window->setView(nullptr);
 }
 
 void MyController::windowControlViewWillRender(tygra::Window * window)
 {
-    scene_->update();
+    // Mouse look turns the camera for a single update by the movement gathered over the last frame.
     if (camera_turn_mode_) {
-        scene_->getCamera().setRotationalVelocity(sponza::Vector2(0, 0));
+        const float dx = mouse_rotation_[0];
+        const float dy = mouse_rotation_[1];
+        simulation_->post([dx, dy](sponza::Context& scene) {
+            scene.getCamera().setRotationalVelocity(sponza::Vector2(dx, dy));
+        }, dx != 0.f || dy != 0.f);
+        mouse_rotation_[0] = 0;
+        mouse_rotation_[1] = 0;
     }
+
+    simulation_->acquire(*render_scene_);
 }
 
 void MyController::windowControlMouseMoved(tygra::Window * window,
@@ -60,8 +98,8 @@ void MyController::windowControlMouseMoved(tygra::Window * window,
         int dx = x - prev_x;
         int dy = y - prev_y;
         const float mouse_speed = 0.6f;
-        scene_->getCamera().setRotationalVelocity(
-			sponza::Vector2(-dx * mouse_speed, -dy * mouse_speed));
+        mouse_rotation_[0] += -dx * mouse_speed;
+        mouse_rotation_[1] += -dy * mouse_speed;
     }
     prev_x = x;
     prev_y = y;
@@ -73,6 +111,11 @@ void MyController::windowControlMouseButtonChanged(tygra::Window * window,
 {
     if (button_index == tygra::kWindowMouseButtonLeft) {
         camera_turn_mode_ = down;
+        if (!down) {
+            simulation_->post([](sponza::Context& scene) {
+                scene.getCamera().setRotationalVelocity(sponza::Vector2(0, 0));
+            });
+        }
     }
 }
 
@@ -113,10 +156,19 @@ void MyController::windowControlKeyboardChanged(tygra::Window * window,
     switch (key_index)
     {
     case tygra::kWindowKeyF2:
-        scene_->toggleCameraAnimation();
+        simulation_->post([](sponza::Context& scene) { scene.toggleCameraAnimation(); });
+        break;
+    case tygra::kWindowKeyF1:
+        view_->toggleLightBudget();
+        break;
+    case tygra::kWindowKeyF3:
+        view_->toggleGovernor();
+        break;
+    case tygra::kWindowKeyF4:
+        view_->toggleOcclusion();
         break;
     case tygra::kWindowKeyF7:
-        view_->toggleShadows();
+        view_->cycleShadowFilter();
         break;
     case tygra::kWindowKeyF8:
         view_->toggleSSR();
@@ -124,9 +176,61 @@ void MyController::windowControlKeyboardChanged(tygra::Window * window,
     case tygra::kWindowKeyF9:
         view_->toggleSMAA();
         break;
+    case tygra::kWindowKeyF10:
+        view_->toggleComputeSMAA();
+        break;
+    case tygra::kWindowKeyF11:
+        view_->toggleTAA();
+        break;
+    case tygra::kWindowKeyF6:
+        view_->printTimings();
+        break;
+    case tygra::kWindowKeyF12:
+        view_->cycleLightFormat();
+        break;
     case tygra::kWindowKeyF5:
         view_->recompileShaders();
         break;
+    case 'L':
+        view_->toggleLayeredPointShadows();
+        break;
+    case 'U':
+        view_->toggleShadowScheduler();
+        break;
+    case 'T':
+        simulation_->setThreaded(!simulation_->isThreaded());
+        std::cout << "Simulation: " << (simulation_->isThreaded() ? "threaded" : "serial") << std::endl;
+        break;
+    case 'J':
+        view_->runJobBenchmark();
+        break;
+    case 'C':
+        view_->toggleInstanceCulling();
+        break;
+    case 'B':
+        view_->toggleBVHQueries();
+        break;
+    case 'V':
+        view_->togglePVS();
+        break;
+    case 'O':
+        view_->toggleMaskedOcclusion();
+        break;
+    case 'K':
+        view_->toggleDrawSorting();
+        break;
+    case 'Q':
+        view_->runRenderQueueBenchmark();
+        break;
+    case 'G':
+        view_->toggleDirectStateAccess();
+        break;
+    case 'H':
+        view_->writeJobTrace();
+        break;
+    case 'P':
+        view_->pickInstance();
+        break;
     }
 }
 
@@ -173,9 +277,7 @@ void MyController::windowControlGamepadAxisMoved(tygra::Window * window,
         else {
             camera_rotate_speed_[0] = 0.f;
         }
-        scene_->getCamera().setRotationalVelocity(
-			sponza::Vector2(camera_rotate_speed_[0] * rotate_speed,
-                           camera_rotate_speed_[1] * rotate_speed));
+        updateCameraRotation(rotate_speed);
         break;
     case tygra::kWindowGamepadAxisRightThumbY:
         if (pos < -deadzone || pos > deadzone) {
@@ -184,9 +286,7 @@ void MyController::windowControlGamepadAxisMoved(tygra::Window * window,
         else {
             camera_rotate_speed_[1] = 0.f;
         }
-        scene_->getCamera().setRotationalVelocity(
-			sponza::Vector2(camera_rotate_speed_[0] * rotate_speed,
-                           camera_rotate_speed_[1] * rotate_speed));
+        updateCameraRotation(rotate_speed);
         break;
     }
 
@@ -207,6 +307,16 @@ void MyController::updateCameraTranslation()
         + key_speed * camera_move_speed_[1];
     const float forward_speed = key_speed * camera_move_speed_[2]
         - key_speed * camera_move_speed_[3];
-    scene_->getCamera().setLinearVelocity(
-		sponza::Vector3(sideward_speed, 0, forward_speed));
+    simulation_->post([sideward_speed, forward_speed](sponza::Context& scene) {
+        scene.getCamera().setLinearVelocity(sponza::Vector3(sideward_speed, 0, forward_speed));
+    });
+}
+
+void MyController::updateCameraRotation(float rotate_speed)
+{
+    const float x = camera_rotate_speed_[0] * rotate_speed;
+    const float y = camera_rotate_speed_[1] * rotate_speed;
+    simulation_->post([x, y](sponza::Context& scene) {
+        scene.getCamera().setRotationalVelocity(sponza::Vector2(x, y));
+    });
 }
@@ -5,6 +5,11 @@
 
 class MyView;
 
+namespace MLK
+{
+    class Simulation;
+}
+
 class MyController : public tygra::WindowControlDelegate
 {
 public:
@@ -47,11 +52,15 @@ private:
                                            bool down) override;
 
     void updateCameraTranslation();
+    void updateCameraRotation(float rotate_speed);
 
     MyView * view_;
 	sponza::Context * scene_;
+    sponza::Context * render_scene_;
+    MLK::Simulation * simulation_;
 
     bool camera_turn_mode_;
     float camera_move_speed_[4];
     float camera_rotate_speed_[2];
+    float mouse_rotation_[2];
 };
@@ -7,15 +7,51 @@
 #include "MLK/MaterialManager.hpp"
 #include "MLK/SMAA/SMAA.hpp"
 #include "MLK/SSR/SSR.hpp"
+#include "MLK/TAA/TAA.hpp"
+#include "MLK/Profiler.hpp"
+#include "MLK/QualityGovernor.hpp"
+#include "MLK/LightCuller.hpp"
+#include "MLK/LightOcclusion.hpp"
+#include "MLK/LightBudget.hpp"
+#include "MLK/PointShadows.hpp"
+#include "MLK/SceneBounds.hpp"
+#include "MLK/PotentialVisibility.hpp"
+#include "MLK/MaskedOcclusion.hpp"
+#include "MLK/DrawSorter.hpp"
+#include "MLK/PipelineStatistics.hpp"
+#include "MLK/RenderQueue.hpp"
+#include "MLK/ShadowScheduler.hpp"
+#include "MLK/Simulation.hpp"
+#include "MLK/JobSystem.hpp"
+#include "MLK/JobBenchmark.hpp"
+#include "MLK/PostProcessChain.hpp"
+#include "MLK/Resources.hpp"
+#include "MLK/TargetCapacity.hpp"
 
 #include <tygra/FileHelper.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <sponza/sponza.hpp>
 #include <iostream>
 #include <cassert>
+#include <cstddef>
+#include <algorithm>
 
 namespace MU = M::Utils;
 
+namespace
+{
+    const char* g_shadowFilterNames[] = { "off", "point sampled", "PCF", "EVSM" };
+
+    // Baked visibility sets, relative so they land in the working directory like the job trace.
+    const char* g_pvsPath = "sponza.pvs";
+
+    // Chrome trace of the last frame's jobs, written only when asked for.
+    const char* g_jobTracePath = "job_trace.json";
+
+    // Draws the render queue benchmark submits, each a single instance.
+    const GLuint g_queueBenchmarkDraws = 8192;
+}
+
 MyView::MyView()
 {
 }
@@ -29,6 +65,11 @@ void MyView::setScene(const sponza::Context * sponza)
     scene_ = sponza;
 }
 
+void MyView::setSimulation(M::Simulation* simulation)
+{
+    m_simulation = simulation;
+}
+
 void MyView::recompileShaders()
 {
     m_shaderManager->recompileShaders();
@@ -39,13 +80,23 @@ void MyView::windowViewWillStart(tygra::Window * window)
 	assert(scene_ != nullptr);
 
     updateAspectRatio(false);
-
-    // Create required resources.
-    m_gBuffer = MU::createGBuffer(m_windowWidth, m_windowHeight);
-    m_lBuffer = MU::createLBuffer(m_windowWidth, m_windowHeight, m_gBuffer.depth);
-    m_shadowMap = MU::createShadowMap(m_shadowRes);
+    updateRenderResolution(1.f);
+
+    // Create required resources, by name where the context allows it. Render targets are allocated with room to
+    // grow, see updateViewportData.
+    M::Resources::init();
+    m_targetCapacity = new M::TargetCapacity("Render targets");
+    m_targetCapacity->fit(m_renderWidth, m_renderHeight);
+    m_outputCapacity = new M::TargetCapacity("Output targets");
+    m_outputCapacity->fit(m_windowWidth, m_windowHeight);
+    const auto capacityWidth = m_targetCapacity->getWidth();
+    const auto capacityHeight = m_targetCapacity->getHeight();
+    m_gBuffer = MU::createGBuffer(capacityWidth, capacityHeight);
+    m_lBuffer = MU::createLBuffer(capacityWidth, capacityHeight, m_gBuffer.depth);
 
     // Create managers.
+    m_jobs = new M::JobSystem();
+
     m_meshManager = new M::MeshManager(*scene_);
 
     m_materialManager = new M::MaterialManager(*scene_);
@@ -56,9 +107,33 @@ void MyView::windowViewWillStart(tygra::Window * window)
 
     m_glStateManager = new M::GlStateManager();
     
-    m_ssr = new MLK::SSR(m_shaderManager, m_glStateManager, m_meshManager, m_windowWidth, m_windowHeight);
+    m_ssr = new MLK::SSR(m_shaderManager, m_glStateManager, m_meshManager);
+
+    m_smaa = new M::SMAA(m_shaderManager, m_glStateManager, m_meshManager, capacityWidth, capacityHeight);
 
-    m_smaa = new M::SMAA(m_shaderManager, m_glStateManager, m_meshManager, m_windowWidth, m_windowHeight);
+    m_taa = new M::TAA(m_shaderManager, m_glStateManager, m_meshManager, m_outputCapacity->getWidth(), m_outputCapacity->getHeight());
+
+    m_postProcess = new M::PostProcessChain(m_shaderManager, m_glStateManager, m_meshManager, capacityWidth, capacityHeight);
+    m_postProcess->setFormat(m_lBuffer.format);
+    m_postProcess->setExposure(m_exposure);
+
+    m_profiler = new M::Profiler();
+
+    m_governor = new M::QualityGovernor();
+
+    m_lightCuller = new M::LightCuller();
+    m_pointOcclusion = new M::LightOcclusion("Point light");
+    m_spotOcclusion = new M::LightOcclusion("Spot light");
+    m_lightBudget = new M::LightBudget(*m_jobs);
+    m_sceneBounds = new M::SceneBounds(*scene_);
+    m_pvs = new M::PotentialVisibility(*scene_);
+    m_pvs->load(g_pvsPath);
+    m_maskedOcclusion = new M::MaskedOcclusion(*scene_);
+    m_drawSorter = new M::DrawSorter(*scene_);
+    m_gBufferStatistics = new M::PipelineStatistics("GBuffer");
+    m_renderQueue = new M::RenderQueue(*m_shaderManager, *m_glStateManager, *m_meshManager);
+    m_pointShadows = new M::PointShadows(m_shaderManager, m_glStateManager, m_meshManager, m_uniformManager, *m_sceneBounds);
+    m_shadowScheduler = new M::ShadowScheduler(m_shadowRes);
 
     // Set static data on start.
     updateStaticData();
@@ -83,6 +158,26 @@ void MyView::windowViewDidStop(tygra::Window * window)
     delete m_glStateManager;
     delete m_ssr;
     delete m_smaa;
+    delete m_taa;
+    delete m_postProcess;
+    delete m_profiler;
+    delete m_governor;
+    delete m_lightCuller;
+    delete m_pointOcclusion;
+    delete m_spotOcclusion;
+    delete m_lightBudget;
+    delete m_pointShadows;
+    delete m_sceneBounds;
+    delete m_pvs;
+    delete m_maskedOcclusion;
+    delete m_drawSorter;
+    delete m_gBufferStatistics;
+    delete m_renderQueue;
+    delete m_targetCapacity;
+    delete m_outputCapacity;
+    delete m_shadowScheduler;
+    delete m_jobBenchmark;
+    delete m_jobs;
 }
 
 void MyView::updateStaticData()
@@ -104,96 +199,374 @@ void MyView::updateStaticData()
 
 void MyView::updateFrameData()
 {
+    // Last frame's matrices are kept for motion vectors, the first frame has no motion.
+    const bool hasPreviousFrame = m_frameIndex > 0;
+    const auto viewProjection = MLK::Utils::getViewProjectionMatrix(*scene_, m_aspectRatio);
+    m_frameData.PreviousViewProjectionMatrix = hasPreviousFrame ? m_frameData.UnjitteredViewProjectionMatrix : viewProjection;
+    m_frameData.UnjitteredViewProjectionMatrix = viewProjection;
+
+    // TAA offsets the whole frame by a sub-pixel amount, applied in clip space so it's independent of depth.
+    glm::vec2 jitter(0.f);
+    if (m_useTAA)
+    {
+        jitter = M::TAA::getJitter(m_frameIndex) * 2.f / glm::vec2(m_renderWidth, m_renderHeight);
+    }
+
     m_frameData.EyePosition = (const glm::vec3&)scene_->getCamera().getPosition();
-    m_frameData.ViewProjectionMatrix = MLK::Utils::getViewProjectionMatrix(*scene_, m_aspectRatio);
+    m_frameData.ViewProjectionMatrix = glm::translate(glm::mat4(1.f), glm::vec3(jitter, 0.f)) * viewProjection;
+
+    const auto& journal = scene_->getChangeJournal();
+    const auto changes = journal.getChangesSince(m_sceneVersion);
+    m_sceneVersion = journal.getVersion();
+    applySceneChanges(changes);
+
+    // Only instances the scene reports changed are rewritten, along with those that changed the frame before so
+    // their previous transform catches up and they stop reporting motion.
+    const auto transforms = scene_->getInstanceTransforms();
+    const auto meshIds = scene_->getInstanceMeshIds();
+    const auto materialIds = scene_->getInstanceMaterialIds();
+    const sponza::InstanceRange allInstances = { 0, transforms.size() };
+
+    m_instanceUpdates = m_changedInstances;
+    if (changes.everything || !hasPreviousFrame)
+    {
+        m_changedInstances.assign(1, allInstances);
+    }
+    else
+    {
+        m_changedInstances = changes.instances;
+    }
+    m_instanceUpdates.insert(m_instanceUpdates.end(), m_changedInstances.begin(), m_changedInstances.end());
+    sponza::mergeInstanceRanges(m_instanceUpdates);
+
+    m_instanceUpdateIds.clear();
+    for (const auto& range : m_instanceUpdates)
+    {
+        for (auto i = range.first; i < range.first + range.count; ++i)
+        {
+            m_instanceUpdateIds.push_back((GLuint)i);
+        }
+    }
+    m_sceneChangeStats.instancesWritten = (GLuint)m_instanceUpdateIds.size();
 
-    unsigned int counter = 0;
-    for (const auto& instance : scene_->getAllInstances())
+    // Read straight from the scene's instance arrays, nothing is copied out per instance.
+    m_jobs->parallelFor("Instance data", m_instanceUpdateIds.size(), 256, [&](size_t begin, size_t end)
     {
-        const auto& modelTransform = glm::mat4(
-            (const glm::mat4x3&)instance.getTransformationMatrix());
+        for (auto u = begin; u < end; ++u)
+        {
+            const auto i = m_instanceUpdateIds[u];
+            const auto& modelTransform = glm::mat4((const glm::mat4x3&)transforms[i]);
+
+            // Special case required for only sponza's floor to be reflective.
+            GLuint materialId = 0;
+            if (meshIds[i] == 311)
+            {
+                materialId = m_materialManager->lookupMaterialId(100);
+            }
+            else
+            {
+                materialId = m_materialManager->lookupMaterialId(materialIds[i]);
+            }
+
+            const auto& previousTransform = hasPreviousFrame ? m_frameData.InstanceData[i].ModelTransform : modelTransform;
+            const M::MeshInstanceData instanceData(modelTransform, previousTransform, materialId);
+
+            m_frameData.InstanceData[i] = instanceData;
+        }
+    });
+
+    // The view matrices change every frame, instance data only where it was rewritten.
+    const auto viewOffset = offsetof(M::PerFrameUniformData, ViewProjectionMatrix);
+    m_uniformManager->updateBufferData(M::UniformBufferId::Frame, viewOffset, (const GLubyte*)&m_frameData + viewOffset,
+        sizeof(m_frameData) - viewOffset);
+    for (const auto& range : m_instanceUpdates)
+    {
+        m_uniformManager->updateBufferData(M::UniformBufferId::Frame,
+            offsetof(M::PerFrameUniformData, InstanceData) + range.first * sizeof(M::MeshInstanceData),
+            &m_frameData.InstanceData[range.first], range.count * sizeof(M::MeshInstanceData));
+    }
 
-		// Special case required for only sponza's floor to be reflective.
-		GLuint materialId = 0;
-		if (instance.getMeshId() == 311)
-		{
-			materialId = m_materialManager->lookupMaterialId(100);
-		}
-		else
-		{
-			materialId = m_materialManager->lookupMaterialId(instance.getMaterialId());
-		}
+    m_sceneBounds->update(*m_jobs, changes);
+    m_pvs->markDynamic(m_sceneBounds->getMovedInstances());
+    m_maskedOcclusion->markDynamic(m_sceneBounds->getMovedInstances());
+}
 
-        const M::MeshInstanceData instanceData(modelTransform, materialId);
+void MyView::applySceneChanges(const sponza::SceneChanges& changes)
+{
+    m_sceneChangeStats.lights = (GLuint)changes.lights.size();
+    m_sceneChangeStats.materials = (GLuint)changes.materials.size();
+
+    if (changes.everything)
+    {
+        ++m_sceneChangeStats.fullUpdates;
+        m_materialManager->updateMaterialDataFromScene();
+        updateStaticData();
+        m_shadowScheduler->invalidate();
+        return;
+    }
+
+    // Lights are rebuilt from the scene every frame, but shadow maps are kept by position in the light lists,
+    // which adding or removing a light shifts. Directional lights live in the static data.
+    bool lightsAddedOrRemoved = false;
+    bool directionalChanged = false;
+    for (const auto& light : changes.lights)
+    {
+        lightsAddedOrRemoved |= (light.changes & (sponza::LIGHT_ADDED | sponza::LIGHT_REMOVED)) != 0;
+        for (const auto& directional : scene_->getAllDirectionalLights())
+        {
+            directionalChanged |= directional.getId() == light.id;
+        }
+    }
+
+    if (lightsAddedOrRemoved)
+    {
+        m_shadowScheduler->invalidate();
+    }
 
-        m_frameData.InstanceData[counter] = instanceData;
-        ++counter;
+    if (directionalChanged)
+    {
+        updateStaticData();
     }
 
-    m_uniformManager->updateBufferData(M::UniformBufferId::Frame, &m_frameData, sizeof(m_frameData));
+    // Only the edited materials are converted and uploaded.
+    if (!changes.materials.empty())
+    {
+        m_materialManager->updateMaterials(changes.materials);
+        const auto& materialData = m_materialManager->getMaterialData();
+        const auto materialCount = sizeof(m_staticData.Materials) / sizeof(m_staticData.Materials[0]);
+
+        for (const auto sponzaId : changes.materials)
+        {
+            const auto index = m_materialManager->lookupMaterialId(sponzaId);
+            if (index < materialCount)
+            {
+                m_staticData.Materials[index] = materialData[index];
+                m_uniformManager->updateBufferData(M::UniformBufferId::Static,
+                    offsetof(M::StaticUniformData, Materials) + index * sizeof(M::ShaderMaterial),
+                    &m_staticData.Materials[index], sizeof(M::ShaderMaterial));
+            }
+        }
+    }
 }
 
-void MyView::updateShadowData()
+void MyView::updateShadowData(const glm::mat4& viewProjection)
 {
-    auto shadowPerspective = glm::perspective(m_lightData.Angle * 2, 1.f, 0.1f, m_lightData.Range);
-    auto shadowView = glm::lookAt(m_lightData.Position, m_lightData.Position + m_lightData.Direction, (const glm::vec3&)scene_->getUpDirection());
-    m_shadowData.VP = shadowPerspective * shadowView;
+    m_shadowData.VP = viewProjection;
     m_uniformManager->updateBufferData(M::UniformBufferId::Shadow, &m_shadowData, sizeof(m_shadowData));
 }
 
+glm::mat4 MyView::getShadowViewProjection(const M::ShaderLight& light) const
+{
+    auto shadowPerspective = glm::perspective(light.Angle * 2, 1.f, 0.1f, light.Range);
+    auto shadowView = glm::lookAt(light.Position, light.Position + light.Direction, (const glm::vec3&)scene_->getUpDirection());
+    return shadowPerspective * shadowView;
+}
+
 void MyView::updateViewportData()
 {
+    // Every target is only replaced when the size it holds outgrows its capacity, passes otherwise keeping to
+    // the corner the viewport covers. Targets at render resolution share one capacity, the TAA history follows
+    // the window instead.
+    m_targetCapacity->beginResize();
+    m_outputCapacity->beginResize();
+    const bool grow = m_targetCapacity->fit(m_renderWidth, m_renderHeight);
+    const bool outputGrow = m_outputCapacity->fit(m_windowWidth, m_windowHeight);
+    if (grow)
+    {
+        allocateRenderTargets();
+    }
+    if (outputGrow)
+    {
+        m_taa->setCapacity(m_outputCapacity->getWidth(), m_outputCapacity->getHeight());
+    }
+    m_smaa->resizeBuffers(m_renderWidth, m_renderHeight);
+    m_taa->resizeBuffers(m_renderWidth, m_renderHeight, m_windowWidth, m_windowHeight);
+    m_postProcess->resize(m_renderWidth, m_renderHeight, m_windowWidth, m_windowHeight);
+    uploadViewportData();
+    m_targetCapacity->endResize(grow);
+    m_outputCapacity->endResize(outputGrow);
+}
+
+void MyView::uploadViewportData()
+{
+    // Everything up to the final upscale works at render resolution, in the corner of targets at capacity.
+    const auto capacityWidth = (float)m_targetCapacity->getWidth();
+    const auto capacityHeight = (float)m_targetCapacity->getHeight();
+
     M::ViewportData data;
-    data.PixelHeight = 1.f / m_windowHeight;
-    data.PixelWidth = 1.f / m_windowWidth;
-    data.ScreenHeight = m_windowHeight;
-    data.ScreenWidth = m_windowWidth;
+    data.PixelWidth = 1.f / capacityWidth;
+    data.PixelHeight = 1.f / capacityHeight;
+    data.TargetWidth = capacityWidth;
+    data.TargetHeight = capacityHeight;
+    data.ViewportScaleX = m_renderWidth / capacityWidth;
+    data.ViewportScaleY = m_renderHeight / capacityHeight;
+    data.ViewportWidth = (float)m_renderWidth;
+    data.ViewportHeight = (float)m_renderHeight;
     m_uniformManager->updateBufferData(M::UniformBufferId::Viewport, &data, sizeof(data));
+}
+
+void MyView::allocateRenderTargets()
+{
+    const auto width = m_targetCapacity->getWidth();
+    const auto height = m_targetCapacity->getHeight();
+    MU::resizeGBuffer(width, height, m_gBuffer, m_lBuffer);
+    MU::resizeLBuffer(width, height, m_lBuffer);
+    m_smaa->setCapacity(width, height);
+    m_postProcess->setCapacity(width, height);
+}
+
+void MyView::updateRenderResolution(float scale)
+{
+    m_renderWidth = std::max(1, (GLint)(m_windowWidth * scale + 0.5f));
+    m_renderHeight = std::max(1, (GLint)(m_windowHeight * scale + 0.5f));
+}
+
+void MyView::applyQualitySettings(const M::QualitySettings& settings)
+{
+    if (settings.shadowResolution != m_shadowRes)
+    {
+        m_shadowRes = settings.shadowResolution;
+        m_shadowScheduler->setResolution(m_shadowRes);
+    }
 
-    // Resize necessary frambuffers.
-    MU::resizeFramebuffers(m_windowWidth, m_windowHeight, m_gBuffer, m_lBuffer);
-    m_ssr->resize(m_windowWidth, m_windowHeight);
-    m_smaa->resizeBuffers(m_windowWidth, m_windowHeight);
+    m_ssr->setStepCount(settings.ssrStepCount);
+
+    const auto renderWidth = m_renderWidth;
+    const auto renderHeight = m_renderHeight;
+    updateRenderResolution(settings.resolutionScale);
+    if (renderWidth != m_renderWidth || renderHeight != m_renderHeight)
+    {
+        updateViewportData();
+    }
 }
 
 void MyView::windowViewRender(tygra::Window * window)
 {
 	assert(scene_ != nullptr);
 
+    m_targetCapacity->frameStarted();
+    m_outputCapacity->frameStarted();
+    m_jobs->beginFrame();
+    m_renderQueue->beginFrame();
+    M::Resources::beginFrame();
+
     // Update per frame uniforms.
     updateFrameData();
+
+    // Lights are culled against the unjittered view so their scissor rectangles don't shimmer with TAA.
+    m_lightCuller->beginFrame(m_frameData.UnjitteredViewProjectionMatrix, m_renderWidth, m_renderHeight);
+    m_pointOcclusion->beginFrame();
+    m_spotOcclusion->beginFrame();
+    scheduleLights();
+    cullInstances();
+
+    m_profiler->beginQuery(M::ProfileKey::FrameTime);
+
+    // Scene passes run at render resolution, post processing brings the result up to window size.
+    glViewport(0, 0, m_renderWidth, m_renderHeight);
     
+    m_profiler->beginQuery(M::ProfileKey::GBufferTime);
     drawGBuffer();
+    m_profiler->endQuery(M::ProfileKey::GBufferTime);
     
+    m_profiler->beginQuery(M::ProfileKey::AmbientTime);
     drawAmbient();
+    m_profiler->endQuery(M::ProfileKey::AmbientTime);
 
+    m_profiler->beginQuery(M::ProfileKey::PointLightTime);
     drawPointLights();
+    m_profiler->endQuery(M::ProfileKey::PointLightTime);
 
+    m_profiler->beginQuery(M::ProfileKey::SpotLightTime);
     drawSpotLights();
+    m_profiler->endQuery(M::ProfileKey::SpotLightTime);
 
-    GLuint inputTex = m_lBuffer.color;
+    // Post processing ping-pongs from the LBuffer, with the last enabled pass writing to the screen.
+    // TAA takes the place of SMAA when both are enabled.
+    const bool antiAliasing = m_useTAA || m_useSMAA;
+    const GLuint postProcessPasses = (m_enableSSR ? 1 : 0) + (antiAliasing ? 1 : 0);
+    m_postProcess->begin(m_lBuffer.color, m_lBuffer.fbo, postProcessPasses);
 
     if (m_enableSSR)
     {
-        m_ssr->run(inputTex, m_lBuffer.depth, m_lBuffer.fbo);
+        const auto step = m_postProcess->nextStep();
+        m_profiler->beginQuery(M::ProfileKey::SSRTime);
+        m_ssr->run(step.input, m_lBuffer.depth, step.outputFbo, step.exposure);
+        m_profiler->endQuery(M::ProfileKey::SSRTime);
     }
 
-    if (m_useSMAA)
+    if (m_useTAA)
     {
-        m_smaa->runSMAA(inputTex);
+        // TAA resolves into its output resolution history, upscaling as it goes.
+        const auto step = m_postProcess->nextStep(false, true);
+        m_profiler->beginQuery(M::ProfileKey::TAATime);
+        m_taa->run(step.input, step.inputFbo, m_gBuffer.velocityTex, step.outputFbo, step.exposure);
+        m_profiler->endQuery(M::ProfileKey::TAATime);
+    }
+    else if (m_useSMAA)
+    {
+        const auto step = m_postProcess->nextStep();
+        m_profiler->beginQuery(M::ProfileKey::SMAATime);
+        if (m_useComputeSMAA)
+        {
+            m_smaa->runComputeSMAA(step.input, step.inputFbo, step.outputFbo, step.exposure);
+        }
+        else
+        {
+            m_smaa->runSMAA(step.input, step.outputFbo, step.exposure);
+        }
+        m_profiler->endQuery(M::ProfileKey::SMAATime);
     }
 
-    else
+    m_postProcess->end();
+
+    m_profiler->endQuery(M::ProfileKey::FrameTime);
+    m_profiler->endFrame();
+    m_gBufferStatistics->endFrame();
+    ++m_frameIndex;
+
+    // Oversized targets are given back once the render size has settled.
+    if (m_targetCapacity->endFrame())
+    {
+        m_targetCapacity->beginResize();
+        allocateRenderTargets();
+        uploadViewportData();
+        m_targetCapacity->endResize(true);
+    }
+    if (m_outputCapacity->endFrame())
+    {
+        m_outputCapacity->beginResize();
+        m_taa->setCapacity(m_outputCapacity->getWidth(), m_outputCapacity->getHeight());
+        m_outputCapacity->endResize(true);
+    }
+
+    if (m_simulation != nullptr)
     {
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-        glBlitFramebuffer(0, 0, m_windowWidth, m_windowHeight, 0, 0, m_windowWidth, m_windowHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        m_simulation->frameSubmitted();
+    }
+
+    if (m_enableGovernor)
+    {
+        const auto gpuFrameMs = m_profiler->getAverageTime(M::ProfileKey::FrameTime);
+        if (m_governor->update(gpuFrameMs))
+        {
+            // Only reported when the settings change, as printing every frame would cost frames of its own.
+            const auto& settings = m_governor->getSettings();
+            applyQualitySettings(settings);
+            std::cout << "Governor: GPU " << gpuFrameMs << "ms, render " << m_renderWidth << "x" << m_renderHeight
+                << " (" << settings.resolutionScale << "), shadows " << settings.shadowResolution
+                << ", SSR steps " << settings.ssrStepCount << std::endl;
+        }
     }
 }
 
-void MyView::toggleShadows()
+void MyView::cycleShadowFilter()
 {
-    m_enableShadows = !m_enableShadows;
+    m_shadowFilter = (M::ShadowFilter)((m_shadowFilter + 1) % 4);
+
+    // Cached maps only hold moments if they were rendered for EVSM.
+    m_shadowScheduler->invalidate();
+    std::cout << "Shadows: " << g_shadowFilterNames[m_shadowFilter] << std::endl;
 }
 
 void MyView::toggleSSR()
@@ -206,14 +579,241 @@ void MyView::toggleSMAA()
     m_useSMAA = !m_useSMAA;
 }
 
+void MyView::toggleComputeSMAA()
+{
+    m_useComputeSMAA = !m_useComputeSMAA;
+}
+
+void MyView::toggleTAA()
+{
+    m_useTAA = !m_useTAA;
+
+    // History from before TAA was last disabled is no longer valid.
+    m_taa->reset();
+}
+
+void MyView::toggleLightBudget()
+{
+    m_enableLightBudget = !m_enableLightBudget;
+    m_lightBudget->setEnabled(m_enableLightBudget);
+}
+
+void MyView::toggleShadowScheduler()
+{
+    m_shadowScheduler->setEnabled(!m_shadowScheduler->isEnabled());
+    std::cout << "Shadow scheduler: " << (m_shadowScheduler->isEnabled() ? "on" : "off, every visible map each frame") << std::endl;
+}
+
+void MyView::toggleLayeredPointShadows()
+{
+    m_pointShadows->setLayered(!m_pointShadows->isLayered());
+    std::cout << "Point shadows: " << (m_pointShadows->isLayered() ? "layered, culled per face" : "six passes") << std::endl;
+}
+
+void MyView::toggleInstanceCulling()
+{
+    m_enableInstanceCulling = !m_enableInstanceCulling;
+    std::cout << "Instance frustum culling: " << (m_enableInstanceCulling ? "on" : "off") << std::endl;
+}
+
+void MyView::toggleBVHQueries()
+{
+    m_useBVHQueries = !m_useBVHQueries;
+    std::cout << "Shadow caster queries: " << (m_useBVHQueries ? "instance BVH" : "every instance") << std::endl;
+}
+
+void MyView::togglePVS()
+{
+    if (!m_pvs->isReady())
+    {
+        std::cout << "Baking PVS..." << std::endl;
+        m_pvs->bake(*m_jobs, m_sceneBounds->getInstanceBoxes());
+        if (!m_pvs->save(g_pvsPath))
+        {
+            std::cout << "Couldn't write " << g_pvsPath << std::endl;
+        }
+        m_pvs->printStats();
+        m_enablePVS = true;
+    }
+    else
+    {
+        m_enablePVS = !m_enablePVS;
+    }
+    std::cout << "PVS: " << (m_enablePVS ? "on" : "off") << std::endl;
+}
+
+void MyView::toggleMaskedOcclusion()
+{
+    m_enableMaskedOcclusion = !m_enableMaskedOcclusion;
+    std::cout << "Masked occlusion culling: " << (m_enableMaskedOcclusion ? "on" : "off") << std::endl;
+}
+
+void MyView::toggleDrawSorting()
+{
+    m_sortDraws = !m_sortDraws;
+    std::cout << "Draw order: " << (m_sortDraws ? "front to back" : "instance order") << std::endl;
+}
+
+void MyView::toggleDirectStateAccess()
+{
+    if (!M::Resources::isDSAAvailable())
+    {
+        std::cout << "Direct state access needs GL 4.5, resources are edited by binding them" << std::endl;
+        return;
+    }
+
+    M::Resources::setUseDSA(!M::Resources::usesDSA());
+    std::cout << "Resource edits and texture binds: " << (M::Resources::usesDSA() ? "direct state access" : "bind to edit")
+        << ", press F6 for last frame's bind counts" << std::endl;
+}
+
+void MyView::pickInstance()
+{
+    const auto& camera = scene_->getCamera();
+    M::BvhRay ray;
+    ray.origin = (const glm::vec3&)camera.getPosition();
+    ray.direction = glm::normalize((const glm::vec3&)camera.getDirection());
+    ray.maxDistance = camera.getFarPlaneDistance();
+
+    const auto hit = m_sceneBounds->getBVH().queryRay(ray);
+    if (hit.instance == M::InstanceBVH::NoHit)
+    {
+        std::cout << "Picked nothing" << std::endl;
+        return;
+    }
+
+    const auto& instance = scene_->getAllInstances()[hit.instance];
+    std::cout << "Picked instance " << instance.getId() << " (mesh " << instance.getMeshId() << ", material "
+        << instance.getMaterialId() << (instance.isStatic() ? ", static" : "") << ") " << hit.distance << " away" << std::endl;
+}
+
+void MyView::toggleOcclusion()
+{
+    m_enableOcclusion = !m_enableOcclusion;
+}
+
+void MyView::toggleGovernor()
+{
+    m_enableGovernor = !m_enableGovernor;
+
+    // Start again from full quality either way, the governor works back down if it needs to.
+    delete m_governor;
+    m_governor = new M::QualityGovernor();
+    applyQualitySettings(m_governor->getSettings());
+}
+
+void MyView::cycleLightFormat()
+{
+    // RGBA8 is kept to compare against, it clips and isn't tonemapped. Both HDR formats blend the same lights so
+    // the light pass timings show the bandwidth difference.
+    const GLenum formats[] = { GL_R11F_G11F_B10F, GL_RGBA16F, GL_RGBA8 };
+    const char* names[] = { "R11F_G11F_B10F (4 bytes)", "RGBA16F (8 bytes)", "RGBA8 (4 bytes, LDR)" };
+
+    m_lightFormat = (m_lightFormat + 1) % 3;
+    MU::setLBufferFormat(formats[m_lightFormat], m_lBuffer);
+
+    m_postProcess->setFormat(m_lBuffer.format);
+    m_postProcess->setExposure(m_lBuffer.format == GL_RGBA8 ? 0.f : m_exposure);
+    m_taa->reset();
+
+    std::cout << "Light accumulation format: " << names[m_lightFormat] << std::endl;
+}
+
+void MyView::printTimings()
+{
+    // Shadow map and spot light times are for the current filtering tier, cycle it to compare.
+    std::cout << "Shadows: " << g_shadowFilterNames[m_shadowFilter] << std::endl;
+    m_profiler->printTimings();
+    m_lightCuller->printStats();
+    m_pointOcclusion->printStats();
+    m_spotOcclusion->printStats();
+    m_lightBudget->printStats();
+    m_pointShadows->printStats();
+    m_shadowScheduler->printStats();
+    m_sceneBounds->getBVH().printStats();
+    m_pvs->printStats();
+    if (m_enableMaskedOcclusion)
+    {
+        m_maskedOcclusion->printStats();
+    }
+    if (m_sortDraws)
+    {
+        m_drawSorter->printStats();
+    }
+    m_gBufferStatistics->printStats(m_renderWidth * m_renderHeight);
+    m_renderQueue->printStats();
+    m_meshManager->printStats();
+    M::Resources::printStats();
+    m_targetCapacity->printStats();
+    m_outputCapacity->printStats();
+    if (m_simulation != nullptr)
+    {
+        m_simulation->printStats();
+    }
+
+    std::cout << "Instance culling" << (m_enableInstanceCulling ? "" : " (off)") << ": " << m_instanceCullStats.cameraVisible
+        << " of " << m_instanceCullStats.cameraTested << " in view, " << m_instanceCullStats.shadowVisible << " of "
+        << m_instanceCullStats.shadowTested << " across " << m_instanceCullStats.shadowViews << " shadow frusta" << std::endl;
+
+    std::cout << "Scene changes (version " << m_sceneVersion << "): " << m_sceneChangeStats.instancesWritten << " of "
+        << scene_->getAllInstances().size() << " instances rewritten, " << m_sceneBounds->getUpdatedCount()
+        << " rebounded, " << m_sceneChangeStats.lights << " lights and " << m_sceneChangeStats.materials
+        << " materials changed, " << m_sceneChangeStats.fullUpdates << " full updates" << std::endl;
+
+    m_jobs->printTrace();
+}
+
+void MyView::writeJobTrace()
+{
+    m_jobs->writeTrace(g_jobTracePath);
+    std::cout << "Wrote the last frame's job trace to " << g_jobTracePath << std::endl;
+}
+
+void MyView::runJobBenchmark()
+{
+    // The synthetic scene takes a moment to build, so it's only made when first asked for.
+    if (m_jobBenchmark == nullptr)
+    {
+        m_jobBenchmark = new M::JobBenchmark(*m_jobs);
+    }
+
+    m_jobBenchmark->run(m_frameData.UnjitteredViewProjectionMatrix, m_renderWidth, m_renderHeight);
+}
+
+void MyView::runRenderQueueBenchmark()
+{
+    // Draws need the G-buffer bound, so the benchmark waits for the next frame's.
+    m_runQueueBenchmark = true;
+}
+
 void MyView::drawGBuffer()
 {
     MU::unbindGBufferTextures();
     glBindFramebuffer(GL_FRAMEBUFFER, m_gBuffer.fbo);
+    if (m_runQueueBenchmark)
+    {
+        // Whatever the benchmark drew is cleared away with the rest of the G-buffer.
+        m_renderQueue->runBenchmark(M::MeshGroup::Sponza, g_queueBenchmarkDraws);
+        m_runQueueBenchmark = false;
+        m_glStateManager->setState(M::DrawPass::GBufferPass);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
     m_glStateManager->setState(M::DrawPass::GBufferPass); // Set GL variables.
     glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-    m_shaderManager->useProgram(M::ShaderProgram::GBufferProgram); // Use program.
-    m_meshManager->drawMeshGroup(M::MeshGroup::Sponza); // Draw Sponza.
+
+    // Drawn through the render queue, which sets the program and binds the VAO.
+    M::DrawPacket packet;
+    packet.Program = M::ShaderProgram::GBufferProgram;
+    packet.State = M::DrawPass::GBufferPass;
+    if (fillSponzaPacket(m_visibleInstances, packet))
+    {
+        m_renderQueue->record(M::RenderQueue::makeKey(0, packet.State, packet.Program, packet.VaoId, 0)) = packet;
+    }
+
+    m_gBufferStatistics->begin();
+    m_renderQueue->execute();
+    m_gBufferStatistics->end();
 }
 
 void MyView::drawAmbient()
@@ -226,74 +826,478 @@ void MyView::drawAmbient()
     m_meshManager->drawMeshGroup(M::MeshGroup::Quad);
 }
 
-void MyView::drawPointLights()
+void MyView::scheduleLights()
 {
-    m_shaderManager->useProgram(M::ShaderProgram::PointLight); // Use program.
+    const auto lightGpuMs = m_profiler->getAverageTime(M::ProfileKey::PointLightTime) +
+        m_profiler->getAverageTime(M::ProfileKey::SpotLightTime);
+    m_lightBudget->beginFrame(m_frameData.EyePosition, m_renderWidth, m_renderHeight, lightGpuMs);
+
+    // Point and spot lights compete for the same budget, spot keys follow on from the point lights.
+    const auto& points = scene_->getAllPointLights();
+    const auto& spots = scene_->getAllSpotLights();
 
-    for (const auto& point : scene_->getAllPointLights())
+    // Lights are built and culled across the job threads, then gathered in order on this one so the budget sees
+    // them the same way however the work was split.
+    const auto cullLights = [&](const char* name, size_t count, GLuint firstKey, bool spot, std::vector<M::ScheduledLight>& culled)
     {
-        m_lightData = M::ShaderLight(point);
-        m_uniformManager->updateBufferData(M::UniformBufferId::Light, &m_lightData, sizeof(m_lightData));
+        m_lightScratch.resize(count);
+        m_lightVisible.assign(count, 0);
+        m_lightBounds.resize(count);
+        m_jobs->parallelFor(name, count, 64, [&](size_t begin, size_t end)
+        {
+            for (auto i = begin; i < end; ++i)
+            {
+                auto& light = m_lightScratch[i];
+                light.index = (GLuint)i;
+                light.key = firstKey + (GLuint)i;
+                light.rect = M::ScissorRect();
+                light.light = spot ? M::ShaderLight(spots[i]) : M::ShaderLight(points[i]);
+                m_lightBounds.set(i, spot ? M::LightCuller::getSpotBounds(light.light) : glm::vec4(light.light.Position, light.light.Range));
+            }
+        });
+
+        // The frustum test runs over every light in batches, the scissor and cutoffs only over those inside.
+        m_lightCuller->cullBounds(m_lightBounds, m_lightsInFrustum);
+        m_jobs->parallelFor(name, m_lightsInFrustum.size(), 64, [&](size_t begin, size_t end)
+        {
+            for (auto j = begin; j < end; ++j)
+            {
+                const auto i = m_lightsInFrustum[j];
+                auto& light = m_lightScratch[i];
+                m_lightVisible[i] = spot ? m_lightCuller->cullSpotLight(light.light, light.rect, true) :
+                    m_lightCuller->cullPointLight(light.light, light.rect, true);
+            }
+        });
+
+        culled.clear();
+        for (const auto i : m_lightsInFrustum)
+        {
+            if (m_lightVisible[i])
+            {
+                culled.push_back(m_lightScratch[i]);
+                m_lightBudget->addCandidate(m_lightScratch[i]);
+            }
+        }
+    };
 
-        m_glStateManager->setState(M::DrawPass::LightStencilPass);
-        m_meshManager->drawMeshGroup(M::MeshGroup::Sphere);
+    cullLights("Cull point lights", points.size(), 0, false, m_pointLights);
+    cullLights("Cull spot lights", spots.size(), (GLuint)points.size(), true, m_spotLights);
 
-        m_glStateManager->setState(M::DrawPass::LightShadingPass);
-        m_meshManager->drawMeshGroup(M::MeshGroup::Sphere);
+    m_lightBudget->schedule();
+
+    assignPointShadows();
+    scheduleShadows();
+}
+
+void MyView::cullInstances()
+{
+    m_meshManager->beginFrame();
+    m_instanceCullStats = InstanceCullStats();
+    m_drawSorter->resetStats();
+
+    // Culled against the unjittered view, TAA's sub-pixel offset is well inside the spheres' slack.
+    const auto& spheres = m_sceneBounds->getInstanceSpheres();
+    M::FrustumCuller(m_frameData.UnjitteredViewProjectionMatrix).cull(*m_jobs, spheres, m_visibleInstances);
+    m_instanceCullStats.cameraTested = (GLuint)spheres.count;
+    m_instanceCullStats.cameraVisible = (GLuint)m_visibleInstances.size();
+
+    // Only the camera's passes use the PVS, lights see the scene from elsewhere. Without instance culling the
+    // list isn't drawn from, so it's left alone to keep that a true baseline.
+    if (m_enableInstanceCulling && m_enablePVS)
+    {
+        m_pvs->filter((const glm::vec3&)scene_->getCamera().getPosition(), m_visibleInstances);
+    }
+
+    // Occluders are picked once the instances have bounds, the first frame through, and drop out as they move.
+    // Rasterising them is wasted when the list isn't drawn from.
+    if (m_enableInstanceCulling && m_enableMaskedOcclusion)
+    {
+        const auto& boxes = m_sceneBounds->getInstanceBoxes();
+        if (!m_maskedOcclusion->hasOccluders())
+        {
+            m_maskedOcclusion->buildOccluders(boxes);
+        }
+        m_maskedOcclusion->render(*m_jobs, m_frameData.UnjitteredViewProjectionMatrix);
+        m_maskedOcclusion->cull(*m_jobs, boxes, m_visibleInstances);
+    }
+
+    // Nearest first, so early depth testing rejects as much of what's behind as it can.
+    if (m_sortDraws)
+    {
+        m_drawSorter->sortFromPoint(m_sceneBounds->getInstanceBounds(), m_frameData.EyePosition, m_visibleInstances);
     }
 }
 
-void MyView::drawSpotLights()
+bool MyView::fillSponzaPacket(const std::vector<GLuint>& visibleInstances, M::DrawPacket& packet)
 {
-    for (const auto& spot : scene_->getAllSpotLights())
+    if (m_enableInstanceCulling)
     {
-        m_lightData = M::ShaderLight(spot);
-        m_uniformManager->updateBufferData(M::UniformBufferId::Light, &m_lightData, sizeof(m_lightData));
+        return m_meshManager->fillPacket(M::MeshGroup::Sponza, visibleInstances, packet);
+    }
 
-        if (m_enableShadows && m_lightData.CastsShadows)
+    m_meshManager->fillPacket(M::MeshGroup::Sponza, packet);
+    return true;
+}
+
+void MyView::drawSponza(const std::vector<GLuint>& visibleInstances)
+{
+    if (m_enableInstanceCulling)
+    {
+        m_meshManager->drawMeshGroup(M::MeshGroup::Sponza, visibleInstances);
+    }
+    else
+    {
+        m_meshManager->drawMeshGroup(M::MeshGroup::Sponza);
+    }
+}
+
+void MyView::scheduleShadows()
+{
+    m_shadowScheduler->beginFrame(m_profiler->getAverageTime(M::ProfileKey::ShadowMapTime), m_sceneBounds->getMovedBounds());
+
+    if (m_shadowFilter == M::ShadowFilter::ShadowsOff)
+    {
+        return;
+    }
+
+    // Every caster is tracked so changes while it's off screen or faded out are still noticed, only shaded ones
+    // are given a coverage and so considered for an update.
+    const auto& spots = scene_->getAllSpotLights();
+    std::vector<float> coverage(spots.size(), -1.f);
+    const auto screenArea = (float)std::max(1, m_renderWidth * m_renderHeight);
+    for (const auto& light : m_spotLights)
+    {
+        if (m_lightBudget->getFade(light.key) > 0.f)
         {
-            updateShadowData();
+            coverage[light.index] = light.rect.width * (float)light.rect.height / screenArea;
+        }
+    }
 
-            m_shaderManager->useProgram(M::ShaderProgram::Shadows);
+    for (GLuint i = 0; i < spots.size(); ++i)
+    {
+        if (spots[i].getCastShadow())
+        {
+            m_shadowScheduler->addCaster(i, M::ShaderLight(spots[i]), coverage[i]);
+        }
+    }
 
-            glBindFramebuffer(GL_FRAMEBUFFER, m_shadowMap.fbo);
-            m_glStateManager->setState(M::DrawPass::ShadowMapPass);
+    m_shadowScheduler->schedule();
+}
 
-            glActiveTexture(M::TextureSlot::TShadow);
-            glBindTexture(GL_TEXTURE_2D, 0);
+void MyView::assignPointShadows()
+{
+    m_pointShadows->beginFrame();
 
-            glClear(GL_DEPTH_BUFFER_BIT);
+    if (m_shadowFilter == M::ShadowFilter::ShadowsOff)
+    {
+        return;
+    }
 
-            glViewport(0, 0, m_shadowRes, m_shadowRes);
+    std::vector<M::ScheduledLight*> shaded;
+    for (auto& light : m_pointLights)
+    {
+        if (m_lightBudget->getFade(light.key) > 0.f)
+        {
+            shaded.push_back(&light);
+        }
+    }
 
-            m_meshManager->drawMeshGroup(M::MeshGroup::Sponza);
+    const auto count = std::min<size_t>(m_pointShadows->getSlotCount(), shaded.size());
+    std::partial_sort(shaded.begin(), shaded.begin() + count, shaded.end(),
+        [](const M::ScheduledLight* a, const M::ScheduledLight* b)
+        {
+            return a->rect.width * a->rect.height > b->rect.width * b->rect.height;
+        });
 
-            glViewport(0, 0, m_windowWidth, m_windowHeight);
+    for (GLuint slot = 0; slot < count; ++slot)
+    {
+        shaded[slot]->light.CastsShadows = 1;
+        shaded[slot]->light.ShadowSlot = slot;
+    }
+}
 
-            glBindTexture(GL_TEXTURE_2D, m_shadowMap.depthTex);
-            glActiveTexture(M::TextureSlot::TEmpty);
-            glBindTexture(GL_TEXTURE_2D, 0);
+bool MyView::setScheduledLight(const M::ScheduledLight& light)
+{
+    const auto fade = m_lightBudget->getFade(light.key);
+    if (fade <= 0.f)
+    {
+        return false;
+    }
 
-            glBindFramebuffer(GL_FRAMEBUFFER, m_lBuffer.fbo);
+    m_lightData = light.light;
+    m_lightData.Intensity *= fade;
+    m_uniformManager->updateBufferData(M::UniformBufferId::Light, &m_lightData, sizeof(m_lightData));
+    glScissor(light.rect.x, light.rect.y, light.rect.width, light.rect.height);
+    return true;
+}
 
-            m_shaderManager->useProgram(M::ShaderProgram::SpotShadow); // Use program.
+void MyView::drawPointLights()
+{
+    // Every cube is rendered up front so the array stays bound through the light loop, with the instances within
+    // each light's range found together beforehand.
+    m_pointShadowSpheres.clear();
+    for (const auto& light : m_pointLights)
+    {
+        if (light.light.ShadowSlot >= 0)
+        {
+            m_pointShadowSpheres.push_back(glm::vec4(light.light.Position, light.light.Range));
+        }
+    }
 
-            m_glStateManager->setState(M::DrawPass::LightStencilPass);
-            m_meshManager->drawMeshGroup(M::MeshGroup::Cone);
+    if (m_useBVHQueries)
+    {
+        m_sceneBounds->getBVH().querySpheres(*m_jobs, m_pointShadowSpheres, m_pointShadowCasters);
+    }
 
-            m_glStateManager->setState(M::DrawPass::LightShadingPass);
-            m_meshManager->drawMeshGroup(M::MeshGroup::Cone);
+    m_profiler->beginQuery(M::ProfileKey::PointShadowTime);
+    bool hasShadows = false;
+    size_t sphere = 0;
+    for (const auto& light : m_pointLights)
+    {
+        if (light.light.ShadowSlot >= 0)
+        {
+            // Nearest the light first, the order depth is written in from its point of view.
+            if (m_useBVHQueries && m_sortDraws)
+            {
+                m_drawSorter->sortFromPoint(m_sceneBounds->getInstanceBounds(), light.light.Position, m_pointShadowCasters[sphere]);
+            }
+            m_pointShadows->render(light.light.ShadowSlot, light.light, m_useBVHQueries ? &m_pointShadowCasters[sphere++] : nullptr);
+            hasShadows = true;
         }
-        else
+    }
+    m_profiler->endQuery(M::ProfileKey::PointShadowTime);
+
+    if (hasShadows)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_lBuffer.fbo);
+        glViewport(0, 0, m_renderWidth, m_renderHeight);
+    }
+
+    M::Resources::bindTexture(M::TextureSlot::TPointShadow, GL_TEXTURE_CUBE_MAP_ARRAY, hasShadows ? m_pointShadows->getTexture() : 0);
+
+    glEnable(GL_SCISSOR_TEST);
+
+    for (const auto& light : m_pointLights)
+    {
+        if (!setScheduledLight(light))
+        {
+            continue;
+        }
+
+        const auto program = light.light.ShadowSlot >= 0 ? M::ShaderProgram::PointShadow : M::ShaderProgram::PointLight;
+        m_shaderManager->useProgram(program); // Use program.
+
+        drawLightVolume(*m_pointOcclusion, light.index, light.rect, M::MeshGroup::Sphere, false);
+    }
+
+    glDisable(GL_SCISSOR_TEST);
+}
+
+void MyView::updateShadowMaps()
+{
+    // Scheduled maps are rendered up front rather than inside each light's conditional block, so a map the
+    // scheduler counts as fresh can't have been skipped on the GPU.
+    m_profiler->beginQuery(M::ProfileKey::ShadowMapTime);
+
+    // The casters of every map due are found together, one cone per light as nothing outside it can be lit.
+    m_spotShadowCones.clear();
+    for (const auto& light : m_spotLights)
+    {
+        if (m_shadowScheduler->needsUpdate(light.index))
+        {
+            m_spotShadowCones.push_back({ light.light.Position, light.light.Range, glm::normalize(light.light.Direction), light.light.Angle });
+        }
+    }
+
+    if (m_useBVHQueries)
+    {
+        m_instanceCullStats.shadowTested += m_sceneBounds->getBVH().queryCones(*m_jobs, m_spotShadowCones, m_spotShadowCasters);
+    }
+
+    bool updated = false;
+    size_t cone = 0;
+    for (const auto& light : m_spotLights)
+    {
+        if (!m_shadowScheduler->needsUpdate(light.index))
         {
-            m_shaderManager->useProgram(M::ShaderProgram::SpotLight); // Use program.
+            continue;
+        }
+
+        const auto& shadowMap = m_shadowScheduler->getShadowMap(light.index);
+        const auto viewProjection = getShadowViewProjection(light.light);
+        updateShadowData(viewProjection);
+
+        m_shaderManager->useProgram(M::ShaderProgram::Shadows);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, shadowMap.fbo);
+        m_glStateManager->setState(M::DrawPass::ShadowMapPass);
+
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        glViewport(0, 0, m_shadowRes, m_shadowRes);
 
-            m_glStateManager->setState(M::DrawPass::LightStencilPass);
-            m_meshManager->drawMeshGroup(M::MeshGroup::Cone);
+        // Each map only needs what's inside its light's frustum.
+        auto& casters = m_useBVHQueries ? m_spotShadowCasters[cone++] : m_shadowInstances;
+        if (!m_useBVHQueries)
+        {
+            M::FrustumCuller(viewProjection).cull(m_sceneBounds->getInstanceSpheres(), m_shadowInstances);
+            m_instanceCullStats.shadowTested += (GLuint)m_sceneBounds->getInstanceSpheres().count;
+        }
+        if (m_sortDraws)
+        {
+            m_drawSorter->sortFromPoint(m_sceneBounds->getInstanceBounds(), light.light.Position, casters);
+        }
+        m_instanceCullStats.shadowVisible += (GLuint)casters.size();
+        ++m_instanceCullStats.shadowViews;
+        drawSponza(casters);
 
-            m_glStateManager->setState(M::DrawPass::LightShadingPass);
-            m_meshManager->drawMeshGroup(M::MeshGroup::Cone);
+        if (m_shadowFilter == M::ShadowFilter::EVSMFilter)
+        {
+            filterShadowMap(shadowMap);
         }
+
+        m_shadowScheduler->markUpdated(light.index, viewProjection);
+        updated = true;
+    }
+
+    m_profiler->endQuery(M::ProfileKey::ShadowMapTime);
+
+    if (updated)
+    {
+        glViewport(0, 0, m_renderWidth, m_renderHeight);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_lBuffer.fbo);
+    }
+}
+
+void MyView::drawSpotLights()
+{
+    // Shadow textures are unbound while maps are rendered, one may be drawn into.
+    M::Resources::bindTexture(M::TextureSlot::TShadow, GL_TEXTURE_2D, 0);
+
+    if (m_shadowFilter != M::ShadowFilter::ShadowsOff)
+    {
+        updateShadowMaps();
+    }
+
+    // Each filtering tier has its own variant of the shadowed spot light program.
+    auto shadowProgram = M::ShaderProgram::SpotShadow;
+    switch (m_shadowFilter)
+    {
+    case M::ShadowFilter::PCFFilter:
+        shadowProgram = M::ShaderProgram::SpotShadowPCF;
+        break;
+    case M::ShadowFilter::EVSMFilter:
+        shadowProgram = M::ShaderProgram::SpotShadowEVSM;
+        break;
+    default:
+        break;
+    }
+
+    for (const auto& light : m_spotLights)
+    {
+        if (!setScheduledLight(light))
+        {
+            continue;
+        }
+
+        const bool castsShadows = m_shadowFilter != M::ShadowFilter::ShadowsOff && m_lightData.CastsShadows &&
+            m_shadowScheduler->hasShadowMap(light.index);
+        const auto program = castsShadows ? shadowProgram : M::ShaderProgram::SpotLight;
+        m_shaderManager->useProgram(program); // Use program.
+
+        if (castsShadows)
+        {
+            // Lights are shaded with the view their map was rendered from, which lags a moving light until its
+            // next update.
+            const auto& shadowMap = m_shadowScheduler->getShadowMap(light.index);
+            updateShadowData(m_shadowScheduler->getViewProjection(light.index));
+
+            M::Resources::bindTexture(M::TextureSlot::TShadow, GL_TEXTURE_2D, m_shadowFilter == M::ShadowFilter::EVSMFilter ? shadowMap.momentsTex : shadowMap.depthTex);
+            glBindSampler(M::TextureSlot::TShadow - GL_TEXTURE0, m_shadowFilter == M::ShadowFilter::PCFFilter ? shadowMap.compareSampler : 0);
+        }
+
+        glEnable(GL_SCISSOR_TEST);
+        drawLightVolume(*m_spotOcclusion, light.index, light.rect, M::MeshGroup::Cone, castsShadows);
+        glDisable(GL_SCISSOR_TEST);
+    }
+
+    glBindSampler(M::TextureSlot::TShadow - GL_TEXTURE0, 0);
+}
+
+void MyView::filterShadowMap(const M::ShadowMap& shadowMap)
+{
+    // Moments are written at half resolution, blurred separably and mipmapped, so lighting needs a single
+    // trilinear fetch per pixel.
+    const auto momentsRes = std::max(1u, m_shadowRes / 2);
+    glViewport(0, 0, momentsRes, momentsRes);
+    m_glStateManager->setState(M::DrawPass::ShadowFilterPass);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, shadowMap.momentsFbo);
+    m_shaderManager->useProgram(M::ShaderProgram::ShadowMoments);
+    M::Resources::bindTexture(M::TextureSlot::TInput, GL_TEXTURE_2D, shadowMap.depthTex);
+    m_meshManager->drawMeshGroup(M::MeshGroup::Quad);
+
+    const auto direction = m_shaderManager->getUniformLocation(M::ShaderProgram::ShadowBlur, M::UniformId::UDirection);
+    m_shaderManager->useProgram(M::ShaderProgram::ShadowBlur);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, shadowMap.blurFbo);
+    glUniform2f(direction, 1.f, 0.f);
+    M::Resources::bindTexture(M::TextureSlot::TInput, GL_TEXTURE_2D, shadowMap.momentsTex);
+    m_meshManager->drawMeshGroup(M::MeshGroup::Quad);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, shadowMap.momentsFbo);
+    glUniform2f(direction, 0.f, 1.f);
+    M::Resources::bindTexture(M::TextureSlot::TInput, GL_TEXTURE_2D, shadowMap.blurTex);
+    m_meshManager->drawMeshGroup(M::MeshGroup::Quad);
+
+    M::Resources::bindTexture(M::TextureSlot::TInput, GL_TEXTURE_2D, 0);
+    M::Resources::generateMipmap(shadowMap.momentsTex, GL_TEXTURE_2D);
+}
+
+void MyView::drawLightVolume(M::LightOcclusion& occlusion, GLuint index, const M::ScissorRect& rect,
+                             M::MeshGroup volume, bool castsShadows)
+{
+    // Only volumes that may contain the camera need the stencil to find the lit pixels. Their front faces are
+    // clipped away by the near plane, so a query would miss them and they always render.
+    if (rect.crossesNearPlane)
+    {
+        m_glStateManager->setState(M::DrawPass::LightStencilPass);
+        m_meshManager->drawMeshGroup(volume);
+
+        m_glStateManager->setState(M::DrawPass::LightShadingPass);
+        m_meshManager->drawMeshGroup(volume);
+        return;
+    }
+
+    // The rest are a single depth tested draw of their front faces, which the query counts as it shades. A query
+    // inside a draw the last result discarded would count nothing, so lights last seen hidden are given a
+    // colourless draw to query instead, or they could never reappear.
+    const bool query = m_enableOcclusion;
+    const bool separateQuery = query && occlusion.isHidden(index);
+    if (separateQuery)
+    {
+        m_glStateManager->setState(M::DrawPass::LightQueryPass);
+        occlusion.beginQuery(index);
+        m_meshManager->drawMeshGroup(volume);
+        occlusion.endQuery();
+    }
+
+    const bool conditional = query && occlusion.beginConditionalRender(index, castsShadows);
+
+    m_glStateManager->setState(M::DrawPass::LightVolumePass);
+    if (query && !separateQuery)
+    {
+        occlusion.beginQuery(index);
+    }
+    m_meshManager->drawMeshGroup(volume);
+    if (query && !separateQuery)
+    {
+        occlusion.endQuery();
+    }
+
+    if (conditional)
+    {
+        occlusion.endConditionalRender();
     }
 }
 
@@ -309,6 +1313,7 @@ void MyView::updateAspectRatio(bool resizeFramebuffers)
 
     if (resizeFramebuffers)
     {
+        updateRenderResolution(m_governor->getSettings().resolutionScale);
         updateViewportData();
     }
 }
\ No newline at end of file
@@ -2,8 +2,12 @@
 
 #include "MLK/Utils.hpp"
 #include "MLK/ShaderStructs.hpp"
+#include "MLK/LightBudget.hpp"
+#include "MLK/FrustumCuller.hpp"
+#include "MLK/InstanceBVH.hpp"
 
 #include <sponza/sponza_fwd.hpp>
+#include <sponza/ChangeJournal.hpp>
 #include <tygra/WindowViewDelegate.hpp>
 #include <tgl/tgl.h>
 #include <glm/glm.hpp>
@@ -25,6 +29,26 @@ namespace MLK
     class GlStateManager;
     class SMAA;
     class SSR;
+    class TAA;
+    class PostProcessChain;
+    class Profiler;
+    class QualityGovernor;
+    class LightCuller;
+    class LightOcclusion;
+    class PointShadows;
+    class SceneBounds;
+    class PotentialVisibility;
+    class MaskedOcclusion;
+    class DrawSorter;
+    class PipelineStatistics;
+    class RenderQueue;
+    class TargetCapacity;
+    struct DrawPacket;
+    class ShadowScheduler;
+    class Simulation;
+    class JobSystem;
+    class JobBenchmark;
+    struct QualitySettings;
 }
 
 namespace M = MLK;
@@ -38,6 +62,9 @@ public:
 
     void setScene(const sponza::Context * sponza);
 
+    // Frames are reported to the simulation once submitted, for its timings.
+    void setSimulation(M::Simulation* simulation);
+
 private:
     void windowViewWillStart(tygra::Window * window) override;
 
@@ -54,31 +81,113 @@ private:
 public:
     void recompileShaders();
 
-    void toggleShadows();
+    void cycleShadowFilter();
     void toggleSSR();
     void toggleSMAA();
+    void toggleComputeSMAA();
+    void toggleTAA();
+    void toggleGovernor();
+    void toggleOcclusion();
+    void toggleInstanceCulling();
+    void toggleBVHQueries();
+
+    // Turns filtering by the camera's PVS cell on or off, baking the sets first if there are none yet.
+    void togglePVS();
+
+    void toggleMaskedOcclusion();
+
+    // Switches the G-buffer and shadow casters between front to back order and instance order.
+    void toggleDrawSorting();
+
+    // Switches resource edits and texture binds between GL 4.5 direct state access and binding to edit.
+    void toggleDirectStateAccess();
+
+    void toggleLightBudget();
+    void toggleShadowScheduler();
+    void toggleLayeredPointShadows();
+    void cycleLightFormat();
+    void printTimings();
+
+    // Writes the last frame's jobs as a Chrome trace, kept off printTimings so printing stats doesn't write files.
+    void writeJobTrace();
+
+    // Times the per frame CPU work serially and across the job threads on a 100k instance, 10k light scene.
+    void runJobBenchmark();
+
+    // Times CPU submission of thousands of draws through the render queue against drawing each as it's made.
+    void runRenderQueueBenchmark();
+
+    // Prints the instance at the centre of the screen, the nearest whose bounds the camera's view ray enters.
+    void pickInstance();
 
 private:
     void updateStaticData();
     void updateFrameData();
-    void updateShadowData();
+
+    // Applies the light and material changes the scene has journalled since the last frame.
+    void applySceneChanges(const sponza::SceneChanges& changes);
+    void updateShadowData(const glm::mat4& viewProjection);
+    glm::mat4 getShadowViewProjection(const M::ShaderLight& light) const;
     void updateViewportData();
+    void uploadViewportData();
+    void allocateRenderTargets();
+
+    // Scales the window size down to the internal resolution used up to post processing.
+    void updateRenderResolution(float scale);
+    void applyQualitySettings(const M::QualitySettings& settings);
 
     // Internal drawing calls which allows for quick addition/removal of certain steps.
     // These could be made public to allow for the aspects that are drawn to be chosen.
     void drawGBuffer();
     void drawAmbient();
+    // Culls the scene's lights and picks the ones to shade within the light budget.
+    void scheduleLights();
+
+    // Uploads a scheduled light and sets its scissor, returns false if it's been faded out.
+    bool setScheduledLight(const M::ScheduledLight& light);
+
+    // Gives the point lights covering the most of the screen a slot in the point shadow maps.
+    void assignPointShadows();
+
+    // Tracks the shadow casting spot lights and picks the maps to refresh this frame.
+    void scheduleShadows();
+
+    // Frustum culls the scene's instances against the camera, resetting the culled draw buffers for the frame.
+    void cullInstances();
+
+    // Draws the given instances of Sponza, or all of it with instance culling off.
+    void drawSponza(const std::vector<GLuint>& visibleInstances);
+
+    // Fills in <packet>'s draw of Sponza as drawSponza would make it, returning false when there's nothing to draw.
+    bool fillSponzaPacket(const std::vector<GLuint>& visibleInstances, M::DrawPacket& packet);
+
     void drawPointLights();
     void drawSpotLights();
 
+    // Renders the spot shadow maps the scheduler picked for this frame.
+    void updateShadowMaps();
+
+    // Turns a shadow map's depth into the blurred, mipmapped moments EVSM filtering samples.
+    void filterShadowMap(const M::ShadowMap& shadowMap);
+
+    // Shades the light in the light uniform block using its volume mesh, conditionally on last frame's occlusion
+    // query for light <index>. The shading draw is this frame's query where it can be.
+    void drawLightVolume(M::LightOcclusion& occlusion, GLuint index, const M::ScissorRect& rect,
+                         M::MeshGroup volume, bool castsShadows);
+
     // Updates the aspect ratio required for calculate view/projection matrix.
     void updateAspectRatio(bool resizeFramebuffers = true);
 
 private:
     GLint m_windowWidth = 0;
     GLint m_windowHeight = 0;
+    GLint m_renderWidth = 0;
+    GLint m_renderHeight = 0;
     GLuint m_shadowRes = 2048;
     float m_aspectRatio = 0;
+    GLuint m_frameIndex = 0;
+    GLuint m_lightFormat = 0;
+    float m_exposure = 1.f;
 
     MLK::PerFrameUniformData m_frameData;
     MLK::StaticUniformData m_staticData;
@@ -92,14 +201,91 @@ private:
     M::GlStateManager* m_glStateManager = nullptr;
     M::SSR* m_ssr = nullptr;
     M::SMAA* m_smaa = nullptr;
+    M::TAA* m_taa = nullptr;
+    M::PostProcessChain* m_postProcess = nullptr;
+    M::Profiler* m_profiler = nullptr;
+    M::QualityGovernor* m_governor = nullptr;
+    M::LightCuller* m_lightCuller = nullptr;
+    M::LightOcclusion* m_pointOcclusion = nullptr;
+    M::LightOcclusion* m_spotOcclusion = nullptr;
+    M::LightBudget* m_lightBudget = nullptr;
+    M::PointShadows* m_pointShadows = nullptr;
+    M::SceneBounds* m_sceneBounds = nullptr;
+    M::PotentialVisibility* m_pvs = nullptr;
+    M::MaskedOcclusion* m_maskedOcclusion = nullptr;
+    M::DrawSorter* m_drawSorter = nullptr;
+    M::PipelineStatistics* m_gBufferStatistics = nullptr;
+    M::RenderQueue* m_renderQueue = nullptr;
+    M::TargetCapacity* m_targetCapacity = nullptr;
+    M::TargetCapacity* m_outputCapacity = nullptr;
+    M::ShadowScheduler* m_shadowScheduler = nullptr;
+    M::Simulation* m_simulation = nullptr;
+    M::JobSystem* m_jobs = nullptr;
+    M::JobBenchmark* m_jobBenchmark = nullptr;
 
-    bool m_enableShadows = true;
+    M::ShadowFilter m_shadowFilter = M::ShadowFilter::PCFFilter;
     bool m_enableSSR = true;
     bool m_useSMAA = true;
+    bool m_useComputeSMAA = false;
+    bool m_useTAA = false;
+    bool m_enableGovernor = false;
+    bool m_enableOcclusion = true;
+    bool m_enableLightBudget = true;
+    bool m_enableInstanceCulling = true;
+    bool m_useBVHQueries = true;
+    bool m_enablePVS = true;
+    bool m_enableMaskedOcclusion = true;
+    bool m_sortDraws = true;
+    bool m_runQueueBenchmark = false;
 
 private:
     M::GBuffer m_gBuffer;
     M::LBuffer m_lBuffer;
-    M::ShadowMap m_shadowMap;
+
+    std::vector<M::ScheduledLight> m_pointLights;
+    std::vector<M::ScheduledLight> m_spotLights;
+
+    // Every light of a type before culling, and whether it survived, filled in parallel then compacted.
+    std::vector<M::ScheduledLight> m_lightScratch;
+    std::vector<GLubyte> m_lightVisible;
+    M::SphereBoundsSoA m_lightBounds;
+    std::vector<GLuint> m_lightsInFrustum;
+
+    // Instances inside the camera's frustum, and the current shadow map's, nearest first when draws are sorted
+    // and otherwise as ascending instance ids.
+    std::vector<GLuint> m_visibleInstances;
+    std::vector<GLuint> m_shadowInstances;
+
+    // Volumes of the lights whose shadow maps are rendered this frame, and the instances each can shadow, found
+    // together through the instance BVH.
+    std::vector<M::BvhCone> m_spotShadowCones;
+    std::vector<std::vector<GLuint>> m_spotShadowCasters;
+    std::vector<glm::vec4> m_pointShadowSpheres;
+    std::vector<std::vector<GLuint>> m_pointShadowCasters;
+
+    struct InstanceCullStats
+    {
+        GLuint cameraTested = 0;
+        GLuint cameraVisible = 0;
+        GLuint shadowTested = 0;
+        GLuint shadowVisible = 0;
+        GLuint shadowViews = 0;
+    };
+    InstanceCullStats m_instanceCullStats;
+
+    // Scene version the renderer has caught up to, and the instances that changed in the last frame's update.
+    sponza::ChangeJournal::Version m_sceneVersion = 0;
+    std::vector<sponza::InstanceRange> m_changedInstances;
+    std::vector<sponza::InstanceRange> m_instanceUpdates;
+    std::vector<GLuint> m_instanceUpdateIds;
+
+    struct SceneChangeStats
+    {
+        GLuint instancesWritten = 0;
+        GLuint lights = 0;
+        GLuint materials = 0;
+        GLuint fullUpdates = 0;
+    };
+    SceneChangeStats m_sceneChangeStats;
 
 };
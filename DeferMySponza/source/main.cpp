@@ -21,7 +21,8 @@ int main(int argc, char *argv[])
         const int window_height = 720;
         const int number_of_samples = 1;
 
-        if (window->open(window_width, window_height, number_of_samples, true))
+        // Compute shaders need a 4.3 context.
+        if (window->open(window_width, window_height, number_of_samples, true, 4, 3))
         {
             while (window->isVisible()) {
                 window->update();
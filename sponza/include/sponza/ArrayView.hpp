@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+
+namespace sponza {
+
+/**
+ * A read-only view of a contiguous array owned by someone else, such as the
+ * context's instance arrays. Nothing is copied, so the view is only valid
+ * until the owner next changes the array's size.
+ */
+template<typename T>
+class ArrayView
+{
+public:
+
+    ArrayView() : data_(nullptr), size_(0) {}
+
+    ArrayView(const T * data, std::size_t size) : data_(data), size_(size) {}
+
+    const T * data() const { return data_; }
+
+    std::size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    const T * begin() const { return data_; }
+
+    const T * end() const { return data_ + size_; }
+
+    const T& operator[](std::size_t i) const { return data_[i]; }
+
+private:
+
+    const T * data_;
+    std::size_t size_;
+
+};
+
+} // end namespace sponza
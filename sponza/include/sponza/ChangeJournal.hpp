@@ -0,0 +1,113 @@
+#pragma once
+
+#include "sponza_fwd.hpp"
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+namespace sponza {
+
+/**
+ * A run of instances whose data changed, as indices into
+ * Context::getAllInstances() and the context's instance arrays.
+ */
+struct InstanceRange
+{
+    std::size_t first;
+    std::size_t count;
+};
+
+/**
+ * Sorts ranges by their first instance and merges any that overlap or
+ * touch, as SceneChanges::instances are.
+ */
+void mergeInstanceRanges(std::vector<InstanceRange>& ranges);
+
+/**
+ * What happened to a light, combined as bits when a light changed more than
+ * once over the versions asked about.
+ */
+enum LightChange
+{
+    LIGHT_ADDED = 1,
+    LIGHT_MOVED = 2,
+    LIGHT_REMOVED = 4
+};
+
+struct LightEvent
+{
+    LightId id;
+    unsigned int changes;
+};
+
+/**
+ * Everything that changed between two versions of a scene. When the changes
+ * are no longer journalled, or the caller has seen no version yet, every
+ * flag is set instead and the lists are empty.
+ */
+struct SceneChanges
+{
+    bool everything{ false };
+
+    // Sorted, with overlapping and touching ranges merged.
+    std::vector<InstanceRange> instances;
+
+    // One entry per light, in the order each first changed.
+    std::vector<LightEvent> lights;
+
+    // Each edited material once, in the order first edited.
+    std::vector<MaterialId> materials;
+
+    bool empty() const;
+};
+
+/**
+ * A short history of what the context changed, kept as a change set per
+ * version so renderers can do work in proportion to what changed rather
+ * than to the size of the scene. Each consumer remembers the last version
+ * it caught up to and asks for the changes since; a version of zero means
+ * nothing has been seen yet. Only the latest few versions are kept, so a
+ * consumer that falls further behind is told everything changed.
+ */
+class ChangeJournal
+{
+public:
+
+    typedef unsigned long long Version;
+
+    ChangeJournal();
+
+    Version getVersion() const;
+
+    SceneChanges getChangesSince(Version since) const;
+
+    void recordInstances(std::size_t first, std::size_t count);
+
+    void recordLight(LightId id, LightChange change);
+
+    void recordMaterial(MaterialId id);
+
+    // Closes the changes recorded so far as a new version, if there were any.
+    void commit();
+
+private:
+
+    struct ChangeSet
+    {
+        std::vector<InstanceRange> instances;
+        std::vector<LightEvent> lights;
+        std::vector<MaterialId> materials;
+    };
+
+    static void mergeLight(std::vector<LightEvent>& lights, LightId id, unsigned int changes);
+
+    Version version_;
+
+    ChangeSet pending_;
+
+    // Change sets of the latest versions, the back being the current version.
+    std::deque<ChangeSet> history_;
+
+};
+
+} // end namespace sponza
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "sponza_fwd.hpp"
+#include "ArrayView.hpp"
+#include "ChangeJournal.hpp"
 #include <vector>
 #include <chrono>
 #include <memory>
@@ -43,12 +45,40 @@ public:
 
     const Instance& getInstanceById(InstanceId id) const;
 
-    const std::vector<InstanceId> getInstancesByMeshId(MeshId id) const;
+    const std::vector<InstanceId>& getInstancesByMeshId(MeshId id) const;
+
+    // Instance data as parallel arrays in the same order as getAllInstances(),
+    // with each mesh's instances contiguous. Transforms are tightly packed so
+    // they can be copied straight into a GPU buffer.
+
+    ArrayView<Matrix4x3> getInstanceTransforms() const;
+
+    ArrayView<MeshId> getInstanceMeshIds() const;
+
+    ArrayView<MaterialId> getInstanceMaterialIds() const;
+
+    ArrayView<unsigned char> getInstanceStaticFlags() const;
+
+    // Changes made by update() and the functions below, a version per update.
+
+    const ChangeJournal& getChangeJournal() const;
+
+    void addPointLight(const PointLight& light);
+
+    void addSpotLight(const SpotLight& light);
+
+    bool removeLight(LightId id);
+
+    void setMaterial(const Material& material);
 
 private:
 
     bool readFile(std::string filepath);
 
+    void buildInstanceArrays();
+
+    void setInstanceTransform(std::size_t index, const Matrix4x3& xform);
+
     std::chrono::system_clock::time_point start_time_;
     float time_seconds_;
 
@@ -68,6 +98,16 @@ private:
 
     std::vector<std::vector<InstanceId>> instances_by_mesh_;
 
+    std::vector<Matrix4x3> instance_transforms_;
+
+    std::vector<MeshId> instance_mesh_ids_;
+
+    std::vector<MaterialId> instance_material_ids_;
+
+    std::vector<unsigned char> instance_static_flags_;
+
+    ChangeJournal journal_;
+
 };
 
 } // end namespace sponza
@@ -17,7 +17,7 @@ public:
 
     MaterialId getMaterialId() const;
 
-    Matrix4x3 getTransformationMatrix() const;
+    const Matrix4x3& getTransformationMatrix() const;
 
     void setStatic(bool b);
     void setMeshId(MeshId id);
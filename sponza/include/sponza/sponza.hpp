@@ -1,7 +1,9 @@
 #pragma once
 
 #include "sponza_fwd.hpp"
+#include "ArrayView.hpp"
 #include "Camera.hpp"
+#include "ChangeJournal.hpp"
 #include "Context.hpp"
 #include "GeometryBuilder.hpp"
 #include "Instance.hpp"
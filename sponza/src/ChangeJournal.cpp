@@ -0,0 +1,129 @@
+#include <sponza/sponza.hpp>
+
+#include <algorithm>
+
+using namespace sponza;
+
+// Versions kept, enough for a consumer to skip a few frames without
+// having to start over.
+static const std::size_t max_history = 16;
+
+void sponza::mergeInstanceRanges(std::vector<InstanceRange>& ranges)
+{
+    std::sort(ranges.begin(), ranges.end(),
+              [](const InstanceRange& a, const InstanceRange& b) { return a.first < b.first; });
+
+    std::size_t merged = 0;
+    for (std::size_t i = 1; i < ranges.size(); ++i)
+    {
+        auto& last = ranges[merged];
+        const auto& range = ranges[i];
+        if (range.first <= last.first + last.count) {
+            last.count = std::max(last.count, range.first + range.count - last.first);
+        } else {
+            ranges[++merged] = range;
+        }
+    }
+    if (!ranges.empty()) {
+        ranges.resize(merged + 1);
+    }
+}
+
+bool SceneChanges::empty() const
+{
+    return !everything && instances.empty() && lights.empty() && materials.empty();
+}
+
+ChangeJournal::ChangeJournal() : version_(0)
+{
+}
+
+ChangeJournal::Version ChangeJournal::getVersion() const
+{
+    return version_;
+}
+
+SceneChanges ChangeJournal::getChangesSince(Version since) const
+{
+    SceneChanges changes;
+
+    if (since == 0 || since > version_ || version_ - since > history_.size()) {
+        changes.everything = true;
+        return changes;
+    }
+
+    for (auto set = history_.end() - (std::ptrdiff_t)(version_ - since); set != history_.end(); ++set)
+    {
+        changes.instances.insert(changes.instances.end(), set->instances.begin(), set->instances.end());
+
+        for (const auto& light : set->lights) {
+            mergeLight(changes.lights, light.id, light.changes);
+        }
+
+        for (const auto material : set->materials) {
+            if (std::find(changes.materials.begin(), changes.materials.end(), material) == changes.materials.end()) {
+                changes.materials.push_back(material);
+            }
+        }
+    }
+
+    mergeInstanceRanges(changes.instances);
+
+    return changes;
+}
+
+void ChangeJournal::recordInstances(std::size_t first, std::size_t count)
+{
+    // Instances tend to change in index order, so most runs just grow.
+    if (!pending_.instances.empty()) {
+        auto& last = pending_.instances.back();
+        if (first >= last.first && first <= last.first + last.count) {
+            last.count = std::max(last.count, first + count - last.first);
+            return;
+        }
+    }
+
+    pending_.instances.push_back({ first, count });
+}
+
+void ChangeJournal::recordLight(LightId id, LightChange change)
+{
+    mergeLight(pending_.lights, id, change);
+}
+
+void ChangeJournal::recordMaterial(MaterialId id)
+{
+    if (std::find(pending_.materials.begin(), pending_.materials.end(), id) == pending_.materials.end()) {
+        pending_.materials.push_back(id);
+    }
+}
+
+void ChangeJournal::commit()
+{
+    if (pending_.instances.empty() && pending_.lights.empty() && pending_.materials.empty()) {
+        return;
+    }
+
+    history_.push_back(ChangeSet());
+    history_.back().instances.swap(pending_.instances);
+    history_.back().lights.swap(pending_.lights);
+    history_.back().materials.swap(pending_.materials);
+    ++version_;
+
+    if (history_.size() > max_history) {
+        history_.pop_front();
+    }
+}
+
+void ChangeJournal::mergeLight(std::vector<LightEvent>& lights, LightId id, unsigned int changes)
+{
+    for (auto& light : lights)
+    {
+        if (light.id == id) {
+            light.changes |= changes;
+            return;
+        }
+    }
+
+    lights.push_back({ id, changes });
+}
@@ -4,6 +4,7 @@
 #include <tcf/tcf.hpp>
 #include <tcf/SimpleScene.hpp>
 
+#include <algorithm>
 #include <random>
 #include <cmath>
 
@@ -163,10 +164,41 @@ bool Context::readFile(std::string filepath)
 
     reader->release();
     tcf_scene->release();
+
+    buildInstanceArrays();
     
     return true;
 }
 
+void Context::buildInstanceArrays()
+{
+    instance_transforms_.clear();
+    instance_mesh_ids_.clear();
+    instance_material_ids_.clear();
+    instance_static_flags_.clear();
+
+    instance_transforms_.reserve(instances_.size());
+    instance_mesh_ids_.reserve(instances_.size());
+    instance_material_ids_.reserve(instances_.size());
+    instance_static_flags_.reserve(instances_.size());
+
+    for (const auto& instance : instances_)
+    {
+        instance_transforms_.push_back(instance.getTransformationMatrix());
+        instance_mesh_ids_.push_back(instance.getMeshId());
+        instance_material_ids_.push_back(instance.getMaterialId());
+        instance_static_flags_.push_back(instance.isStatic() ? 1 : 0);
+    }
+}
+
+void Context::setInstanceTransform(std::size_t index, const Matrix4x3& xform)
+{
+    // Both layouts are kept so the instance objects stay valid alongside the arrays.
+    instances_[index].setTransformationMatrix(xform);
+    instance_transforms_[index] = xform;
+    journal_.recordInstances(index, 1);
+}
+
 void Context::update()
 {
     const auto clock_time = std::chrono::system_clock::now() - start_time_;
@@ -204,42 +236,56 @@ void Context::update()
 
     const float t = time_seconds_;
 
+    // Lights can be added and removed after the first update, so they're only
+    // created once and animated by id rather than by position in the lists.
+    const bool first_update = directional_lights_.empty();
+
     const int num_of_directional_lights = 2;
-    if (directional_lights_.empty())
+    if (first_update)
     {
         directional_lights_.assign({ DirectionalLight(401), DirectionalLight(402) });
 
         directional_lights_[0].setDirection(normalize(Vector3(-10, -5, -2)));
 
         directional_lights_[1].setDirection(normalize(Vector3(10, 5, 2)));
+
+        for (const auto& light : directional_lights_) {
+            journal_.recordLight(light.getId(), LIGHT_ADDED);
+        }
     }
 
     const int num_of_point_lights = 20;
-    if (point_lights_.empty())
+    const LightId first_point_light_id = directional_lights_.back().getId() + 1;
+    if (first_update)
     {
         auto r = std::default_random_engine(0);
         auto rand = std::uniform_real_distribution<float>(0.6f, 1.f);
-        const LightId base_id = directional_lights_.back().getId();
+        const LightId base_id = first_point_light_id;
         for (int i = 0; i < num_of_point_lights; ++i)
         {
             auto light = PointLight(LightId(base_id + i));
             light.setRange(20.f);
             light.setIntensity(Vector3(rand(r), rand(r), rand(r)));
             point_lights_.push_back(light);
+            journal_.recordLight(light.getId(), LIGHT_ADDED);
         }
     }
 
-    for (int i = 0; i < num_of_point_lights; ++i)
+    for (auto& light : point_lights_)
     {
-        auto& light = point_lights_[i];
+        const int i = int(light.getId() - first_point_light_id);
+        if (i < 0 || i >= num_of_point_lights) continue;
+
 		float A = time_seconds_ + i * 6.28f / num_of_point_lights;
         light.setPosition(Vector3(120.f * cosf(A), 10.f, 40.f * sinf(A)));
+        journal_.recordLight(light.getId(), LIGHT_MOVED);
     }
 
     const int num_of_spot_lights = 5;
-    if (spot_lights_.empty())
+    const LightId first_spot_light_id = first_point_light_id + num_of_point_lights;
+    if (first_update)
     {
-        const LightId base_id = point_lights_.back().getId();
+        const LightId base_id = first_spot_light_id;
         for (int i = 0; i < num_of_spot_lights; ++i)
         {
             auto light = SpotLight(LightId(base_id + i));
@@ -267,23 +313,37 @@ void Context::update()
         spot_lights_[4].setConeAngleDegrees(90.f);
         spot_lights_[4].setCastShadow(false);
         spot_lights_[4].setStatic(true);
-    }
 
-    spot_lights_[0].setPosition(Vector3(75.f, 110.f, -5.f + 15.f * cosf(t)));
-    spot_lights_[0].setDirection(normalize(Vector3(-40.f, 0.f, -5.f) - spot_lights_[0].getPosition()));
+        for (const auto& light : spot_lights_) {
+            journal_.recordLight(light.getId(), LIGHT_ADDED);
+        }
+    }
 
-    spot_lights_[1].setPosition(Vector3(-75.f, 110.f, -5.f + 15.f * cosf(1 + t)));
-    spot_lights_[1].setDirection(normalize(Vector3(40.f, 0.f, -5.f) - spot_lights_[1].getPosition()));
+    for (auto& light : spot_lights_)
+    {
+        if (light.getId() == first_spot_light_id) {
+            light.setPosition(Vector3(75.f, 110.f, -5.f + 15.f * cosf(t)));
+            light.setDirection(normalize(Vector3(-40.f, 0.f, -5.f) - light.getPosition()));
+        } else if (light.getId() == first_spot_light_id + 1) {
+            light.setPosition(Vector3(-75.f, 110.f, -5.f + 15.f * cosf(1 + t)));
+            light.setDirection(normalize(Vector3(40.f, 0.f, -5.f) - light.getPosition()));
+        } else {
+            continue;
+        }
+        journal_.recordLight(light.getId(), LIGHT_MOVED);
+    }
 
-    for (auto& instance : instances_)
+    for (std::size_t i = 0; i < instances_.size(); ++i)
     {
-        if (instance.getMeshId() != 300) continue;
+        if (instance_mesh_ids_[i] != 300) continue;
 
-        auto xform = instance.getTransformationMatrix();
+        auto xform = instance_transforms_[i];
         const float bounce_y = 4;
         xform.m31 = 6.6f + bounce_y * (0.5f + 0.5f * cosf(t));
-        instance.setTransformationMatrix(xform);
+        setInstanceTransform(i, xform);
     }
+
+    journal_.commit();
 }
 
 bool Context::toggleCameraAnimation()
@@ -351,7 +411,71 @@ const Instance& Context::getInstanceById(InstanceId id) const
     return instances_[id - 100];
 }
 
-const std::vector<InstanceId> Context::getInstancesByMeshId(MeshId id) const
+const std::vector<InstanceId>& Context::getInstancesByMeshId(MeshId id) const
 {
     return instances_by_mesh_[id - 300];
 }
+
+ArrayView<Matrix4x3> Context::getInstanceTransforms() const
+{
+    return ArrayView<Matrix4x3>(instance_transforms_.data(), instance_transforms_.size());
+}
+
+ArrayView<MeshId> Context::getInstanceMeshIds() const
+{
+    return ArrayView<MeshId>(instance_mesh_ids_.data(), instance_mesh_ids_.size());
+}
+
+ArrayView<MaterialId> Context::getInstanceMaterialIds() const
+{
+    return ArrayView<MaterialId>(instance_material_ids_.data(), instance_material_ids_.size());
+}
+
+ArrayView<unsigned char> Context::getInstanceStaticFlags() const
+{
+    return ArrayView<unsigned char>(instance_static_flags_.data(), instance_static_flags_.size());
+}
+
+const ChangeJournal& Context::getChangeJournal() const
+{
+    return journal_;
+}
+
+void Context::addPointLight(const PointLight& light)
+{
+    point_lights_.push_back(light);
+    journal_.recordLight(light.getId(), LIGHT_ADDED);
+}
+
+void Context::addSpotLight(const SpotLight& light)
+{
+    spot_lights_.push_back(light);
+    journal_.recordLight(light.getId(), LIGHT_ADDED);
+}
+
+bool Context::removeLight(LightId id)
+{
+    const auto has_id = [id](const auto& light) { return light.getId() == id; };
+
+    const auto point = std::find_if(point_lights_.begin(), point_lights_.end(), has_id);
+    if (point != point_lights_.end()) {
+        point_lights_.erase(point);
+        journal_.recordLight(id, LIGHT_REMOVED);
+        return true;
+    }
+
+    const auto spot = std::find_if(spot_lights_.begin(), spot_lights_.end(), has_id);
+    if (spot != spot_lights_.end()) {
+        spot_lights_.erase(spot);
+        journal_.recordLight(id, LIGHT_REMOVED);
+        return true;
+    }
+
+    return false;
+}
+
+void Context::setMaterial(const Material& material)
+{
+    materials_[material.getId() - 200] = material;
+    journal_.recordMaterial(material.getId());
+}
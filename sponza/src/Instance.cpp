@@ -45,7 +45,7 @@ void Instance::setMaterialId(MaterialId id)
     material_id = id;
 }
 
-Matrix4x3 Instance::getTransformationMatrix() const
+const Matrix4x3& Instance::getTransformationMatrix() const
 {
     return xform;
 }